@@ -0,0 +1,12 @@
+#ifndef _LIBNFTNL_BATCH_INTERNAL_H_
+#define _LIBNFTNL_BATCH_INTERNAL_H_
+
+#include <stdint.h>
+
+struct nftnl_batch;
+
+/* Bytes that can be written at nftnl_batch_buffer(), overrun included. */
+uint32_t nftnl_batch_room(struct nftnl_batch *batch);
+uint32_t nftnl_batch_overrun_size(const struct nftnl_batch *batch);
+
+#endif
@@ -10,6 +10,7 @@ struct nftnl_buf {
 	size_t		len;
 	uint32_t	off;
 	bool		fail;
+	bool		cbor;	/* binary, no trailing comma to strip */
 };
 
 #define NFTNL_BUF_INIT(__b, __buf, __len)			\
@@ -68,7 +69,6 @@ int nftnl_buf_reg(struct nftnl_buf *b, int type, union nftnl_data_reg *reg,
 #define QTHRESH			"qthreshold"
 #define RATE			"rate"
 #define SET			"set"
-#define SET_NAME		"set_name"
 #define SIZE			"size"
 #define SNAPLEN			"snaplen"
 #define SREG_ADDR_MAX		"sreg_addr_max"
@@ -79,6 +79,7 @@ int nftnl_buf_reg(struct nftnl_buf *b, int type, union nftnl_data_reg *reg,
 #define SREG_DATA		"sreg_data"
 #define SREG			"sreg"
 #define TABLE			"table"
+#define TIMEOUT			"timeout"
 #define TOTAL			"total"
 #define TYPE			"type"
 #define UNIT			"unit"
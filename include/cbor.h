@@ -0,0 +1,60 @@
+#ifndef LIBNFTNL_CBOR_INTERNAL_H
+#define LIBNFTNL_CBOR_INTERNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "common.h"
+#include "json.h"
+
+/*
+ * CBOR (RFC 7049) output carries the same document as JSON: the same keys,
+ * nesting and strings, numbers are encoded as integers. Maps and arrays are
+ * of indefinite length so that objects can be written piece by piece.
+ */
+#define NFTNL_CBOR_UINT		0x00
+#define NFTNL_CBOR_NEGINT	0x20
+#define NFTNL_CBOR_BYTES	0x40
+#define NFTNL_CBOR_TEXT		0x60
+#define NFTNL_CBOR_ARRAY	0x80
+#define NFTNL_CBOR_MAP		0xa0
+#define NFTNL_CBOR_TAG		0xc0
+#define NFTNL_CBOR_SIMPLE	0xe0
+
+#define NFTNL_CBOR_INDEF	0x1f
+#define NFTNL_CBOR_BREAK	0xff
+
+int nftnl_cbor_byte(char *buf, size_t size, uint8_t byte);
+int nftnl_cbor_uint(char *buf, size_t size, uint64_t val);
+int nftnl_cbor_int(char *buf, size_t size, int64_t val);
+int nftnl_cbor_str(char *buf, size_t size, const char *str);
+int nftnl_cbor_pair_str(char *buf, size_t size, const char *key,
+			const char *str);
+int nftnl_cbor_pair_uint(char *buf, size_t size, const char *key,
+			 uint64_t val);
+
+#ifdef JSON_PARSING
+/* length of an indefinite map or array */
+#define NFTNL_CBOR_COUNT_INDEF	UINT64_MAX
+
+struct nftnl_cbor_reader {
+	FILE			*fp;
+	size_t			pos;
+};
+
+int nftnl_cbor_reader_init(struct nftnl_cbor_reader *r, const void *data,
+			   enum nftnl_parse_input input,
+			   struct nftnl_parse_err *err);
+int nftnl_cbor_enter(struct nftnl_cbor_reader *r, uint8_t major,
+		     uint64_t *count, struct nftnl_parse_err *err);
+int nftnl_cbor_next(struct nftnl_cbor_reader *r, uint64_t *count,
+		    struct nftnl_parse_err *err);
+int nftnl_cbor_key(struct nftnl_cbor_reader *r, char *key, size_t size,
+		   struct nftnl_parse_err *err);
+int nftnl_cbor_skip(struct nftnl_cbor_reader *r, struct nftnl_parse_err *err);
+json_t *nftnl_cbor_load(struct nftnl_cbor_reader *r,
+			struct nftnl_parse_err *err);
+json_t *nftnl_cbor_create_root(const void *data, struct nftnl_parse_err *err,
+			       enum nftnl_parse_input input);
+#endif
+
+#endif /* LIBNFTNL_CBOR_INTERNAL_H */
@@ -18,15 +18,17 @@ enum nftnl_parse_input {
 	NFTNL_PARSE_FILE,
 };
 
+/* State of the *_nlmsg_parse() attribute callbacks. */
+struct nftnl_nlmsg_parse_ctx {
+	const struct nlattr	**tb;
+	uint32_t		mask;	/* attributes the caller asked for */
+};
+
 #include <stdio.h>
 
 int nftnl_cmd_header_snprintf(char *buf, size_t bufsize, uint32_t cmd,
 			   uint32_t format, uint32_t flags);
-int nftnl_cmd_header_fprintf(FILE *fp, uint32_t cmd, uint32_t format,
-			  uint32_t flags);
 int nftnl_cmd_footer_snprintf(char *buf, size_t bufsize, uint32_t cmd,
 			   uint32_t format, uint32_t flags);
-int nftnl_cmd_footer_fprintf(FILE *fp, uint32_t cmd, uint32_t format,
-			  uint32_t flags);
 
 #endif
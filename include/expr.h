@@ -13,6 +13,9 @@ struct nftnl_expr {
 struct nlmsghdr;
 
 void nftnl_expr_build_payload(struct nlmsghdr *nlh, struct nftnl_expr *expr);
+int nftnl_expr_build_payload_excl(struct nlmsghdr *nlh,
+				  const struct nftnl_expr *expr,
+				  uint32_t exclude);
 struct nftnl_expr *nftnl_expr_parse(struct nlattr *attr);
 
 
@@ -10,9 +10,15 @@
 #include "json.h"
 #include "linux_list.h"
 #include "set.h"
+#include "rule.h"
 #include "set_elem.h"
 #include "expr.h"
 #include "expr_ops.h"
 #include "buffer.h"
+#include "monitor.h"
+#include "sink.h"
+#include "cbor.h"
+#include "batch.h"
+#include "workers.h"
 
 #endif /* _LIBNFTNL_INTERNAL_H_ */
@@ -3,6 +3,7 @@
 
 #ifdef JSON_PARSING
 #include <jansson.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include "common.h"
 
@@ -20,7 +21,8 @@ const char *nftnl_jansson_parse_str(json_t *root, const char *node_name,
 				  struct nftnl_parse_err *err);
 bool nftnl_jansson_node_exist(json_t *root, const char *node_name);
 json_t *nftnl_jansson_create_root(const void *json, json_error_t *error,
-				struct nftnl_parse_err *err, enum nftnl_parse_input input);
+				struct nftnl_parse_err *err, enum nftnl_parse_input input,
+				enum nftnl_parse_type type);
 json_t *nftnl_jansson_get_node(json_t *root, const char *node_name,
 			     struct nftnl_parse_err *err);
 void nftnl_jansson_free_root(json_t *root);
@@ -30,8 +32,7 @@ int nftnl_jansson_str2num(json_t *root, const char *node_name, int base, void *o
 int nftnl_jansson_parse_reg(json_t *root, const char *node_name, int type,
 			  void *out, struct nftnl_parse_err *err);
 struct nftnl_expr *nftnl_jansson_expr_parse(json_t *root,
-					     struct nftnl_parse_err *err,
-					     struct nftnl_set_list *set_list);
+					     struct nftnl_parse_err *err);
 int nftnl_jansson_data_reg_parse(json_t *root, const char *node_name,
 			       union nftnl_data_reg *data_reg,
 			       struct nftnl_parse_err *err);
@@ -51,6 +52,46 @@ int nftnl_jansson_parse_elem(struct nftnl_set *s, json_t *tree,
 
 int nftnl_data_reg_json_parse(union nftnl_data_reg *reg, json_t *data,
 			    struct nftnl_parse_err *err);
+
+struct nftnl_jansson_stream {
+	enum nftnl_parse_input	input;
+	union {
+		FILE		*fp;
+		const char	*buf;
+	};
+	size_t			pos;
+	int			c;	/* lookahead, EOF at the end */
+	int			line;
+	int			column;
+	/* text of the value that is being loaded */
+	char			*val;
+	size_t			len;
+	size_t			size;
+	int			val_line;
+	int			val_column;
+	bool			record;
+	bool			oom;
+};
+
+void nftnl_jansson_stream_init(struct nftnl_jansson_stream *s,
+			       const void *data, enum nftnl_parse_input input);
+void nftnl_jansson_stream_free(struct nftnl_jansson_stream *s);
+int nftnl_jansson_stream_peek(struct nftnl_jansson_stream *s);
+int nftnl_jansson_stream_expect(struct nftnl_jansson_stream *s, int c,
+				struct nftnl_parse_err *err);
+int nftnl_jansson_stream_next(struct nftnl_jansson_stream *s, int close,
+			      struct nftnl_parse_err *err);
+int nftnl_jansson_stream_key(struct nftnl_jansson_stream *s, char *key,
+			     size_t size, struct nftnl_parse_err *err);
+int nftnl_jansson_stream_skip(struct nftnl_jansson_stream *s,
+			      struct nftnl_parse_err *err);
+int nftnl_jansson_stream_record(struct nftnl_jansson_stream *s,
+				struct nftnl_parse_err *err);
+json_t *nftnl_jansson_load(const char *val, size_t len, int line, int column,
+			   struct nftnl_parse_err *err);
+json_t *nftnl_jansson_stream_load(struct nftnl_jansson_stream *s,
+				  struct nftnl_parse_err *err);
+bool nftnl_jansson_stream_eof(struct nftnl_jansson_stream *s);
 #else
 #define json_t void
 #endif
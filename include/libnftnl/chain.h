@@ -64,9 +64,14 @@ int nftnl_chain_parse_file(struct nftnl_chain *c, enum nftnl_parse_type type,
 			 FILE *fp, struct nftnl_parse_err *err);
 int nftnl_chain_snprintf(char *buf, size_t size, struct nftnl_chain *t, uint32_t type, uint32_t flags);
 int nftnl_chain_fprintf(FILE *fp, struct nftnl_chain *c, uint32_t type, uint32_t flags);
+struct nftnl_sink;
+int nftnl_chain_output(struct nftnl_sink *sink, struct nftnl_chain *c, uint32_t type, uint32_t flags);
 
 #define nftnl_chain_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *t);
+/* Only decode the attributes in @mask, (1 << NFTNL_CHAIN_*). */
+int nftnl_chain_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				 struct nftnl_chain *c, uint32_t mask);
 
 struct nftnl_chain_list;
 
@@ -85,6 +90,10 @@ struct nftnl_chain_list_iter *nftnl_chain_list_iter_create(struct nftnl_chain_li
 struct nftnl_chain *nftnl_chain_list_iter_next(struct nftnl_chain_list_iter *iter);
 void nftnl_chain_list_iter_destroy(struct nftnl_chain_list_iter *iter);
 
+/* Chains are indexed when added, set family, table, name and handle first. */
+struct nftnl_chain *nftnl_chain_list_lookup_byname(struct nftnl_chain_list *list, uint32_t family, const char *table, const char *name);
+struct nftnl_chain *nftnl_chain_list_lookup_byhandle(struct nftnl_chain_list *list, uint32_t family, const char *table, uint64_t handle);
+
 /*
  * Compat
  */
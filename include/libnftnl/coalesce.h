@@ -0,0 +1,50 @@
+#ifndef _LIBNFTNL_COALESCE_H_
+#define _LIBNFTNL_COALESCE_H_
+
+#include <stdint.h>
+
+#include <libnftnl/monitor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nlmsghdr;
+
+/*
+ * Event coalescer: collects the events of a time window and reports only
+ * their net effect once the window is flushed. Objects are tracked by
+ * identity: table, chain and set by name, rules by handle and elements by
+ * set and key. Something that is created and deleted again within the
+ * window is not reported at all, an object that changes several times is
+ * reported once with its latest version, at the place it was first added.
+ * Deletions are reported before additions, and elements of the same set
+ * are grouped in one nftnl_set.
+ */
+struct nftnl_coalesce;
+
+struct nftnl_coalesce *nftnl_coalesce_alloc(void);
+void nftnl_coalesce_free(struct nftnl_coalesce *c);
+
+/*
+ * Takes over an object as nftnl_monitor decodes it, so this can be called
+ * from the monitor callback, which then returns NFTNL_MONITOR_CB_KEEP.
+ */
+int nftnl_coalesce_add(struct nftnl_coalesce *c, uint16_t type, void *obj);
+int nftnl_coalesce_nlmsg(struct nftnl_coalesce *c, const struct nlmsghdr *nlh);
+/* Number of objects that are waiting for the end of the window. */
+uint32_t nftnl_coalesce_pending(const struct nftnl_coalesce *c);
+
+/*
+ * Ends the window. The callback follows the nftnl_monitor conventions, it
+ * returns the number of events that were reported or -1.
+ */
+int nftnl_coalesce_flush(struct nftnl_coalesce *c,
+			 int (*cb)(uint16_t type, void *obj, void *data),
+			 void *data);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _LIBNFTNL_COALESCE_H_ */
@@ -14,6 +14,7 @@ enum nftnl_output_type {
 	NFTNL_OUTPUT_DEFAULT	= 0,
 	NFTNL_OUTPUT_XML,
 	NFTNL_OUTPUT_JSON,
+	NFTNL_OUTPUT_CBOR,	/* the JSON document in RFC 7049 encoding */
 };
 
 enum nftnl_output_flags {
@@ -36,6 +37,7 @@ enum nftnl_parse_type {
 	NFTNL_PARSE_NONE		= 0,
 	NFTNL_PARSE_XML,
 	NFTNL_PARSE_JSON,
+	NFTNL_PARSE_CBOR,	/* requires JSON parsing support, files only */
 	NFTNL_PARSE_MAX,
 };
 
@@ -50,6 +52,11 @@ int nftnl_parse_perror(const char *str, struct nftnl_parse_err *err);
 
 int nftnl_batch_is_supported(void);
 void nftnl_batch_begin(char *buf, uint32_t seq);
+/*
+ * Kernels that support it reject the batch with ERESTART if the ruleset
+ * generation is no longer @genid, older ones ignore it.
+ */
+void nftnl_batch_begin_genid(char *buf, uint32_t seq, uint32_t genid);
 void nftnl_batch_end(char *buf, uint32_t seq);
 
 /*
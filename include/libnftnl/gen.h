@@ -44,6 +44,32 @@ int nftnl_gen_fprintf(FILE *fp, struct nftnl_gen *gen, uint32_t type, uint32_t f
 #define nftnl_gen_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 int nftnl_gen_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_gen *gen);
 
+/*
+ * Commit on top of generation @genid, as read before building the batch,
+ * from the socket with port ID @portid. Pass the messages from a socket
+ * subscribed to NFNLGRP_NFTABLES to nftnl_gen_commit_event() after sending
+ * the batch, until it stops returning NFTNL_GEN_COMMIT_PENDING. On
+ * NFTNL_GEN_COMMIT_OK, nftnl_gen_commit_genid() is the generation that the
+ * batch created, so the next commit can be based on it without reading the
+ * ruleset again. On NFTNL_GEN_COMMIT_CONFLICT, another transaction came
+ * first. nftnl_gen_commit_event() also reports that before the NEWGEN
+ * message of the batch shows up.
+ */
+struct nftnl_gen_commit;
+
+enum {
+	NFTNL_GEN_COMMIT_PENDING	= 0,
+	NFTNL_GEN_COMMIT_OK,
+	NFTNL_GEN_COMMIT_CONFLICT,
+};
+
+struct nftnl_gen_commit *nftnl_gen_commit_alloc(uint32_t genid,
+						uint32_t portid);
+void nftnl_gen_commit_free(struct nftnl_gen_commit *gc);
+int nftnl_gen_commit_event(struct nftnl_gen_commit *gc,
+			   const struct nlmsghdr *nlh);
+uint32_t nftnl_gen_commit_genid(const struct nftnl_gen_commit *gc);
+
 /*
  * Compat
  */
@@ -0,0 +1,92 @@
+#ifndef _LIBNFTNL_MONITOR_H_
+#define _LIBNFTNL_MONITOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libnftnl/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event monitor: receives nf_tables events in batches, drops those that do
+ * not pass the filter before they are parsed, and hands the rest to the
+ * callback as objects: nftnl_table, nftnl_chain, nftnl_rule, nftnl_set (also
+ * for element events) or nftnl_gen. Objects are freed once the callback
+ * returns, unless it returns NFTNL_MONITOR_CB_KEEP to take them over. A
+ * negative return value stops the processing.
+ */
+struct nftnl_monitor;
+
+/*
+ * None of the MNL_CB_* values, so that a callback that returns MNL_CB_OK
+ * out of habit does not leak the objects.
+ */
+#define NFTNL_MONITOR_CB_KEEP	256
+
+struct nftnl_monitor *nftnl_monitor_alloc(void);
+void nftnl_monitor_free(struct nftnl_monitor *m);
+
+enum nftnl_monitor_attr {
+	NFTNL_MONITOR_TYPES	= 0,	/* mask of (1 << NFT_MSG_*) */
+	NFTNL_MONITOR_FAMILY,
+	NFTNL_MONITOR_TABLE,
+	NFTNL_MONITOR_SET,		/* set and element events only */
+	__NFTNL_MONITOR_MAX
+};
+#define NFTNL_MONITOR_MAX (__NFTNL_MONITOR_MAX - 1)
+
+void nftnl_monitor_set_u32(struct nftnl_monitor *m, uint16_t attr,
+			   uint32_t val);
+void nftnl_monitor_set_str(struct nftnl_monitor *m, uint16_t attr,
+			   const char *str);
+void nftnl_monitor_set_cb(struct nftnl_monitor *m,
+			  int (*cb)(uint16_t type, void *obj, void *data),
+			  void *data);
+
+struct nftnl_monitor_stats {
+	uint64_t	received;	/* messages received */
+	uint64_t	filtered;	/* dropped before parsing */
+	uint64_t	decoded;	/* handed to the callback */
+	uint64_t	errors;		/* messages that failed to parse */
+	uint64_t	lost;		/* ENOBUFS hits and truncated datagrams */
+};
+
+void nftnl_monitor_get_stats(const struct nftnl_monitor *m,
+			     struct nftnl_monitor_stats *stats);
+
+/* Subscribe to the nf_tables events, @rcvbuf sets the socket buffer size. */
+int nftnl_monitor_open(struct nftnl_monitor *m, unsigned int rcvbuf);
+int nftnl_monitor_fd(const struct nftnl_monitor *m);
+/*
+ * Returns the number of objects handed to the callback, or -1. It fails
+ * with ENOBUFS when events were lost, after handing over the ones that
+ * arrived in full.
+ */
+int nftnl_monitor_recv(struct nftnl_monitor *m);
+int nftnl_monitor_process(struct nftnl_monitor *m, const void *buf,
+			  size_t len);
+void nftnl_monitor_obj_free(uint16_t type, void *obj);
+
+/*
+ * NDJSON export: one compact JSON object per event and line, such as
+ * {"add":{"rule":{...}}} or {"delete":{"element":{...}}}. Once a sink is
+ * set, every event that passes the filter is written to it before the
+ * callback is called. nftnl_monitor_recv() flushes the sink after each
+ * batch of datagrams, callers of nftnl_monitor_process() flush it
+ * themselves. The sink is not freed with the monitor.
+ */
+struct nftnl_sink;
+
+void nftnl_monitor_set_sink(struct nftnl_monitor *m, struct nftnl_sink *sink);
+int nftnl_monitor_event_output(struct nftnl_sink *sink, uint16_t type,
+			       void *obj);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _LIBNFTNL_MONITOR_H_ */
@@ -60,9 +60,20 @@ int nftnl_rule_parse_file(struct nftnl_rule *r, enum nftnl_parse_type type,
 			FILE *fp, struct nftnl_parse_err *err);
 int nftnl_rule_snprintf(char *buf, size_t size, struct nftnl_rule *t, uint32_t type, uint32_t flags);
 int nftnl_rule_fprintf(FILE *fp, struct nftnl_rule *r, uint32_t type, uint32_t flags);
+struct nftnl_sink;
+int nftnl_rule_output(struct nftnl_sink *sink, struct nftnl_rule *r, uint32_t type, uint32_t flags);
 
 #define nftnl_rule_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *t);
+/*
+ * Only decode the attributes in @mask, (1 << NFTNL_RULE_*). Expressions are
+ * decoded with NFTNL_RULE_PARSE_EXPRS, and only those of type @expr_name
+ * unless it is NULL. The family is always set.
+ */
+#define NFTNL_RULE_PARSE_EXPRS	(1U << 31)
+int nftnl_rule_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				struct nftnl_rule *r, uint32_t mask,
+				const char *expr_name);
 
 int nftnl_expr_foreach(struct nftnl_rule *r,
 			  int (*cb)(struct nftnl_expr *e, void *data),
@@ -84,6 +95,33 @@ void nftnl_rule_list_add_tail(struct nftnl_rule *r, struct nftnl_rule_list *list
 void nftnl_rule_list_del(struct nftnl_rule *r);
 int nftnl_rule_list_foreach(struct nftnl_rule_list *rule_list, int (*cb)(struct nftnl_rule *t, void *data), void *data);
 
+/*
+ * Optional index by handle and by chain, maintained by the add/del functions
+ * above. The rule family, table, chain and handle must be set before adding.
+ */
+int nftnl_rule_list_index(struct nftnl_rule_list *list);
+struct nftnl_rule *nftnl_rule_list_lookup_byhandle(struct nftnl_rule_list *list, uint32_t family, const char *table, uint64_t handle);
+int nftnl_rule_list_insert_after(struct nftnl_rule *r, struct nftnl_rule_list *list, uint64_t handle);
+int nftnl_rule_list_chain_foreach(struct nftnl_rule_list *list, uint32_t family, const char *table, const char *chain, int (*cb)(struct nftnl_rule *r, void *data), void *data);
+
+/*
+ * 128-bit hash of the rule content, handle, position and counter values are
+ * not taken into account. If @sets is given, anonymous sets are hashed by
+ * their elements, otherwise by their name. Use the dedup object to hash many
+ * rules.
+ */
+struct nftnl_set_list;
+int nftnl_rule_fingerprint(struct nftnl_rule *r, struct nftnl_set_list *sets,
+			   uint64_t fp[2]);
+
+struct nftnl_rule_dedup;
+
+struct nftnl_rule_dedup *nftnl_rule_dedup_alloc(void);
+void nftnl_rule_dedup_free(struct nftnl_rule_dedup *d);
+int nftnl_rule_dedup_add(struct nftnl_rule_dedup *d, struct nftnl_rule *r);
+struct nftnl_rule *nftnl_rule_dedup_lookup(struct nftnl_rule_dedup *d, struct nftnl_rule *r);
+int nftnl_rule_list_dedup(struct nftnl_rule_list *list);
+
 struct nftnl_rule_list_iter;
 
 struct nftnl_rule_list_iter *nftnl_rule_list_iter_create(struct nftnl_rule_list *l);
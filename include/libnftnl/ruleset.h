@@ -67,8 +67,119 @@ int nftnl_ruleset_parse(struct nftnl_ruleset *rs, enum nftnl_parse_type type,
 		      const char *data, struct nftnl_parse_err *err);
 int nftnl_ruleset_parse_file(struct nftnl_ruleset *rs, enum nftnl_parse_type type,
 			   FILE *fp, struct nftnl_parse_err *err);
+/*
+ * JSON objects are built by up to @nthreads threads, the callback is still
+ * called from the calling thread and in document order. Other formats are
+ * parsed as usual.
+ */
+int nftnl_ruleset_parse_file_cb_parallel(enum nftnl_parse_type type, FILE *fp,
+					 struct nftnl_parse_err *err, void *data,
+					 int (*cb)(const struct nftnl_parse_ctx *ctx),
+					 unsigned int nthreads);
+int nftnl_ruleset_parse_buffer_cb_parallel(enum nftnl_parse_type type,
+					   const char *buffer,
+					   struct nftnl_parse_err *err, void *data,
+					   int (*cb)(const struct nftnl_parse_ctx *ctx),
+					   unsigned int nthreads);
+int nftnl_ruleset_parse_file_parallel(struct nftnl_ruleset *rs,
+				      enum nftnl_parse_type type, FILE *fp,
+				      struct nftnl_parse_err *err,
+				      unsigned int nthreads);
+struct nftnl_batch;
+/*
+ * Turn each command into netlink messages in @batch as soon as it is parsed,
+ * no ruleset is built. Sets are referred to by their ID within the batch.
+ * Messages are built in place and take up to 64K, so the batch overrun has
+ * to be at least UINT16_MAX plus the page size, smaller ones fail with
+ * EINVAL. The caller adds the batch begin/end messages. Returns the number
+ * of messages or -1 on error.
+ */
+int nftnl_ruleset_parse_file_batch(enum nftnl_parse_type type, FILE *fp,
+				   struct nftnl_parse_err *err,
+				   struct nftnl_batch *batch, uint32_t *seq);
+int nftnl_ruleset_parse_buffer_batch(enum nftnl_parse_type type,
+				     const char *buffer,
+				     struct nftnl_parse_err *err,
+				     struct nftnl_batch *batch, uint32_t *seq);
 int nftnl_ruleset_snprintf(char *buf, size_t size, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
 int nftnl_ruleset_fprintf(FILE *fp, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
+struct nftnl_sink;
+int nftnl_ruleset_output(struct nftnl_sink *sink, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
+/*
+ * Same output as nftnl_ruleset_output(), rules and the elements of large sets
+ * are rendered by up to @nthreads threads.
+ */
+int nftnl_ruleset_output_parallel(struct nftnl_sink *sink, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags, unsigned int nthreads);
+
+/*
+ * Put the messages that turn the ruleset @cur into @want into @batch, the
+ * caller is responsible for the batch begin/end messages. The rules in @cur
+ * need their handles. Returns the number of messages or -1 on error.
+ */
+struct nftnl_batch;
+
+int nftnl_ruleset_diff(struct nftnl_batch *batch, struct nftnl_ruleset *cur,
+		       struct nftnl_ruleset *want, uint32_t *seq);
+
+/*
+ * Ruleset cache kept up to date by events. After nftnl_ruleset_cache_reset(),
+ * pass the reply to NFT_MSG_GETGEN and then the dump of tables, chains, sets,
+ * elements and rules to nftnl_ruleset_cache_dump(). Messages received on the
+ * event socket go to nftnl_ruleset_cache_event(), which returns
+ * NFTNL_RULESET_CACHE_RESYNC once events are lost and the dump needs to be
+ * done again. So does the caller on ENOBUFS from the event socket.
+ */
+struct nftnl_ruleset_cache;
+struct nlmsghdr;
+
+enum {
+	NFTNL_RULESET_CACHE_RESYNC	= 1,
+};
+
+struct nftnl_ruleset_cache *nftnl_ruleset_cache_alloc(void);
+void nftnl_ruleset_cache_free(struct nftnl_ruleset_cache *c);
+int nftnl_ruleset_cache_reset(struct nftnl_ruleset_cache *c);
+int nftnl_ruleset_cache_dump(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh);
+int nftnl_ruleset_cache_event(struct nftnl_ruleset_cache *c,
+			      const struct nlmsghdr *nlh);
+bool nftnl_ruleset_cache_synced(const struct nftnl_ruleset_cache *c);
+uint32_t nftnl_ruleset_cache_genid(const struct nftnl_ruleset_cache *c);
+const struct nftnl_ruleset *
+nftnl_ruleset_cache_ruleset(const struct nftnl_ruleset_cache *c);
+
+/*
+ * Binary snapshot of a ruleset: the netlink messages that create each object
+ * plus an index, so a ruleset can be restored without going through a text
+ * format. nftnl_ruleset_snapshot_open() maps the file and only checks the
+ * index, objects are decoded on nftnl_ruleset_snapshot_get(). Rules are found
+ * by their chain name.
+ */
+struct nftnl_ruleset_snapshot;
+
+int nftnl_ruleset_snapshot_save(const struct nftnl_ruleset *rs, FILE *fp);
+struct nftnl_ruleset_snapshot *nftnl_ruleset_snapshot_open(const char *filename);
+void nftnl_ruleset_snapshot_close(struct nftnl_ruleset_snapshot *snap);
+uint32_t nftnl_ruleset_snapshot_count(const struct nftnl_ruleset_snapshot *snap);
+enum nftnl_ruleset_type
+nftnl_ruleset_snapshot_type(const struct nftnl_ruleset_snapshot *snap,
+			    uint32_t idx);
+int nftnl_ruleset_snapshot_find(const struct nftnl_ruleset_snapshot *snap,
+				enum nftnl_ruleset_type type, uint32_t family,
+				const char *table, const char *name);
+void *nftnl_ruleset_snapshot_get(const struct nftnl_ruleset_snapshot *snap,
+				 uint32_t idx);
+struct nftnl_ruleset *
+nftnl_ruleset_snapshot_load(const struct nftnl_ruleset_snapshot *snap);
+/*
+ * Copy the messages to @batch, without handles and with set IDs so elements
+ * and rules find the sets created in the same batch. Element messages take up
+ * to 64K, so the batch overrun has to be at least UINT16_MAX plus the page
+ * size, messages that do not fit fail with EMSGSIZE. The caller adds the
+ * batch begin/end messages. Returns the number of messages or -1 on error.
+ */
+int nftnl_ruleset_snapshot_batch(const struct nftnl_ruleset_snapshot *snap,
+				 struct nftnl_batch *batch, uint32_t *seq);
 
 /*
  * Compat
@@ -55,9 +55,23 @@ struct nlmsghdr;
 void nftnl_set_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set *s);
 int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s);
 int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s);
+/* Only decode the attributes in @mask, (1 << NFTNL_SET_*). */
+int nftnl_set_nlmsg_parse_mask(const struct nlmsghdr *nlh, struct nftnl_set *s,
+			       uint32_t mask);
+/*
+ * Only decode the element attributes in @mask, (1 << NFTNL_SET_ELEM_*). The
+ * table, set name and ID are always set.
+ */
+int nftnl_set_elems_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				     struct nftnl_set *s, uint32_t mask);
 
 int nftnl_set_snprintf(char *buf, size_t size, struct nftnl_set *s, uint32_t type, uint32_t flags);
 int nftnl_set_fprintf(FILE *fp, struct nftnl_set *s, uint32_t type, uint32_t flags);
+struct nftnl_sink;
+/* The set is rendered element by element, see libnftnl/sink.h */
+int nftnl_set_output(struct nftnl_sink *sink, struct nftnl_set *s, uint32_t type, uint32_t flags);
+/* Large sets are rendered by up to @nthreads threads, same output. */
+int nftnl_set_output_parallel(struct nftnl_sink *sink, struct nftnl_set *s, uint32_t type, uint32_t flags, unsigned int nthreads);
 
 struct nftnl_set_list;
 
@@ -69,6 +83,12 @@ void nftnl_set_list_add_tail(struct nftnl_set *s, struct nftnl_set_list *list);
 void nftnl_set_list_del(struct nftnl_set *s);
 int nftnl_set_list_foreach(struct nftnl_set_list *set_list, int (*cb)(struct nftnl_set *t, void *data), void *data);
 
+/* Sets are indexed by family, table and name when added, set them first. */
+struct nftnl_set *nftnl_set_list_lookup_byname(struct nftnl_set_list *set_list,
+					       uint32_t family,
+					       const char *table,
+					       const char *name);
+
 struct nftnl_set_list_iter;
 struct nftnl_set_list_iter *nftnl_set_list_iter_create(struct nftnl_set_list *l);
 struct nftnl_set *nftnl_set_list_iter_cur(struct nftnl_set_list_iter *iter);
@@ -99,6 +119,8 @@ enum {
 struct nftnl_set_elem;
 
 struct nftnl_set_elem *nftnl_set_elem_alloc(void);
+/* Only room for the key and data lengths of the set, see NFTNL_SET_*_LEN */
+struct nftnl_set_elem *nftnl_set_elem_alloc_compact(const struct nftnl_set *s);
 void nftnl_set_elem_free(struct nftnl_set_elem *s);
 
 struct nftnl_set_elem *nftnl_set_elem_clone(struct nftnl_set_elem *elem);
@@ -140,6 +162,58 @@ void nftnl_set_elems_iter_destroy(struct nftnl_set_elems_iter *iter);
 int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 					   struct nftnl_set_elems_iter *iter);
 
+/*
+ * Element delta: elements only in @want go to @add, elements only in @cur
+ * go to @del. Elements whose data or verdict changed show up in both.
+ * nftnl_set_elems_batch_diff() emits the delete and then the add messages
+ * for the set identified by @want into @batch, the caller is responsible
+ * for the batch begin/end messages. Both the batch page size and overrun
+ * must be large enough to hold one message, ie. UINT16_MAX plus a page.
+ */
+struct nftnl_batch;
+
+int nftnl_set_elems_diff(struct nftnl_set *cur, struct nftnl_set *want,
+			 struct nftnl_set *add, struct nftnl_set *del);
+int nftnl_set_elems_batch_diff(struct nftnl_batch *batch,
+			       struct nftnl_set *cur, struct nftnl_set *want,
+			       uint32_t *seq);
+
+/*
+ * Put the elements of @s into @batch as @cmd messages, using up to @nthreads
+ * threads to build them. The result is the same as calling
+ * nftnl_set_elems_nlmsg_build_payload_iter() until it returns 0.
+ */
+int nftnl_set_elems_batch_build(struct nftnl_batch *batch,
+				struct nftnl_set *s, uint16_t cmd,
+				uint16_t type, uint32_t *seq,
+				unsigned int nthreads);
+
+/*
+ * Binary set element file: a header followed by fixed size records, each
+ * record is key_len bytes of key followed by data_len bytes of data, both
+ * copied as is into the messages. Header fields are in network byte order,
+ * flags are the NFTA_SET_ELEM_FLAGS for all elements.
+ */
+#define NFTNL_SET_ELEMS_FILE_MAGIC	0x4e465345	/* "NFSE" */
+#define NFTNL_SET_ELEMS_FILE_VERSION	1
+
+struct nftnl_set_elems_file_hdr {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	key_len;
+	uint32_t	data_len;
+	uint32_t	flags;
+	uint32_t	reserved;
+};
+
+struct nftnl_set_elems_file;
+
+struct nftnl_set_elems_file *nftnl_set_elems_file_open(const char *filename);
+void nftnl_set_elems_file_close(struct nftnl_set_elems_file *f);
+int nftnl_set_elems_file_nlmsg_build_payload(struct nlmsghdr *nlh,
+					     struct nftnl_set *s,
+					     struct nftnl_set_elems_file *f);
+
 /*
  * Compat
  */
@@ -0,0 +1,42 @@
+#ifndef _LIBNFTNL_SINK_H_
+#define _LIBNFTNL_SINK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Output sink: the *_output() functions render objects into it piece by
+ * piece, so even a large set or a whole ruleset is rendered only once. The
+ * sink keeps its staging area across calls, there is no need to allocate
+ * one per object.
+ */
+struct nftnl_sink;
+
+/* Collects everything in a growable buffer, see nftnl_sink_buf(). */
+struct nftnl_sink *nftnl_sink_alloc(void);
+struct nftnl_sink *nftnl_sink_alloc_file(FILE *fp);
+struct nftnl_sink *nftnl_sink_alloc_fd(int fd);
+/* @cb returns a negative value on errors. */
+struct nftnl_sink *nftnl_sink_alloc_cb(int (*cb)(const char *buf, size_t len,
+						 void *data),
+				       void *data);
+/* Flushes what is still pending, errors are only reported by _flush(). */
+void nftnl_sink_free(struct nftnl_sink *s);
+
+int nftnl_sink_write(struct nftnl_sink *s, const char *buf, size_t len);
+int nftnl_sink_flush(struct nftnl_sink *s);
+
+/* Buffer sinks only: the NUL terminated output and its length. */
+const char *nftnl_sink_buf(const struct nftnl_sink *s, size_t *len);
+void nftnl_sink_reset(struct nftnl_sink *s);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _LIBNFTNL_SINK_H_ */
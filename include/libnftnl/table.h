@@ -52,6 +52,8 @@ int nftnl_table_parse_file(struct nftnl_table *t, enum nftnl_parse_type type,
 			 FILE *fp, struct nftnl_parse_err *err);
 int nftnl_table_snprintf(char *buf, size_t size, struct nftnl_table *t, uint32_t type, uint32_t flags);
 int nftnl_table_fprintf(FILE *fp, struct nftnl_table *t, uint32_t type, uint32_t flags);
+struct nftnl_sink;
+int nftnl_table_output(struct nftnl_sink *sink, struct nftnl_table *t, uint32_t type, uint32_t flags);
 
 #define nftnl_table_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 int nftnl_table_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_table *t);
@@ -73,6 +75,9 @@ struct nftnl_table_list_iter *nftnl_table_list_iter_create(struct nftnl_table_li
 struct nftnl_table *nftnl_table_list_iter_next(struct nftnl_table_list_iter *iter);
 void nftnl_table_list_iter_destroy(struct nftnl_table_list_iter *iter);
 
+/* Tables are indexed when added, set family and name first. */
+struct nftnl_table *nftnl_table_list_lookup_byname(struct nftnl_table_list *list, uint32_t family, const char *name);
+
 /*
  * Compat
  */
@@ -0,0 +1,11 @@
+#ifndef _LIBNFTNL_MONITOR_INTERNAL_H_
+#define _LIBNFTNL_MONITOR_INTERNAL_H_
+
+#include <stdint.h>
+
+struct nlmsghdr;
+
+/* Parse an event into the object type that nftnl_monitor hands out. */
+void *nftnl_monitor_decode(const struct nlmsghdr *nlh, uint16_t type);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _LIBNFTNL_RULE_INTERNAL_H_
+#define _LIBNFTNL_RULE_INTERNAL_H_
+
+#include <stdint.h>
+
+/* Room for the rule attributes plus one expression of maximum size. */
+#define NFTNL_RULE_FP_BUFSIZ	(2 * (UINT16_MAX + 1))
+
+struct nftnl_rule;
+struct nftnl_set_list;
+
+int nftnl_rule_fingerprint_buf(struct nftnl_rule *r, char *buf,
+			       uint64_t fp[2], struct nftnl_set_list *sets);
+void nftnl_rule_lookup_set_ids(struct nftnl_rule *r,
+			       struct nftnl_set_list *set_list);
+
+#endif
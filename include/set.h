@@ -5,6 +5,7 @@
 
 struct nftnl_set {
 	struct list_head	head;
+	struct hlist_node	hnode;
 
 	uint32_t		family;
 	uint32_t		set_flags;
@@ -27,8 +28,12 @@ struct nftnl_set {
 };
 
 struct nftnl_set_list;
-struct nftnl_expr;
-int nftnl_set_lookup_id(struct nftnl_expr *e, struct nftnl_set_list *set_list,
-		      uint32_t *set_id);
+int nftnl_set_lookup_id(const char *set_name, struct nftnl_set_list *set_list,
+		      uint32_t family, const char *table, uint32_t *set_id);
+
+struct nftnl_sink;
+/* Same as nftnl_set_output(), JSON names the set "element" as the parser. */
+int nftnl_set_elems_output(struct nftnl_sink *sink, struct nftnl_set *s,
+			   uint32_t type, uint32_t flags);
 
 #endif
@@ -6,16 +6,48 @@
 struct nftnl_set_elem {
 	struct list_head	head;
 	uint32_t		set_elem_flags;
-	union nftnl_data_reg	key;
-	union nftnl_data_reg	data;
-	struct nftnl_expr	*expr;
 	uint32_t		flags;
+	struct nftnl_expr	*expr;
 	uint64_t		timeout;
 	uint64_t		expiration;
 	struct {
 		void		*data;
 		uint32_t	len;
 	} user;
+	const char		*chain;
+	int			verdict;
+	uint8_t			key_len;
+	uint8_t			data_len;
+	uint8_t			key_size;
+	uint8_t			data_size;
+	/* key_size bytes of key followed by data_size bytes of data */
+	uint32_t		val[];
 };
 
+static inline void *nftnl_set_elem_key(const struct nftnl_set_elem *e)
+{
+	return (void *)e->val;
+}
+
+static inline void *nftnl_set_elem_data(const struct nftnl_set_elem *e)
+{
+	return (char *)e->val + e->key_size;
+}
+
+struct nlmsghdr;
+struct nlattr;
+struct nftnl_set;
+
+void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
+				    struct nftnl_set *s);
+struct nlattr *nftnl_set_elem_build(struct nlmsghdr *nlh,
+				    struct nftnl_set_elem *elem, int i);
+uint32_t nftnl_set_elem_hash(const struct nftnl_set_elem *e);
+bool nftnl_set_elem_key_equal(const struct nftnl_set_elem *a,
+			      const struct nftnl_set_elem *b);
+int nftnl_set_elems_nlmsg_build_payload_array(struct nlmsghdr *nlh,
+					      struct nftnl_set *s,
+					      struct nftnl_set_elem **elems,
+					      uint32_t num, uint32_t *pos);
+
 #endif
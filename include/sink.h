@@ -0,0 +1,80 @@
+#ifndef _LIBNFTNL_SINK_INTERNAL_H_
+#define _LIBNFTNL_SINK_INTERNAL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+enum nftnl_sink_type {
+	NFTNL_SINK_BUFFER,
+	NFTNL_SINK_FILE,
+	NFTNL_SINK_FD,
+	NFTNL_SINK_CB,
+};
+
+struct nftnl_sink {
+	enum nftnl_sink_type	type;
+	union {
+		FILE		*fp;
+		int		fd;
+		struct {
+			int	(*cb)(const char *buf, size_t len, void *data);
+			void	*data;
+		};
+	};
+	char			*buf;	/* staging area, kept across objects */
+	size_t			size;
+	size_t			len;
+	uint64_t		total;	/* bytes rendered so far */
+	bool			owned;	/* buf was allocated by the sink */
+	bool			error;
+};
+
+/*
+ * A FILE sink on top of a caller provided (stack) buffer, so the fprintf
+ * functions do not need to allocate unless an object does not fit in it.
+ * Call nftnl_sink_release() once done.
+ */
+void nftnl_sink_init_file(struct nftnl_sink *s, FILE *fp, char *buf,
+			  size_t size);
+int nftnl_sink_release(struct nftnl_sink *s);
+
+/*
+ * Render straight into the staging area:
+ *
+ *	do {
+ *		buf = nftnl_sink_reserve(s, &size);
+ *		if (buf == NULL)
+ *			return -1;
+ *		ret = xyz_snprintf(buf, size, ...);
+ *	} while ((ret = nftnl_sink_commit(s, ret)) > 0);
+ *
+ * nftnl_sink_commit() returns 0 once the piece is in, -1 on errors and 1
+ * if it did not fit. In that case room was made and the piece needs to be
+ * rendered again, which stops happening once the staging area has grown to
+ * the size of the largest piece.
+ */
+char *nftnl_sink_reserve(struct nftnl_sink *s, size_t *size);
+int nftnl_sink_commit(struct nftnl_sink *s, int ret);
+
+int nftnl_sink_printf(struct nftnl_sink *s, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+int nftnl_sink_obj(struct nftnl_sink *s, void *obj, uint32_t cmd,
+		   uint32_t type, uint32_t flags,
+		   int (*snprintf_cb)(char *buf, size_t bufsiz, void *obj,
+				      uint32_t cmd, uint32_t type,
+				      uint32_t flags));
+
+/*
+ * Render objs[0..num) with up to @nthreads threads: each renders a range of
+ * objects into a buffer of its own, the buffers are then appended to @s in
+ * order. @idx is the position of @obj in @objs, so the callback can tell
+ * the first and last object apart. It must not touch shared state.
+ */
+int nftnl_sink_parallel(struct nftnl_sink *s, void **objs, uint32_t num,
+			int (*render)(struct nftnl_sink *s, void *obj,
+				      uint32_t idx, void *data),
+			void *data, unsigned int nthreads);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <libnftnl/common.h>
@@ -11,8 +12,10 @@
 #ifdef HAVE_VISIBILITY_HIDDEN
 #	define __visible	__attribute__((visibility("default")))
 #	define EXPORT_SYMBOL(x, y)	typeof(x) (x) __visible; __typeof (y) y __attribute ((alias (#x), visibility ("default")))
+#	define EXPORT_SYMBOL_NOALIAS(x)	typeof(x) (x) __visible
 #else
 #	define EXPORT_SYMBOL
+#	define EXPORT_SYMBOL_NOALIAS(x)	typeof(x) (x)
 #endif
 
 #define __noreturn	__attribute__((__noreturn__))
@@ -75,6 +78,29 @@ uint32_t nftnl_str2cmd(const char *cmd);
 
 enum nftnl_cmd_type nftnl_flag2cmd(uint32_t flags);
 
+uint32_t nftnl_hash_str(uint32_t hash, const char *str);
+
+const char *nftnl_str_intern(const char *str);
+void nftnl_str_release(const char *str);
+
+/* Interned strings can be compared by address. */
+static inline bool nftnl_str_equal(const char *a, const char *b)
+{
+	return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+/*
+ * Integer emitters for the output path, these write the digits at @p and
+ * return the end of them, no trailing NUL. @p needs room for 20 digits
+ * (plus the sign) for decimals and 8 for hex words.
+ */
+char *nftnl_fmt_u32(char *p, uint32_t value);
+char *nftnl_fmt_u64(char *p, uint64_t value);
+char *nftnl_fmt_s32(char *p, int32_t value);
+char *nftnl_fmt_hex32(char *p, uint32_t value);
+/* Like snprintf(buf, size, "%.*s", len, src). */
+int nftnl_fmt_copy(char *buf, size_t size, const char *src, size_t len);
+
 int nftnl_fprintf(FILE *fp, void *obj, uint32_t cmd, uint32_t type,
 		uint32_t flags, int (*snprintf_cb)(char *buf, size_t bufsiz,
 		void *obj, uint32_t cmd, uint32_t type, uint32_t flags));
@@ -0,0 +1,23 @@
+#ifndef _LIBNFTNL_WORKERS_INTERNAL_H_
+#define _LIBNFTNL_WORKERS_INTERNAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Items of one worker, the first member of the worker structures. */
+struct nftnl_worker {
+	uint32_t	first;
+	uint32_t	num;
+};
+
+/*
+ * Split the items [@first, @first + @num) into @nthreads contiguous ranges
+ * and call @fn for each worker of @w, an array of @nthreads entries of
+ * @size bytes. The first worker runs in the calling thread, and so do
+ * those that got no items or whose thread could not be started. Returns
+ * once all workers are done.
+ */
+void nftnl_workers_run(void *w, size_t size, unsigned int nthreads,
+		       uint32_t first, uint32_t num, void *(*fn)(void *arg));
+
+#endif
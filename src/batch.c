@@ -33,7 +33,8 @@ static struct nftnl_batch_page *nftnl_batch_page_alloc(struct nftnl_batch *batch
 	if (page == NULL)
 		return NULL;
 
-	buf = malloc(batch->page_size + batch->page_overrun_size);
+	/* Zeroed, libmnl does not always clear the attribute padding. */
+	buf = calloc(1, batch->page_size + batch->page_overrun_size);
 	if (buf == NULL)
 		goto err1;
 
@@ -127,6 +128,17 @@ void *nftnl_batch_buffer(struct nftnl_batch *batch)
 }
 EXPORT_SYMBOL(nftnl_batch_buffer, nft_batch_buffer);
 
+uint32_t nftnl_batch_room(struct nftnl_batch *batch)
+{
+	return batch->page_size + batch->page_overrun_size -
+	       mnl_nlmsg_batch_size(batch->current_page->batch);
+}
+
+uint32_t nftnl_batch_overrun_size(const struct nftnl_batch *batch)
+{
+	return batch->page_overrun_size;
+}
+
 uint32_t nftnl_batch_buffer_len(struct nftnl_batch *batch)
 {
 	return mnl_nlmsg_batch_size(batch->current_page->batch);
@@ -9,8 +9,6 @@
 
 #include <stdio.h>
 #include <stdint.h>
-#include <stdarg.h>
-#include <inttypes.h>
 #include <string.h>
 #include <buffer.h>
 #include <libnftnl/common.h>
@@ -36,8 +34,8 @@ int nftnl_buf_done(struct nftnl_buf *b)
 	if (b->fail)
 		return -1;
 
-	/* Remove trailing comma in json */
-	if (b->size > 0 && b->buf[b->size - 1] == ',') {
+	/* Remove trailing comma in json, cbor may well end in 0x2c */
+	if (!b->cbor && b->size > 0 && b->buf[b->size - 1] == ',') {
 		b->off--;
 		b->size--;
 		b->len++;
@@ -46,26 +44,88 @@ int nftnl_buf_done(struct nftnl_buf *b)
 	return b->off;
 }
 
-static int nftnl_buf_put(struct nftnl_buf *b, const char *fmt, ...)
+static int nftnl_buf_mem(struct nftnl_buf *b, const char *data, size_t len)
 {
-	int ret;
-	va_list ap;
+	return nftnl_buf_update(b, nftnl_fmt_copy(b->buf + b->off, b->len,
+						  data, len));
+}
 
-	va_start(ap, fmt);
-	ret = vsnprintf(b->buf + b->off, b->len, fmt, ap);
-	ret = nftnl_buf_update(b, ret);
-	va_end(ap);
+static int nftnl_buf_put(struct nftnl_buf *b, const char *str)
+{
+	return nftnl_buf_mem(b, str, strlen(str));
+}
 
-	return ret;
+static int nftnl_buf_cbor_byte(struct nftnl_buf *b, uint8_t byte)
+{
+	b->cbor = true;
+	return nftnl_buf_update(b, nftnl_cbor_byte(b->buf + b->off, b->len,
+						   byte));
+}
+
+static int nftnl_buf_cbor_str(struct nftnl_buf *b, const char *str)
+{
+	b->cbor = true;
+	return nftnl_buf_update(b, nftnl_cbor_str(b->buf + b->off, b->len,
+						  str));
+}
+
+/* {"tag": followed by a map or an array, both closed by a break */
+static int nftnl_buf_cbor_open(struct nftnl_buf *b, const char *tag,
+			       uint8_t major)
+{
+	nftnl_buf_cbor_byte(b, NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	nftnl_buf_cbor_str(b, tag);
+	return nftnl_buf_cbor_byte(b, major | NFTNL_CBOR_INDEF);
+}
+
+static int nftnl_buf_cbor_close(struct nftnl_buf *b)
+{
+	nftnl_buf_cbor_byte(b, NFTNL_CBOR_BREAK);
+	return nftnl_buf_cbor_byte(b, NFTNL_CBOR_BREAK);
+}
+
+/* <tag>value</tag> or "tag":value, */
+static int nftnl_buf_field(struct nftnl_buf *b, int type, const char *tag,
+			   const char *value, size_t len, bool quote)
+{
+	switch (type) {
+	case NFTNL_OUTPUT_XML:
+		nftnl_buf_mem(b, "<", 1);
+		nftnl_buf_put(b, tag);
+		nftnl_buf_mem(b, ">", 1);
+		nftnl_buf_mem(b, value, len);
+		nftnl_buf_mem(b, "</", 2);
+		nftnl_buf_put(b, tag);
+		return nftnl_buf_mem(b, ">", 1);
+	case NFTNL_OUTPUT_JSON:
+		nftnl_buf_mem(b, "\"", 1);
+		nftnl_buf_put(b, tag);
+		if (quote) {
+			nftnl_buf_mem(b, "\":\"", 3);
+			nftnl_buf_mem(b, value, len);
+			return nftnl_buf_mem(b, "\",", 2);
+		}
+		nftnl_buf_mem(b, "\":", 2);
+		nftnl_buf_mem(b, value, len);
+		return nftnl_buf_mem(b, ",", 1);
+	default:
+		return 0;
+	}
 }
 
 int nftnl_buf_open(struct nftnl_buf *b, int type, const char *tag)
 {
 	switch (type) {
 	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>", tag);
+		nftnl_buf_mem(b, "<", 1);
+		nftnl_buf_put(b, tag);
+		return nftnl_buf_mem(b, ">", 1);
 	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "{\"%s\":{", tag);
+		nftnl_buf_mem(b, "{\"", 2);
+		nftnl_buf_put(b, tag);
+		return nftnl_buf_mem(b, "\":{", 3);
+	case NFTNL_OUTPUT_CBOR:
+		return nftnl_buf_cbor_open(b, tag, NFTNL_CBOR_MAP);
 	default:
 		return 0;
 	}
@@ -75,7 +135,9 @@ int nftnl_buf_close(struct nftnl_buf *b, int type, const char *tag)
 {
 	switch (type) {
 	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "</%s>", tag);
+		nftnl_buf_mem(b, "</", 2);
+		nftnl_buf_put(b, tag);
+		return nftnl_buf_mem(b, ">", 1);
 	case NFTNL_OUTPUT_JSON:
 		/* Remove trailing comma in json */
 		if (b->size > 0 && b->buf[b->size - 1] == ',') {
@@ -84,7 +146,9 @@ int nftnl_buf_close(struct nftnl_buf *b, int type, const char *tag)
 			b->len++;
 		}
 
-		return nftnl_buf_put(b, "}}");
+		return nftnl_buf_mem(b, "}}", 2);
+	case NFTNL_OUTPUT_CBOR:
+		return nftnl_buf_cbor_close(b);
 	default:
 		return 0;
 	}
@@ -94,9 +158,13 @@ int nftnl_buf_open_array(struct nftnl_buf *b, int type, const char *tag)
 {
 	switch (type) {
 	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "{\"%s\":[", tag);
+		nftnl_buf_mem(b, "{\"", 2);
+		nftnl_buf_put(b, tag);
+		return nftnl_buf_mem(b, "\":[", 3);
+	case NFTNL_OUTPUT_CBOR:
+		return nftnl_buf_cbor_open(b, tag, NFTNL_CBOR_ARRAY);
 	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>", tag);
+		return nftnl_buf_open(b, type, tag);
 	default:
 		return 0;
 	}
@@ -106,9 +174,11 @@ int nftnl_buf_close_array(struct nftnl_buf *b, int type, const char *tag)
 {
 	switch (type) {
 	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "]}");
+		return nftnl_buf_mem(b, "]}", 2);
+	case NFTNL_OUTPUT_CBOR:
+		return nftnl_buf_cbor_close(b);
 	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "</%s>", tag);
+		return nftnl_buf_close(b, type, tag);
 	default:
 		return 0;
 	}
@@ -116,50 +186,55 @@ int nftnl_buf_close_array(struct nftnl_buf *b, int type, const char *tag)
 
 int nftnl_buf_u32(struct nftnl_buf *b, int type, uint32_t value, const char *tag)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>%u</%s>", tag, value, tag);
-	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":%u,", tag, value);
-	default:
-		return 0;
+	char num[10];
+
+	if (type == NFTNL_OUTPUT_CBOR) {
+		nftnl_buf_cbor_str(b, tag);
+		return nftnl_buf_update(b, nftnl_cbor_uint(b->buf + b->off,
+							   b->len, value));
 	}
+
+	return nftnl_buf_field(b, type, tag, num,
+			       nftnl_fmt_u32(num, value) - num, false);
 }
 
 int nftnl_buf_s32(struct nftnl_buf *b, int type, uint32_t value, const char *tag)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>%d</%s>", tag, value, tag);
-	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":%d,", tag, value);
-	default:
-		return 0;
+	char num[11];
+
+	if (type == NFTNL_OUTPUT_CBOR) {
+		nftnl_buf_cbor_str(b, tag);
+		return nftnl_buf_update(b, nftnl_cbor_int(b->buf + b->off,
+							  b->len,
+							  (int32_t)value));
 	}
+
+	return nftnl_buf_field(b, type, tag, num,
+			       nftnl_fmt_s32(num, value) - num, false);
 }
 
 int nftnl_buf_u64(struct nftnl_buf *b, int type, uint64_t value, const char *tag)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>%"PRIu64"</%s>", tag, value, tag);
-	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":%"PRIu64",", tag, value);
-	default:
-		return 0;
+	char num[20];
+
+	if (type == NFTNL_OUTPUT_CBOR) {
+		nftnl_buf_cbor_str(b, tag);
+		return nftnl_buf_update(b, nftnl_cbor_uint(b->buf + b->off,
+							   b->len, value));
 	}
+
+	return nftnl_buf_field(b, type, tag, num,
+			       nftnl_fmt_u64(num, value) - num, false);
 }
 
 int nftnl_buf_str(struct nftnl_buf *b, int type, const char *str, const char *tag)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_XML:
-		return nftnl_buf_put(b, "<%s>%s</%s>", tag, str, tag);
-	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":\"%s\",", tag, str);
-	default:
-		return 0;
+	if (type == NFTNL_OUTPUT_CBOR) {
+		nftnl_buf_cbor_str(b, tag);
+		return nftnl_buf_cbor_str(b, str);
 	}
+
+	return nftnl_buf_field(b, type, tag, str, strlen(str), true);
 }
 
 int nftnl_buf_reg(struct nftnl_buf *b, int type, union nftnl_data_reg *reg,
@@ -169,17 +244,26 @@ int nftnl_buf_reg(struct nftnl_buf *b, int type, union nftnl_data_reg *reg,
 
 	switch (type) {
 	case NFTNL_OUTPUT_XML:
-		ret = nftnl_buf_put(b, "<%s>", tag);
+		nftnl_buf_open(b, type, tag);
 		ret = nftnl_data_reg_snprintf(b->buf + b->off, b->len, reg,
                                     NFTNL_OUTPUT_XML, 0, reg_type);
 		nftnl_buf_update(b, ret);
-		return nftnl_buf_put(b, "</%s>", tag);
+		return nftnl_buf_close(b, type, tag);
 	case NFTNL_OUTPUT_JSON:
-		nftnl_buf_put(b, "\"%s\":{", tag);
+		nftnl_buf_mem(b, "\"", 1);
+		nftnl_buf_put(b, tag);
+		nftnl_buf_mem(b, "\":{", 3);
 		ret = nftnl_data_reg_snprintf(b->buf + b->off, b->len, reg,
 					    NFTNL_OUTPUT_JSON, 0, reg_type);
 		nftnl_buf_update(b, ret);
-		return nftnl_buf_put(b, "},");
+		return nftnl_buf_mem(b, "},", 2);
+	case NFTNL_OUTPUT_CBOR:
+		nftnl_buf_cbor_str(b, tag);
+		nftnl_buf_cbor_byte(b, NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+		ret = nftnl_data_reg_snprintf(b->buf + b->off, b->len, reg,
+					      NFTNL_OUTPUT_CBOR, 0, reg_type);
+		nftnl_buf_update(b, ret);
+		return nftnl_buf_cbor_byte(b, NFTNL_CBOR_BREAK);
 	}
 	return 0;
 }
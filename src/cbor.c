@@ -0,0 +1,455 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <internal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+static int nftnl_cbor_put_head(char *buf, size_t size, uint8_t major,
+			       uint64_t val)
+{
+	char head[9];
+	int len, i;
+
+	if (val < 24) {
+		head[0] = major | val;
+		len = 1;
+	} else if (val <= UINT8_MAX) {
+		head[0] = major | 24;
+		len = 2;
+	} else if (val <= UINT16_MAX) {
+		head[0] = major | 25;
+		len = 3;
+	} else if (val <= UINT32_MAX) {
+		head[0] = major | 26;
+		len = 5;
+	} else {
+		head[0] = major | 27;
+		len = 9;
+	}
+
+	/* the argument follows in network byte order */
+	for (i = len - 1; i > 0; i--) {
+		head[i] = val & 0xff;
+		val >>= 8;
+	}
+
+	return nftnl_fmt_copy(buf, size, head, len);
+}
+
+int nftnl_cbor_byte(char *buf, size_t size, uint8_t byte)
+{
+	char c = byte;
+
+	return nftnl_fmt_copy(buf, size, &c, 1);
+}
+
+int nftnl_cbor_uint(char *buf, size_t size, uint64_t val)
+{
+	return nftnl_cbor_put_head(buf, size, NFTNL_CBOR_UINT, val);
+}
+
+int nftnl_cbor_int(char *buf, size_t size, int64_t val)
+{
+	if (val < 0)
+		return nftnl_cbor_put_head(buf, size, NFTNL_CBOR_NEGINT,
+					   -1 - val);
+
+	return nftnl_cbor_put_head(buf, size, NFTNL_CBOR_UINT, val);
+}
+
+int nftnl_cbor_str(char *buf, size_t size, const char *str)
+{
+	int ret, len = size, offset = 0;
+	size_t n = strlen(str);
+
+	ret = nftnl_cbor_put_head(buf, len, NFTNL_CBOR_TEXT, n);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_fmt_copy(buf + offset, len, str, n);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
+int nftnl_cbor_pair_str(char *buf, size_t size, const char *key,
+			const char *str)
+{
+	int ret, len = size, offset = 0;
+
+	ret = nftnl_cbor_str(buf, len, key);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_str(buf + offset, len, str);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
+int nftnl_cbor_pair_uint(char *buf, size_t size, const char *key,
+			 uint64_t val)
+{
+	int ret, len = size, offset = 0;
+
+	ret = nftnl_cbor_str(buf, len, key);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_uint(buf + offset, len, val);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
+#ifdef JSON_PARSING
+
+/* deeper documents are rejected rather than blowing the stack */
+#define NFTNL_CBOR_MAX_DEPTH	64
+/* longer strings are rejected before their length is allocated */
+#define NFTNL_CBOR_MAX_STRLEN	(1 << 20)
+
+/*
+ * Buffers come without their length and, unlike text, CBOR may contain any
+ * byte, so there is no telling where a buffer ends. Only files are read.
+ */
+int nftnl_cbor_reader_init(struct nftnl_cbor_reader *r, const void *data,
+			   enum nftnl_parse_input input,
+			   struct nftnl_parse_err *err)
+{
+	memset(r, 0, sizeof(*r));
+	if (input != NFTNL_PARSE_FILE) {
+		err->error = NFTNL_PARSE_EOPNOTSUPP;
+		err->node_name = NULL;
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+	r->fp = (FILE *)data;
+
+	return 0;
+}
+
+/* Files are read byte by byte so that they are left right behind the item. */
+static int nftnl_cbor_getc(struct nftnl_cbor_reader *r)
+{
+	int c;
+
+	c = getc(r->fp);
+	if (c == EOF)
+		return -1;
+	r->pos++;
+
+	return c;
+}
+
+static int nftnl_cbor_peek(struct nftnl_cbor_reader *r)
+{
+	int c;
+
+	c = getc(r->fp);
+	if (c == EOF)
+		return -1;
+	return ungetc(c, r->fp);
+}
+
+/* CBOR has no lines, the column is the offset of the offending byte */
+static int nftnl_cbor_error(struct nftnl_cbor_reader *r,
+			    struct nftnl_parse_err *err)
+{
+	err->error = NFTNL_PARSE_EBADINPUT;
+	err->line = 1;
+	err->column = r->pos;
+	errno = EINVAL;
+	return -1;
+}
+
+static int nftnl_cbor_get_head(struct nftnl_cbor_reader *r, uint8_t *major,
+			       uint64_t *val, struct nftnl_parse_err *err)
+{
+	int c, i, n;
+
+	do {
+		c = nftnl_cbor_getc(r);
+		if (c < 0)
+			return nftnl_cbor_error(r, err);
+
+		*major = c & 0xe0;
+		*val = c & 0x1f;
+		if (*val == NFTNL_CBOR_INDEF) {
+			/* indefinite strings are not supported */
+			if (*major != NFTNL_CBOR_ARRAY &&
+			    *major != NFTNL_CBOR_MAP &&
+			    *major != NFTNL_CBOR_SIMPLE)
+				return nftnl_cbor_error(r, err);
+
+			*val = NFTNL_CBOR_COUNT_INDEF;
+		} else if (*val >= 24) {
+			if (*val > 27)
+				return nftnl_cbor_error(r, err);
+
+			n = 1 << (*val - 24);
+			for (*val = 0, i = 0; i < n; i++) {
+				c = nftnl_cbor_getc(r);
+				if (c < 0)
+					return nftnl_cbor_error(r, err);
+				*val = (*val << 8) | c;
+			}
+		}
+	/* tags do not change the meaning of the document, skip them */
+	} while (*major == NFTNL_CBOR_TAG);
+
+	return 0;
+}
+
+int nftnl_cbor_enter(struct nftnl_cbor_reader *r, uint8_t major,
+		     uint64_t *count, struct nftnl_parse_err *err)
+{
+	uint8_t m;
+
+	if (nftnl_cbor_get_head(r, &m, count, err) < 0)
+		return -1;
+	if (m != major)
+		return nftnl_cbor_error(r, err);
+
+	return 0;
+}
+
+/* Returns 1 if the map or array has another member, 0 at its end. */
+int nftnl_cbor_next(struct nftnl_cbor_reader *r, uint64_t *count,
+		    struct nftnl_parse_err *err)
+{
+	int c;
+
+	if (*count != NFTNL_CBOR_COUNT_INDEF) {
+		if (*count == 0)
+			return 0;
+		(*count)--;
+		return 1;
+	}
+
+	c = nftnl_cbor_peek(r);
+	if (c < 0)
+		return nftnl_cbor_error(r, err);
+	if (c != NFTNL_CBOR_BREAK)
+		return 1;
+
+	nftnl_cbor_getc(r);
+	return 0;
+}
+
+static int nftnl_cbor_text(struct nftnl_cbor_reader *r, uint64_t len,
+			   char *buf, size_t size, struct nftnl_parse_err *err)
+{
+	uint64_t i;
+	int c;
+
+	for (i = 0; i < len; i++) {
+		c = nftnl_cbor_getc(r);
+		if (c < 0)
+			return nftnl_cbor_error(r, err);
+		if (i + 1 < size)
+			buf[i] = c;
+	}
+	if (size > 0)
+		buf[len < size ? len : size - 1] = '\0';
+
+	return 0;
+}
+
+/* Reads a map key into @key, truncated to @size. */
+int nftnl_cbor_key(struct nftnl_cbor_reader *r, char *key, size_t size,
+		   struct nftnl_parse_err *err)
+{
+	uint64_t len;
+	uint8_t major;
+
+	if (nftnl_cbor_get_head(r, &major, &len, err) < 0)
+		return -1;
+	if (major != NFTNL_CBOR_TEXT)
+		return nftnl_cbor_error(r, err);
+
+	return nftnl_cbor_text(r, len, key, size, err);
+}
+
+static json_t *nftnl_cbor_string(struct nftnl_cbor_reader *r, uint64_t len,
+				 struct nftnl_parse_err *err)
+{
+	json_t *str;
+	char *val;
+
+	if (len > NFTNL_CBOR_MAX_STRLEN) {
+		nftnl_cbor_error(r, err);
+		return NULL;
+	}
+
+	val = malloc(len + 1);
+	if (val == NULL)
+		return NULL;
+
+	if (nftnl_cbor_text(r, len, val, len + 1, err) < 0) {
+		xfree(val);
+		return NULL;
+	}
+
+	/* jansson wants valid UTF-8 without embedded NUL characters */
+	str = json_string(val);
+	xfree(val);
+	if (str == NULL)
+		nftnl_cbor_error(r, err);
+
+	return str;
+}
+
+/* Loads the next item into @out, or skips it if @out is NULL. */
+static int nftnl_cbor_item(struct nftnl_cbor_reader *r, json_t **out,
+			   int depth, struct nftnl_parse_err *err)
+{
+	json_t *item = NULL, *key, *val;
+	uint64_t arg, count;
+	uint8_t major;
+	int ret;
+
+	if (depth > NFTNL_CBOR_MAX_DEPTH)
+		return nftnl_cbor_error(r, err);
+
+	if (nftnl_cbor_get_head(r, &major, &arg, err) < 0)
+		return -1;
+
+	switch (major) {
+	case NFTNL_CBOR_UINT:
+	case NFTNL_CBOR_NEGINT:
+		if (arg > INT64_MAX)
+			return nftnl_cbor_error(r, err);
+		if (out == NULL)
+			return 0;
+
+		item = json_integer(major == NFTNL_CBOR_UINT ?
+				    (json_int_t)arg : -1 - (json_int_t)arg);
+		break;
+	case NFTNL_CBOR_BYTES:
+	case NFTNL_CBOR_TEXT:
+		if (out == NULL)
+			return nftnl_cbor_text(r, arg, NULL, 0, err);
+		/* byte strings are not part of the document */
+		if (major == NFTNL_CBOR_BYTES)
+			return nftnl_cbor_error(r, err);
+
+		item = nftnl_cbor_string(r, arg, err);
+		if (item == NULL)
+			return -1;
+		break;
+	case NFTNL_CBOR_ARRAY:
+		if (out != NULL && (item = json_array()) == NULL)
+			return -1;
+
+		count = arg;
+		while ((ret = nftnl_cbor_next(r, &count, err)) > 0) {
+			if (nftnl_cbor_item(r, out ? &val : NULL, depth + 1,
+					    err) < 0)
+				goto err;
+			if (out != NULL && json_array_append_new(item, val) < 0)
+				goto err;
+		}
+		if (ret < 0)
+			goto err;
+		break;
+	case NFTNL_CBOR_MAP:
+		if (out != NULL && (item = json_object()) == NULL)
+			return -1;
+
+		count = arg;
+		while ((ret = nftnl_cbor_next(r, &count, err)) > 0) {
+			if (out == NULL) {
+				if (nftnl_cbor_item(r, NULL, depth + 1, err) < 0 ||
+				    nftnl_cbor_item(r, NULL, depth + 1, err) < 0)
+					goto err;
+				continue;
+			}
+
+			if (nftnl_cbor_item(r, &key, depth + 1, err) < 0)
+				goto err;
+			if (json_string_value(key) == NULL) {
+				json_decref(key);
+				nftnl_cbor_error(r, err);
+				goto err;
+			}
+			if (nftnl_cbor_item(r, &val, depth + 1, err) < 0) {
+				json_decref(key);
+				goto err;
+			}
+			ret = json_object_set_new(item, json_string_value(key),
+						  val);
+			json_decref(key);
+			if (ret < 0)
+				goto err;
+		}
+		if (ret < 0)
+			goto err;
+		break;
+	case NFTNL_CBOR_SIMPLE:
+		/* a break where an item is expected */
+		if (arg == NFTNL_CBOR_COUNT_INDEF)
+			return nftnl_cbor_error(r, err);
+		if (out == NULL)
+			return 0;
+
+		switch (arg) {
+		case 20:
+			item = json_false();
+			break;
+		case 21:
+			item = json_true();
+			break;
+		case 22:
+			item = json_null();
+			break;
+		default:
+			/* floats and unassigned simple values */
+			return nftnl_cbor_error(r, err);
+		}
+		break;
+	}
+
+	if (out == NULL)
+		return 0;
+	if (item == NULL)
+		return -1;
+
+	*out = item;
+	return 0;
+err:
+	json_decref(item);
+	return -1;
+}
+
+json_t *nftnl_cbor_load(struct nftnl_cbor_reader *r,
+			struct nftnl_parse_err *err)
+{
+	json_t *root;
+
+	if (nftnl_cbor_item(r, &root, 0, err) < 0)
+		return NULL;
+
+	return root;
+}
+
+int nftnl_cbor_skip(struct nftnl_cbor_reader *r, struct nftnl_parse_err *err)
+{
+	return nftnl_cbor_item(r, NULL, 0, err);
+}
+
+json_t *nftnl_cbor_create_root(const void *data, struct nftnl_parse_err *err,
+			       enum nftnl_parse_input input)
+{
+	struct nftnl_cbor_reader r;
+
+	if (nftnl_cbor_reader_init(&r, data, input, err) < 0)
+		return NULL;
+
+	return nftnl_cbor_load(&r, err);
+}
+#endif
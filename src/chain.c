@@ -31,6 +31,8 @@
 
 struct nftnl_chain {
 	struct list_head head;
+	struct hlist_node hnode_name;
+	struct hlist_node hnode_handle;
 
 	char		name[NFT_CHAIN_MAXNAMELEN];
 	const char	*type;
@@ -96,7 +98,7 @@ EXPORT_SYMBOL(nftnl_chain_alloc, nft_chain_alloc);
 void nftnl_chain_free(struct nftnl_chain *c)
 {
 	if (c->table != NULL)
-		xfree(c->table);
+		nftnl_str_release(c->table);
 	if (c->type != NULL)
 		xfree(c->type);
 	if (c->dev != NULL)
@@ -120,7 +122,7 @@ void nftnl_chain_unset(struct nftnl_chain *c, uint16_t attr)
 	switch (attr) {
 	case NFTNL_CHAIN_TABLE:
 		if (c->table) {
-			xfree(c->table);
+			nftnl_str_release(c->table);
 			c->table = NULL;
 		}
 		break;
@@ -179,9 +181,9 @@ void nftnl_chain_set_data(struct nftnl_chain *c, uint16_t attr,
 		break;
 	case NFTNL_CHAIN_TABLE:
 		if (c->table)
-			xfree(c->table);
+			nftnl_str_release(c->table);
 
-		c->table = strdup(data);
+		c->table = nftnl_str_intern(data);
 		break;
 	case NFTNL_CHAIN_HOOKNUM:
 		memcpy(&c->hooknum, data, sizeof(c->hooknum));
@@ -399,13 +401,30 @@ void nftnl_chain_nlmsg_build_payload(struct nlmsghdr *nlh, const struct nftnl_ch
 }
 EXPORT_SYMBOL(nftnl_chain_nlmsg_build_payload, nft_chain_nlmsg_build_payload);
 
+/* NFTNL_CHAIN_* attributes that each NFTA_CHAIN_* attribute fills in. */
+static const uint32_t nftnl_chain_attr_mask[NFTA_CHAIN_MAX + 1] = {
+	[NFTA_CHAIN_TABLE]	= (1 << NFTNL_CHAIN_TABLE),
+	[NFTA_CHAIN_HANDLE]	= (1 << NFTNL_CHAIN_HANDLE),
+	[NFTA_CHAIN_NAME]	= (1 << NFTNL_CHAIN_NAME),
+	[NFTA_CHAIN_HOOK]	= (1 << NFTNL_CHAIN_HOOKNUM) |
+				  (1 << NFTNL_CHAIN_PRIO) |
+				  (1 << NFTNL_CHAIN_DEV),
+	[NFTA_CHAIN_POLICY]	= (1 << NFTNL_CHAIN_POLICY),
+	[NFTA_CHAIN_USE]	= (1 << NFTNL_CHAIN_USE),
+	[NFTA_CHAIN_TYPE]	= (1 << NFTNL_CHAIN_TYPE),
+	[NFTA_CHAIN_COUNTERS]	= (1 << NFTNL_CHAIN_BYTES) |
+				  (1 << NFTNL_CHAIN_PACKETS),
+};
+
 static int nftnl_chain_parse_attr_cb(const struct nlattr *attr, void *data)
 {
-	const struct nlattr **tb = data;
+	struct nftnl_nlmsg_parse_ctx *ctx = data;
 	int type = mnl_attr_get_type(attr);
 
 	if (mnl_attr_type_valid(attr, NFTA_CHAIN_MAX) < 0)
 		return MNL_CB_OK;
+	if (!(ctx->mask & nftnl_chain_attr_mask[type]))
+		return MNL_CB_OK;
 
 	switch(type) {
 	case NFTA_CHAIN_NAME:
@@ -430,7 +449,7 @@ static int nftnl_chain_parse_attr_cb(const struct nlattr *attr, void *data)
 		break;
 	}
 
-	tb[type] = attr;
+	ctx->tb[type] = attr;
 	return MNL_CB_OK;
 }
 
@@ -454,18 +473,19 @@ static int nftnl_chain_parse_counters_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int nftnl_chain_parse_counters(struct nlattr *attr, struct nftnl_chain *c)
+static int nftnl_chain_parse_counters(struct nlattr *attr, struct nftnl_chain *c,
+				      uint32_t mask)
 {
 	struct nlattr *tb[NFTA_COUNTER_MAX+1] = {};
 
 	if (mnl_attr_parse_nested(attr, nftnl_chain_parse_counters_cb, tb) < 0)
 		return -1;
 
-	if (tb[NFTA_COUNTER_PACKETS]) {
+	if (tb[NFTA_COUNTER_PACKETS] && mask & (1 << NFTNL_CHAIN_PACKETS)) {
 		c->packets = be64toh(mnl_attr_get_u64(tb[NFTA_COUNTER_PACKETS]));
 		c->flags |= (1 << NFTNL_CHAIN_PACKETS);
 	}
-	if (tb[NFTA_COUNTER_BYTES]) {
+	if (tb[NFTA_COUNTER_BYTES] && mask & (1 << NFTNL_CHAIN_BYTES)) {
 		c->bytes = be64toh(mnl_attr_get_u64(tb[NFTA_COUNTER_BYTES]));
 		c->flags |= (1 << NFTNL_CHAIN_BYTES);
 	}
@@ -497,22 +517,23 @@ static int nftnl_chain_parse_hook_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int nftnl_chain_parse_hook(struct nlattr *attr, struct nftnl_chain *c)
+static int nftnl_chain_parse_hook(struct nlattr *attr, struct nftnl_chain *c,
+				  uint32_t mask)
 {
 	struct nlattr *tb[NFTA_HOOK_MAX+1] = {};
 
 	if (mnl_attr_parse_nested(attr, nftnl_chain_parse_hook_cb, tb) < 0)
 		return -1;
 
-	if (tb[NFTA_HOOK_HOOKNUM]) {
+	if (tb[NFTA_HOOK_HOOKNUM] && mask & (1 << NFTNL_CHAIN_HOOKNUM)) {
 		c->hooknum = ntohl(mnl_attr_get_u32(tb[NFTA_HOOK_HOOKNUM]));
 		c->flags |= (1 << NFTNL_CHAIN_HOOKNUM);
 	}
-	if (tb[NFTA_HOOK_PRIORITY]) {
+	if (tb[NFTA_HOOK_PRIORITY] && mask & (1 << NFTNL_CHAIN_PRIO)) {
 		c->prio = ntohl(mnl_attr_get_u32(tb[NFTA_HOOK_PRIORITY]));
 		c->flags |= (1 << NFTNL_CHAIN_PRIO);
 	}
-	if (tb[NFTA_HOOK_DEV]) {
+	if (tb[NFTA_HOOK_DEV] && mask & (1 << NFTNL_CHAIN_DEV)) {
 		c->dev = strdup(mnl_attr_get_str(tb[NFTA_HOOK_DEV]));
 		c->flags |= (1 << NFTNL_CHAIN_DEV);
 	}
@@ -520,13 +541,19 @@ static int nftnl_chain_parse_hook(struct nlattr *attr, struct nftnl_chain *c)
 	return 0;
 }
 
-int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
+int nftnl_chain_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				 struct nftnl_chain *c, uint32_t mask)
 {
 	struct nlattr *tb[NFTA_CHAIN_MAX+1] = {};
 	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	struct nftnl_nlmsg_parse_ctx ctx = {
+		.tb	= (const struct nlattr **)tb,
+		.mask	= mask,
+	};
 	int ret = 0;
 
-	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_chain_parse_attr_cb, tb) < 0)
+	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_chain_parse_attr_cb,
+			   &ctx) < 0)
 		return -1;
 
 	if (tb[NFTA_CHAIN_NAME]) {
@@ -535,12 +562,13 @@ int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
 		c->flags |= (1 << NFTNL_CHAIN_NAME);
 	}
 	if (tb[NFTA_CHAIN_TABLE]) {
-		xfree(c->table);
-		c->table = strdup(mnl_attr_get_str(tb[NFTA_CHAIN_TABLE]));
+		nftnl_str_release(c->table);
+		c->table =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_CHAIN_TABLE]));
 		c->flags |= (1 << NFTNL_CHAIN_TABLE);
 	}
 	if (tb[NFTA_CHAIN_HOOK]) {
-		ret = nftnl_chain_parse_hook(tb[NFTA_CHAIN_HOOK], c);
+		ret = nftnl_chain_parse_hook(tb[NFTA_CHAIN_HOOK], c, mask);
 		if (ret < 0)
 			return ret;
 	}
@@ -553,7 +581,8 @@ int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
 		c->flags |= (1 << NFTNL_CHAIN_USE);
 	}
 	if (tb[NFTA_CHAIN_COUNTERS]) {
-		ret = nftnl_chain_parse_counters(tb[NFTA_CHAIN_COUNTERS], c);
+		ret = nftnl_chain_parse_counters(tb[NFTA_CHAIN_COUNTERS], c,
+						 mask);
 		if (ret < 0)
 			return ret;
 	}
@@ -572,6 +601,12 @@ int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
 
 	return ret;
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_chain_nlmsg_parse_mask);
+
+int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
+{
+	return nftnl_chain_nlmsg_parse_mask(nlh, c, ~0U);
+}
 EXPORT_SYMBOL(nftnl_chain_nlmsg_parse, nft_chain_nlmsg_parse);
 
 static inline int nftnl_str2hooknum(int family, const char *hook)
@@ -668,14 +703,15 @@ int nftnl_jansson_parse_chain(struct nftnl_chain *c, json_t *tree,
 
 static int nftnl_chain_json_parse(struct nftnl_chain *c, const void *json,
 				struct nftnl_parse_err *err,
-				enum nftnl_parse_input input)
+				enum nftnl_parse_input input,
+				enum nftnl_parse_type type)
 {
 #ifdef JSON_PARSING
 	json_t *tree;
 	json_error_t error;
 	int ret;
 
-	tree = nftnl_jansson_create_root(json, &error, err, input);
+	tree = nftnl_jansson_create_root(json, &error, err, input, type);
 	if (tree == NULL)
 		return -1;
 
@@ -805,7 +841,8 @@ static int nftnl_chain_do_parse(struct nftnl_chain *c, enum nftnl_parse_type typ
 		ret = nftnl_chain_xml_parse(c, data, &perr, input);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_chain_json_parse(c, data, &perr, input);
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_chain_json_parse(c, data, &perr, input, type);
 		break;
 	default:
 		ret = -1;
@@ -913,6 +950,7 @@ static int nftnl_chain_cmd_snprintf(char *buf, size_t size, struct nftnl_chain *
 		break;
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		ret = nftnl_chain_export(buf+offset, len, c, type);
 		break;
 	default:
@@ -950,10 +988,104 @@ int nftnl_chain_fprintf(FILE *fp, struct nftnl_chain *c, uint32_t type,
 }
 EXPORT_SYMBOL(nftnl_chain_fprintf, nft_chain_fprintf);
 
+int nftnl_chain_output(struct nftnl_sink *sink, struct nftnl_chain *c,
+		       uint32_t type, uint32_t flags)
+{
+	return nftnl_sink_obj(sink, c, NFTNL_CMD_UNSPEC, type, flags,
+			      nftnl_chain_do_snprintf);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_chain_output);
+
+/* initial number of buckets, doubled as the list grows */
+#define NFTNL_CHAIN_LIST_HSIZE	64
+
 struct nftnl_chain_list {
-	struct list_head list;
+	struct list_head	list;
+	struct hlist_head	*name_hash;
+	struct hlist_head	*handle_hash;
+	uint32_t		hsize;
+	/* chains added since the last count, removals do not reach the list */
+	uint32_t		nchains;
 };
 
+static uint32_t nftnl_chain_list_hash_name(uint32_t family, const char *table,
+					   const char *name)
+{
+	uint32_t hash = 5381 + family;
+
+	hash = nftnl_hash_str(hash, table);
+	return nftnl_hash_str(hash, name);
+}
+
+/* Handles are allocated per table, so the table is hashed too. */
+static uint32_t nftnl_chain_list_hash_handle(uint32_t family,
+					     const char *table, uint64_t handle)
+{
+	uint32_t hash = 5381 + family;
+
+	hash = nftnl_hash_str(hash, table);
+	return hash ^ (uint32_t)handle ^ (uint32_t)(handle >> 32);
+}
+
+static void nftnl_chain_list_hash_add(struct nftnl_chain *c,
+				      struct nftnl_chain_list *list)
+{
+	uint32_t hash;
+
+	hash = nftnl_chain_list_hash_name(c->family, c->table, c->name);
+	hlist_add_head(&c->hnode_name, &list->name_hash[hash % list->hsize]);
+	hash = nftnl_chain_list_hash_handle(c->family, c->table, c->handle);
+	hlist_add_head(&c->hnode_handle,
+		       &list->handle_hash[hash % list->hsize]);
+}
+
+static void nftnl_chain_list_hash_del(struct nftnl_chain *c)
+{
+	hlist_del_init(&c->hnode_name);
+	hlist_del_init(&c->hnode_handle);
+}
+
+/*
+ * Keep at most two chains per bucket. The counter only goes up, so count
+ * the list once it says so and double the buckets if it is really full. If
+ * there is no memory for them the old buckets stay, just more crowded.
+ */
+static void nftnl_chain_list_grow(struct nftnl_chain_list *list)
+{
+	struct hlist_head *name_hash, *handle_hash;
+	struct nftnl_chain *c;
+	uint32_t hsize, n = 0;
+
+	if (++list->nchains <= 2 * list->hsize)
+		return;
+
+	list_for_each_entry(c, &list->list, head)
+		n++;
+	list->nchains = n;
+
+	for (hsize = list->hsize; hsize < n; hsize *= 2)
+		;
+	if (hsize == list->hsize)
+		return;
+
+	name_hash = calloc(hsize, sizeof(struct hlist_head));
+	handle_hash = calloc(hsize, sizeof(struct hlist_head));
+	if (name_hash == NULL || handle_hash == NULL) {
+		xfree(name_hash);
+		xfree(handle_hash);
+		return;
+	}
+
+	xfree(list->name_hash);
+	xfree(list->handle_hash);
+	list->name_hash = name_hash;
+	list->handle_hash = handle_hash;
+	list->hsize = hsize;
+
+	list_for_each_entry(c, &list->list, head)
+		nftnl_chain_list_hash_add(c, list);
+}
+
 struct nftnl_chain_list *nftnl_chain_list_alloc(void)
 {
 	struct nftnl_chain_list *list;
@@ -962,9 +1094,20 @@ struct nftnl_chain_list *nftnl_chain_list_alloc(void)
 	if (list == NULL)
 		return NULL;
 
+	list->hsize = NFTNL_CHAIN_LIST_HSIZE;
+	list->name_hash = calloc(list->hsize, sizeof(struct hlist_head));
+	list->handle_hash = calloc(list->hsize, sizeof(struct hlist_head));
+	if (list->name_hash == NULL || list->handle_hash == NULL)
+		goto err;
+
 	INIT_LIST_HEAD(&list->list);
 
 	return list;
+err:
+	xfree(list->name_hash);
+	xfree(list->handle_hash);
+	xfree(list);
+	return NULL;
 }
 EXPORT_SYMBOL(nftnl_chain_list_alloc, nft_chain_list_alloc);
 
@@ -974,8 +1117,11 @@ void nftnl_chain_list_free(struct nftnl_chain_list *list)
 
 	list_for_each_entry_safe(r, tmp, &list->list, head) {
 		list_del(&r->head);
+		nftnl_chain_list_hash_del(r);
 		nftnl_chain_free(r);
 	}
+	xfree(list->name_hash);
+	xfree(list->handle_hash);
 	xfree(list);
 }
 EXPORT_SYMBOL(nftnl_chain_list_free, nft_chain_list_free);
@@ -989,18 +1135,23 @@ EXPORT_SYMBOL(nftnl_chain_list_is_empty, nft_chain_list_is_empty);
 void nftnl_chain_list_add(struct nftnl_chain *r, struct nftnl_chain_list *list)
 {
 	list_add(&r->head, &list->list);
+	nftnl_chain_list_hash_add(r, list);
+	nftnl_chain_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_chain_list_add, nft_chain_list_add);
 
 void nftnl_chain_list_add_tail(struct nftnl_chain *r, struct nftnl_chain_list *list)
 {
 	list_add_tail(&r->head, &list->list);
+	nftnl_chain_list_hash_add(r, list);
+	nftnl_chain_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_chain_list_add_tail, nft_chain_list_add_tail);
 
 void nftnl_chain_list_del(struct nftnl_chain *r)
 {
 	list_del(&r->head);
+	nftnl_chain_list_hash_del(r);
 }
 EXPORT_SYMBOL(nftnl_chain_list_del, nft_chain_list_del);
 
@@ -1020,6 +1171,57 @@ int nftnl_chain_list_foreach(struct nftnl_chain_list *chain_list,
 }
 EXPORT_SYMBOL(nftnl_chain_list_foreach, nft_chain_list_foreach);
 
+static bool nftnl_chain_match(const struct nftnl_chain *c, uint32_t family,
+			      const char *table)
+{
+	return c->family == family && nftnl_str_equal(c->table, table);
+}
+
+struct nftnl_chain *nftnl_chain_list_lookup_byname(struct nftnl_chain_list *list,
+						   uint32_t family,
+						   const char *table,
+						   const char *name)
+{
+	struct hlist_node *n;
+	struct nftnl_chain *c;
+	uint32_t hash;
+
+	if (table == NULL || name == NULL)
+		return NULL;
+
+	hash = nftnl_chain_list_hash_name(family, table, name) % list->hsize;
+	hlist_for_each_entry(c, n, &list->name_hash[hash], hnode_name) {
+		if (nftnl_chain_match(c, family, table) &&
+		    strcmp(c->name, name) == 0)
+			return c;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_chain_list_lookup_byname);
+
+struct nftnl_chain *nftnl_chain_list_lookup_byhandle(struct nftnl_chain_list *list,
+						     uint32_t family,
+						     const char *table,
+						     uint64_t handle)
+{
+	struct hlist_node *n;
+	struct nftnl_chain *c;
+	uint32_t hash;
+
+	if (table == NULL)
+		return NULL;
+
+	hash = nftnl_chain_list_hash_handle(family, table, handle) % list->hsize;
+	hlist_for_each_entry(c, n, &list->handle_hash[hash], hnode_handle) {
+		if (nftnl_chain_match(c, family, table) &&
+		    c->flags & (1 << NFTNL_CHAIN_HANDLE) &&
+		    c->handle == handle)
+			return c;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_chain_list_lookup_byhandle);
+
 struct nftnl_chain_list_iter {
 	struct nftnl_chain_list	*list;
 	struct nftnl_chain	*cur;
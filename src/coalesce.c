@@ -0,0 +1,511 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/coalesce.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+
+/*
+ * Every object seen in the window has one entry. The first deletion keeps
+ * the object as it was before the window, the last addition the one that
+ * is there now. An object that was added first did not exist before, so
+ * deleting it again drops the entry. Entries are reported in the order of
+ * their first deletion, and then in the order of their last addition, so
+ * that tables come before their chains and rules.
+ */
+
+/* initial number of buckets, doubled as entries are added */
+#define NFTNL_COALESCE_HSIZE	64
+
+struct nftnl_coalesce_entry {
+	struct hlist_node	hnode;
+	struct list_head	del_head;
+	struct list_head	new_head;
+	uint16_t		type;	/* NFT_MSG_NEW* */
+	uint32_t		hash;
+	void			*del_obj;
+	void			*new_obj;
+};
+
+struct nftnl_coalesce {
+	struct hlist_head	*hash;
+	uint32_t		hsize;
+	struct list_head	del_list;
+	struct list_head	new_list;
+	struct nftnl_gen	*gen;
+	uint32_t		num;
+};
+
+struct nftnl_coalesce_key {
+	uint32_t			family;
+	const char			*table;
+	const char			*name;
+	uint64_t			handle;
+	const struct nftnl_set_elem	*elem;
+};
+
+struct nftnl_coalesce_out {
+	int			(*cb)(uint16_t type, void *obj, void *data);
+	void			*data;
+	struct nftnl_set	*set;
+	uint16_t		set_type;
+	int			num;
+	int			ret;
+};
+
+struct nftnl_coalesce *nftnl_coalesce_alloc(void)
+{
+	struct nftnl_coalesce *c;
+
+	c = calloc(1, sizeof(struct nftnl_coalesce));
+	if (c == NULL)
+		return NULL;
+
+	c->hsize = NFTNL_COALESCE_HSIZE;
+	c->hash = calloc(c->hsize, sizeof(struct hlist_head));
+	if (c->hash == NULL) {
+		xfree(c);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&c->del_list);
+	INIT_LIST_HEAD(&c->new_list);
+	return c;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_alloc);
+
+static void nftnl_coalesce_entry_free(struct nftnl_coalesce *c,
+				      struct nftnl_coalesce_entry *e)
+{
+	hlist_del(&e->hnode);
+	list_del(&e->del_head);
+	list_del(&e->new_head);
+	if (e->del_obj != NULL)
+		nftnl_monitor_obj_free(e->type, e->del_obj);
+	if (e->new_obj != NULL)
+		nftnl_monitor_obj_free(e->type, e->new_obj);
+	xfree(e);
+	c->num--;
+}
+
+static void nftnl_coalesce_reset(struct nftnl_coalesce *c)
+{
+	struct nftnl_coalesce_entry *e;
+	struct hlist_node *pos, *n;
+	uint32_t i;
+
+	for (i = 0; i < c->hsize; i++) {
+		hlist_for_each_entry_safe(e, pos, n, &c->hash[i], hnode)
+			nftnl_coalesce_entry_free(c, e);
+	}
+	if (c->gen != NULL) {
+		nftnl_gen_free(c->gen);
+		c->gen = NULL;
+	}
+}
+
+void nftnl_coalesce_free(struct nftnl_coalesce *c)
+{
+	nftnl_coalesce_reset(c);
+	xfree(c->hash);
+	xfree(c);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_free);
+
+uint32_t nftnl_coalesce_pending(const struct nftnl_coalesce *c)
+{
+	return c->num;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_pending);
+
+static int nftnl_coalesce_new_type(uint16_t type, bool *del)
+{
+	*del = false;
+
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_NEWSETELEM:
+		return type;
+	case NFT_MSG_DELTABLE:
+		*del = true;
+		return NFT_MSG_NEWTABLE;
+	case NFT_MSG_DELCHAIN:
+		*del = true;
+		return NFT_MSG_NEWCHAIN;
+	case NFT_MSG_DELRULE:
+		*del = true;
+		return NFT_MSG_NEWRULE;
+	case NFT_MSG_DELSET:
+		*del = true;
+		return NFT_MSG_NEWSET;
+	case NFT_MSG_DELSETELEM:
+		*del = true;
+		return NFT_MSG_NEWSETELEM;
+	}
+	return -1;
+}
+
+static uint16_t nftnl_coalesce_del_type(uint16_t type)
+{
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+		return NFT_MSG_DELTABLE;
+	case NFT_MSG_NEWCHAIN:
+		return NFT_MSG_DELCHAIN;
+	case NFT_MSG_NEWRULE:
+		return NFT_MSG_DELRULE;
+	case NFT_MSG_NEWSET:
+		return NFT_MSG_DELSET;
+	}
+	return NFT_MSG_DELSETELEM;
+}
+
+static void nftnl_coalesce_key(struct nftnl_coalesce_key *k, uint16_t type,
+			       void *obj)
+{
+	struct nftnl_set *s = obj;
+
+	memset(k, 0, sizeof(*k));
+
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+		k->family = nftnl_table_get_u32(obj, NFTNL_TABLE_FAMILY);
+		k->name = nftnl_table_get_str(obj, NFTNL_TABLE_NAME);
+		break;
+	case NFT_MSG_NEWCHAIN:
+		k->family = nftnl_chain_get_u32(obj, NFTNL_CHAIN_FAMILY);
+		k->table = nftnl_chain_get_str(obj, NFTNL_CHAIN_TABLE);
+		k->name = nftnl_chain_get_str(obj, NFTNL_CHAIN_NAME);
+		break;
+	case NFT_MSG_NEWRULE:
+		k->family = nftnl_rule_get_u32(obj, NFTNL_RULE_FAMILY);
+		k->table = nftnl_rule_get_str(obj, NFTNL_RULE_TABLE);
+		k->name = nftnl_rule_get_str(obj, NFTNL_RULE_CHAIN);
+		k->handle = nftnl_rule_get_u64(obj, NFTNL_RULE_HANDLE);
+		break;
+	case NFT_MSG_NEWSETELEM:
+		k->elem = list_entry(s->element_list.next,
+				     struct nftnl_set_elem, head);
+		/* fall through */
+	case NFT_MSG_NEWSET:
+		k->family = s->family;
+		k->table = s->table;
+		k->name = s->name;
+		break;
+	}
+}
+
+static uint32_t nftnl_coalesce_hash(const struct nftnl_coalesce_key *k,
+				    uint16_t type)
+{
+	uint32_t hash = 5381 + type * 16 + k->family;
+
+	hash = nftnl_hash_str(hash, k->table);
+	hash = nftnl_hash_str(hash, k->name);
+	hash ^= k->handle ^ (k->handle >> 32);
+	if (k->elem != NULL)
+		hash ^= nftnl_set_elem_hash(k->elem);
+
+	return hash;
+}
+
+static bool nftnl_coalesce_key_equal(const struct nftnl_coalesce_key *a,
+				     const struct nftnl_coalesce_key *b)
+{
+	return a->family == b->family &&
+	       nftnl_str_equal(a->table, b->table) &&
+	       nftnl_str_equal(a->name, b->name) &&
+	       a->handle == b->handle &&
+	       (a->elem == NULL ||
+		nftnl_set_elem_key_equal(a->elem, b->elem));
+}
+
+static struct nftnl_coalesce_entry *
+nftnl_coalesce_lookup(struct nftnl_coalesce *c, uint16_t type, uint32_t hash,
+		      const struct nftnl_coalesce_key *k)
+{
+	struct nftnl_coalesce_key cur;
+	struct nftnl_coalesce_entry *e;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(e, n, &c->hash[hash % c->hsize],
+			     hnode) {
+		if (e->hash != hash || e->type != type)
+			continue;
+
+		nftnl_coalesce_key(&cur, type,
+				   e->new_obj ? e->new_obj : e->del_obj);
+		if (nftnl_coalesce_key_equal(&cur, k))
+			return e;
+	}
+	return NULL;
+}
+
+/*
+ * At most two entries per bucket. The entries keep their hash, so they are
+ * moved over without looking at the objects. Without memory for a bigger
+ * table, the old one stays in use.
+ */
+static void nftnl_coalesce_grow(struct nftnl_coalesce *c)
+{
+	struct nftnl_coalesce_entry *e;
+	struct hlist_node *pos, *n;
+	struct hlist_head *hash;
+	uint32_t i, hsize;
+
+	if (c->num <= 2 * c->hsize)
+		return;
+
+	hsize = c->hsize * 2;
+	hash = calloc(hsize, sizeof(struct hlist_head));
+	if (hash == NULL)
+		return;
+
+	for (i = 0; i < c->hsize; i++) {
+		hlist_for_each_entry_safe(e, pos, n, &c->hash[i], hnode) {
+			hlist_del(&e->hnode);
+			hlist_add_head(&e->hnode, &hash[e->hash % hsize]);
+		}
+	}
+	xfree(c->hash);
+	c->hash = hash;
+	c->hsize = hsize;
+}
+
+static int nftnl_coalesce_obj(struct nftnl_coalesce *c, uint16_t type,
+			      bool del, void *obj)
+{
+	struct nftnl_coalesce_entry *e;
+	struct nftnl_coalesce_key k;
+	uint32_t hash;
+
+	nftnl_coalesce_key(&k, type, obj);
+	hash = nftnl_coalesce_hash(&k, type);
+
+	e = nftnl_coalesce_lookup(c, type, hash, &k);
+	if (e == NULL) {
+		e = calloc(1, sizeof(struct nftnl_coalesce_entry));
+		if (e == NULL) {
+			nftnl_monitor_obj_free(type, obj);
+			return -1;
+		}
+		e->type = type;
+		e->hash = hash;
+		INIT_LIST_HEAD(&e->del_head);
+		INIT_LIST_HEAD(&e->new_head);
+		hlist_add_head(&e->hnode, &c->hash[hash % c->hsize]);
+		c->num++;
+		nftnl_coalesce_grow(c);
+
+		if (del) {
+			e->del_obj = obj;
+			list_add_tail(&e->del_head, &c->del_list);
+		} else {
+			e->new_obj = obj;
+			list_add_tail(&e->new_head, &c->new_list);
+		}
+		return 0;
+	}
+
+	if (e->new_obj != NULL) {
+		nftnl_monitor_obj_free(type, e->new_obj);
+		e->new_obj = NULL;
+	}
+
+	if (!del) {
+		e->new_obj = obj;
+		/*
+		 * An update keeps the place of the first addition, objects
+		 * added in between may depend on it.
+		 */
+		if (list_empty(&e->new_head))
+			list_add_tail(&e->new_head, &c->new_list);
+		return 0;
+	}
+
+	list_del_init(&e->new_head);
+	nftnl_monitor_obj_free(type, obj);
+	/* created within this window, nothing to report */
+	if (e->del_obj == NULL)
+		nftnl_coalesce_entry_free(c, e);
+
+	return 0;
+}
+
+/* Each element is tracked on its own, in a set object of its own. */
+static int nftnl_coalesce_elems(struct nftnl_coalesce *c, bool del,
+				struct nftnl_set *s)
+{
+	struct nftnl_set_elem *elem, *tmp;
+	struct nftnl_set *one;
+	int ret = 0;
+
+	list_for_each_entry_safe(elem, tmp, &s->element_list, head) {
+		one = nftnl_set_alloc();
+		if (one == NULL) {
+			ret = -1;
+			break;
+		}
+		if (s->flags & (1 << NFTNL_SET_TABLE))
+			nftnl_set_set_str(one, NFTNL_SET_TABLE, s->table);
+		if (s->flags & (1 << NFTNL_SET_NAME))
+			nftnl_set_set_str(one, NFTNL_SET_NAME, s->name);
+		if (s->flags & (1 << NFTNL_SET_FAMILY))
+			nftnl_set_set_u32(one, NFTNL_SET_FAMILY, s->family);
+
+		list_move_tail(&elem->head, &one->element_list);
+		if (nftnl_coalesce_obj(c, NFT_MSG_NEWSETELEM, del, one) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	nftnl_set_free(s);
+	return ret;
+}
+
+int nftnl_coalesce_add(struct nftnl_coalesce *c, uint16_t type, void *obj)
+{
+	int new_type;
+	bool del;
+
+	if (type == NFT_MSG_NEWGEN) {
+		/* only the last generation is of interest */
+		if (c->gen != NULL)
+			nftnl_gen_free(c->gen);
+		c->gen = obj;
+		return 0;
+	}
+
+	new_type = nftnl_coalesce_new_type(type, &del);
+	if (new_type < 0) {
+		nftnl_monitor_obj_free(type, obj);
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (new_type == NFT_MSG_NEWSETELEM)
+		return nftnl_coalesce_elems(c, del, obj);
+
+	return nftnl_coalesce_obj(c, new_type, del, obj);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_add);
+
+int nftnl_coalesce_nlmsg(struct nftnl_coalesce *c, const struct nlmsghdr *nlh)
+{
+	uint16_t type = NFNL_MSG_TYPE(nlh->nlmsg_type);
+	void *obj;
+
+	if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+		return 0;
+
+	obj = nftnl_monitor_decode(nlh, type);
+	if (obj == NULL)
+		return -1;
+
+	return nftnl_coalesce_add(c, type, obj);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_nlmsg);
+
+static void nftnl_coalesce_deliver(struct nftnl_coalesce_out *out,
+				   uint16_t type, void *obj)
+{
+	int ret = 0;
+
+	if (out->ret >= 0 && out->cb != NULL)
+		ret = out->cb(type, obj, out->data);
+
+	if (ret != NFTNL_MONITOR_CB_KEEP)
+		nftnl_monitor_obj_free(type, obj);
+	if (ret < 0)
+		out->ret = -1;
+	else if (out->ret >= 0)
+		out->num++;
+}
+
+static void nftnl_coalesce_deliver_set(struct nftnl_coalesce_out *out)
+{
+	if (out->set == NULL)
+		return;
+
+	nftnl_coalesce_deliver(out, out->set_type, out->set);
+	out->set = NULL;
+}
+
+static void nftnl_coalesce_emit(struct nftnl_coalesce_out *out, uint16_t type,
+				void *obj)
+{
+	struct nftnl_set_elem *elem, *tmp;
+	struct nftnl_set *s = obj;
+
+	if (type != NFT_MSG_NEWSETELEM && type != NFT_MSG_DELSETELEM) {
+		nftnl_coalesce_deliver_set(out);
+		nftnl_coalesce_deliver(out, type, obj);
+		return;
+	}
+
+	if (out->set != NULL && out->set_type == type &&
+	    out->set->family == s->family &&
+	    nftnl_str_equal(out->set->table, s->table) &&
+	    nftnl_str_equal(out->set->name, s->name)) {
+		list_for_each_entry_safe(elem, tmp, &s->element_list, head)
+			list_move_tail(&elem->head, &out->set->element_list);
+		nftnl_set_free(s);
+		return;
+	}
+
+	nftnl_coalesce_deliver_set(out);
+	out->set = s;
+	out->set_type = type;
+}
+
+int nftnl_coalesce_flush(struct nftnl_coalesce *c,
+			 int (*cb)(uint16_t type, void *obj, void *data),
+			 void *data)
+{
+	struct nftnl_coalesce_out out = {
+		.cb	= cb,
+		.data	= data,
+	};
+	struct nftnl_coalesce_entry *e;
+
+	list_for_each_entry(e, &c->del_list, del_head) {
+		nftnl_coalesce_emit(&out, nftnl_coalesce_del_type(e->type),
+				    e->del_obj);
+		e->del_obj = NULL;
+	}
+	list_for_each_entry(e, &c->new_list, new_head) {
+		nftnl_coalesce_emit(&out, e->type, e->new_obj);
+		e->new_obj = NULL;
+	}
+	nftnl_coalesce_deliver_set(&out);
+
+	if (c->gen != NULL) {
+		nftnl_coalesce_deliver(&out, NFT_MSG_NEWGEN, c->gen);
+		c->gen = NULL;
+	}
+
+	nftnl_coalesce_reset(c);
+
+	return out.ret < 0 ? -1 : out.num;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_coalesce_flush);
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <time.h>
+#include <arpa/inet.h>
 #include <linux/netlink.h>
 #include <linux/netfilter/nfnetlink.h>
 #include <linux/netfilter/nf_tables.h>
@@ -93,6 +94,7 @@ int nftnl_cmd_header_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t typ
 	switch (type) {
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		nftnl_buf_open_array(&b, type, nftnl_cmd2tag(cmd));
 		break;
 	default:
@@ -109,20 +111,6 @@ int nftnl_cmd_header_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t typ
 	return nftnl_buf_done(&b);
 }
 
-static int nftnl_cmd_header_fprintf_cb(char *buf, size_t size, void *obj,
-				     uint32_t cmd, uint32_t type,
-				     uint32_t flags)
-{
-	return nftnl_cmd_header_snprintf(buf, size, cmd, type, flags);
-}
-
-int nftnl_cmd_header_fprintf(FILE *fp, uint32_t cmd, uint32_t type,
-			   uint32_t flags)
-{
-	return nftnl_fprintf(fp, NULL, cmd, type, flags,
-			   nftnl_cmd_header_fprintf_cb);
-}
-
 int nftnl_cmd_footer_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t type,
 			    uint32_t flags)
 {
@@ -134,6 +122,7 @@ int nftnl_cmd_footer_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t typ
 	switch (type) {
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		nftnl_buf_close_array(&b, type, nftnl_cmd2tag(cmd));
 		break;
 	default:
@@ -142,21 +131,8 @@ int nftnl_cmd_footer_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t typ
 	return nftnl_buf_done(&b);
 }
 
-static int nftnl_cmd_footer_fprintf_cb(char *buf, size_t size, void *obj,
-				     uint32_t cmd, uint32_t type,
-				     uint32_t flags)
-{
-	return nftnl_cmd_footer_snprintf(buf, size, cmd, type, flags);
-}
-
-int nftnl_cmd_footer_fprintf(FILE *fp, uint32_t cmd, uint32_t type,
-			   uint32_t flags)
-{
-	return nftnl_fprintf(fp, NULL, cmd, type, flags,
-			   nftnl_cmd_footer_fprintf_cb);
-}
-
-static void nftnl_batch_build_hdr(char *buf, uint16_t type, uint32_t seq)
+static struct nlmsghdr *nftnl_batch_build_hdr(char *buf, uint16_t type,
+						uint32_t seq)
 {
 	struct nlmsghdr *nlh;
 	struct nfgenmsg *nfg;
@@ -170,6 +146,8 @@ static void nftnl_batch_build_hdr(char *buf, uint16_t type, uint32_t seq)
 	nfg->nfgen_family = AF_UNSPEC;
 	nfg->version = NFNETLINK_V0;
 	nfg->res_id = NFNL_SUBSYS_NFTABLES;
+
+	return nlh;
 }
 
 void nftnl_batch_begin(char *buf, uint32_t seq)
@@ -178,6 +156,15 @@ void nftnl_batch_begin(char *buf, uint32_t seq)
 }
 EXPORT_SYMBOL(nftnl_batch_begin, nft_batch_begin);
 
+void nftnl_batch_begin_genid(char *buf, uint32_t seq, uint32_t genid)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_batch_build_hdr(buf, NFNL_MSG_BATCH_BEGIN, seq);
+	mnl_attr_put_u32(nlh, NFNL_BATCH_GENID, htonl(genid));
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_batch_begin_genid);
+
 void nftnl_batch_end(char *buf, uint32_t seq)
 {
 	nftnl_batch_build_hdr(buf, NFNL_MSG_BATCH_END, seq);
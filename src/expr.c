@@ -215,6 +215,29 @@ nftnl_expr_build_payload(struct nlmsghdr *nlh, struct nftnl_expr *expr)
 	mnl_attr_nest_end(nlh, nest);
 }
 
+/*
+ * Same as above, but the attributes in @exclude are left out. The build
+ * callbacks look at the expression flags, so a copy is built: @expr may be
+ * shared with other threads.
+ */
+int nftnl_expr_build_payload_excl(struct nlmsghdr *nlh,
+				  const struct nftnl_expr *expr,
+				  uint32_t exclude)
+{
+	struct nftnl_expr *tmp;
+
+	tmp = malloc(sizeof(struct nftnl_expr) + expr->ops->alloc_len);
+	if (tmp == NULL)
+		return -1;
+
+	memcpy(tmp, expr, sizeof(struct nftnl_expr) + expr->ops->alloc_len);
+	tmp->flags &= ~exclude;
+	nftnl_expr_build_payload(nlh, tmp);
+	xfree(tmp);
+
+	return 0;
+}
+
 static int nftnl_rule_parse_expr_cb(const struct nlattr *attr, void *data)
 {
 	const struct nlattr **tb = data;
@@ -191,6 +191,7 @@ static int nftnl_expr_counter_snprintf(char *buf, size_t len, uint32_t type,
 		return nftnl_expr_counter_snprintf_default(buf, len, e);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_counter_export(buf, len, e, type);
 	default:
 		break;
@@ -189,33 +189,73 @@ nftnl_data_reg_value_snprintf_json(char *buf, size_t size,
 					   union nftnl_data_reg *reg,
 					   uint32_t flags)
 {
-	int len = size, offset = 0, ret, i, j;
-	uint32_t utemp;
-	uint8_t *tmp;
+	int len = size, offset = 0, ret, i;
+	char word[32], *p;
 
 	ret = snprintf(buf, len, "\"reg\":{\"type\":\"value\",");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-	ret = snprintf(buf+offset, len, "\"len\":%u,", reg->len);
+	memcpy(word, "\"len\":", 6);
+	p = nftnl_fmt_u32(word + 6, reg->len);
+	*p++ = ',';
+	ret = nftnl_fmt_copy(buf+offset, len, word, p - word);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
+	/* "dataN":"0x01020304", in one go */
 	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf+offset, len, "\"data%d\":\"0x", i);
+		p = word;
+		memcpy(p, "\"data", 5);
+		p = nftnl_fmt_u32(p + 5, i);
+		memcpy(p, "\":\"0x", 5);
+		p = nftnl_fmt_hex32(p + 5, reg->val[i]);
+		memcpy(p, "\",", 2);
+		p += 2;
+
+		ret = nftnl_fmt_copy(buf+offset, len, word, p - word);
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	offset--;
+	ret = snprintf(buf+offset, len, "}");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
 
-		utemp = htonl(reg->val[i]);
-		tmp = (uint8_t *)&utemp;
+static
+int nftnl_data_reg_value_snprintf_cbor(char *buf, size_t size,
+				     union nftnl_data_reg *reg,
+				     uint32_t flags)
+{
+	int len = size, offset = 0, ret, i;
+	char key[16], val[16], *p;
 
-		for (j = 0; j<sizeof(uint32_t); j++) {
-			ret = snprintf(buf+offset, len, "%.02x", tmp[j]);
-			SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-		}
+	ret = nftnl_cbor_str(buf, len, "reg");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-		ret = snprintf(buf+offset, len, "\",");
+	ret = nftnl_cbor_byte(buf+offset, len,
+			      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_pair_str(buf+offset, len, "type", "value");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_pair_uint(buf+offset, len, "len", reg->len);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	/* same "dataN":"0x01020304" pairs as in json */
+	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
+		memcpy(key, "data", 4);
+		p = nftnl_fmt_u32(key + 4, i);
+		*p = '\0';
+		memcpy(val, "0x", 2);
+		p = nftnl_fmt_hex32(val + 2, reg->val[i]);
+		*p = '\0';
+
+		ret = nftnl_cbor_pair_str(buf+offset, len, key, val);
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
-	offset--;
-	ret = snprintf(buf+offset, len, "}");
+
+	ret = nftnl_cbor_byte(buf+offset, len, NFTNL_CBOR_BREAK);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	return offset;
@@ -225,29 +265,35 @@ static
 int nftnl_data_reg_value_snprintf_xml(char *buf, size_t size,
 				    union nftnl_data_reg *reg, uint32_t flags)
 {
-	int len = size, offset = 0, ret, i, j;
-	uint32_t be;
-	uint8_t *tmp;
+	int len = size, offset = 0, ret, i;
+	char word[48], idx[10], *p;
+	size_t n;
 
 	ret = snprintf(buf, len, "<reg type=\"value\">");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-	ret = snprintf(buf+offset, len, "<len>%u</len>", reg->len);
+	memcpy(word, "<len>", 5);
+	p = nftnl_fmt_u32(word + 5, reg->len);
+	memcpy(p, "</len>", 6);
+	p += 6;
+	ret = nftnl_fmt_copy(buf+offset, len, word, p - word);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
+	/* <dataN>0x01020304</dataN> in one go */
 	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf+offset, len, "<data%d>0x", i);
-		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-		be = htonl(reg->val[i]);
-		tmp = (uint8_t *)&be;
-
-		for (j = 0; j < sizeof(uint32_t); j++) {
-			ret = snprintf(buf+offset, len, "%.02x", tmp[j]);
-			SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-		}
-
-		ret = snprintf(buf+offset, len, "</data%d>", i);
+		n = nftnl_fmt_u32(idx, i) - idx;
+
+		p = word;
+		memcpy(p, "<data", 5);
+		memcpy(p + 5, idx, n);
+		memcpy(p + 5 + n, ">0x", 3);
+		p = nftnl_fmt_hex32(p + 5 + n + 3, reg->val[i]);
+		memcpy(p, "</data", 6);
+		memcpy(p + 6, idx, n);
+		p += 6 + n;
+		*p++ = '>';
+
+		ret = nftnl_fmt_copy(buf+offset, len, word, p - word);
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
@@ -262,9 +308,13 @@ nftnl_data_reg_value_snprintf_default(char *buf, size_t size,
 				    union nftnl_data_reg *reg, uint32_t flags)
 {
 	int len = size, offset = 0, ret, i;
+	char word[11] = "0x";
 
 	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf+offset, len, "0x%.8x ", reg->val[i]);
+		nftnl_fmt_hex32(word + 2, reg->val[i]);
+		word[10] = ' ';
+
+		ret = nftnl_fmt_copy(buf+offset, len, word, sizeof(word));
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
@@ -332,6 +382,37 @@ nftnl_data_reg_verdict_snprintf_json(char *buf, size_t size,
 	return offset;
 }
 
+static int
+nftnl_data_reg_verdict_snprintf_cbor(char *buf, size_t size,
+				   union nftnl_data_reg *reg, uint32_t flags)
+{
+	int len = size, offset = 0, ret = 0;
+
+	ret = nftnl_cbor_str(buf, len, "reg");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf+offset, len,
+			      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_pair_str(buf+offset, len, "type", "verdict");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_pair_str(buf+offset, len, "verdict",
+				  nftnl_verdict2str(reg->verdict));
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	if (reg->chain != NULL) {
+		ret = nftnl_cbor_pair_str(buf+offset, len, "chain", reg->chain);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	ret = nftnl_cbor_byte(buf+offset, len, NFTNL_CBOR_BREAK);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
 int nftnl_data_reg_snprintf(char *buf, size_t size, union nftnl_data_reg *reg,
 			  uint32_t output_format, uint32_t flags, int reg_type)
 {
@@ -347,6 +428,9 @@ int nftnl_data_reg_snprintf(char *buf, size_t size, union nftnl_data_reg *reg,
 		case NFTNL_OUTPUT_JSON:
 			return nftnl_data_reg_value_snprintf_json(buf, size,
 							       reg, flags);
+		case NFTNL_OUTPUT_CBOR:
+			return nftnl_data_reg_value_snprintf_cbor(buf, size,
+								reg, flags);
 		default:
 			break;
 		}
@@ -362,6 +446,9 @@ int nftnl_data_reg_snprintf(char *buf, size_t size, union nftnl_data_reg *reg,
 		case NFTNL_OUTPUT_JSON:
 			return nftnl_data_reg_verdict_snprintf_json(buf, size,
 								  reg, flags);
+		case NFTNL_OUTPUT_CBOR:
+			return nftnl_data_reg_verdict_snprintf_cbor(buf, size,
+								  reg, flags);
 		default:
 			break;
 		}
@@ -115,18 +115,15 @@ static int nftnl_expr_dup_json_parse(struct nftnl_expr *e, json_t *root,
 				     struct nftnl_parse_err *err)
 {
 #ifdef JSON_PARSING
-	struct nftnl_expr_dup *dup = nftnl_expr_data(e);
 	uint32_t sreg_addr, sreg_dev;
-	int datareg_type;
 
-	ret = nftnl_jansson_parse_val(root, "sreg_addr", NFT_TYPE_U32, &sreg_addr, err);
-	if (ret >= 0)
-		nftnl_expr_set_u32(e, NFTNL_EXPR_DUP_SREG_DEV, sreg_addr);
-	ret = nftnl_jansson_parse_val(root, "sreg_dev", NFT_TYPE_U32, &sreg_dev, err);
-	if (ret >= 0)
+	if (nftnl_jansson_parse_reg(root, "sreg_addr", NFTNL_TYPE_U32,
+				    &sreg_addr, err) == 0)
+		nftnl_expr_set_u32(e, NFTNL_EXPR_DUP_SREG_ADDR, sreg_addr);
+	if (nftnl_jansson_parse_reg(root, "sreg_dev", NFTNL_TYPE_U32,
+				    &sreg_dev, err) == 0)
 		nftnl_expr_set_u32(e, NFTNL_EXPR_DUP_SREG_DEV, sreg_dev);
 
-
 	return 0;
 #else
 	errno = EOPNOTSUPP;
@@ -138,14 +135,13 @@ static int nftnl_expr_dup_xml_parse(struct nftnl_expr *e, mxml_node_t *tree,
 				    struct nftnl_parse_err *err)
 {
 #ifdef XML_PARSING
-	struct nftnl_expr_dup *dup = nftnl_expr_data(e);
 	uint32_t sreg_addr, sreg_dev;
 
 	if (nftnl_mxml_reg_parse(tree, "sreg_addr", &sreg_addr, MXML_DESCEND_FIRST,
-			       NFT_XML_OPT, err) == 0)
+			       NFTNL_XML_OPT, err) == 0)
 		nftnl_expr_set_u32(e, NFTNL_EXPR_DUP_SREG_ADDR, sreg_addr);
 	if (nftnl_mxml_reg_parse(tree, "sreg_dev", &sreg_dev, MXML_DESCEND_FIRST,
-			       NFT_XML_OPT, err) == 0)
+			       NFTNL_XML_OPT, err) == 0)
 		nftnl_expr_set_u32(e, NFTNL_EXPR_DUP_SREG_DEV, sreg_dev);
 
 	return 0;
@@ -196,6 +192,7 @@ static int nftnl_expr_dup_snprintf(char *buf, size_t len, uint32_t type,
 		return nftnl_expr_dup_snprintf_default(buf, len, e, flags);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_dup_export(buf, len, e, type);
 	default:
 		break;
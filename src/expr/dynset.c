@@ -284,11 +284,15 @@ nftnl_expr_dynset_export(char *buf, size_t size,
 	NFTNL_BUF_INIT(b, buf, size);
 
 	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SET_NAME))
-		nftnl_buf_str(&b, type, dynset->set_name, SET_NAME);
+		nftnl_buf_str(&b, type, dynset->set_name, SET);
 	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SREG_KEY))
 		nftnl_buf_u32(&b, type, dynset->sreg_key, SREG_KEY);
 	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SREG_DATA))
 		nftnl_buf_u32(&b, type, dynset->sreg_data, SREG_DATA);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_OP))
+		nftnl_buf_u32(&b, type, dynset->op, OP);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_TIMEOUT))
+		nftnl_buf_u64(&b, type, dynset->timeout, TIMEOUT);
 
 	return nftnl_buf_done(&b);
 }
@@ -354,6 +358,7 @@ nftnl_expr_dynset_snprintf(char *buf, size_t size, uint32_t type,
 		return nftnl_expr_dynset_snprintf_default(buf, size, e);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_dynset_export(buf, size, e, type);
 	default:
 		break;
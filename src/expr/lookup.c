@@ -74,6 +74,7 @@ nftnl_expr_lookup_get(const struct nftnl_expr *e, uint16_t type,
 	case NFTNL_EXPR_LOOKUP_SET:
 		return lookup->set_name;
 	case NFTNL_EXPR_LOOKUP_SET_ID:
+		*data_len = sizeof(lookup->set_id);
 		return &lookup->set_id;
 	}
 	return NULL;
@@ -251,6 +252,7 @@ nftnl_expr_lookup_snprintf(char *buf, size_t size, uint32_t type,
 		return nftnl_expr_lookup_snprintf_default(buf, size, e);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_lookup_export(buf, size, e, type);
 	default:
 		break;
@@ -226,6 +226,7 @@ nftnl_expr_match_snprintf(char *buf, size_t len, uint32_t type,
 				match->name, match->rev);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_match_export(buf, len, e, type);
 	default:
 		break;
@@ -397,6 +397,7 @@ nftnl_expr_nat_snprintf(char *buf, size_t size, uint32_t type,
 		return nftnl_expr_nat_snprintf_default(buf, size, e);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_nat_export(buf, size, e, type);
 	default:
 		break;
@@ -278,6 +278,7 @@ nftnl_expr_payload_snprintf(char *buf, size_t len, uint32_t type,
 				payload->offset, payload->dreg);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_expr_payload_export(buf, len, flags, e, type);
 	default:
 		break;
@@ -227,6 +227,7 @@ nftnl_expr_target_snprintf(char *buf, size_t len, uint32_t type,
 				target->name, target->rev);
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_rule_exp_target_export(buf, len, e, type);
 	default:
 		break;
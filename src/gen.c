@@ -161,6 +161,22 @@ static int nftnl_gen_snprintf_default(char *buf, size_t size, struct nftnl_gen *
 	return snprintf(buf, size, "ruleset generation ID %u", gen->id);
 }
 
+static int nftnl_gen_snprintf_json(char *buf, size_t size, struct nftnl_gen *gen)
+{
+	return snprintf(buf, size, "{\"gen\":{\"id\":%u}}", gen->id);
+}
+
+static int nftnl_gen_snprintf_cbor(char *buf, size_t size, struct nftnl_gen *gen)
+{
+	NFTNL_BUF_INIT(b, buf, size);
+
+	nftnl_buf_open(&b, NFTNL_OUTPUT_CBOR, "gen");
+	nftnl_buf_u32(&b, NFTNL_OUTPUT_CBOR, gen->id, "id");
+	nftnl_buf_close(&b, NFTNL_OUTPUT_CBOR, "gen");
+
+	return nftnl_buf_done(&b);
+}
+
 static int nftnl_gen_cmd_snprintf(char *buf, size_t size, struct nftnl_gen *gen,
 				uint32_t cmd, uint32_t type, uint32_t flags)
 {
@@ -173,6 +189,12 @@ static int nftnl_gen_cmd_snprintf(char *buf, size_t size, struct nftnl_gen *gen,
 	case NFTNL_OUTPUT_DEFAULT:
 		ret = nftnl_gen_snprintf_default(buf + offset, len, gen);
 		break;
+	case NFTNL_OUTPUT_JSON:
+		ret = nftnl_gen_snprintf_json(buf + offset, len, gen);
+		break;
+	case NFTNL_OUTPUT_CBOR:
+		ret = nftnl_gen_snprintf_cbor(buf + offset, len, gen);
+		break;
 	default:
 		return -1;
 	}
@@ -206,3 +228,73 @@ int nftnl_gen_fprintf(FILE *fp, struct nftnl_gen *gen, uint32_t type,
 			   nftnl_gen_do_snprintf);
 }
 EXPORT_SYMBOL(nftnl_gen_fprintf, nft_gen_fprintf);
+
+/*
+ * The NEWGEN event that ends a transaction carries the port ID of the socket
+ * that committed it. If the one for our batch does not follow the generation
+ * the changes were based on, someone else committed in between.
+ */
+struct nftnl_gen_commit {
+	uint32_t	genid;
+	uint32_t	portid;
+	int		state;
+};
+
+struct nftnl_gen_commit *nftnl_gen_commit_alloc(uint32_t genid,
+						uint32_t portid)
+{
+	struct nftnl_gen_commit *gc;
+
+	gc = calloc(1, sizeof(struct nftnl_gen_commit));
+	if (gc == NULL)
+		return NULL;
+
+	gc->genid = genid;
+	gc->portid = portid;
+	gc->state = NFTNL_GEN_COMMIT_PENDING;
+
+	return gc;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_gen_commit_alloc);
+
+void nftnl_gen_commit_free(struct nftnl_gen_commit *gc)
+{
+	xfree(gc);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_gen_commit_free);
+
+int nftnl_gen_commit_event(struct nftnl_gen_commit *gc,
+			   const struct nlmsghdr *nlh)
+{
+	struct nftnl_gen gen = {};
+
+	if (gc->state != NFTNL_GEN_COMMIT_PENDING ||
+	    NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES ||
+	    NFNL_MSG_TYPE(nlh->nlmsg_type) != NFT_MSG_NEWGEN)
+		return gc->state;
+
+	if (nftnl_gen_nlmsg_parse(nlh, &gen) < 0 ||
+	    !(gen.flags & (1 << NFTNL_GEN_ID))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* an older transaction, our changes already took it into account */
+	if ((int32_t)(gen.id - gc->genid) <= 0)
+		return gc->state;
+
+	if (nlh->nlmsg_pid == gc->portid && gen.id == gc->genid + 1)
+		gc->state = NFTNL_GEN_COMMIT_OK;
+	else
+		gc->state = NFTNL_GEN_COMMIT_CONFLICT;
+
+	gc->genid = gen.id;
+	return gc->state;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_gen_commit_event);
+
+uint32_t nftnl_gen_commit_genid(const struct nftnl_gen_commit *gc)
+{
+	return gc->genid;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_gen_commit_genid);
@@ -90,10 +90,15 @@ bool nftnl_jansson_node_exist(json_t *root, const char *node_name)
 }
 
 json_t *nftnl_jansson_create_root(const void *json, json_error_t *error,
-				struct nftnl_parse_err *err, enum nftnl_parse_input input)
+				struct nftnl_parse_err *err, enum nftnl_parse_input input,
+				enum nftnl_parse_type type)
 {
 	json_t *root;
 
+	/* cbor is decoded into the very same tree */
+	if (type == NFTNL_PARSE_CBOR)
+		return nftnl_cbor_create_root(json, err, input);
+
 	switch (input) {
 	case NFTNL_PARSE_BUFFER:
 		root = json_loadb(json, strlen(json), 0, error);
@@ -187,12 +192,10 @@ int nftnl_jansson_str2num(json_t *root, const char *node_name, int base,
 }
 
 struct nftnl_expr *nftnl_jansson_expr_parse(json_t *root,
-					     struct nftnl_parse_err *err,
-					     struct nftnl_set_list *set_list)
+					     struct nftnl_parse_err *err)
 {
 	struct nftnl_expr *e;
 	const char *type;
-	uint32_t set_id;
 	int ret;
 
 	type = nftnl_jansson_parse_str(root, "type", err);
@@ -207,11 +210,6 @@ struct nftnl_expr *nftnl_jansson_expr_parse(json_t *root,
 
 	ret = e->ops->json_parse(e, root, err);
 
-	if (set_list != NULL &&
-	    strcmp(type, "lookup") == 0 &&
-	    nftnl_set_lookup_id(e, set_list, &set_id))
-		nftnl_expr_set_u32(e, NFTNL_EXPR_LOOKUP_SET_ID, set_id);
-
 	return ret < 0 ? NULL : e;
 }
 
@@ -247,26 +245,32 @@ int nftnl_jansson_data_reg_parse(json_t *root, const char *node_name,
 int nftnl_jansson_set_elem_parse(struct nftnl_set_elem *e, json_t *root,
 			       struct nftnl_parse_err *err)
 {
+	union nftnl_data_reg key = {}, data = {};
 	int set_elem_data;
 	uint32_t flags;
 
 	if (nftnl_jansson_parse_val(root, "flags", NFTNL_TYPE_U32, &flags, err) == 0)
 		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS, flags);
 
-	if (nftnl_jansson_data_reg_parse(root, "key", &e->key, err) == DATA_VALUE)
-		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
+	if (nftnl_jansson_data_reg_parse(root, "key", &key, err) == DATA_VALUE)
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key.val, key.len);
 
 	if (nftnl_jansson_node_exist(root, "data")) {
 		set_elem_data = nftnl_jansson_data_reg_parse(root, "data",
-							   &e->data, err);
+							   &data, err);
 		switch (set_elem_data) {
 		case DATA_VALUE:
-			e->flags |= (1 << NFTNL_SET_ELEM_DATA);
+			nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, data.val,
+					   data.len);
 			break;
 		case DATA_VERDICT:
-			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
-			if (e->data.chain != NULL)
-				e->flags |= (1 << NFTNL_SET_ELEM_CHAIN);
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+					       data.verdict);
+			if (data.chain != NULL) {
+				nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN,
+						       data.chain);
+				xfree(data.chain);
+			}
 			break;
 		case DATA_NONE:
 		default:
@@ -276,4 +280,248 @@ int nftnl_jansson_set_elem_parse(struct nftnl_set_elem *e, json_t *root,
 
 	return 0;
 }
+
+/*
+ * Incremental reader: the outer structure of a document is walked with the
+ * helpers below and only the values of interest are loaded as jansson trees,
+ * one at a time, so memory use does not grow with the size of the document.
+ */
+static void nftnl_jansson_stream_advance(struct nftnl_jansson_stream *s)
+{
+	char *val;
+
+	if (s->c == EOF)
+		return;
+
+	if (s->record) {
+		if (s->len + 1 >= s->size) {
+			s->size = s->size ? s->size * 2 : 4096;
+			val = realloc(s->val, s->size);
+			if (val == NULL) {
+				s->oom = true;
+				s->record = false;
+			} else {
+				s->val = val;
+			}
+		}
+		if (s->record)
+			s->val[s->len++] = s->c;
+	}
+
+	if (s->c == '\n') {
+		s->line++;
+		s->column = 1;
+	} else {
+		s->column++;
+	}
+
+	switch (s->input) {
+	case NFTNL_PARSE_FILE:
+		s->c = getc(s->fp);
+		break;
+	case NFTNL_PARSE_BUFFER:
+		s->c = s->buf[s->pos] ? (unsigned char)s->buf[s->pos++] : EOF;
+		break;
+	}
+}
+
+void nftnl_jansson_stream_init(struct nftnl_jansson_stream *s,
+			       const void *data, enum nftnl_parse_input input)
+{
+	memset(s, 0, sizeof(*s));
+	s->input = input;
+	if (input == NFTNL_PARSE_FILE)
+		s->fp = (FILE *)data;
+	else
+		s->buf = data;
+	s->line = 1;
+	s->column = 0;
+	/* load the lookahead, it starts at line 1 column 1 */
+	s->c = '\0';
+	nftnl_jansson_stream_advance(s);
+}
+
+void nftnl_jansson_stream_free(struct nftnl_jansson_stream *s)
+{
+	xfree(s->val);
+}
+
+static int nftnl_jansson_stream_error(struct nftnl_jansson_stream *s,
+				      struct nftnl_parse_err *err)
+{
+	err->error = NFTNL_PARSE_EBADINPUT;
+	err->line = s->line;
+	err->column = s->column;
+	err->node_name = NULL;
+	errno = s->oom ? ENOMEM : EINVAL;
+	return -1;
+}
+
+int nftnl_jansson_stream_peek(struct nftnl_jansson_stream *s)
+{
+	while (s->c == ' ' || s->c == '\t' || s->c == '\n' || s->c == '\r')
+		nftnl_jansson_stream_advance(s);
+
+	return s->c;
+}
+
+int nftnl_jansson_stream_expect(struct nftnl_jansson_stream *s, int c,
+				struct nftnl_parse_err *err)
+{
+	if (nftnl_jansson_stream_peek(s) != c)
+		return nftnl_jansson_stream_error(s, err);
+
+	nftnl_jansson_stream_advance(s);
+	return 0;
+}
+
+/* After a member or element: 1 if another one follows, 0 on @close. */
+int nftnl_jansson_stream_next(struct nftnl_jansson_stream *s, int close,
+			      struct nftnl_parse_err *err)
+{
+	int c = nftnl_jansson_stream_peek(s);
+
+	if (c != ',' && c != close)
+		return nftnl_jansson_stream_error(s, err);
+
+	nftnl_jansson_stream_advance(s);
+	return c == ',';
+}
+
+static int nftnl_jansson_stream_string(struct nftnl_jansson_stream *s,
+				       char *str, size_t size,
+				       struct nftnl_parse_err *err)
+{
+	size_t len = 0;
+	bool escape = false;
+
+	if (nftnl_jansson_stream_expect(s, '"', err) < 0)
+		return -1;
+
+	while (s->c != EOF && (escape || s->c != '"')) {
+		escape = !escape && s->c == '\\';
+		if (str != NULL && len + 1 < size)
+			str[len++] = s->c;
+		nftnl_jansson_stream_advance(s);
+	}
+	if (str != NULL)
+		str[len] = '\0';
+
+	return nftnl_jansson_stream_expect(s, '"', err);
+}
+
+/* Reads the key of the next member, which is truncated to @size. */
+int nftnl_jansson_stream_key(struct nftnl_jansson_stream *s, char *key,
+			     size_t size, struct nftnl_parse_err *err)
+{
+	if (nftnl_jansson_stream_string(s, key, size, err) < 0)
+		return -1;
+
+	return nftnl_jansson_stream_expect(s, ':', err);
+}
+
+/* Consumes the next value, nesting is checked but nothing else is. */
+int nftnl_jansson_stream_skip(struct nftnl_jansson_stream *s,
+			      struct nftnl_parse_err *err)
+{
+	int depth = 0, c;
+
+	do {
+		c = nftnl_jansson_stream_peek(s);
+		switch (c) {
+		case '"':
+			if (nftnl_jansson_stream_string(s, NULL, 0, err) < 0)
+				return -1;
+			continue;
+		case '{':
+		case '[':
+			depth++;
+			break;
+		case '}':
+		case ']':
+			if (--depth < 0)
+				return nftnl_jansson_stream_error(s, err);
+			break;
+		case ',':
+		case ':':
+			if (depth == 0)
+				return nftnl_jansson_stream_error(s, err);
+			break;
+		case EOF:
+			return nftnl_jansson_stream_error(s, err);
+		default:
+			/* numbers, true, false and null */
+			do {
+				nftnl_jansson_stream_advance(s);
+			} while (s->c != EOF && s->c != '\0' &&
+				 strchr(",:]}\" \t\r\n", s->c) == NULL);
+			continue;
+		}
+		nftnl_jansson_stream_advance(s);
+	} while (depth > 0);
+
+	return 0;
+}
+
+/*
+ * Reads the next value into s->val, s->line and s->column are where it
+ * started for nftnl_jansson_load().
+ */
+int nftnl_jansson_stream_record(struct nftnl_jansson_stream *s,
+				struct nftnl_parse_err *err)
+{
+	int ret;
+
+	nftnl_jansson_stream_peek(s);
+	s->val_line = s->line;
+	s->val_column = s->column;
+
+	s->len = 0;
+	s->record = true;
+	ret = nftnl_jansson_stream_skip(s, err);
+	s->record = false;
+	if (ret < 0)
+		return -1;
+
+	if (s->oom)
+		return nftnl_jansson_stream_error(s, err);
+
+	return 0;
+}
+
+/* Errors are reported as if @val was found at @line and @column. */
+json_t *nftnl_jansson_load(const char *val, size_t len, int line, int column,
+			   struct nftnl_parse_err *err)
+{
+	json_error_t error;
+	json_t *root;
+
+	root = json_loadb(val, len, 0, &error);
+	if (root == NULL) {
+		err->error = NFTNL_PARSE_EBADINPUT;
+		err->line = line + error.line - 1;
+		err->column = error.line == 1 ? column + error.column - 1 :
+						error.column;
+		err->node_name = NULL;
+		errno = EINVAL;
+	}
+
+	return root;
+}
+
+/* Loads the next value, the caller releases it with json_decref(). */
+json_t *nftnl_jansson_stream_load(struct nftnl_jansson_stream *s,
+				  struct nftnl_parse_err *err)
+{
+	if (nftnl_jansson_stream_record(s, err) < 0)
+		return NULL;
+
+	return nftnl_jansson_load(s->val, s->len, s->val_line, s->val_column,
+				  err);
+}
+
+bool nftnl_jansson_stream_eof(struct nftnl_jansson_stream *s)
+{
+	return nftnl_jansson_stream_peek(s) == EOF;
+}
 #endif
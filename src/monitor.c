@@ -0,0 +1,493 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#define _GNU_SOURCE
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/monitor.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+#include <libnftnl/sink.h>
+
+/* Datagrams fetched per recvmmsg() call, and room for each of them. */
+#define NFTNL_MONITOR_VLEN	16
+#define NFTNL_MONITOR_BUFSIZ	65536
+
+struct nftnl_monitor {
+	struct mnl_socket		*nl;
+	char				*buf;
+	struct mmsghdr			msgs[NFTNL_MONITOR_VLEN];
+	struct iovec			iov[NFTNL_MONITOR_VLEN];
+
+	uint32_t			types;
+	uint32_t			family;
+	const char			*table;
+	const char			*set;
+	uint32_t			flags;
+
+	int				(*cb)(uint16_t type, void *obj,
+					      void *data);
+	void				*data;
+	struct nftnl_sink		*sink;
+
+	struct nftnl_monitor_stats	stats;
+};
+
+struct nftnl_monitor *nftnl_monitor_alloc(void)
+{
+	struct nftnl_monitor *m;
+
+	m = calloc(1, sizeof(struct nftnl_monitor));
+	if (m == NULL)
+		return NULL;
+
+	m->types = ~0U;
+	return m;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_alloc);
+
+void nftnl_monitor_free(struct nftnl_monitor *m)
+{
+	if (m->nl != NULL)
+		mnl_socket_close(m->nl);
+	if (m->table != NULL)
+		nftnl_str_release(m->table);
+	if (m->set != NULL)
+		nftnl_str_release(m->set);
+	xfree(m->buf);
+	xfree(m);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_free);
+
+void nftnl_monitor_set_u32(struct nftnl_monitor *m, uint16_t attr,
+			   uint32_t val)
+{
+	switch (attr) {
+	case NFTNL_MONITOR_TYPES:
+		m->types = val;
+		break;
+	case NFTNL_MONITOR_FAMILY:
+		m->family = val;
+		break;
+	default:
+		return;
+	}
+	m->flags |= (1 << attr);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_set_u32);
+
+void nftnl_monitor_set_str(struct nftnl_monitor *m, uint16_t attr,
+			   const char *str)
+{
+	const char **name;
+
+	switch (attr) {
+	case NFTNL_MONITOR_TABLE:
+		name = &m->table;
+		break;
+	case NFTNL_MONITOR_SET:
+		name = &m->set;
+		break;
+	default:
+		return;
+	}
+
+	if (*name != NULL)
+		nftnl_str_release(*name);
+	*name = str ? nftnl_str_intern(str) : NULL;
+
+	if (*name != NULL)
+		m->flags |= (1 << attr);
+	else
+		m->flags &= ~(1 << attr);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_set_str);
+
+void nftnl_monitor_set_cb(struct nftnl_monitor *m,
+			  int (*cb)(uint16_t type, void *obj, void *data),
+			  void *data)
+{
+	m->cb = cb;
+	m->data = data;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_set_cb);
+
+void nftnl_monitor_set_sink(struct nftnl_monitor *m, struct nftnl_sink *sink)
+{
+	m->sink = sink;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_set_sink);
+
+void nftnl_monitor_get_stats(const struct nftnl_monitor *m,
+			     struct nftnl_monitor_stats *stats)
+{
+	*stats = m->stats;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_get_stats);
+
+int nftnl_monitor_open(struct nftnl_monitor *m, unsigned int rcvbuf)
+{
+	unsigned int i;
+
+	if (m->nl != NULL) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	m->buf = malloc(NFTNL_MONITOR_VLEN * NFTNL_MONITOR_BUFSIZ);
+	if (m->buf == NULL)
+		return -1;
+
+	m->nl = mnl_socket_open(NETLINK_NETFILTER);
+	if (m->nl == NULL)
+		goto err;
+
+	/* Needs CAP_NET_ADMIN to go beyond net.core.rmem_max. */
+	if (rcvbuf > 0 &&
+	    setsockopt(mnl_socket_get_fd(m->nl), SOL_SOCKET, SO_RCVBUFFORCE,
+		       &rcvbuf, sizeof(rcvbuf)) < 0)
+		setsockopt(mnl_socket_get_fd(m->nl), SOL_SOCKET, SO_RCVBUF,
+			   &rcvbuf, sizeof(rcvbuf));
+
+	if (mnl_socket_bind(m->nl, 1 << (NFNLGRP_NFTABLES - 1),
+			    MNL_SOCKET_AUTOPID) < 0)
+		goto err;
+
+	for (i = 0; i < NFTNL_MONITOR_VLEN; i++) {
+		m->iov[i].iov_base = m->buf + i * NFTNL_MONITOR_BUFSIZ;
+		m->iov[i].iov_len = NFTNL_MONITOR_BUFSIZ;
+		m->msgs[i].msg_hdr.msg_iov = &m->iov[i];
+		m->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	return 0;
+err:
+	if (m->nl != NULL) {
+		mnl_socket_close(m->nl);
+		m->nl = NULL;
+	}
+	xfree(m->buf);
+	m->buf = NULL;
+	return -1;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_open);
+
+int nftnl_monitor_fd(const struct nftnl_monitor *m)
+{
+	return m->nl ? mnl_socket_get_fd(m->nl) : -1;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_fd);
+
+static bool nftnl_monitor_attr_equal(const struct nlattr *attr,
+				     const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	return mnl_attr_get_payload_len(attr) == len &&
+	       memcmp(mnl_attr_get_payload(attr), str, len) == 0;
+}
+
+/*
+ * Look at the raw attributes only. All objects carry the table name as
+ * attribute 1, sets and element lists have the set name as attribute 2.
+ */
+static bool nftnl_monitor_match(const struct nftnl_monitor *m,
+				const struct nlmsghdr *nlh, uint16_t type)
+{
+	const struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	bool set_msg, table_ok, set_ok;
+	const struct nlattr *attr;
+
+	if (type >= 32 || !(m->types & (1 << type)))
+		return false;
+	if (type == NFT_MSG_NEWGEN)
+		return true;
+
+	if (m->flags & (1 << NFTNL_MONITOR_FAMILY) &&
+	    nfg->nfgen_family != m->family)
+		return false;
+
+	set_msg = type == NFT_MSG_NEWSET || type == NFT_MSG_DELSET ||
+		  type == NFT_MSG_NEWSETELEM || type == NFT_MSG_DELSETELEM;
+	table_ok = m->table == NULL;
+	set_ok = m->set == NULL || !set_msg;
+	if (table_ok && set_ok)
+		return true;
+
+	mnl_attr_for_each(attr, nlh, sizeof(*nfg)) {
+		switch (mnl_attr_get_type(attr)) {
+		case NFTA_TABLE_NAME:
+			if (!table_ok)
+				table_ok = nftnl_monitor_attr_equal(attr,
+								    m->table);
+			break;
+		case NFTA_SET_NAME:
+			if (!set_ok)
+				set_ok = nftnl_monitor_attr_equal(attr,
+								  m->set);
+			break;
+		}
+	}
+	return table_ok && set_ok;
+}
+
+void *nftnl_monitor_decode(const struct nlmsghdr *nlh, uint16_t type)
+{
+	void *obj = NULL;
+	int ret = -1;
+
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		obj = nftnl_table_alloc();
+		if (obj != NULL)
+			ret = nftnl_table_nlmsg_parse(nlh, obj);
+		break;
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		obj = nftnl_chain_alloc();
+		if (obj != NULL)
+			ret = nftnl_chain_nlmsg_parse(nlh, obj);
+		break;
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		obj = nftnl_rule_alloc();
+		if (obj != NULL)
+			ret = nftnl_rule_nlmsg_parse(nlh, obj);
+		break;
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+		obj = nftnl_set_alloc();
+		if (obj != NULL)
+			ret = nftnl_set_nlmsg_parse(nlh, obj);
+		break;
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		obj = nftnl_set_alloc();
+		if (obj != NULL)
+			ret = nftnl_set_elems_nlmsg_parse(nlh, obj);
+		break;
+	case NFT_MSG_NEWGEN:
+		obj = nftnl_gen_alloc();
+		if (obj != NULL)
+			ret = nftnl_gen_nlmsg_parse(nlh, obj);
+		break;
+	default:
+		return NULL;
+	}
+
+	if (ret < 0 && obj != NULL) {
+		nftnl_monitor_obj_free(type, obj);
+		obj = NULL;
+	}
+	return obj;
+}
+
+void nftnl_monitor_obj_free(uint16_t type, void *obj)
+{
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		nftnl_table_free(obj);
+		break;
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		nftnl_chain_free(obj);
+		break;
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		nftnl_rule_free(obj);
+		break;
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		nftnl_set_free(obj);
+		break;
+	case NFT_MSG_NEWGEN:
+		nftnl_gen_free(obj);
+		break;
+	}
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_obj_free);
+
+static int nftnl_monitor_gen_snprintf(char *buf, size_t size, void *gen,
+				      uint32_t cmd, uint32_t type,
+				      uint32_t flags)
+{
+	return nftnl_gen_snprintf(buf, size, gen, type, flags);
+}
+
+int nftnl_monitor_event_output(struct nftnl_sink *sink, uint16_t type,
+			       void *obj)
+{
+	uint64_t total = sink->total;
+	int ret;
+
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_NEWGEN:
+		ret = nftnl_sink_write(sink, "{\"" ADD "\":", strlen(ADD) + 4);
+		break;
+	case NFT_MSG_DELTABLE:
+	case NFT_MSG_DELCHAIN:
+	case NFT_MSG_DELRULE:
+	case NFT_MSG_DELSET:
+	case NFT_MSG_DELSETELEM:
+		ret = nftnl_sink_write(sink, "{\"" DELETE "\":",
+				       strlen(DELETE) + 4);
+		break;
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+	if (ret < 0)
+		return -1;
+
+	/* the objects render without an envelope unless asked for one */
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		ret = nftnl_table_output(sink, obj, NFTNL_OUTPUT_JSON, 0);
+		break;
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		ret = nftnl_chain_output(sink, obj, NFTNL_OUTPUT_JSON, 0);
+		break;
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		ret = nftnl_rule_output(sink, obj, NFTNL_OUTPUT_JSON, 0);
+		break;
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+		ret = nftnl_set_output(sink, obj, NFTNL_OUTPUT_JSON, 0);
+		break;
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		ret = nftnl_set_elems_output(sink, obj, NFTNL_OUTPUT_JSON, 0);
+		break;
+	case NFT_MSG_NEWGEN:
+		ret = nftnl_sink_obj(sink, obj, NFTNL_CMD_UNSPEC,
+				     NFTNL_OUTPUT_JSON, 0,
+				     nftnl_monitor_gen_snprintf);
+		break;
+	}
+	if (ret < 0 || nftnl_sink_write(sink, "}\n", 2) < 0)
+		return -1;
+
+	return sink->total - total;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_event_output);
+
+int nftnl_monitor_process(struct nftnl_monitor *m, const void *buf,
+			  size_t len)
+{
+	const struct nlmsghdr *nlh = buf;
+	int remain = len, ret, num = 0;
+	uint16_t type;
+	void *obj;
+
+	while (mnl_nlmsg_ok(nlh, remain)) {
+		m->stats.received++;
+
+		if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+			goto next;
+
+		type = NFNL_MSG_TYPE(nlh->nlmsg_type);
+		if (!nftnl_monitor_match(m, nlh, type)) {
+			m->stats.filtered++;
+			goto next;
+		}
+
+		obj = nftnl_monitor_decode(nlh, type);
+		if (obj == NULL) {
+			m->stats.errors++;
+			goto next;
+		}
+		m->stats.decoded++;
+		num++;
+
+		if (m->sink != NULL &&
+		    nftnl_monitor_event_output(m->sink, type, obj) < 0) {
+			nftnl_monitor_obj_free(type, obj);
+			return -1;
+		}
+
+		ret = m->cb ? m->cb(type, obj, m->data) : 0;
+		if (ret != NFTNL_MONITOR_CB_KEEP)
+			nftnl_monitor_obj_free(type, obj);
+		if (ret < 0)
+			return -1;
+next:
+		nlh = mnl_nlmsg_next(nlh, &remain);
+	}
+	return num;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_process);
+
+int nftnl_monitor_recv(struct nftnl_monitor *m)
+{
+	int i, n, ret, num = 0;
+	bool lost = false;
+
+	if (m->nl == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	n = recvmmsg(mnl_socket_get_fd(m->nl), m->msgs, NFTNL_MONITOR_VLEN,
+		     MSG_WAITFORONE, NULL);
+	if (n < 0) {
+		/* the kernel dropped events, tell the caller to resync */
+		if (errno == ENOBUFS)
+			m->stats.lost++;
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		/* what did not fit in the buffer is gone, as if dropped */
+		if (m->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			m->stats.lost++;
+			lost = true;
+			continue;
+		}
+
+		ret = nftnl_monitor_process(m, m->buf + i * NFTNL_MONITOR_BUFSIZ,
+					    m->msgs[i].msg_len);
+		if (ret < 0)
+			return -1;
+		num += ret;
+	}
+
+	if (m->sink != NULL && nftnl_sink_flush(m->sink) < 0)
+		return -1;
+
+	if (lost) {
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	return num;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_monitor_recv);
@@ -58,15 +58,47 @@ err:
 	return NULL;
 }
 
+/*
+ * Nodes are handed to @sax_cb as they are read, only those it retains stay in
+ * the tree. Returns the root element, which the callback needs to retain.
+ */
+mxml_node_t *nftnl_mxml_sax_load(const void *data, enum nftnl_parse_input input,
+				 mxml_sax_cb_t sax_cb, void *sax_data,
+				 struct nftnl_parse_err *err)
+{
+	mxml_node_t *tree;
+
+	switch (input) {
+	case NFTNL_PARSE_BUFFER:
+		tree = mxmlSAXLoadString(NULL, data, MXML_OPAQUE_CALLBACK,
+					 sax_cb, sax_data);
+		break;
+	case NFTNL_PARSE_FILE:
+		tree = mxmlSAXLoadFile(NULL, (FILE *)data, MXML_OPAQUE_CALLBACK,
+				       sax_cb, sax_data);
+		break;
+	default:
+		goto err;
+	}
+
+	if (tree != NULL)
+		return tree;
+
+	err->error = NFTNL_PARSE_EBADINPUT;
+err:
+	err->line = 0;
+	err->column = 0;
+	errno = EINVAL;
+	return NULL;
+}
+
 struct nftnl_expr *nftnl_mxml_expr_parse(mxml_node_t *node,
-					  struct nftnl_parse_err *err,
-					  struct nftnl_set_list *set_list)
+					  struct nftnl_parse_err *err)
 {
 	mxml_node_t *tree;
 	struct nftnl_expr *e;
 	const char *expr_name;
 	char *xml_text;
-	uint32_t set_id;
 	int ret;
 
 	expr_name = mxmlElementGetAttr(node, "type");
@@ -93,11 +125,6 @@ struct nftnl_expr *nftnl_mxml_expr_parse(mxml_node_t *node,
 	ret = e->ops->xml_parse(e, tree, err);
 	mxmlDelete(tree);
 
-	if (set_list != NULL &&
-	    strcmp(expr_name, "lookup") == 0 &&
-	    nftnl_set_lookup_id(e, set_list, &set_id))
-		nftnl_expr_set_u32(e, NFTNL_EXPR_LOOKUP_SET_ID, set_id);
-
 	return ret < 0 ? NULL : e;
 err_expr:
 	nftnl_expr_free(e);
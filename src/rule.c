@@ -31,6 +31,9 @@
 
 struct nftnl_rule {
 	struct list_head head;
+	/* only in use if the list this rule belongs to is indexed */
+	struct hlist_node hnode;
+	struct list_head chain_head;
 
 	uint32_t	flags;
 	uint32_t	family;
@@ -72,9 +75,9 @@ void nftnl_rule_free(struct nftnl_rule *r)
 		nftnl_expr_free(e);
 
 	if (r->table != NULL)
-		xfree(r->table);
+		nftnl_str_release(r->table);
 	if (r->chain != NULL)
-		xfree(r->chain);
+		nftnl_str_release(r->chain);
 
 	xfree(r);
 }
@@ -94,13 +97,13 @@ void nftnl_rule_unset(struct nftnl_rule *r, uint16_t attr)
 	switch (attr) {
 	case NFTNL_RULE_TABLE:
 		if (r->table) {
-			xfree(r->table);
+			nftnl_str_release(r->table);
 			r->table = NULL;
 		}
 		break;
 	case NFTNL_RULE_CHAIN:
 		if (r->chain) {
-			xfree(r->chain);
+			nftnl_str_release(r->chain);
 			r->chain = NULL;
 		}
 		break;
@@ -136,15 +139,15 @@ void nftnl_rule_set_data(struct nftnl_rule *r, uint16_t attr,
 	switch(attr) {
 	case NFTNL_RULE_TABLE:
 		if (r->table)
-			xfree(r->table);
+			nftnl_str_release(r->table);
 
-		r->table = strdup(data);
+		r->table = nftnl_str_intern(data);
 		break;
 	case NFTNL_RULE_CHAIN:
 		if (r->chain)
-			xfree(r->chain);
+			nftnl_str_release(r->chain);
 
-		r->chain = strdup(data);
+		r->chain = nftnl_str_intern(data);
 		break;
 	case NFTNL_RULE_HANDLE:
 		r->handle = *((uint64_t *)data);
@@ -321,13 +324,27 @@ void nftnl_rule_add_expr(struct nftnl_rule *r, struct nftnl_expr *expr)
 }
 EXPORT_SYMBOL(nftnl_rule_add_expr, nft_rule_add_expr);
 
+/* Attributes of the object that each netlink attribute carries. */
+static const uint32_t nftnl_rule_attr_mask[NFTA_RULE_MAX + 1] = {
+	[NFTA_RULE_TABLE]	= (1 << NFTNL_RULE_TABLE),
+	[NFTA_RULE_CHAIN]	= (1 << NFTNL_RULE_CHAIN),
+	[NFTA_RULE_HANDLE]	= (1 << NFTNL_RULE_HANDLE),
+	[NFTA_RULE_EXPRESSIONS]	= NFTNL_RULE_PARSE_EXPRS,
+	[NFTA_RULE_COMPAT]	= (1 << NFTNL_RULE_COMPAT_PROTO) |
+				  (1 << NFTNL_RULE_COMPAT_FLAGS),
+	[NFTA_RULE_POSITION]	= (1 << NFTNL_RULE_POSITION),
+	[NFTA_RULE_USERDATA]	= (1 << NFTNL_RULE_USERDATA),
+};
+
 static int nftnl_rule_parse_attr_cb(const struct nlattr *attr, void *data)
 {
-	const struct nlattr **tb = data;
+	struct nftnl_nlmsg_parse_ctx *ctx = data;
 	int type = mnl_attr_get_type(attr);
 
 	if (mnl_attr_type_valid(attr, NFTA_RULE_MAX) < 0)
 		return MNL_CB_OK;
+	if (!(ctx->mask & nftnl_rule_attr_mask[type]))
+		return MNL_CB_OK;
 
 	switch(type) {
 	case NFTA_RULE_TABLE:
@@ -353,11 +370,28 @@ static int nftnl_rule_parse_attr_cb(const struct nlattr *attr, void *data)
 		break;
 	}
 
-	tb[type] = attr;
+	ctx->tb[type] = attr;
 	return MNL_CB_OK;
 }
 
-static int nftnl_rule_parse_expr(struct nlattr *nest, struct nftnl_rule *r)
+/* Look at the expression name before parsing the whole expression. */
+static bool nftnl_rule_expr_is(const struct nlattr *nest, const char *name)
+{
+	size_t len = strlen(name) + 1;
+	struct nlattr *attr;
+
+	mnl_attr_for_each_nested(attr, nest) {
+		if (mnl_attr_get_type(attr) != NFTA_EXPR_NAME)
+			continue;
+
+		return mnl_attr_get_payload_len(attr) == len &&
+		       memcmp(mnl_attr_get_payload(attr), name, len) == 0;
+	}
+	return false;
+}
+
+static int nftnl_rule_parse_expr(struct nlattr *nest, struct nftnl_rule *r,
+				 const char *name)
 {
 	struct nftnl_expr *expr;
 	struct nlattr *attr;
@@ -365,6 +399,8 @@ static int nftnl_rule_parse_expr(struct nlattr *nest, struct nftnl_rule *r)
 	mnl_attr_for_each_nested(attr, nest) {
 		if (mnl_attr_get_type(attr) != NFTA_LIST_ELEM)
 			return -1;
+		if (name != NULL && !nftnl_rule_expr_is(attr, name))
+			continue;
 
 		expr = nftnl_expr_parse(attr);
 		if (expr == NULL)
@@ -395,19 +431,22 @@ static int nftnl_rule_parse_compat_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int nftnl_rule_parse_compat(struct nlattr *nest, struct nftnl_rule *r)
+static int nftnl_rule_parse_compat(struct nlattr *nest, struct nftnl_rule *r,
+				   uint32_t mask)
 {
 	struct nlattr *tb[NFTA_RULE_COMPAT_MAX+1] = {};
 
 	if (mnl_attr_parse_nested(nest, nftnl_rule_parse_compat_cb, tb) < 0)
 		return -1;
 
-	if (tb[NFTA_RULE_COMPAT_PROTO]) {
+	if (tb[NFTA_RULE_COMPAT_PROTO] &&
+	    mask & (1 << NFTNL_RULE_COMPAT_PROTO)) {
 		r->compat.proto =
 			ntohl(mnl_attr_get_u32(tb[NFTA_RULE_COMPAT_PROTO]));
 		r->flags |= (1 << NFTNL_RULE_COMPAT_PROTO);
 	}
-	if (tb[NFTA_RULE_COMPAT_FLAGS]) {
+	if (tb[NFTA_RULE_COMPAT_FLAGS] &&
+	    mask & (1 << NFTNL_RULE_COMPAT_FLAGS)) {
 		r->compat.flags =
 			ntohl(mnl_attr_get_u32(tb[NFTA_RULE_COMPAT_FLAGS]));
 		r->flags |= (1 << NFTNL_RULE_COMPAT_FLAGS);
@@ -415,23 +454,32 @@ static int nftnl_rule_parse_compat(struct nlattr *nest, struct nftnl_rule *r)
 	return 0;
 }
 
-int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
+int nftnl_rule_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				struct nftnl_rule *r, uint32_t mask,
+				const char *expr_name)
 {
 	struct nlattr *tb[NFTA_RULE_MAX+1] = {};
 	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	struct nftnl_nlmsg_parse_ctx ctx = {
+		.tb	= (const struct nlattr **)tb,
+		.mask	= mask,
+	};
 	int ret = 0;
 
-	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_rule_parse_attr_cb, tb) < 0)
+	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_rule_parse_attr_cb,
+			   &ctx) < 0)
 		return -1;
 
 	if (tb[NFTA_RULE_TABLE]) {
-		xfree(r->table);
-		r->table = strdup(mnl_attr_get_str(tb[NFTA_RULE_TABLE]));
+		nftnl_str_release(r->table);
+		r->table =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_RULE_TABLE]));
 		r->flags |= (1 << NFTNL_RULE_TABLE);
 	}
 	if (tb[NFTA_RULE_CHAIN]) {
-		xfree(r->chain);
-		r->chain = strdup(mnl_attr_get_str(tb[NFTA_RULE_CHAIN]));
+		nftnl_str_release(r->chain);
+		r->chain =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_RULE_CHAIN]));
 		r->flags |= (1 << NFTNL_RULE_CHAIN);
 	}
 	if (tb[NFTA_RULE_HANDLE]) {
@@ -439,9 +487,10 @@ int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
 		r->flags |= (1 << NFTNL_RULE_HANDLE);
 	}
 	if (tb[NFTA_RULE_EXPRESSIONS])
-		ret = nftnl_rule_parse_expr(tb[NFTA_RULE_EXPRESSIONS], r);
+		ret = nftnl_rule_parse_expr(tb[NFTA_RULE_EXPRESSIONS], r,
+					    expr_name);
 	if (tb[NFTA_RULE_COMPAT])
-		ret = nftnl_rule_parse_compat(tb[NFTA_RULE_COMPAT], r);
+		ret = nftnl_rule_parse_compat(tb[NFTA_RULE_COMPAT], r, mask);
 	if (tb[NFTA_RULE_POSITION]) {
 		r->position = be64toh(mnl_attr_get_u64(tb[NFTA_RULE_POSITION]));
 		r->flags |= (1 << NFTNL_RULE_POSITION);
@@ -468,8 +517,42 @@ int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
 
 	return ret;
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_nlmsg_parse_mask);
+
+int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
+{
+	return nftnl_rule_nlmsg_parse_mask(nlh, r, ~0U, NULL);
+}
 EXPORT_SYMBOL(nftnl_rule_nlmsg_parse, nft_rule_nlmsg_parse);
 
+/*
+ * Lookups in a ruleset that is being parsed refer to sets by name, the sets
+ * are created in the same batch and are found by their ID instead.
+ */
+void nftnl_rule_lookup_set_ids(struct nftnl_rule *r,
+			       struct nftnl_set_list *set_list)
+{
+	uint16_t name_attr, id_attr;
+	struct nftnl_expr *e;
+	uint32_t set_id;
+
+	list_for_each_entry(e, &r->expr_list, head) {
+		if (strcmp(e->ops->name, "lookup") == 0) {
+			name_attr = NFTNL_EXPR_LOOKUP_SET;
+			id_attr = NFTNL_EXPR_LOOKUP_SET_ID;
+		} else if (strcmp(e->ops->name, "dynset") == 0) {
+			name_attr = NFTNL_EXPR_DYNSET_SET_NAME;
+			id_attr = NFTNL_EXPR_DYNSET_SET_ID;
+		} else {
+			continue;
+		}
+
+		if (nftnl_set_lookup_id(nftnl_expr_get_str(e, name_attr),
+					set_list, r->family, r->table, &set_id))
+			nftnl_expr_set_u32(e, id_attr, set_id);
+	}
+}
+
 #ifdef JSON_PARSING
 int nftnl_jansson_parse_rule(struct nftnl_rule *r, json_t *tree,
 			   struct nftnl_parse_err *err,
@@ -478,8 +561,8 @@ int nftnl_jansson_parse_rule(struct nftnl_rule *r, json_t *tree,
 	json_t *root, *array;
 	struct nftnl_expr *e;
 	const char *str = NULL;
-	uint64_t uval64;
 	uint32_t uval32;
+	uint64_t uval64;
 	int i, family;
 
 	root = nftnl_jansson_get_node(tree, "rule", err);
@@ -549,14 +632,16 @@ int nftnl_jansson_parse_rule(struct nftnl_rule *r, json_t *tree,
 
 	for (i = 0; i < json_array_size(array); ++i) {
 
-		e = nftnl_jansson_expr_parse(json_array_get(array, i), err,
-					   set_list);
+		e = nftnl_jansson_expr_parse(json_array_get(array, i), err);
 		if (e == NULL)
 			goto err;
 
 		nftnl_rule_add_expr(r, e);
 	}
 
+	if (set_list != NULL)
+		nftnl_rule_lookup_set_ids(r, set_list);
+
 	return 0;
 err:
 	return -1;
@@ -566,6 +651,7 @@ err:
 static int nftnl_rule_json_parse(struct nftnl_rule *r, const void *json,
 			       struct nftnl_parse_err *err,
 			       enum nftnl_parse_input input,
+			       enum nftnl_parse_type type,
 			       struct nftnl_set_list *set_list)
 {
 #ifdef JSON_PARSING
@@ -573,7 +659,7 @@ static int nftnl_rule_json_parse(struct nftnl_rule *r, const void *json,
 	json_error_t error;
 	int ret;
 
-	tree = nftnl_jansson_create_root(json, &error, err, input);
+	tree = nftnl_jansson_create_root(json, &error, err, input, type);
 	if (tree == NULL)
 		return -1;
 
@@ -642,13 +728,16 @@ int nftnl_mxml_rule_parse(mxml_node_t *tree, struct nftnl_rule *r,
 		node != NULL;
 		node = mxmlFindElement(node, tree, "expr", "type",
 				       NULL, MXML_DESCEND)) {
-		e = nftnl_mxml_expr_parse(node, err, set_list);
+		e = nftnl_mxml_expr_parse(node, err);
 		if (e == NULL)
 			return -1;
 
 		nftnl_rule_add_expr(r, e);
 	}
 
+	if (set_list != NULL)
+		nftnl_rule_lookup_set_ids(r, set_list);
+
 	return 0;
 }
 #endif
@@ -685,7 +774,8 @@ static int nftnl_rule_do_parse(struct nftnl_rule *r, enum nftnl_parse_type type,
 		ret = nftnl_rule_xml_parse(r, data, &perr, input, NULL);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_rule_json_parse(r, data, &perr, input, NULL);
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_rule_json_parse(r, data, &perr, input, type, NULL);
 		break;
 	default:
 		ret = -1;
@@ -782,13 +872,99 @@ static int nftnl_rule_snprintf_json(char *buf, size_t size, struct nftnl_rule *r
 
 	}
 	/* Remove comma from last element */
-	offset--;
+	if (!list_empty(&r->expr_list))
+		offset--;
 	ret = snprintf(buf+offset, len, "]}}");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	return offset;
 }
 
+static int nftnl_rule_snprintf_cbor(char *buf, size_t size, struct nftnl_rule *r,
+				    uint32_t type, uint32_t flags)
+{
+	int ret, len = size, offset = 0;
+	struct nftnl_expr *expr;
+
+	ret = nftnl_cbor_byte(buf, len, NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_str(buf+offset, len, "rule");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf+offset, len,
+			      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	if (r->flags & (1 << NFTNL_RULE_FAMILY)) {
+		ret = nftnl_cbor_pair_str(buf+offset, len, "family",
+					  nftnl_family2str(r->family));
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	if (r->flags & (1 << NFTNL_RULE_TABLE)) {
+		ret = nftnl_cbor_pair_str(buf+offset, len, "table", r->table);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	if (r->flags & (1 << NFTNL_RULE_CHAIN)) {
+		ret = nftnl_cbor_pair_str(buf+offset, len, "chain", r->chain);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (r->flags & (1 << NFTNL_RULE_HANDLE)) {
+		ret = nftnl_cbor_pair_uint(buf+offset, len, "handle",
+					   r->handle);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	if (r->flags & (1 << NFTNL_RULE_COMPAT_PROTO) ||
+	    r->flags & (1 << NFTNL_RULE_COMPAT_FLAGS)) {
+		ret = nftnl_cbor_pair_uint(buf+offset, len, "compat_flags",
+					   r->compat.flags);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_pair_uint(buf+offset, len, "compat_proto",
+					   r->compat.proto);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	if (r->flags & (1 << NFTNL_RULE_POSITION)) {
+		ret = nftnl_cbor_pair_uint(buf+offset, len, "position",
+					   r->position);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	ret = nftnl_cbor_str(buf+offset, len, "expr");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf+offset, len,
+			      NFTNL_CBOR_ARRAY | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	/* no commas to take care of, members are followed by a break */
+	list_for_each_entry(expr, &r->expr_list, head) {
+		ret = nftnl_cbor_byte(buf+offset, len,
+				      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_pair_str(buf+offset, len, "type",
+					  expr->ops->name);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = expr->ops->snprintf(buf+offset, len, type, flags, expr);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_byte(buf+offset, len, NFTNL_CBOR_BREAK);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	/* the expression array, the rule and the outer map */
+	ret = nftnl_fmt_copy(buf+offset, len, "\xff\xff\xff", 3);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
 static int nftnl_rule_snprintf_xml(char *buf, size_t size, struct nftnl_rule *r,
 				 uint32_t type, uint32_t flags)
 {
@@ -949,6 +1125,10 @@ static int nftnl_rule_cmd_snprintf(char *buf, size_t size, struct nftnl_rule *r,
 		ret = nftnl_rule_snprintf_json(buf+offset, len, r, type,
 					     inner_flags);
 		break;
+	case NFTNL_OUTPUT_CBOR:
+		ret = nftnl_rule_snprintf_cbor(buf+offset, len, r, type,
+					       inner_flags);
+		break;
 	default:
 		return -1;
 	}
@@ -984,6 +1164,14 @@ int nftnl_rule_fprintf(FILE *fp, struct nftnl_rule *r, uint32_t type,
 }
 EXPORT_SYMBOL(nftnl_rule_fprintf, nft_rule_fprintf);
 
+int nftnl_rule_output(struct nftnl_sink *sink, struct nftnl_rule *r,
+		      uint32_t type, uint32_t flags)
+{
+	return nftnl_sink_obj(sink, r, NFTNL_CMD_UNSPEC, type, flags,
+			      nftnl_rule_do_snprintf);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_output);
+
 int nftnl_expr_foreach(struct nftnl_rule *r,
                           int (*cb)(struct nftnl_expr *e, void *data),
                           void *data)
@@ -1046,10 +1234,263 @@ void nftnl_expr_iter_destroy(struct nftnl_expr_iter *iter)
 }
 EXPORT_SYMBOL(nftnl_expr_iter_destroy, nft_rule_expr_iter_destroy);
 
+/* initial number of buckets, doubled as the index grows */
+#define NFTNL_RULE_INDEX_HSIZE	256
+
+/* Rules in one chain, in the same order as they are in the list. */
+struct nftnl_rule_chain {
+	struct hlist_node	hnode;
+	struct list_head	rule_list;
+	uint32_t		family;
+	const char		*table;
+	const char		*chain;
+};
+
+struct nftnl_rule_index {
+	struct hlist_head	*handle_hash;
+	uint32_t		hsize;
+	/* rules added since the last count, removals do not reach the list */
+	uint32_t		nrules;
+	/* chains stay until the index goes, so they are counted exactly */
+	struct hlist_head	*chain_hash;
+	uint32_t		csize;
+	uint32_t		nchains;
+};
+
 struct nftnl_rule_list {
-	struct list_head list;
+	struct list_head	list;
+	struct nftnl_rule_index	*index;
 };
 
+static uint32_t nftnl_rule_hash_chain(uint32_t family, const char *table,
+				      const char *chain)
+{
+	uint32_t hash = 5381 + family;
+
+	hash = nftnl_hash_str(hash, table);
+	return nftnl_hash_str(hash, chain);
+}
+
+/* Handles are allocated per table, so the table is hashed too. */
+static uint32_t nftnl_rule_hash_handle(uint32_t family, const char *table,
+				       uint64_t handle)
+{
+	uint32_t hash = 5381 + family;
+
+	hash = nftnl_hash_str(hash, table);
+	return hash ^ (uint32_t)handle ^ (uint32_t)(handle >> 32);
+}
+
+/* Double the chain buckets once there are more than two chains per bucket. */
+static void nftnl_rule_index_grow_chains(struct nftnl_rule_index *index)
+{
+	struct hlist_head *chain_hash;
+	struct nftnl_rule_chain *c;
+	struct hlist_node *n, *tmp;
+	uint32_t i, hash;
+
+	if (index->nchains <= 2 * index->csize)
+		return;
+
+	chain_hash = calloc(index->csize * 2, sizeof(struct hlist_head));
+	if (chain_hash == NULL)
+		return;
+
+	for (i = 0; i < index->csize; i++) {
+		hlist_for_each_entry_safe(c, n, tmp, &index->chain_hash[i],
+					  hnode) {
+			hash = nftnl_rule_hash_chain(c->family, c->table,
+						     c->chain);
+			hlist_add_head(&c->hnode,
+				       &chain_hash[hash % (index->csize * 2)]);
+		}
+	}
+	xfree(index->chain_hash);
+	index->chain_hash = chain_hash;
+	index->csize *= 2;
+}
+
+static struct nftnl_rule_chain *
+nftnl_rule_index_chain(struct nftnl_rule_index *index, uint32_t family,
+		       const char *table, const char *chain, bool create)
+{
+	struct nftnl_rule_chain *c;
+	struct hlist_node *n;
+	uint32_t hash;
+
+	hash = nftnl_rule_hash_chain(family, table, chain);
+	hlist_for_each_entry(c, n, &index->chain_hash[hash % index->csize],
+			     hnode) {
+		if (c->family == family &&
+		    nftnl_str_equal(c->table, table) &&
+		    nftnl_str_equal(c->chain, chain))
+			return c;
+	}
+	if (!create)
+		return NULL;
+
+	c = calloc(1, sizeof(struct nftnl_rule_chain));
+	if (c == NULL)
+		return NULL;
+
+	c->family = family;
+	if (table != NULL) {
+		c->table = nftnl_str_intern(table);
+		if (c->table == NULL)
+			goto err;
+	}
+	if (chain != NULL) {
+		c->chain = nftnl_str_intern(chain);
+		if (c->chain == NULL)
+			goto err;
+	}
+	INIT_LIST_HEAD(&c->rule_list);
+	hlist_add_head(&c->hnode, &index->chain_hash[hash % index->csize]);
+	index->nchains++;
+	nftnl_rule_index_grow_chains(index);
+
+	return c;
+err:
+	nftnl_str_release(c->table);
+	xfree(c);
+	return NULL;
+}
+
+static struct nftnl_rule_index *nftnl_rule_index_alloc(uint32_t nrules)
+{
+	struct nftnl_rule_index *index;
+
+	index = calloc(1, sizeof(struct nftnl_rule_index));
+	if (index == NULL)
+		return NULL;
+
+	for (index->hsize = NFTNL_RULE_INDEX_HSIZE; index->hsize < nrules;
+	     index->hsize *= 2)
+		;
+	index->csize = NFTNL_RULE_INDEX_HSIZE;
+	index->handle_hash = calloc(index->hsize, sizeof(struct hlist_head));
+	index->chain_hash = calloc(index->csize, sizeof(struct hlist_head));
+	if (index->handle_hash == NULL || index->chain_hash == NULL) {
+		xfree(index->handle_hash);
+		xfree(index->chain_hash);
+		xfree(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+static void nftnl_rule_index_free(struct nftnl_rule_index *index)
+{
+	struct nftnl_rule_chain *c;
+	struct hlist_node *n, *tmp;
+	uint32_t i;
+
+	for (i = 0; i < index->csize; i++) {
+		hlist_for_each_entry_safe(c, n, tmp, &index->chain_hash[i],
+					  hnode) {
+			nftnl_str_release(c->table);
+			nftnl_str_release(c->chain);
+			xfree(c);
+		}
+	}
+	xfree(index->handle_hash);
+	xfree(index->chain_hash);
+	xfree(index);
+}
+
+/* Out of memory while adding a rule, fall back to the plain list. */
+static void nftnl_rule_list_unindex(struct nftnl_rule_list *list)
+{
+	struct nftnl_rule *r;
+
+	list_for_each_entry(r, &list->list, head)
+		INIT_HLIST_NODE(&r->hnode);
+
+	nftnl_rule_index_free(list->index);
+	list->index = NULL;
+}
+
+static void nftnl_rule_index_hash(struct nftnl_rule_index *index,
+				  struct nftnl_rule *r)
+{
+	uint32_t hash;
+
+	hash = nftnl_rule_hash_handle(r->family, r->table, r->handle);
+	hlist_add_head(&r->hnode, &index->handle_hash[hash % index->hsize]);
+}
+
+/*
+ * Keep at most two rules per handle bucket. The counter only goes up, so
+ * count the indexed rules once it says so and double the buckets if they
+ * are really full. Rules that are not indexed yet, while
+ * nftnl_rule_list_index() is still walking the list, are left alone.
+ */
+static void nftnl_rule_index_grow(struct nftnl_rule_list *list)
+{
+	struct nftnl_rule_index *index = list->index;
+	struct hlist_head *handle_hash;
+	struct nftnl_rule *r;
+	uint32_t hsize, n = 0;
+
+	if (++index->nrules <= 2 * index->hsize)
+		return;
+
+	list_for_each_entry(r, &list->list, head) {
+		if (!hlist_unhashed(&r->hnode))
+			n++;
+	}
+	index->nrules = n;
+
+	for (hsize = index->hsize; hsize < n; hsize *= 2)
+		;
+	if (hsize == index->hsize)
+		return;
+
+	handle_hash = calloc(hsize, sizeof(struct hlist_head));
+	if (handle_hash == NULL)
+		return;
+
+	xfree(index->handle_hash);
+	index->handle_hash = handle_hash;
+	index->hsize = hsize;
+
+	list_for_each_entry(r, &list->list, head) {
+		if (!hlist_unhashed(&r->hnode))
+			nftnl_rule_index_hash(index, r);
+	}
+}
+
+static int nftnl_rule_index_add(struct nftnl_rule_list *list,
+				struct nftnl_rule *r, bool tail)
+{
+	struct nftnl_rule_chain *c;
+
+	c = nftnl_rule_index_chain(list->index, r->family, r->table, r->chain,
+				   true);
+	if (c == NULL)
+		return -1;
+
+	if (tail)
+		list_add_tail(&r->chain_head, &c->rule_list);
+	else
+		list_add(&r->chain_head, &c->rule_list);
+
+	nftnl_rule_index_hash(list->index, r);
+	nftnl_rule_index_grow(list);
+
+	return 0;
+}
+
+static void nftnl_rule_index_del(struct nftnl_rule *r)
+{
+	if (hlist_unhashed(&r->hnode))
+		return;
+
+	hlist_del_init(&r->hnode);
+	list_del(&r->chain_head);
+}
+
 struct nftnl_rule_list *nftnl_rule_list_alloc(void)
 {
 	struct nftnl_rule_list *list;
@@ -1072,6 +1513,8 @@ void nftnl_rule_list_free(struct nftnl_rule_list *list)
 		list_del(&r->head);
 		nftnl_rule_free(r);
 	}
+	if (list->index != NULL)
+		nftnl_rule_index_free(list->index);
 	xfree(list);
 }
 EXPORT_SYMBOL(nftnl_rule_list_free, nft_rule_list_free);
@@ -1085,21 +1528,154 @@ EXPORT_SYMBOL(nftnl_rule_list_is_empty, nft_rule_list_is_empty);
 void nftnl_rule_list_add(struct nftnl_rule *r, struct nftnl_rule_list *list)
 {
 	list_add(&r->head, &list->list);
+	if (list->index != NULL &&
+	    nftnl_rule_index_add(list, r, false) < 0)
+		nftnl_rule_list_unindex(list);
 }
 EXPORT_SYMBOL(nftnl_rule_list_add, nft_rule_list_add);
 
 void nftnl_rule_list_add_tail(struct nftnl_rule *r, struct nftnl_rule_list *list)
 {
 	list_add_tail(&r->head, &list->list);
+	if (list->index != NULL &&
+	    nftnl_rule_index_add(list, r, true) < 0)
+		nftnl_rule_list_unindex(list);
 }
 EXPORT_SYMBOL(nftnl_rule_list_add_tail, nft_rule_list_add_tail);
 
 void nftnl_rule_list_del(struct nftnl_rule *r)
 {
 	list_del(&r->head);
+	nftnl_rule_index_del(r);
 }
 EXPORT_SYMBOL(nftnl_rule_list_del, nft_rule_list_del);
 
+int nftnl_rule_list_index(struct nftnl_rule_list *list)
+{
+	struct nftnl_rule *r;
+	uint32_t n = 0;
+
+	if (list->index != NULL)
+		return 0;
+
+	list_for_each_entry(r, &list->list, head)
+		n++;
+
+	list->index = nftnl_rule_index_alloc(n);
+	if (list->index == NULL)
+		return -1;
+
+	list_for_each_entry(r, &list->list, head) {
+		if (nftnl_rule_index_add(list, r, true) < 0) {
+			nftnl_rule_list_unindex(list);
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+	return 0;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_list_index);
+
+struct nftnl_rule *nftnl_rule_list_lookup_byhandle(struct nftnl_rule_list *list,
+						   uint32_t family,
+						   const char *table,
+						   uint64_t handle)
+{
+	struct hlist_node *n;
+	struct nftnl_rule *r;
+	uint32_t hash;
+
+	if (list->index == NULL) {
+		list_for_each_entry(r, &list->list, head) {
+			if (r->family == family &&
+			    nftnl_str_equal(r->table, table) &&
+			    r->flags & (1 << NFTNL_RULE_HANDLE) &&
+			    r->handle == handle)
+				return r;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_rule_hash_handle(family, table, handle) %
+	       list->index->hsize;
+	hlist_for_each_entry(r, n, &list->index->handle_hash[hash], hnode) {
+		if (r->family == family &&
+		    nftnl_str_equal(r->table, table) &&
+		    r->flags & (1 << NFTNL_RULE_HANDLE) &&
+		    r->handle == handle)
+			return r;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_list_lookup_byhandle);
+
+int nftnl_rule_list_insert_after(struct nftnl_rule *r,
+				 struct nftnl_rule_list *list,
+				 uint64_t handle)
+{
+	struct nftnl_rule *pos;
+
+	pos = nftnl_rule_list_lookup_byhandle(list, r->family, r->table,
+					      handle);
+	if (pos == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	if (!nftnl_str_equal(pos->chain, r->chain)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	list_add(&r->head, &pos->head);
+	if (list->index != NULL) {
+		if (nftnl_rule_index_add(list, r, false) < 0) {
+			nftnl_rule_list_unindex(list);
+			return 0;
+		}
+		/* move it right after the rule it goes behind */
+		list_move(&r->chain_head, &pos->chain_head);
+	}
+	return 0;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_list_insert_after);
+
+int nftnl_rule_list_chain_foreach(struct nftnl_rule_list *list,
+				  uint32_t family, const char *table,
+				  const char *chain,
+				  int (*cb)(struct nftnl_rule *r, void *data),
+				  void *data)
+{
+	struct nftnl_rule_chain *c;
+	struct nftnl_rule *cur, *tmp;
+	int ret;
+
+	if (list->index == NULL) {
+		list_for_each_entry_safe(cur, tmp, &list->list, head) {
+			if (cur->family != family ||
+			    !nftnl_str_equal(cur->table, table) ||
+			    !nftnl_str_equal(cur->chain, chain))
+				continue;
+
+			ret = cb(cur, data);
+			if (ret < 0)
+				return ret;
+		}
+		return 0;
+	}
+
+	c = nftnl_rule_index_chain(list->index, family, table, chain, false);
+	if (c == NULL)
+		return 0;
+
+	list_for_each_entry_safe(cur, tmp, &c->rule_list, chain_head) {
+		ret = cb(cur, data);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_list_chain_foreach);
+
 int nftnl_rule_list_foreach(struct nftnl_rule_list *rule_list,
 			  int (*cb)(struct nftnl_rule *r, void *data),
 			  void *data)
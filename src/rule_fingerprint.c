@@ -0,0 +1,434 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+
+/*
+ * The fingerprint is a 128-bit MurmurHash3 of the netlink representation
+ * of the rule, without handle and position, seeded with the family. The
+ * expressions always put their attributes in the same order, so equal
+ * rules result in the same message. Counter values are left out, and so
+ * are the set IDs, which only have a meaning within one transaction.
+ *
+ * Anonymous sets get a new name each time they are created, so when the
+ * sets are known, what is in them is hashed instead of their name.
+ */
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+
+	return k;
+}
+
+static void murmur3_128(const void *data, size_t len, uint32_t seed,
+			uint64_t out[2])
+{
+	const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+	const uint8_t *tail, *p = data;
+	uint64_t h1 = seed, h2 = seed, k1, k2;
+	size_t i, rem, nblocks = len / 16;
+
+	for (i = 0; i < nblocks; i++, p += 16) {
+		memcpy(&k1, p, sizeof(k1));
+		memcpy(&k2, p + 8, sizeof(k2));
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	tail = p;
+	rem = len & 15;
+	k1 = k2 = 0;
+	for (i = rem; i > 8; i--)
+		k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+	if (rem > 8) {
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	for (i = rem < 8 ? rem : 8; i > 0; i--)
+		k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+	if (rem > 0) {
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= len;
+	h2 ^= len;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	out[0] = h1;
+	out[1] = h2;
+}
+
+/*
+ * Elements are hashed one by one and the hashes added up: a dump does not
+ * list them in the order they were added.
+ */
+static void nftnl_set_fingerprint(struct nftnl_set *s, uint64_t fp[2])
+{
+	uint8_t buf[2 * sizeof(uint32_t) + 2 * UINT8_MAX + NFT_CHAIN_MAXNAMELEN];
+	struct nftnl_set_elem *e;
+	uint32_t def[5], len;
+	uint64_t h[2];
+
+	def[0] = s->set_flags;
+	def[1] = s->key_type;
+	def[2] = s->key_len;
+	def[3] = s->data_type;
+	def[4] = s->data_len;
+	murmur3_128(def, sizeof(def), 0, fp);
+
+	list_for_each_entry(e, &s->element_list, head) {
+		memcpy(buf, &e->set_elem_flags, sizeof(uint32_t));
+		memcpy(buf + sizeof(uint32_t), &e->verdict, sizeof(uint32_t));
+		len = 2 * sizeof(uint32_t);
+		memcpy(buf + len, nftnl_set_elem_key(e), e->key_len);
+		len += e->key_len;
+		memcpy(buf + len, nftnl_set_elem_data(e), e->data_len);
+		len += e->data_len;
+		if (e->chain != NULL) {
+			memcpy(buf + len, e->chain,
+			       strnlen(e->chain, NFT_CHAIN_MAXNAMELEN));
+			len += strnlen(e->chain, NFT_CHAIN_MAXNAMELEN);
+		}
+
+		murmur3_128(buf, len, 0, h);
+		fp[0] += h[0];
+		fp[1] += h[1];
+	}
+}
+
+struct nftnl_rule_fp_ctx {
+	struct nlmsghdr		*nlh;
+	struct nftnl_rule	*rule;
+	struct nftnl_set_list	*sets;
+};
+
+static struct nftnl_set *nftnl_rule_fp_anon_set(struct nftnl_rule_fp_ctx *ctx,
+						const char *name)
+{
+	struct nftnl_set *s;
+
+	if (ctx->sets == NULL || name == NULL)
+		return NULL;
+
+	s = nftnl_set_list_lookup_byname(ctx->sets,
+			nftnl_rule_get_u32(ctx->rule, NFTNL_RULE_FAMILY),
+			nftnl_rule_get_str(ctx->rule, NFTNL_RULE_TABLE), name);
+	if (s == NULL || !(s->flags & (1 << NFTNL_SET_FLAGS)) ||
+	    !(s->set_flags & NFT_SET_ANONYMOUS))
+		return NULL;
+
+	return s;
+}
+
+static int nftnl_rule_fp_expr_cb(struct nftnl_expr *e, void *data)
+{
+	struct nftnl_rule_fp_ctx *ctx = data;
+	struct nlmsghdr *nlh = ctx->nlh;
+	struct nftnl_set *anon = NULL;
+	uint32_t exclude = 0;
+	struct nlattr *nest;
+	uint64_t set_fp[2];
+
+	if (nlh->nlmsg_len > NFTNL_RULE_FP_BUFSIZ - UINT16_MAX) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	if (strcmp(e->ops->name, "lookup") == 0) {
+		exclude = 1 << NFTNL_EXPR_LOOKUP_SET_ID;
+		anon = nftnl_rule_fp_anon_set(ctx,
+				nftnl_expr_get_str(e, NFTNL_EXPR_LOOKUP_SET));
+		if (anon != NULL)
+			exclude |= 1 << NFTNL_EXPR_LOOKUP_SET;
+	} else if (strcmp(e->ops->name, "dynset") == 0) {
+		exclude = 1 << NFTNL_EXPR_DYNSET_SET_ID;
+		anon = nftnl_rule_fp_anon_set(ctx,
+				nftnl_expr_get_str(e, NFTNL_EXPR_DYNSET_SET_NAME));
+		if (anon != NULL)
+			exclude |= 1 << NFTNL_EXPR_DYNSET_SET_NAME;
+	}
+
+	nest = mnl_attr_nest_start(nlh, NFTA_LIST_ELEM);
+	if (strcmp(e->ops->name, "counter") == 0)
+		mnl_attr_put_strz(nlh, NFTA_EXPR_NAME, e->ops->name);
+	else if (exclude == 0)
+		nftnl_expr_build_payload(nlh, e);
+	else if (nftnl_expr_build_payload_excl(nlh, e, exclude) < 0)
+		return -1;
+
+	if (anon != NULL) {
+		nftnl_set_fingerprint(anon, set_fp);
+		mnl_attr_put(nlh, NFTA_EXPR_UNSPEC, sizeof(set_fp), set_fp);
+	}
+	mnl_attr_nest_end(nlh, nest);
+
+	return 0;
+}
+
+/*
+ * @buf is NFTNL_RULE_FP_BUFSIZ bytes long and zeroed, it is left zeroed.
+ * @sets are those the rule refers to, if known.
+ */
+int nftnl_rule_fingerprint_buf(struct nftnl_rule *r, char *buf,
+			       uint64_t fp[2], struct nftnl_set_list *sets)
+{
+	struct nftnl_rule_fp_ctx ctx = {
+		.rule	= r,
+		.sets	= sets,
+	};
+	struct nlmsghdr *nlh;
+	struct nlattr *nest;
+	const void *udata;
+	uint32_t len;
+	int ret;
+
+	nlh = mnl_nlmsg_put_header(buf);
+
+	if (nftnl_rule_is_set(r, NFTNL_RULE_TABLE))
+		mnl_attr_put_strz(nlh, NFTA_RULE_TABLE,
+				  nftnl_rule_get_str(r, NFTNL_RULE_TABLE));
+	if (nftnl_rule_is_set(r, NFTNL_RULE_CHAIN))
+		mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN,
+				  nftnl_rule_get_str(r, NFTNL_RULE_CHAIN));
+	if (nftnl_rule_is_set(r, NFTNL_RULE_USERDATA)) {
+		udata = nftnl_rule_get_data(r, NFTNL_RULE_USERDATA, &len);
+		if (len > UINT16_MAX) {
+			errno = EMSGSIZE;
+			ret = -1;
+			goto out;
+		}
+		mnl_attr_put(nlh, NFTA_RULE_USERDATA, len, udata);
+	}
+	if (nftnl_rule_is_set(r, NFTNL_RULE_COMPAT_PROTO) &&
+	    nftnl_rule_is_set(r, NFTNL_RULE_COMPAT_FLAGS)) {
+		nest = mnl_attr_nest_start(nlh, NFTA_RULE_COMPAT);
+		mnl_attr_put_u32(nlh, NFTA_RULE_COMPAT_PROTO,
+			htonl(nftnl_rule_get_u32(r, NFTNL_RULE_COMPAT_PROTO)));
+		mnl_attr_put_u32(nlh, NFTA_RULE_COMPAT_FLAGS,
+			htonl(nftnl_rule_get_u32(r, NFTNL_RULE_COMPAT_FLAGS)));
+		mnl_attr_nest_end(nlh, nest);
+	}
+
+	nest = mnl_attr_nest_start(nlh, NFTA_RULE_EXPRESSIONS);
+	ctx.nlh = nlh;
+	ret = nftnl_expr_foreach(r, nftnl_rule_fp_expr_cb, &ctx);
+	if (ret < 0)
+		goto out;
+	mnl_attr_nest_end(nlh, nest);
+
+	murmur3_128(mnl_nlmsg_get_payload(nlh),
+		    nlh->nlmsg_len - MNL_NLMSG_HDRLEN,
+		    nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY), fp);
+out:
+	/* libmnl does not always clear the attribute padding */
+	memset(buf, 0, nlh->nlmsg_len);
+	return ret;
+}
+
+int nftnl_rule_fingerprint(struct nftnl_rule *r, struct nftnl_set_list *sets,
+			   uint64_t fp[2])
+{
+	char *buf;
+	int ret;
+
+	buf = calloc(1, NFTNL_RULE_FP_BUFSIZ);
+	if (buf == NULL)
+		return -1;
+
+	ret = nftnl_rule_fingerprint_buf(r, buf, fp, sets);
+	xfree(buf);
+
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_fingerprint);
+
+struct nftnl_rule_dedup_slot {
+	uint64_t		fp[2];
+	struct nftnl_rule	*rule;
+};
+
+struct nftnl_rule_dedup {
+	struct nftnl_rule_dedup_slot	*slots;
+	uint32_t			size;
+	uint32_t			num;
+	char				*buf;
+};
+
+#define NFTNL_RULE_DEDUP_MINSIZE	1024
+
+struct nftnl_rule_dedup *nftnl_rule_dedup_alloc(void)
+{
+	struct nftnl_rule_dedup *d;
+
+	d = calloc(1, sizeof(struct nftnl_rule_dedup));
+	if (d == NULL)
+		return NULL;
+
+	d->size = NFTNL_RULE_DEDUP_MINSIZE;
+	d->slots = calloc(d->size, sizeof(struct nftnl_rule_dedup_slot));
+	d->buf = calloc(1, NFTNL_RULE_FP_BUFSIZ);
+	if (d->slots == NULL || d->buf == NULL) {
+		nftnl_rule_dedup_free(d);
+		return NULL;
+	}
+	return d;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_dedup_alloc);
+
+void nftnl_rule_dedup_free(struct nftnl_rule_dedup *d)
+{
+	xfree(d->slots);
+	xfree(d->buf);
+	xfree(d);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_dedup_free);
+
+static struct nftnl_rule_dedup_slot *
+nftnl_rule_dedup_find(struct nftnl_rule_dedup_slot *slots, uint32_t size,
+		      const uint64_t fp[2])
+{
+	uint32_t i = fp[0] & (size - 1);
+
+	while (slots[i].rule != NULL) {
+		if (slots[i].fp[0] == fp[0] && slots[i].fp[1] == fp[1])
+			break;
+		i = (i + 1) & (size - 1);
+	}
+	return &slots[i];
+}
+
+static int nftnl_rule_dedup_grow(struct nftnl_rule_dedup *d)
+{
+	struct nftnl_rule_dedup_slot *slots, *slot;
+	uint32_t i, size = d->size * 2;
+
+	slots = calloc(size, sizeof(struct nftnl_rule_dedup_slot));
+	if (slots == NULL)
+		return -1;
+
+	for (i = 0; i < d->size; i++) {
+		if (d->slots[i].rule == NULL)
+			continue;
+
+		slot = nftnl_rule_dedup_find(slots, size, d->slots[i].fp);
+		*slot = d->slots[i];
+	}
+	xfree(d->slots);
+	d->slots = slots;
+	d->size = size;
+
+	return 0;
+}
+
+int nftnl_rule_dedup_add(struct nftnl_rule_dedup *d, struct nftnl_rule *r)
+{
+	struct nftnl_rule_dedup_slot *slot;
+	uint64_t fp[2];
+
+	if (nftnl_rule_fingerprint_buf(r, d->buf, fp, NULL) < 0)
+		return -1;
+
+	slot = nftnl_rule_dedup_find(d->slots, d->size, fp);
+	if (slot->rule != NULL)
+		return 0;
+
+	if ((d->num + 1) * 2 > d->size) {
+		if (nftnl_rule_dedup_grow(d) < 0)
+			return -1;
+
+		slot = nftnl_rule_dedup_find(d->slots, d->size, fp);
+	}
+	slot->fp[0] = fp[0];
+	slot->fp[1] = fp[1];
+	slot->rule = r;
+	d->num++;
+
+	return 1;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_dedup_add);
+
+struct nftnl_rule *nftnl_rule_dedup_lookup(struct nftnl_rule_dedup *d,
+					   struct nftnl_rule *r)
+{
+	uint64_t fp[2];
+
+	if (nftnl_rule_fingerprint_buf(r, d->buf, fp, NULL) < 0)
+		return NULL;
+
+	return nftnl_rule_dedup_find(d->slots, d->size, fp)->rule;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_dedup_lookup);
+
+struct nftnl_rule_list_dedup_ctx {
+	struct nftnl_rule_dedup	*d;
+	int			removed;
+};
+
+static int nftnl_rule_list_dedup_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_rule_list_dedup_ctx *ctx = data;
+	int ret;
+
+	ret = nftnl_rule_dedup_add(ctx->d, r);
+	if (ret < 0)
+		return -1;
+
+	if (ret == 0) {
+		nftnl_rule_list_del(r);
+		nftnl_rule_free(r);
+		ctx->removed++;
+	}
+	return 0;
+}
+
+int nftnl_rule_list_dedup(struct nftnl_rule_list *list)
+{
+	struct nftnl_rule_list_dedup_ctx ctx;
+	int ret;
+
+	ctx.d = nftnl_rule_dedup_alloc();
+	if (ctx.d == NULL)
+		return -1;
+	ctx.removed = 0;
+
+	ret = nftnl_rule_list_foreach(list, nftnl_rule_list_dedup_cb, &ctx);
+	nftnl_rule_dedup_free(ctx.d);
+
+	return ret < 0 ? -1 : ctx.removed;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_rule_list_dedup);
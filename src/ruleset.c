@@ -12,16 +12,20 @@
  */
 
 #include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
 
 #include "internal.h"
 #include <stdlib.h>
 
 #include <libmnl/libmnl.h>
+#include <linux/netfilter.h>
 #include <libnftnl/ruleset.h>
 #include <libnftnl/table.h>
 #include <libnftnl/chain.h>
 #include <libnftnl/set.h>
 #include <libnftnl/rule.h>
+#include <libnftnl/batch.h>
 
 struct nftnl_ruleset {
 	struct nftnl_table_list	*table_list;
@@ -53,6 +57,8 @@ struct nftnl_parse_ctx {
 	uint32_t format;
 	uint32_t set_id;
 	struct nftnl_set_list *set_list;
+	/* objects that wait for the workers, see nftnl_ruleset_json_batch */
+	struct nftnl_ruleset_json_batch *batch;
 
 	int (*cb)(const struct nftnl_parse_ctx *ctx);
 	uint16_t flags;
@@ -337,14 +343,34 @@ static int nftnl_ruleset_parse_set(struct nftnl_parse_ctx *ctx,
 {
 	struct nftnl_set *newset;
 
+	/* elements go to the set of that name created earlier, if any */
+	if (type == NFTNL_RULESET_SET_ELEMS) {
+		newset = nftnl_set_list_lookup_byname(ctx->set_list,
+						      set->family, set->table,
+						      set->name);
+		if (newset != NULL)
+			nftnl_set_set_u32(set, NFTNL_SET_ID, newset->id);
+		else
+			nftnl_set_unset(set, NFTNL_SET_ID);
+		goto out;
+	}
+
 	nftnl_set_set_u32(set, NFTNL_SET_ID, ctx->set_id++);
 
-	newset = nftnl_set_clone(set);
+	/* lookups only need the name and the ID, leave the elements out */
+	newset = nftnl_set_alloc();
 	if (newset == NULL)
 		goto err;
 
-	nftnl_set_list_add_tail(newset, ctx->set_list);
+	nftnl_set_set_u32(newset, NFTNL_SET_FAMILY, set->family);
+	if (set->flags & (1 << NFTNL_SET_TABLE))
+		nftnl_set_set_str(newset, NFTNL_SET_TABLE, set->table);
+	if (set->flags & (1 << NFTNL_SET_NAME))
+		nftnl_set_set_str(newset, NFTNL_SET_NAME, set->name);
+	nftnl_set_set_u32(newset, NFTNL_SET_ID, set->id);
 
+	nftnl_set_list_add_tail(newset, ctx->set_list);
+out:
 	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE, type);
 	nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_SET, set);
 	if (ctx->cb(ctx) < 0)
@@ -468,39 +494,387 @@ err:
 #endif
 
 #ifdef JSON_PARSING
-static int nftnl_ruleset_json_parse_ruleset(struct nftnl_parse_ctx *ctx,
-					  struct nftnl_parse_err *err)
+static int nftnl_ruleset_json_parse_node(struct nftnl_parse_ctx *ctx,
+					 struct nftnl_parse_err *err)
 {
-	json_t *node, *array = ctx->json;
-	int len, i, ret;
+	json_t *node = ctx->json;
+
+	if (nftnl_jansson_node_exist(node, "table"))
+		return nftnl_ruleset_parse_tables(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "chain"))
+		return nftnl_ruleset_parse_chains(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "set"))
+		return nftnl_ruleset_parse_sets(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "rule"))
+		return nftnl_ruleset_parse_rules(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "element"))
+		return nftnl_ruleset_parse_set_elems(ctx, err);
 
-	len = json_array_size(array);
-	for (i = 0; i < len; i++) {
-		node = json_array_get(array, i);
-		if (node == NULL) {
-			errno = EINVAL;
+	return -1;
+}
+
+static int nftnl_ruleset_json_parse_next(struct nftnl_parse_ctx *ctx,
+					 struct nftnl_jansson_stream *s,
+					 struct nftnl_parse_err *err)
+{
+	int ret;
+
+	ctx->json = nftnl_jansson_stream_load(s, err);
+	if (ctx->json == NULL)
+		return -1;
+
+	ret = nftnl_ruleset_json_parse_node(ctx, err);
+	nftnl_jansson_free_root(ctx->json);
+
+	return ret;
+}
+
+/*
+ * Parallel import: the objects are read as text, built by the workers and
+ * then handed to the callback in document order. Lookups get the IDs of
+ * their sets at that point, once all sets before them have been seen.
+ */
+#define NFTNL_RULESET_JSON_CHUNK	1024	/* objects per thread and round */
+
+struct nftnl_ruleset_json_obj {
+	uint32_t		cmd;
+	uint32_t		type;	/* enum nftnl_ruleset_type */
+	void			*obj;	/* NULL if it could not be built */
+	size_t			off;	/* of the text in the batch */
+	size_t			len;
+	int			line;
+	int			column;
+	int			errnum;
+	struct nftnl_parse_err	err;
+};
+
+struct nftnl_ruleset_json_worker {
+	struct nftnl_worker		range;
+	struct nftnl_ruleset_json_batch	*batch;
+};
+
+struct nftnl_ruleset_json_batch {
+	struct nftnl_ruleset_json_obj		*objs;
+	uint32_t				num;
+	uint32_t				size;
+	char					*text;
+	size_t					len;
+	size_t					text_size;
+	struct nftnl_ruleset_json_worker	*w;
+	unsigned int				nthreads;
+};
+
+static struct nftnl_ruleset_json_batch *
+nftnl_ruleset_json_batch_alloc(unsigned int nthreads)
+{
+	struct nftnl_ruleset_json_batch *b;
+
+	b = calloc(1, sizeof(struct nftnl_ruleset_json_batch));
+	if (b == NULL)
+		return NULL;
+
+	b->nthreads = nthreads;
+	b->size = nthreads * NFTNL_RULESET_JSON_CHUNK;
+	b->objs = calloc(b->size, sizeof(struct nftnl_ruleset_json_obj));
+	b->w = calloc(nthreads, sizeof(struct nftnl_ruleset_json_worker));
+	if (b->objs == NULL || b->w == NULL) {
+		xfree(b->objs);
+		xfree(b->w);
+		xfree(b);
+		return NULL;
+	}
+
+	return b;
+}
+
+static void nftnl_ruleset_json_obj_free(struct nftnl_ruleset_json_obj *o)
+{
+	if (o->obj == NULL)
+		return;
+
+	switch (o->type) {
+	case NFTNL_RULESET_TABLE:
+		nftnl_table_free(o->obj);
+		break;
+	case NFTNL_RULESET_CHAIN:
+		nftnl_chain_free(o->obj);
+		break;
+	case NFTNL_RULESET_SET:
+	case NFTNL_RULESET_SET_ELEMS:
+		nftnl_set_free(o->obj);
+		break;
+	case NFTNL_RULESET_RULE:
+		nftnl_rule_free(o->obj);
+		break;
+	}
+	o->obj = NULL;
+}
+
+static void nftnl_ruleset_json_batch_free(struct nftnl_ruleset_json_batch *b)
+{
+	uint32_t i;
+
+	for (i = 0; i < b->num; i++)
+		nftnl_ruleset_json_obj_free(&b->objs[i]);
+
+	xfree(b->objs);
+	xfree(b->text);
+	xfree(b->w);
+	xfree(b);
+}
+
+/* Same as nftnl_ruleset_json_parse_node(), minus everything ordered. */
+static void *nftnl_ruleset_json_build(json_t *node, uint32_t *type,
+				      struct nftnl_parse_err *err)
+{
+	struct nftnl_table *t;
+	struct nftnl_chain *c;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+
+	if (nftnl_jansson_node_exist(node, "table")) {
+		*type = NFTNL_RULESET_TABLE;
+		t = nftnl_table_alloc();
+		if (t != NULL && nftnl_jansson_parse_table(t, node, err) < 0) {
+			nftnl_table_free(t);
+			t = NULL;
+		}
+		return t;
+	} else if (nftnl_jansson_node_exist(node, "chain")) {
+		*type = NFTNL_RULESET_CHAIN;
+		c = nftnl_chain_alloc();
+		if (c != NULL && nftnl_jansson_parse_chain(c, node, err) < 0) {
+			nftnl_chain_free(c);
+			c = NULL;
+		}
+		return c;
+	} else if (nftnl_jansson_node_exist(node, "set")) {
+		*type = NFTNL_RULESET_SET;
+		s = nftnl_set_alloc();
+		if (s != NULL && nftnl_jansson_parse_set(s, node, err) < 0) {
+			nftnl_set_free(s);
+			s = NULL;
+		}
+		return s;
+	} else if (nftnl_jansson_node_exist(node, "rule")) {
+		*type = NFTNL_RULESET_RULE;
+		r = nftnl_rule_alloc();
+		if (r != NULL &&
+		    nftnl_jansson_parse_rule(r, node, err, NULL) < 0) {
+			nftnl_rule_free(r);
+			r = NULL;
+		}
+		return r;
+	} else if (nftnl_jansson_node_exist(node, "element")) {
+		*type = NFTNL_RULESET_SET_ELEMS;
+		s = nftnl_set_alloc();
+		if (s != NULL && nftnl_jansson_parse_elem(s, node, err) < 0) {
+			nftnl_set_free(s);
+			s = NULL;
+		}
+		return s;
+	}
+
+	errno = EINVAL;
+	return NULL;
+}
+
+static void *nftnl_ruleset_json_worker(void *arg)
+{
+	struct nftnl_ruleset_json_worker *w = arg;
+	struct nftnl_ruleset_json_batch *b = w->batch;
+	struct nftnl_ruleset_json_obj *o;
+	json_t *node;
+	uint32_t i;
+
+	for (i = w->range.first; i < w->range.first + w->range.num; i++) {
+		o = &b->objs[i];
+		if (o->type == NFTNL_RULESET_RULESET)
+			continue;
+
+		node = nftnl_jansson_load(b->text + o->off, o->len, o->line,
+					  o->column, &o->err);
+		if (node != NULL) {
+			o->obj = nftnl_ruleset_json_build(node, &o->type,
+							  &o->err);
+			nftnl_jansson_free_root(node);
+		}
+		if (o->obj == NULL)
+			o->errnum = errno;
+	}
+
+	return NULL;
+}
+
+static int nftnl_ruleset_json_deliver(struct nftnl_parse_ctx *ctx,
+				      struct nftnl_ruleset_json_obj *o,
+				      struct nftnl_parse_err *err)
+{
+	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD, o->cmd);
+
+	switch (o->type) {
+	case NFTNL_RULESET_TABLE:
+		nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_TABLE, o->obj);
+		break;
+	case NFTNL_RULESET_CHAIN:
+		nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_CHAIN, o->obj);
+		break;
+	case NFTNL_RULESET_SET:
+	case NFTNL_RULESET_SET_ELEMS:
+		/* the set is ours until the callback has taken it */
+		if (nftnl_ruleset_parse_set(ctx, o->obj, o->type, err) < 0)
 			return -1;
+		o->obj = NULL;
+		return 0;
+	case NFTNL_RULESET_RULE:
+		nftnl_rule_lookup_set_ids(o->obj, ctx->set_list);
+		nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_RULE, o->obj);
+		break;
+	}
+
+	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE, o->type);
+	if (ctx->cb(ctx) < 0)
+		return -1;
+
+	o->obj = NULL;
+	return 0;
+}
+
+static int nftnl_ruleset_json_batch_run(struct nftnl_parse_ctx *ctx,
+					struct nftnl_parse_err *err)
+{
+	struct nftnl_ruleset_json_batch *b = ctx->batch;
+	struct nftnl_ruleset_json_worker *w = b->w;
+	struct nftnl_ruleset_json_obj *o;
+	uint32_t i;
+	int ret = 0;
+
+	for (i = 0; i < b->nthreads; i++)
+		w[i].batch = b;
+
+	nftnl_workers_run(w, sizeof(struct nftnl_ruleset_json_worker),
+			  b->nthreads, 0, b->num, nftnl_ruleset_json_worker);
+
+	for (i = 0; i < b->num; i++) {
+		o = &b->objs[i];
+		if (ret == 0 && o->obj == NULL &&
+		    o->type != NFTNL_RULESET_RULESET) {
+			*err = o->err;
+			errno = o->errnum;
+			ret = -1;
 		}
+		if (ret == 0)
+			ret = nftnl_ruleset_json_deliver(ctx, o, err);
 
-		ctx->json = node;
-		if (nftnl_jansson_node_exist(node, "table"))
-			ret = nftnl_ruleset_parse_tables(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "chain"))
-			ret = nftnl_ruleset_parse_chains(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "set"))
-			ret = nftnl_ruleset_parse_sets(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "rule"))
-			ret = nftnl_ruleset_parse_rules(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "element"))
-			ret = nftnl_ruleset_parse_set_elems(ctx, err);
-		else
+		nftnl_ruleset_json_obj_free(o);
+	}
+	b->num = 0;
+	b->len = 0;
+
+	return ret;
+}
+
+/* Runs what is queued, but keeps @err and errno unless that fails. */
+static void nftnl_ruleset_json_batch_flush(struct nftnl_parse_ctx *ctx,
+					   struct nftnl_parse_err *err)
+{
+	struct nftnl_parse_err saved = *err;
+	int errnum = errno;
+
+	if (nftnl_ruleset_json_batch_run(ctx, err) == 0) {
+		*err = saved;
+		errno = errnum;
+	}
+}
+
+/* Queues the next object of @s, or a flush of the whole ruleset if NULL. */
+static int nftnl_ruleset_json_batch_add(struct nftnl_parse_ctx *ctx,
+					struct nftnl_jansson_stream *s,
+					struct nftnl_parse_err *err)
+{
+	struct nftnl_ruleset_json_batch *b = ctx->batch;
+	struct nftnl_ruleset_json_obj *o;
+	size_t size;
+	char *text;
+
+	if (s != NULL && nftnl_jansson_stream_record(s, err) < 0)
+		return -1;
+
+	if (b->num == b->size && nftnl_ruleset_json_batch_run(ctx, err) < 0)
+		return -1;
+
+	o = &b->objs[b->num];
+	memset(o, 0, sizeof(*o));
+	o->cmd = ctx->cmd;
+
+	if (s == NULL) {
+		o->type = NFTNL_RULESET_RULESET;
+		b->num++;
+		return 0;
+	}
+
+	if (b->len + s->len > b->text_size) {
+		size = (b->len + s->len) * 2;
+		text = realloc(b->text, size);
+		if (text == NULL) {
+			err->error = NFTNL_PARSE_EBADINPUT;
+			err->line = s->val_line;
+			err->column = s->val_column;
+			err->node_name = NULL;
+			errno = ENOMEM;
 			return -1;
+		}
+		b->text = text;
+		b->text_size = size;
+	}
+	memcpy(b->text + b->len, s->val, s->len);
 
-		if (ret < 0)
-			return ret;
+	o->type = NFTNL_RULESET_UNSPEC;
+	o->off = b->len;
+	o->len = s->len;
+	o->line = s->val_line;
+	o->column = s->val_column;
+	b->len += s->len;
+	b->num++;
+
+	return 0;
+}
+
+/*
+ * Objects are loaded one by one and handed to the callback before the next
+ * one is read, so only a single object tree is around at any time.
+ */
+static int nftnl_ruleset_json_parse_ruleset(struct nftnl_parse_ctx *ctx,
+					    struct nftnl_jansson_stream *s,
+					    struct nftnl_parse_err *err)
+{
+	int len = 0, ret = 0;
+
+	if (nftnl_jansson_stream_peek(s) != '[') {
+		if (nftnl_jansson_stream_skip(s, err) < 0)
+			return -1;
+	} else if (nftnl_jansson_stream_expect(s, '[', err) < 0) {
+		return -1;
+	} else if (nftnl_jansson_stream_peek(s) == ']') {
+		ret = nftnl_jansson_stream_expect(s, ']', err);
+	} else {
+		do {
+			len++;
+			if (ctx->batch != NULL)
+				ret = nftnl_ruleset_json_batch_add(ctx, s, err);
+			else
+				ret = nftnl_ruleset_json_parse_next(ctx, s, err);
+			if (ret < 0)
+				return ret;
+		} while ((ret = nftnl_jansson_stream_next(s, ']', err)) > 0);
 	}
+	if (ret < 0)
+		return ret;
 
 	if (len == 0 && ctx->cmd == NFTNL_CMD_FLUSH) {
+		if (ctx->batch != NULL)
+			return nftnl_ruleset_json_batch_add(ctx, NULL, err);
+
 		nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE,
 					NFTNL_RULESET_RULESET);
 		if (ctx->cb(ctx) < 0)
@@ -510,12 +884,17 @@ static int nftnl_ruleset_json_parse_ruleset(struct nftnl_parse_ctx *ctx,
 	return 0;
 }
 
-static int nftnl_ruleset_json_parse_cmd(const char *cmd,
-				      struct nftnl_parse_err *err,
-				      struct nftnl_parse_ctx *ctx)
+static int nftnl_ruleset_json_parse_cmd(struct nftnl_parse_ctx *ctx,
+					struct nftnl_jansson_stream *s,
+					struct nftnl_parse_err *err)
 {
+	char cmd[16];
 	uint32_t cmdnum;
-	json_t *nodecmd;
+	int ret;
+
+	if (nftnl_jansson_stream_expect(s, '{', err) < 0 ||
+	    nftnl_jansson_stream_key(s, cmd, sizeof(cmd), err) < 0)
+		return -1;
 
 	cmdnum = nftnl_str2cmd(cmd);
 	if (cmdnum == NFTNL_CMD_UNSPEC) {
@@ -526,17 +905,37 @@ static int nftnl_ruleset_json_parse_cmd(const char *cmd,
 
 	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD, cmdnum);
 
-	nodecmd = json_object_get(ctx->json, cmd);
-	if (nodecmd == NULL)
-		return 0;
+	if (nftnl_ruleset_json_parse_ruleset(ctx, s, err) != 0)
+		return -1;
 
-	ctx->json = nodecmd;
-	if (nftnl_ruleset_json_parse_ruleset(ctx, err) != 0)
-		goto err;
+	/* only the first member of a command is looked at */
+	while ((ret = nftnl_jansson_stream_next(s, '}', err)) > 0) {
+		if (nftnl_jansson_stream_key(s, NULL, 0, err) < 0 ||
+		    nftnl_jansson_stream_skip(s, err) < 0)
+			return -1;
+	}
 
-	return 0;
-err:
-	return -1;
+	return ret;
+}
+
+static int nftnl_ruleset_json_parse_cmds(struct nftnl_parse_ctx *ctx,
+					 struct nftnl_jansson_stream *s,
+					 struct nftnl_parse_err *err)
+{
+	int ret;
+
+	if (nftnl_jansson_stream_expect(s, '[', err) < 0)
+		return -1;
+
+	if (nftnl_jansson_stream_peek(s) == ']')
+		return nftnl_jansson_stream_expect(s, ']', err);
+
+	do {
+		if (nftnl_ruleset_json_parse_cmd(ctx, s, err) < 0)
+			return -1;
+	} while ((ret = nftnl_jansson_stream_next(s, ']', err)) > 0);
+
+	return ret;
 }
 #endif
 
@@ -544,97 +943,114 @@ static int nftnl_ruleset_json_parse(const void *json,
 				  struct nftnl_parse_err *err,
 				  enum nftnl_parse_input input,
 				  enum nftnl_parse_type type, void *arg,
-				  int (*cb)(const struct nftnl_parse_ctx *ctx))
+				  int (*cb)(const struct nftnl_parse_ctx *ctx),
+				  unsigned int nthreads)
 {
 #ifdef JSON_PARSING
-	json_t *root, *array, *node;
-	json_error_t error;
-	int i, len;
-	const char *key;
+	struct nftnl_jansson_stream s;
 	struct nftnl_parse_ctx ctx;
+	bool found = false;
+	char key[16];
+	int ret;
 
 	ctx.cb = cb;
 	ctx.format = type;
+	ctx.set_id = 0;
+	ctx.batch = NULL;
 
 	ctx.set_list = nftnl_set_list_alloc();
 	if (ctx.set_list == NULL)
 		return -1;
 
+	if (nthreads > 1) {
+		ctx.batch = nftnl_ruleset_json_batch_alloc(nthreads);
+		if (ctx.batch == NULL) {
+			nftnl_set_list_free(ctx.set_list);
+			return -1;
+		}
+	}
+
 	if (arg != NULL)
 		nftnl_ruleset_ctx_set(&ctx, NFTNL_RULESET_CTX_DATA, arg);
 
-	root = nftnl_jansson_create_root(json, &error, err, input);
-	if (root == NULL)
-		goto err1;
+	/* the document is never loaded as a whole, see jansson.c */
+	nftnl_jansson_stream_init(&s, json, input);
+	if (nftnl_jansson_stream_expect(&s, '{', err) < 0)
+		goto err;
 
-	array = json_object_get(root, "nftables");
-	if (array == NULL) {
-		errno = EINVAL;
-		goto err2;
-	}
+	do {
+		if (nftnl_jansson_stream_key(&s, key, sizeof(key), err) < 0)
+			goto err;
 
-	len = json_array_size(array);
-	for (i = 0; i < len; i++) {
-		node = json_array_get(array, i);
-		if (node == NULL) {
-			errno = EINVAL;
-			goto err2;
+		if (strcmp(key, "nftables") == 0) {
+			found = true;
+			ret = nftnl_ruleset_json_parse_cmds(&ctx, &s, err);
+		} else {
+			ret = nftnl_jansson_stream_skip(&s, err);
 		}
-		ctx.json = node;
-		key = json_object_iter_key(json_object_iter(node));
-		if (key == NULL)
-			goto err2;
+		if (ret < 0)
+			goto err;
+	} while ((ret = nftnl_jansson_stream_next(&s, '}', err)) > 0);
 
-		if (nftnl_ruleset_json_parse_cmd(key, err, &ctx) < 0)
-			goto err2;
+	if (ret < 0)
+		goto err;
+	if (!found || !nftnl_jansson_stream_eof(&s)) {
+		errno = EINVAL;
+		goto err;
 	}
+	if (ctx.batch != NULL && nftnl_ruleset_json_batch_run(&ctx, err) < 0)
+		goto err;
 
+	ret = 0;
+out:
+	if (ctx.batch != NULL)
+		nftnl_ruleset_json_batch_free(ctx.batch);
+	nftnl_jansson_stream_free(&s);
 	nftnl_set_list_free(ctx.set_list);
-	nftnl_jansson_free_root(root);
-	return 0;
-err2:
-	nftnl_jansson_free_root(root);
-err1:
-	nftnl_set_list_free(ctx.set_list);
-	return -1;
+	return ret;
+err:
+	/*
+	 * The serial parser has handed over everything in front of the error
+	 * by now, do the same. An error in there came first and wins.
+	 */
+	if (ctx.batch != NULL && ctx.batch->num > 0)
+		nftnl_ruleset_json_batch_flush(&ctx, err);
+	ret = -1;
+	goto out;
 #else
 	errno = EOPNOTSUPP;
 	return -1;
 #endif
 }
 
-#ifdef XML_PARSING
-static int nftnl_ruleset_xml_parse_ruleset(struct nftnl_parse_ctx *ctx,
-					 struct nftnl_parse_err *err)
+#ifdef JSON_PARSING
+/*
+ * CBOR documents have the layout of JSON ones, objects are decoded into the
+ * same trees and handed to the JSON parsers one at a time.
+ */
+static int nftnl_ruleset_cbor_parse_ruleset(struct nftnl_parse_ctx *ctx,
+					    struct nftnl_cbor_reader *r,
+					    struct nftnl_parse_err *err)
 {
-	const char *node_type;
-	mxml_node_t *node, *array = ctx->xml;
 	int len = 0, ret;
+	uint64_t count;
+
+	if (nftnl_cbor_enter(r, NFTNL_CBOR_ARRAY, &count, err) < 0)
+		return -1;
 
-	for (node = mxmlFindElement(array, array, NULL, NULL, NULL,
-				    MXML_DESCEND_FIRST);
-	     node != NULL;
-	     node = mxmlFindElement(node, array, NULL, NULL, NULL,
-				    MXML_NO_DESCEND)) {
+	while ((ret = nftnl_cbor_next(r, &count, err)) > 0) {
 		len++;
-		node_type = node->value.opaque;
-		ctx->xml = node;
-		if (strcmp(node_type, "table") == 0)
-			ret = nftnl_ruleset_parse_tables(ctx, err);
-		else if (strcmp(node_type, "chain") == 0)
-			ret = nftnl_ruleset_parse_chains(ctx, err);
-		else if (strcmp(node_type, "set") == 0)
-			ret = nftnl_ruleset_parse_sets(ctx, err);
-		else if (strcmp(node_type, "rule") == 0)
-			ret = nftnl_ruleset_parse_rules(ctx, err);
-		else if (strcmp(node_type, "element") == 0)
-			ret = nftnl_ruleset_parse_set_elems(ctx, err);
-		else
+		ctx->json = nftnl_cbor_load(r, err);
+		if (ctx->json == NULL)
 			return -1;
 
+		ret = nftnl_ruleset_json_parse_node(ctx, err);
+		nftnl_jansson_free_root(ctx->json);
 		if (ret < 0)
-			return ret;
+			return -1;
 	}
+	if (ret < 0)
+		return -1;
 
 	if (len == 0 && ctx->cmd == NFTNL_CMD_FLUSH) {
 		nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE,
@@ -646,11 +1062,29 @@ static int nftnl_ruleset_xml_parse_ruleset(struct nftnl_parse_ctx *ctx,
 	return 0;
 }
 
-static int nftnl_ruleset_xml_parse_cmd(const char *cmd, struct nftnl_parse_err *err,
-				     struct nftnl_parse_ctx *ctx)
+static int nftnl_ruleset_cbor_parse_cmd(struct nftnl_parse_ctx *ctx,
+					struct nftnl_cbor_reader *r,
+					struct nftnl_parse_err *err)
 {
+	uint64_t count;
 	uint32_t cmdnum;
-	mxml_node_t *nodecmd;
+	char cmd[16];
+	int ret;
+
+	if (nftnl_cbor_enter(r, NFTNL_CBOR_MAP, &count, err) < 0)
+		return -1;
+
+	ret = nftnl_cbor_next(r, &count, err);
+	if (ret <= 0) {
+		if (ret == 0) {
+			err->error = NFTNL_PARSE_EMISSINGNODE;
+			err->node_name = "cmd";
+			errno = EINVAL;
+		}
+		return -1;
+	}
+	if (nftnl_cbor_key(r, cmd, sizeof(cmd), err) < 0)
+		return -1;
 
 	cmdnum = nftnl_str2cmd(cmd);
 	if (cmdnum == NFTNL_CMD_UNSPEC) {
@@ -659,18 +1093,195 @@ static int nftnl_ruleset_xml_parse_cmd(const char *cmd, struct nftnl_parse_err *
 		return -1;
 	}
 
-	nodecmd = mxmlFindElement(ctx->xml, ctx->xml, cmd, NULL, NULL,
-				  MXML_DESCEND_FIRST);
-
-	ctx->xml = nodecmd;
 	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD, cmdnum);
 
-	if (nftnl_ruleset_xml_parse_ruleset(ctx, err) != 0)
+	if (nftnl_ruleset_cbor_parse_ruleset(ctx, r, err) != 0)
+		return -1;
+
+	/* only the first member of a command is looked at */
+	while ((ret = nftnl_cbor_next(r, &count, err)) > 0) {
+		if (nftnl_cbor_key(r, NULL, 0, err) < 0 ||
+		    nftnl_cbor_skip(r, err) < 0)
+			return -1;
+	}
+
+	return ret;
+}
+
+static int nftnl_ruleset_cbor_parse_cmds(struct nftnl_parse_ctx *ctx,
+					 struct nftnl_cbor_reader *r,
+					 struct nftnl_parse_err *err)
+{
+	uint64_t count;
+	int ret;
+
+	if (nftnl_cbor_enter(r, NFTNL_CBOR_ARRAY, &count, err) < 0)
+		return -1;
+
+	while ((ret = nftnl_cbor_next(r, &count, err)) > 0) {
+		if (nftnl_ruleset_cbor_parse_cmd(ctx, r, err) < 0)
+			return -1;
+	}
+
+	return ret;
+}
+#endif
+
+static int nftnl_ruleset_cbor_parse(const void *cbor,
+				    struct nftnl_parse_err *err,
+				    enum nftnl_parse_input input, void *arg,
+				    int (*cb)(const struct nftnl_parse_ctx *ctx))
+{
+#ifdef JSON_PARSING
+	struct nftnl_cbor_reader r;
+	struct nftnl_parse_ctx ctx;
+	bool found = false;
+	uint64_t count;
+	char key[16];
+	int ret;
+
+	ctx.cb = cb;
+	ctx.format = NFTNL_PARSE_JSON;
+	ctx.set_id = 0;
+	ctx.batch = NULL;
+
+	ctx.set_list = nftnl_set_list_alloc();
+	if (ctx.set_list == NULL)
+		return -1;
+
+	if (arg != NULL)
+		nftnl_ruleset_ctx_set(&ctx, NFTNL_RULESET_CTX_DATA, arg);
+
+	if (nftnl_cbor_reader_init(&r, cbor, input, err) < 0 ||
+	    nftnl_cbor_enter(&r, NFTNL_CBOR_MAP, &count, err) < 0)
+		goto err;
+
+	while ((ret = nftnl_cbor_next(&r, &count, err)) > 0) {
+		if (nftnl_cbor_key(&r, key, sizeof(key), err) < 0)
+			goto err;
+
+		if (strcmp(key, "nftables") == 0) {
+			found = true;
+			ret = nftnl_ruleset_cbor_parse_cmds(&ctx, &r, err);
+		} else {
+			ret = nftnl_cbor_skip(&r, err);
+		}
+		if (ret < 0)
+			goto err;
+	}
+
+	if (ret < 0)
 		goto err;
+	if (!found) {
+		errno = EINVAL;
+		goto err;
+	}
+
+	nftnl_set_list_free(ctx.set_list);
+	return 0;
+err:
+	nftnl_set_list_free(ctx.set_list);
+	return -1;
+#else
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
+#ifdef XML_PARSING
+static int nftnl_ruleset_xml_parse_node(struct nftnl_parse_ctx *ctx,
+					struct nftnl_parse_err *err)
+{
+	const char *node_type = ctx->xml->value.opaque;
+
+	if (strcmp(node_type, "table") == 0)
+		return nftnl_ruleset_parse_tables(ctx, err);
+	else if (strcmp(node_type, "chain") == 0)
+		return nftnl_ruleset_parse_chains(ctx, err);
+	else if (strcmp(node_type, "set") == 0)
+		return nftnl_ruleset_parse_sets(ctx, err);
+	else if (strcmp(node_type, "rule") == 0)
+		return nftnl_ruleset_parse_rules(ctx, err);
+	else if (strcmp(node_type, "element") == 0)
+		return nftnl_ruleset_parse_set_elems(ctx, err);
+
+	return -1;
+}
+
+struct nftnl_ruleset_xml_sax {
+	struct nftnl_parse_ctx	*ctx;
+	struct nftnl_parse_err	*err;
+	int			depth;	/* nftables, command, object */
+	int			objs;	/* of the current command */
+	int			ret;
+};
+
+/*
+ * Only the object that is being read is kept: its nodes are retained until
+ * it is closed, then it is handed over and deleted. The parser cannot be
+ * stopped, after an error the rest of the input is only scanned.
+ */
+static void nftnl_ruleset_xml_sax_cb(mxml_node_t *node, mxml_sax_event_t event,
+				     void *data)
+{
+	struct nftnl_ruleset_xml_sax *sax = data;
+	struct nftnl_parse_ctx *ctx = sax->ctx;
+	uint32_t cmdnum;
+
+	switch (event) {
+	case MXML_SAX_ELEMENT_OPEN:
+		sax->depth++;
+		if (sax->depth == 1 || sax->depth >= 3)
+			mxmlRetain(node);
+
+		if (sax->ret < 0)
+			break;
 
-	return 0;
-err:
-	return -1;
+		if (sax->depth == 1 &&
+		    strcmp(node->value.opaque, "nftables") != 0) {
+			sax->err->error = NFTNL_PARSE_EMISSINGNODE;
+			sax->err->node_name = "nftables";
+			errno = EINVAL;
+			sax->ret = -1;
+		} else if (sax->depth == 2) {
+			cmdnum = nftnl_str2cmd(node->value.opaque);
+			if (cmdnum == NFTNL_CMD_UNSPEC) {
+				sax->err->error = NFTNL_PARSE_EMISSINGNODE;
+				sax->err->node_name = strdup(node->value.opaque);
+				sax->ret = -1;
+				break;
+			}
+			nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD,
+						  cmdnum);
+			sax->objs = 0;
+		}
+		break;
+	case MXML_SAX_DATA:
+		if (sax->depth >= 3)
+			mxmlRetain(node);
+		break;
+	case MXML_SAX_ELEMENT_CLOSE:
+		if (sax->depth == 3) {
+			if (sax->ret == 0) {
+				ctx->xml = node;
+				sax->objs++;
+				sax->ret = nftnl_ruleset_xml_parse_node(ctx,
+								sax->err);
+			}
+			/* drop our reference, the parser deletes it now */
+			mxmlRelease(node);
+		} else if (sax->depth == 2 && sax->ret == 0 &&
+			   sax->objs == 0 && ctx->cmd == NFTNL_CMD_FLUSH) {
+			nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE,
+						NFTNL_RULESET_RULESET);
+			if (ctx->cb(ctx) < 0)
+				sax->ret = -1;
+		}
+		sax->depth--;
+		break;
+	default:
+		break;
+	}
 }
 #endif
 
@@ -680,12 +1291,13 @@ static int nftnl_ruleset_xml_parse(const void *xml, struct nftnl_parse_err *err,
 				 int (*cb)(const struct nftnl_parse_ctx *ctx))
 {
 #ifdef XML_PARSING
-	mxml_node_t *tree, *nodecmd = NULL;
-	char *cmd;
+	struct nftnl_ruleset_xml_sax sax = {};
 	struct nftnl_parse_ctx ctx;
+	mxml_node_t *tree;
 
 	ctx.cb = cb;
 	ctx.format = type;
+	ctx.set_id = 0;
 
 	ctx.set_list = nftnl_set_list_alloc();
 	if (ctx.set_list == NULL)
@@ -694,26 +1306,22 @@ static int nftnl_ruleset_xml_parse(const void *xml, struct nftnl_parse_err *err,
 	if (arg != NULL)
 		nftnl_ruleset_ctx_set(&ctx, NFTNL_RULESET_CTX_DATA, arg);
 
-	tree = nftnl_mxml_build_tree(xml, "nftables", err, input);
-	if (tree == NULL)
-		goto err1;
+	sax.ctx = &ctx;
+	sax.err = err;
 
-	ctx.xml = tree;
+	tree = nftnl_mxml_sax_load(xml, input, nftnl_ruleset_xml_sax_cb, &sax,
+				   err);
+	if (tree == NULL)
+		goto err;
 
-	nodecmd = mxmlWalkNext(tree, tree, MXML_DESCEND_FIRST);
-	while (nodecmd != NULL) {
-		cmd = nodecmd->value.opaque;
-		if (nftnl_ruleset_xml_parse_cmd(cmd, err, &ctx) < 0)
-			goto err2;
-		nodecmd = mxmlWalkNext(tree, tree, MXML_NO_DESCEND);
-	}
+	/* what is left of it, the objects are gone already */
+	mxmlDelete(tree);
+	if (sax.ret < 0)
+		goto err;
 
 	nftnl_set_list_free(ctx.set_list);
-	mxmlDelete(tree);
 	return 0;
-err2:
-	mxmlDelete(tree);
-err1:
+err:
 	nftnl_set_list_free(ctx.set_list);
 	return -1;
 #else
@@ -725,7 +1333,8 @@ err1:
 static int
 nftnl_ruleset_do_parse(enum nftnl_parse_type type, const void *data,
 		     struct nftnl_parse_err *err, enum nftnl_parse_input input,
-		     void *arg, int (*cb)(const struct nftnl_parse_ctx *ctx))
+		     void *arg, int (*cb)(const struct nftnl_parse_ctx *ctx),
+		     unsigned int nthreads)
 {
 	int ret;
 
@@ -734,7 +1343,11 @@ nftnl_ruleset_do_parse(enum nftnl_parse_type type, const void *data,
 		ret = nftnl_ruleset_xml_parse(data, err, input, type, arg, cb);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_ruleset_json_parse(data, err, input, type, arg, cb);
+		ret = nftnl_ruleset_json_parse(data, err, input, type, arg, cb,
+					       nthreads);
+		break;
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_ruleset_cbor_parse(data, err, input, arg, cb);
 		break;
 	default:
 		ret = -1;
@@ -749,7 +1362,8 @@ int nftnl_ruleset_parse_file_cb(enum nftnl_parse_type type, FILE *fp,
 			      struct nftnl_parse_err *err, void *data,
 			      int (*cb)(const struct nftnl_parse_ctx *ctx))
 {
-	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_FILE, data, cb);
+	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_FILE, data, cb,
+				      1);
 }
 EXPORT_SYMBOL(nftnl_ruleset_parse_file_cb, nft_ruleset_parse_file_cb);
 
@@ -758,10 +1372,33 @@ int nftnl_ruleset_parse_buffer_cb(enum nftnl_parse_type type, const char *buffer
 				int (*cb)(const struct nftnl_parse_ctx *ctx))
 {
 	return nftnl_ruleset_do_parse(type, buffer, err, NFTNL_PARSE_BUFFER, data,
-				    cb);
+				    cb, 1);
 }
 EXPORT_SYMBOL(nftnl_ruleset_parse_buffer_cb, nft_ruleset_parse_buffer_cb);
 
+int nftnl_ruleset_parse_file_cb_parallel(enum nftnl_parse_type type, FILE *fp,
+					 struct nftnl_parse_err *err,
+					 void *data,
+					 int (*cb)(const struct nftnl_parse_ctx *ctx),
+					 unsigned int nthreads)
+{
+	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_FILE, data, cb,
+				      nthreads);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_parse_file_cb_parallel);
+
+int nftnl_ruleset_parse_buffer_cb_parallel(enum nftnl_parse_type type,
+					   const char *buffer,
+					   struct nftnl_parse_err *err,
+					   void *data,
+					   int (*cb)(const struct nftnl_parse_ctx *ctx),
+					   unsigned int nthreads)
+{
+	return nftnl_ruleset_do_parse(type, buffer, err, NFTNL_PARSE_BUFFER,
+				      data, cb, nthreads);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_parse_buffer_cb_parallel);
+
 static int nftnl_ruleset_cb(const struct nftnl_parse_ctx *ctx)
 {
 	struct nftnl_ruleset *r = ctx->data;
@@ -837,6 +1474,332 @@ int nftnl_ruleset_parse_file(struct nftnl_ruleset *rs, enum nftnl_parse_type typ
 }
 EXPORT_SYMBOL(nftnl_ruleset_parse_file, nft_ruleset_parse_file);
 
+int nftnl_ruleset_parse_file_parallel(struct nftnl_ruleset *rs,
+				      enum nftnl_parse_type type, FILE *fp,
+				      struct nftnl_parse_err *err,
+				      unsigned int nthreads)
+{
+	return nftnl_ruleset_parse_file_cb_parallel(type, fp, err, rs,
+						    nftnl_ruleset_cb, nthreads);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_parse_file_parallel);
+
+struct nftnl_ruleset_import {
+	struct nftnl_batch	*batch;
+	uint32_t		*seq;
+	int			msgs;
+};
+
+/* Messages are built where the last one ended, up to 64K past the page. */
+static bool nftnl_ruleset_import_batch_ok(const struct nftnl_batch *batch)
+{
+	if (nftnl_batch_overrun_size(batch) < UINT16_MAX + getpagesize()) {
+		errno = EINVAL;
+		return false;
+	}
+
+	return true;
+}
+
+static int nftnl_ruleset_import_next(struct nftnl_ruleset_import *imp)
+{
+	if (nftnl_batch_update(imp->batch) < 0)
+		return -1;
+
+	imp->msgs++;
+	return 0;
+}
+
+/* flushing a table or a chain removes its rules, @chain may be NULL */
+static int nftnl_ruleset_import_flush(struct nftnl_ruleset_import *imp,
+				      uint32_t family, const char *table,
+				      const char *chain)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_rule_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					 NFT_MSG_DELRULE, family, NLM_F_ACK,
+					 (*imp->seq)++);
+	if (table != NULL)
+		mnl_attr_put_strz(nlh, NFTA_RULE_TABLE, table);
+	if (chain != NULL)
+		mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN, chain);
+
+	return nftnl_ruleset_import_next(imp);
+}
+
+static int nftnl_ruleset_import_table(struct nftnl_ruleset_import *imp,
+				      uint32_t cmd, struct nftnl_table *t)
+{
+	struct nlmsghdr *nlh;
+	uint16_t type, flags;
+
+	switch (cmd) {
+	case NFTNL_CMD_ADD:
+		type = NFT_MSG_NEWTABLE;
+		flags = NLM_F_CREATE | NLM_F_ACK;
+		break;
+	case NFTNL_CMD_DELETE:
+		type = NFT_MSG_DELTABLE;
+		flags = NLM_F_ACK;
+		break;
+	case NFTNL_CMD_FLUSH:
+		return nftnl_ruleset_import_flush(imp,
+				nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				nftnl_table_get_str(t, NFTNL_TABLE_NAME), NULL);
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	nlh = nftnl_table_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					  type,
+					  nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+					  flags,
+					  (*imp->seq)++);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+
+	return nftnl_ruleset_import_next(imp);
+}
+
+static int nftnl_ruleset_import_chain(struct nftnl_ruleset_import *imp,
+				      uint32_t cmd, struct nftnl_chain *c)
+{
+	struct nlmsghdr *nlh;
+	uint16_t type, flags;
+
+	switch (cmd) {
+	case NFTNL_CMD_ADD:
+		type = NFT_MSG_NEWCHAIN;
+		flags = NLM_F_CREATE | NLM_F_ACK;
+		break;
+	case NFTNL_CMD_DELETE:
+		type = NFT_MSG_DELCHAIN;
+		flags = NLM_F_ACK;
+		break;
+	case NFTNL_CMD_FLUSH:
+		return nftnl_ruleset_import_flush(imp,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	nftnl_chain_unset(c, NFTNL_CHAIN_HANDLE);
+	nlh = nftnl_chain_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					  type,
+					  nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+					  flags,
+					  (*imp->seq)++);
+	nftnl_chain_nlmsg_build_payload(nlh, c);
+
+	return nftnl_ruleset_import_next(imp);
+}
+
+static int nftnl_ruleset_import_elems(struct nftnl_ruleset_import *imp,
+				      uint32_t cmd, struct nftnl_set *s)
+{
+	struct nftnl_set_elems_iter *iter;
+	struct nlmsghdr *nlh;
+	uint16_t type, flags;
+	int more;
+
+	switch (cmd) {
+	case NFTNL_CMD_ADD:
+		type = NFT_MSG_NEWSETELEM;
+		flags = NLM_F_CREATE | NLM_F_ACK;
+		break;
+	case NFTNL_CMD_DELETE:
+		type = NFT_MSG_DELSETELEM;
+		flags = NLM_F_ACK;
+		break;
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (list_empty(&s->element_list))
+		return 0;
+
+	iter = nftnl_set_elems_iter_create(s);
+	if (iter == NULL)
+		return -1;
+
+	/* one message per 64K worth of elements */
+	do {
+		nlh = nftnl_set_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+						type, s->family, flags,
+						(*imp->seq)++);
+		more = nftnl_set_elems_nlmsg_build_payload_iter(nlh, iter);
+		if (nftnl_ruleset_import_next(imp) < 0) {
+			more = -1;
+			break;
+		}
+	} while (more > 0);
+	nftnl_set_elems_iter_destroy(iter);
+
+	return more;
+}
+
+static int nftnl_ruleset_import_set(struct nftnl_ruleset_import *imp,
+				    uint32_t cmd, struct nftnl_set *s)
+{
+	struct nlmsghdr *nlh;
+	uint16_t type, flags;
+
+	switch (cmd) {
+	case NFTNL_CMD_ADD:
+		type = NFT_MSG_NEWSET;
+		flags = NLM_F_CREATE | NLM_F_ACK;
+		break;
+	case NFTNL_CMD_DELETE:
+		type = NFT_MSG_DELSET;
+		flags = NLM_F_ACK;
+		break;
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	nlh = nftnl_set_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					type, s->family, flags,
+					(*imp->seq)++);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+	if (nftnl_ruleset_import_next(imp) < 0)
+		return -1;
+
+	/* the elements of a deleted set go with it */
+	if (cmd == NFTNL_CMD_DELETE)
+		return 0;
+
+	return nftnl_ruleset_import_elems(imp, cmd, s);
+}
+
+static int nftnl_ruleset_import_rule(struct nftnl_ruleset_import *imp,
+				     uint32_t cmd, struct nftnl_rule *r)
+{
+	struct nlmsghdr *nlh;
+	uint16_t type, flags;
+
+	switch (cmd) {
+	case NFTNL_CMD_ADD:
+		type = NFT_MSG_NEWRULE;
+		flags = NLM_F_APPEND | NLM_F_CREATE | NLM_F_ACK;
+		nftnl_rule_unset(r, NFTNL_RULE_HANDLE);
+		break;
+	case NFTNL_CMD_INSERT:
+		type = NFT_MSG_NEWRULE;
+		flags = NLM_F_CREATE | NLM_F_ACK;
+		nftnl_rule_unset(r, NFTNL_RULE_HANDLE);
+		break;
+	case NFTNL_CMD_REPLACE:
+		type = NFT_MSG_NEWRULE;
+		flags = NLM_F_REPLACE | NLM_F_ACK;
+		break;
+	case NFTNL_CMD_DELETE:
+		type = NFT_MSG_DELRULE;
+		flags = NLM_F_ACK;
+		break;
+	default:
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	nlh = nftnl_rule_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					 type,
+					 nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+					 flags,
+					 (*imp->seq)++);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+
+	return nftnl_ruleset_import_next(imp);
+}
+
+/*
+ * The parser already gave sets their IDs and resolved the lookup and dynset
+ * expressions against them, so objects only have to be turned into messages.
+ * They are freed right away, the caller keeps nothing but the batch.
+ */
+static int nftnl_ruleset_import_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct nftnl_ruleset_import *imp = ctx->data;
+	int ret;
+
+	switch (ctx->type) {
+	case NFTNL_RULESET_TABLE:
+		ret = nftnl_ruleset_import_table(imp, ctx->cmd, ctx->table);
+		break;
+	case NFTNL_RULESET_CHAIN:
+		ret = nftnl_ruleset_import_chain(imp, ctx->cmd, ctx->chain);
+		break;
+	case NFTNL_RULESET_SET:
+		ret = nftnl_ruleset_import_set(imp, ctx->cmd, ctx->set);
+		break;
+	case NFTNL_RULESET_SET_ELEMS:
+		ret = nftnl_ruleset_import_elems(imp, ctx->cmd, ctx->set);
+		break;
+	case NFTNL_RULESET_RULE:
+		ret = nftnl_ruleset_import_rule(imp, ctx->cmd, ctx->rule);
+		break;
+	case NFTNL_RULESET_RULESET:
+		/* flush ruleset: delete all tables of all families */
+		nftnl_table_nlmsg_build_hdr(nftnl_batch_buffer(imp->batch),
+					    NFT_MSG_DELTABLE, NFPROTO_UNSPEC,
+					    NLM_F_ACK, (*imp->seq)++);
+		ret = nftnl_ruleset_import_next(imp);
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* on error the object is still the parser's */
+	if (ret < 0)
+		return -1;
+
+	nftnl_ruleset_ctx_free(ctx);
+	return 0;
+}
+
+int nftnl_ruleset_parse_file_batch(enum nftnl_parse_type type, FILE *fp,
+				   struct nftnl_parse_err *err,
+				   struct nftnl_batch *batch, uint32_t *seq)
+{
+	struct nftnl_ruleset_import imp = {
+		.batch	= batch,
+		.seq	= seq,
+	};
+
+	if (!nftnl_ruleset_import_batch_ok(batch) ||
+	    nftnl_ruleset_parse_file_cb(type, fp, err, &imp,
+					nftnl_ruleset_import_cb) < 0)
+		return -1;
+
+	return imp.msgs;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_parse_file_batch);
+
+int nftnl_ruleset_parse_buffer_batch(enum nftnl_parse_type type,
+				     const char *buffer,
+				     struct nftnl_parse_err *err,
+				     struct nftnl_batch *batch, uint32_t *seq)
+{
+	struct nftnl_ruleset_import imp = {
+		.batch	= batch,
+		.seq	= seq,
+	};
+
+	if (!nftnl_ruleset_import_batch_ok(batch) ||
+	    nftnl_ruleset_parse_buffer_cb(type, buffer, err, &imp,
+					  nftnl_ruleset_import_cb) < 0)
+		return -1;
+
+	return imp.msgs;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_parse_buffer_batch);
+
 static const char *nftnl_ruleset_o_opentag(uint32_t type)
 {
 	switch (type) {
@@ -844,6 +1807,8 @@ static const char *nftnl_ruleset_o_opentag(uint32_t type)
 		return "<nftables>";
 	case NFTNL_OUTPUT_JSON:
 		return "{\"nftables\":[";
+	case NFTNL_OUTPUT_CBOR:
+		return "\xbf\x68nftables\x9f";
 	default:
 		return "";
 	}
@@ -871,6 +1836,8 @@ static const char *nftnl_ruleset_o_closetag(uint32_t type)
 		return "</nftables>";
 	case NFTNL_OUTPUT_JSON:
 		return "]}";
+	case NFTNL_OUTPUT_CBOR:
+		return "\xff\xff";
 	default:
 		return "";
 	}
@@ -1075,6 +2042,7 @@ static int nftnl_ruleset_cmd_snprintf(char *buf, size_t size,
 	case NFTNL_OUTPUT_DEFAULT:
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_ruleset_do_snprintf(buf, size, r, cmd, type, flags);
 	default:
 		errno = EOPNOTSUPP;
@@ -1089,6 +2057,7 @@ int nftnl_ruleset_snprintf(char *buf, size_t size, const struct nftnl_ruleset *r
 	case NFTNL_OUTPUT_DEFAULT:
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		return nftnl_ruleset_cmd_snprintf(buf, size, r,
 						nftnl_flag2cmd(flags), type,
 						flags);
@@ -1099,222 +2068,271 @@ int nftnl_ruleset_snprintf(char *buf, size_t size, const struct nftnl_ruleset *r
 }
 EXPORT_SYMBOL(nftnl_ruleset_snprintf, nft_ruleset_snprintf);
 
-static int nftnl_ruleset_fprintf_tables(FILE *fp, const struct nftnl_ruleset *rs,
-				      uint32_t type, uint32_t flags)
+static int nftnl_ruleset_output_tables(struct nftnl_sink *sink,
+				       const struct nftnl_ruleset *rs,
+				       uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
+	struct nftnl_table_list_iter *i;
 	struct nftnl_table *t;
-	struct nftnl_table_list_iter *ti;
 
-	ti = nftnl_table_list_iter_create(rs->table_list);
-	if (ti == NULL)
+	i = nftnl_table_list_iter_create(rs->table_list);
+	if (i == NULL)
 		return -1;
 
-	t = nftnl_table_list_iter_next(ti);
+	t = nftnl_table_list_iter_next(i);
 	while (t != NULL) {
-		ret = nftnl_table_fprintf(fp, t, type, flags);
-		if (ret < 0)
+		if (nftnl_table_output(sink, t, type, flags) < 0)
 			goto err;
 
-		len += ret;
-
-		t = nftnl_table_list_iter_next(ti);
+		t = nftnl_table_list_iter_next(i);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(t, type));
-		if (ret < 0)
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(t, type)) < 0)
 			goto err;
-
-		len += ret;
 	}
-	nftnl_table_list_iter_destroy(ti);
+	nftnl_table_list_iter_destroy(i);
 
-	return len;
+	return 0;
 err:
-	nftnl_table_list_iter_destroy(ti);
+	nftnl_table_list_iter_destroy(i);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_chains(FILE *fp, const struct nftnl_ruleset *rs,
-				      uint32_t type, uint32_t flags)
+static int nftnl_ruleset_output_chains(struct nftnl_sink *sink,
+				       const struct nftnl_ruleset *rs,
+				       uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
-	struct nftnl_chain *o;
 	struct nftnl_chain_list_iter *i;
+	struct nftnl_chain *c;
 
 	i = nftnl_chain_list_iter_create(rs->chain_list);
 	if (i == NULL)
 		return -1;
 
-	o = nftnl_chain_list_iter_next(i);
-	while (o != NULL) {
-		ret = nftnl_chain_fprintf(fp, o, type, flags);
-		if (ret < 0)
+	c = nftnl_chain_list_iter_next(i);
+	while (c != NULL) {
+		if (nftnl_chain_output(sink, c, type, flags) < 0)
 			goto err;
 
-		len += ret;
+		c = nftnl_chain_list_iter_next(i);
 
-		o = nftnl_chain_list_iter_next(i);
-
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(c, type)) < 0)
 			goto err;
-
-		len += ret;
 	}
 	nftnl_chain_list_iter_destroy(i);
 
-	return len;
+	return 0;
 err:
 	nftnl_chain_list_iter_destroy(i);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_sets(FILE *fp, const struct nftnl_ruleset *rs,
-				    uint32_t type, uint32_t flags)
+static int nftnl_ruleset_output_sets(struct nftnl_sink *sink,
+				     const struct nftnl_ruleset *rs,
+				     uint32_t type, uint32_t flags,
+				     unsigned int nthreads)
 {
-	int len = 0, ret = 0;
-	struct nftnl_set *o;
 	struct nftnl_set_list_iter *i;
+	struct nftnl_set *s;
 
 	i = nftnl_set_list_iter_create(rs->set_list);
 	if (i == NULL)
 		return -1;
 
-	o = nftnl_set_list_iter_next(i);
-	while (o != NULL) {
-		ret = nftnl_set_fprintf(fp, o, type, flags);
-		if (ret < 0)
+	s = nftnl_set_list_iter_next(i);
+	while (s != NULL) {
+		if (nftnl_set_output_parallel(sink, s, type, flags,
+					      nthreads) < 0)
 			goto err;
 
-		len += ret;
-
-		o = nftnl_set_list_iter_next(i);
+		s = nftnl_set_list_iter_next(i);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(s, type)) < 0)
 			goto err;
-
-		len += ret;
 	}
 	nftnl_set_list_iter_destroy(i);
 
-	return len;
+	return 0;
 err:
 	nftnl_set_list_iter_destroy(i);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_rules(FILE *fp, const struct nftnl_ruleset *rs,
-				    uint32_t type, uint32_t flags)
+struct nftnl_ruleset_output_ctx {
+	uint32_t	type;
+	uint32_t	flags;
+	uint32_t	num;
+};
+
+static int nftnl_ruleset_output_rule(struct nftnl_sink *sink, void *r,
+				     uint32_t idx, void *data)
 {
-	int len = 0, ret = 0;
-	struct nftnl_rule *o;
-	struct nftnl_rule_list_iter *i;
+	struct nftnl_ruleset_output_ctx *ctx = data;
 
-	i = nftnl_rule_list_iter_create(rs->rule_list);
-	if (i == NULL)
+	if (nftnl_rule_output(sink, r, ctx->type, ctx->flags) < 0)
 		return -1;
 
-	o = nftnl_rule_list_iter_next(i);
-	while (o != NULL) {
-		ret = nftnl_rule_fprintf(fp, o, type, flags);
-		if (ret < 0)
-			goto err;
+	/* the separator only depends on whether this is the last one */
+	return nftnl_sink_printf(sink, "%s",
+			nftnl_ruleset_o_separator(idx + 1 < ctx->num ? r : NULL,
+						  ctx->type));
+}
 
-		len += ret;
+static int nftnl_ruleset_output_rules(struct nftnl_sink *sink,
+				      const struct nftnl_ruleset *rs,
+				      uint32_t type, uint32_t flags,
+				      unsigned int nthreads)
+{
+	struct nftnl_ruleset_output_ctx ctx = {
+		.type	= type,
+		.flags	= flags,
+	};
+	struct nftnl_rule_list_iter *i;
+	struct nftnl_rule **rules, *r;
+	int ret;
 
-		o = nftnl_rule_list_iter_next(i);
+	i = nftnl_rule_list_iter_create(rs->rule_list);
+	if (i == NULL)
+		return -1;
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
-			goto err;
+	while (nftnl_rule_list_iter_next(i) != NULL)
+		ctx.num++;
+	nftnl_rule_list_iter_destroy(i);
 
-		len += ret;
+	rules = calloc(ctx.num, sizeof(struct nftnl_rule *));
+	i = nftnl_rule_list_iter_create(rs->rule_list);
+	if (rules == NULL || i == NULL) {
+		xfree(rules);
+		if (i != NULL)
+			nftnl_rule_list_iter_destroy(i);
+		return -1;
 	}
-	nftnl_rule_list_iter_destroy(i);
 
-	return len;
-err:
+	ctx.num = 0;
+	while ((r = nftnl_rule_list_iter_next(i)) != NULL)
+		rules[ctx.num++] = r;
 	nftnl_rule_list_iter_destroy(i);
-	return -1;
-}
 
-#define NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len)	\
-	if (ret < 0)				\
-		return -1;			\
-	len += ret;
+	ret = nftnl_sink_parallel(sink, (void **)rules, ctx.num,
+				  nftnl_ruleset_output_rule, &ctx, nthreads);
+	xfree(rules);
+
+	return ret;
+}
 
-static int nftnl_ruleset_cmd_fprintf(FILE *fp, const struct nftnl_ruleset *rs,
-				   uint32_t cmd, uint32_t type, uint32_t flags)
+static int nftnl_ruleset_cmd_output(struct nftnl_sink *sink,
+				    const struct nftnl_ruleset *rs, uint32_t cmd,
+				    uint32_t type, uint32_t flags,
+				    unsigned int nthreads)
 {
-	int len = 0, ret = 0;
-	void *prev = NULL;
+	uint64_t total = sink->total;
 	uint32_t inner_flags = flags;
+	void *prev = NULL;
+	size_t size;
+	char *buf;
+	int ret;
 
 	/* dont pass events flags to child calls of _snprintf() */
 	inner_flags &= ~NFTNL_OF_EVENT_ANY;
 
-	ret = fprintf(fp, "%s", nftnl_ruleset_o_opentag(type));
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	if (nftnl_sink_printf(sink, "%s", nftnl_ruleset_o_opentag(type)) < 0)
+		return -1;
 
-	ret = nftnl_cmd_header_fprintf(fp, cmd, type, flags);
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	do {
+		buf = nftnl_sink_reserve(sink, &size);
+		if (buf == NULL)
+			return -1;
+		ret = nftnl_cmd_header_snprintf(buf, size, cmd, type, flags);
+	} while ((ret = nftnl_sink_commit(sink, ret)) > 0);
+	if (ret < 0)
+		return -1;
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_TABLELIST)) &&
 	    (!nftnl_table_list_is_empty(rs->table_list))) {
-		ret = nftnl_ruleset_fprintf_tables(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		if (nftnl_ruleset_output_tables(sink, rs, type, inner_flags) < 0)
+			return -1;
 
-		if (ret > 0)
-			prev = rs->table_list;
+		prev = rs->table_list;
 	}
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_CHAINLIST)) &&
 	    (!nftnl_chain_list_is_empty(rs->chain_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
-
-		ret = nftnl_ruleset_fprintf_chains(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(prev, type)) < 0 ||
+		    nftnl_ruleset_output_chains(sink, rs, type, inner_flags) < 0)
+			return -1;
 
-		if (ret > 0)
-			prev = rs->chain_list;
+		prev = rs->chain_list;
 	}
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_SETLIST)) &&
 	    (!nftnl_set_list_is_empty(rs->set_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
-
-		ret = nftnl_ruleset_fprintf_sets(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(prev, type)) < 0 ||
+		    nftnl_ruleset_output_sets(sink, rs, type, inner_flags,
+					      nthreads) < 0)
+			return -1;
 
-		if (ret > 0)
-			prev = rs->set_list;
+		prev = rs->set_list;
 	}
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_RULELIST)) &&
 	    (!nftnl_rule_list_is_empty(rs->rule_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
-
-		ret = nftnl_ruleset_fprintf_rules(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		if (nftnl_sink_printf(sink, "%s",
+				      nftnl_ruleset_o_separator(prev, type)) < 0 ||
+		    nftnl_ruleset_output_rules(sink, rs, type, inner_flags,
+					       nthreads) < 0)
+			return -1;
 	}
 
-	ret = nftnl_cmd_footer_fprintf(fp, cmd, type, flags);
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	do {
+		buf = nftnl_sink_reserve(sink, &size);
+		if (buf == NULL)
+			return -1;
+		ret = nftnl_cmd_footer_snprintf(buf, size, cmd, type, flags);
+	} while ((ret = nftnl_sink_commit(sink, ret)) > 0);
+	if (ret < 0)
+		return -1;
+
+	if (nftnl_sink_printf(sink, "%s", nftnl_ruleset_o_closetag(type)) < 0)
+		return -1;
 
-	ret = fprintf(fp, "%s", nftnl_ruleset_o_closetag(type));
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	return sink->total - total;
+}
+
+int nftnl_ruleset_output(struct nftnl_sink *sink,
+			 const struct nftnl_ruleset *rs, uint32_t type,
+			 uint32_t flags)
+{
+	return nftnl_ruleset_cmd_output(sink, rs, nftnl_flag2cmd(flags), type,
+					flags, 1);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_output);
 
-	return len;
+int nftnl_ruleset_output_parallel(struct nftnl_sink *sink,
+				  const struct nftnl_ruleset *rs,
+				  uint32_t type, uint32_t flags,
+				  unsigned int nthreads)
+{
+	return nftnl_ruleset_cmd_output(sink, rs, nftnl_flag2cmd(flags), type,
+					flags, nthreads);
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_output_parallel);
 
 int nftnl_ruleset_fprintf(FILE *fp, const struct nftnl_ruleset *rs, uint32_t type,
 			uint32_t flags)
 {
-	return nftnl_ruleset_cmd_fprintf(fp, rs, nftnl_flag2cmd(flags), type,
-				       flags);
+	char buf[NFTNL_SNPRINTF_BUFSIZ];
+	struct nftnl_sink sink;
+	int ret;
+
+	nftnl_sink_init_file(&sink, fp, buf, sizeof(buf));
+	ret = nftnl_ruleset_output(&sink, rs, type, flags);
+	if (nftnl_sink_release(&sink) < 0)
+		return -1;
+
+	return ret;
 }
 EXPORT_SYMBOL(nftnl_ruleset_fprintf, nft_ruleset_fprintf);
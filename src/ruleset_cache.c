@@ -0,0 +1,578 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+
+/*
+ * The kernel sends the events of a transaction followed by a NEWGEN message
+ * that carries the new generation ID. Events are kept aside until then, and
+ * applied only if that ID follows the one of the cached ruleset. Those of a
+ * transaction that the dump already reflects are dropped, a skipped ID
+ * means that events were lost and the cache needs to be dumped again.
+ */
+
+struct nftnl_cache_msg {
+	struct list_head	head;
+	struct nlmsghdr		nlh[];
+};
+
+struct nftnl_ruleset_cache {
+	struct nftnl_ruleset	*rs;
+	struct nftnl_table_list	*tables;
+	struct nftnl_chain_list	*chains;
+	struct nftnl_set_list	*sets;
+	struct nftnl_rule_list	*rules;
+
+	uint32_t		genid;
+	bool			synced;
+	struct list_head	pending;
+};
+
+static void nftnl_cache_pending_flush(struct nftnl_ruleset_cache *c)
+{
+	struct nftnl_cache_msg *msg, *tmp;
+
+	list_for_each_entry_safe(msg, tmp, &c->pending, head) {
+		list_del(&msg->head);
+		xfree(msg);
+	}
+}
+
+static int nftnl_cache_ruleset_alloc(struct nftnl_ruleset_cache *c)
+{
+	c->rs = nftnl_ruleset_alloc();
+	if (c->rs == NULL)
+		return -1;
+
+	c->tables = nftnl_table_list_alloc();
+	if (c->tables != NULL)
+		nftnl_ruleset_set(c->rs, NFTNL_RULESET_TABLELIST, c->tables);
+	c->chains = nftnl_chain_list_alloc();
+	if (c->chains != NULL)
+		nftnl_ruleset_set(c->rs, NFTNL_RULESET_CHAINLIST, c->chains);
+	c->sets = nftnl_set_list_alloc();
+	if (c->sets != NULL)
+		nftnl_ruleset_set(c->rs, NFTNL_RULESET_SETLIST, c->sets);
+	c->rules = nftnl_rule_list_alloc();
+	if (c->rules != NULL)
+		nftnl_ruleset_set(c->rs, NFTNL_RULESET_RULELIST, c->rules);
+
+	if (c->tables == NULL || c->chains == NULL || c->sets == NULL ||
+	    c->rules == NULL || nftnl_rule_list_index(c->rules) < 0) {
+		nftnl_ruleset_free(c->rs);
+		c->rs = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+struct nftnl_ruleset_cache *nftnl_ruleset_cache_alloc(void)
+{
+	struct nftnl_ruleset_cache *c;
+
+	c = calloc(1, sizeof(struct nftnl_ruleset_cache));
+	if (c == NULL)
+		return NULL;
+
+	INIT_LIST_HEAD(&c->pending);
+	if (nftnl_cache_ruleset_alloc(c) < 0) {
+		xfree(c);
+		return NULL;
+	}
+	return c;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_alloc);
+
+void nftnl_ruleset_cache_free(struct nftnl_ruleset_cache *c)
+{
+	nftnl_cache_pending_flush(c);
+	if (c->rs != NULL)
+		nftnl_ruleset_free(c->rs);
+	xfree(c);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_free);
+
+int nftnl_ruleset_cache_reset(struct nftnl_ruleset_cache *c)
+{
+	nftnl_cache_pending_flush(c);
+	if (c->rs != NULL)
+		nftnl_ruleset_free(c->rs);
+
+	c->synced = false;
+	c->genid = 0;
+
+	return nftnl_cache_ruleset_alloc(c);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_reset);
+
+const struct nftnl_ruleset *
+nftnl_ruleset_cache_ruleset(const struct nftnl_ruleset_cache *c)
+{
+	return c->rs;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_ruleset);
+
+bool nftnl_ruleset_cache_synced(const struct nftnl_ruleset_cache *c)
+{
+	return c->synced;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_synced);
+
+uint32_t nftnl_ruleset_cache_genid(const struct nftnl_ruleset_cache *c)
+{
+	return c->genid;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_genid);
+
+/*
+ * Tables
+ */
+
+static int nftnl_cache_table_del_rule_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_table *t = data;
+
+	if (nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY) !=
+	    nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY) ||
+	    !nftnl_str_equal(nftnl_rule_get_str(r, NFTNL_RULE_TABLE),
+			     nftnl_table_get_str(t, NFTNL_TABLE_NAME)))
+		return 0;
+
+	nftnl_rule_list_del(r);
+	nftnl_rule_free(r);
+	return 0;
+}
+
+static int nftnl_cache_table_del_chain_cb(struct nftnl_chain *ch, void *data)
+{
+	struct nftnl_table *t = data;
+
+	if (nftnl_chain_get_u32(ch, NFTNL_CHAIN_FAMILY) !=
+	    nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY) ||
+	    !nftnl_str_equal(nftnl_chain_get_str(ch, NFTNL_CHAIN_TABLE),
+			     nftnl_table_get_str(t, NFTNL_TABLE_NAME)))
+		return 0;
+
+	nftnl_chain_list_del(ch);
+	nftnl_chain_free(ch);
+	return 0;
+}
+
+static int nftnl_cache_table_del_set_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_table *t = data;
+
+	if (s->family != nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY) ||
+	    !nftnl_str_equal(s->table, nftnl_table_get_str(t, NFTNL_TABLE_NAME)))
+		return 0;
+
+	nftnl_set_list_del(s);
+	nftnl_set_free(s);
+	return 0;
+}
+
+static int nftnl_cache_table(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh, bool add)
+{
+	struct nftnl_table *t, *old;
+
+	t = nftnl_table_alloc();
+	if (t == NULL)
+		return -1;
+
+	if (nftnl_table_nlmsg_parse(nlh, t) < 0) {
+		nftnl_table_free(t);
+		return -1;
+	}
+
+	old = nftnl_table_list_lookup_byname(c->tables,
+			nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+			nftnl_table_get_str(t, NFTNL_TABLE_NAME));
+	if (old != NULL) {
+		nftnl_table_list_del(old);
+		/* objects of a deleted table go away with it */
+		if (!add) {
+			nftnl_rule_list_foreach(c->rules,
+					nftnl_cache_table_del_rule_cb, old);
+			nftnl_set_list_foreach(c->sets,
+					nftnl_cache_table_del_set_cb, old);
+			nftnl_chain_list_foreach(c->chains,
+					nftnl_cache_table_del_chain_cb, old);
+		}
+		nftnl_table_free(old);
+	}
+
+	if (add)
+		nftnl_table_list_add_tail(t, c->tables);
+	else
+		nftnl_table_free(t);
+
+	return 0;
+}
+
+/*
+ * Chains
+ */
+
+static int nftnl_cache_chain_del_rule_cb(struct nftnl_rule *r, void *data)
+{
+	nftnl_rule_list_del(r);
+	nftnl_rule_free(r);
+	return 0;
+}
+
+static int nftnl_cache_chain(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh, bool add)
+{
+	struct nftnl_chain *ch, *old;
+
+	ch = nftnl_chain_alloc();
+	if (ch == NULL)
+		return -1;
+
+	if (nftnl_chain_nlmsg_parse(nlh, ch) < 0) {
+		nftnl_chain_free(ch);
+		return -1;
+	}
+
+	old = nftnl_chain_list_lookup_byname(c->chains,
+			nftnl_chain_get_u32(ch, NFTNL_CHAIN_FAMILY),
+			nftnl_chain_get_str(ch, NFTNL_CHAIN_TABLE),
+			nftnl_chain_get_str(ch, NFTNL_CHAIN_NAME));
+	if (old != NULL) {
+		nftnl_chain_list_del(old);
+		if (!add) {
+			nftnl_rule_list_chain_foreach(c->rules,
+				nftnl_chain_get_u32(old, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(old, NFTNL_CHAIN_TABLE),
+				nftnl_chain_get_str(old, NFTNL_CHAIN_NAME),
+				nftnl_cache_chain_del_rule_cb, NULL);
+		}
+		nftnl_chain_free(old);
+	}
+
+	if (add)
+		nftnl_chain_list_add_tail(ch, c->chains);
+	else
+		nftnl_chain_free(ch);
+
+	return 0;
+}
+
+/*
+ * Rules
+ */
+
+static int nftnl_cache_rule(struct nftnl_ruleset_cache *c,
+			    const struct nlmsghdr *nlh, bool add, bool event)
+{
+	struct nftnl_rule *r, *old;
+
+	r = nftnl_rule_alloc();
+	if (r == NULL)
+		return -1;
+
+	if (nftnl_rule_nlmsg_parse(nlh, r) < 0 ||
+	    !nftnl_rule_is_set(r, NFTNL_RULE_HANDLE)) {
+		nftnl_rule_free(r);
+		return -1;
+	}
+
+	old = nftnl_rule_list_lookup_byhandle(c->rules,
+			nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+			nftnl_rule_get_str(r, NFTNL_RULE_TABLE),
+			nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE));
+
+	if (!add) {
+		if (old != NULL) {
+			nftnl_rule_list_del(old);
+			nftnl_rule_free(old);
+		}
+		nftnl_rule_free(r);
+		return 0;
+	}
+
+	/*
+	 * The position is the handle of the rule that comes before, a rule
+	 * without it is the first one in its chain. Dumps come in order.
+	 */
+	if (old != NULL) {
+		nftnl_rule_list_insert_after(r, c->rules,
+				nftnl_rule_get_u64(old, NFTNL_RULE_HANDLE));
+		nftnl_rule_list_del(old);
+		nftnl_rule_free(old);
+	} else if (!event) {
+		nftnl_rule_list_add_tail(r, c->rules);
+	} else if (!nftnl_rule_is_set(r, NFTNL_RULE_POSITION)) {
+		nftnl_rule_list_add(r, c->rules);
+	} else if (nftnl_rule_list_insert_after(r, c->rules,
+			nftnl_rule_get_u64(r, NFTNL_RULE_POSITION)) < 0) {
+		nftnl_rule_list_add_tail(r, c->rules);
+	}
+
+	return 0;
+}
+
+/*
+ * Sets and elements
+ */
+
+static int nftnl_cache_set(struct nftnl_ruleset_cache *c,
+			   const struct nlmsghdr *nlh, bool add)
+{
+	struct nftnl_set *s, *old;
+
+	s = nftnl_set_alloc();
+	if (s == NULL)
+		return -1;
+
+	if (nftnl_set_nlmsg_parse(nlh, s) < 0) {
+		nftnl_set_free(s);
+		return -1;
+	}
+
+	old = nftnl_set_list_lookup_byname(c->sets, s->family, s->table,
+					   s->name);
+	if (!add && old != NULL) {
+		nftnl_set_list_del(old);
+		nftnl_set_free(old);
+	}
+
+	/* sets cannot be updated, keep the elements we have */
+	if (add && old == NULL)
+		nftnl_set_list_add_tail(s, c->sets);
+	else
+		nftnl_set_free(s);
+
+	return 0;
+}
+
+/* Remove the elements of @s that have the key of an element in @keys. */
+static int nftnl_cache_elems_del(struct nftnl_set *s, struct nftnl_set *keys)
+{
+	struct nftnl_set_elem **slots, *elem, *tmp;
+	uint32_t num = 0, size = 16, mask, i;
+
+	list_for_each_entry(elem, &keys->element_list, head)
+		num++;
+
+	if (num == 0)
+		return 0;
+
+	while (size < num * 2)
+		size <<= 1;
+	mask = size - 1;
+
+	slots = calloc(size, sizeof(struct nftnl_set_elem *));
+	if (slots == NULL)
+		return -1;
+
+	list_for_each_entry(elem, &keys->element_list, head) {
+		i = nftnl_set_elem_hash(elem) & mask;
+		while (slots[i] != NULL)
+			i = (i + 1) & mask;
+		slots[i] = elem;
+	}
+
+	list_for_each_entry_safe(elem, tmp, &s->element_list, head) {
+		i = nftnl_set_elem_hash(elem) & mask;
+		while (slots[i] != NULL &&
+		       !nftnl_set_elem_key_equal(slots[i], elem))
+			i = (i + 1) & mask;
+
+		if (slots[i] != NULL) {
+			list_del(&elem->head);
+			nftnl_set_elem_free(elem);
+		}
+	}
+
+	xfree(slots);
+	return 0;
+}
+
+static int nftnl_cache_elems(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh, bool add, bool event)
+{
+	struct nftnl_set_elem *elem, *tmp;
+	struct nftnl_set *elems, *s;
+	int ret = -1;
+
+	elems = nftnl_set_alloc();
+	if (elems == NULL)
+		return -1;
+
+	if (nftnl_set_elems_nlmsg_parse(nlh, elems) < 0)
+		goto out;
+
+	s = nftnl_set_list_lookup_byname(c->sets, elems->family, elems->table,
+					 elems->name);
+	if (s == NULL) {
+		ret = 0;
+		goto out;
+	}
+
+	/* events may repeat what the dump already has, replace those */
+	if ((!add || event) && nftnl_cache_elems_del(s, elems) < 0)
+		goto out;
+
+	if (add) {
+		list_for_each_entry_safe(elem, tmp, &elems->element_list, head)
+			list_move_tail(&elem->head, &s->element_list);
+	}
+	ret = 0;
+out:
+	nftnl_set_free(elems);
+	return ret;
+}
+
+static int nftnl_cache_apply(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh, bool event)
+{
+	switch (NFNL_MSG_TYPE(nlh->nlmsg_type)) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		return nftnl_cache_table(c, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWTABLE);
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		return nftnl_cache_chain(c, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWCHAIN);
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		return nftnl_cache_rule(c, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWRULE,
+			event);
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+		return nftnl_cache_set(c, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWSET);
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		return nftnl_cache_elems(c, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWSETELEM,
+			event);
+	}
+	return 0;
+}
+
+static int nftnl_cache_genid(const struct nlmsghdr *nlh, uint32_t *genid)
+{
+	struct nftnl_gen *gen;
+	int ret = -1;
+
+	gen = nftnl_gen_alloc();
+	if (gen == NULL)
+		return -1;
+
+	if (nftnl_gen_nlmsg_parse(nlh, gen) == 0 &&
+	    nftnl_gen_is_set(gen, NFTNL_GEN_ID)) {
+		*genid = nftnl_gen_get_u32(gen, NFTNL_GEN_ID);
+		ret = 0;
+	} else {
+		errno = EINVAL;
+	}
+
+	nftnl_gen_free(gen);
+	return ret;
+}
+
+int nftnl_ruleset_cache_dump(struct nftnl_ruleset_cache *c,
+			     const struct nlmsghdr *nlh)
+{
+	if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+		return 0;
+
+	if (NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWGEN) {
+		if (nftnl_cache_genid(nlh, &c->genid) < 0)
+			return -1;
+
+		c->synced = true;
+		return 0;
+	}
+
+	return nftnl_cache_apply(c, nlh, false);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_dump);
+
+static int nftnl_cache_commit(struct nftnl_ruleset_cache *c, uint32_t genid)
+{
+	struct nftnl_cache_msg *msg, *tmp;
+	int ret = 0;
+
+	list_for_each_entry_safe(msg, tmp, &c->pending, head) {
+		if (ret == 0 && nftnl_cache_apply(c, msg->nlh, true) < 0)
+			ret = -1;
+
+		list_del(&msg->head);
+		xfree(msg);
+	}
+
+	/* a message we cannot apply leaves the cache out of sync */
+	if (ret < 0) {
+		c->synced = false;
+		return NFTNL_RULESET_CACHE_RESYNC;
+	}
+
+	c->genid = genid;
+	return 0;
+}
+
+int nftnl_ruleset_cache_event(struct nftnl_ruleset_cache *c,
+			      const struct nlmsghdr *nlh)
+{
+	struct nftnl_cache_msg *msg;
+	uint32_t genid;
+
+	if (!c->synced)
+		return NFTNL_RULESET_CACHE_RESYNC;
+
+	if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+		return 0;
+
+	if (NFNL_MSG_TYPE(nlh->nlmsg_type) != NFT_MSG_NEWGEN) {
+		msg = malloc(sizeof(struct nftnl_cache_msg) + nlh->nlmsg_len);
+		if (msg == NULL)
+			return -1;
+
+		memcpy(msg->nlh, nlh, nlh->nlmsg_len);
+		list_add_tail(&msg->head, &c->pending);
+		return 0;
+	}
+
+	if (nftnl_cache_genid(nlh, &genid) < 0)
+		return -1;
+
+	/* the dump already has this one */
+	if ((int32_t)(genid - c->genid) <= 0) {
+		nftnl_cache_pending_flush(c);
+		return 0;
+	}
+
+	if (genid != c->genid + 1) {
+		nftnl_cache_pending_flush(c);
+		c->synced = false;
+		return NFTNL_RULESET_CACHE_RESYNC;
+	}
+
+	return nftnl_cache_commit(c, genid);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_cache_event);
@@ -0,0 +1,1149 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
+
+/*
+ * Objects are matched by family, table and name, rules by fingerprint in
+ * the order they show up in their chain. The messages are put into the
+ * batch in this order, so that no object is referenced before it exists
+ * or removed while it is still in use:
+ *
+ *  1) new and updated tables
+ *  2) new and updated chains
+ *  3) new sets and their elements, element updates of the existing sets
+ *  4) rule removals, chains that go away or are replaced are flushed
+ *  5) replaced sets and base chains, deleted and created again
+ *  6) new rules, anonymous sets right before the rule that uses them
+ *  7) set removals
+ *  8) chain removals
+ *  9) table removals
+ *
+ * Base chains whose hook, priority, type or device change are replaced, as
+ * the kernel does not allow to update them. So are sets whose key or data
+ * definition changes, and the rules that refer to them.
+ */
+
+struct nftnl_diff_add {
+	struct nftnl_rule	*rule;
+	uint64_t		pos;	/* insert before this rule, zero appends */
+};
+
+struct nftnl_diff_index_entry {
+	struct nftnl_rule	*rule;
+	uint32_t		family;
+	const char		*table;
+	const char		*chain;
+	uint32_t		idx;	/* position in the list */
+};
+
+struct nftnl_diff_index {
+	struct nftnl_diff_index_entry	*rules;
+	uint32_t			num, size;
+};
+
+struct nftnl_diff {
+	struct nftnl_batch	*batch;
+	uint32_t		*seq;
+	int			msgs;
+
+	struct nftnl_table_list	*cur_tables, *want_tables;
+	struct nftnl_chain_list	*cur_chains, *want_chains;
+	struct nftnl_set_list	*cur_sets, *want_sets;
+	struct nftnl_rule_list	*cur_rules, *want_rules;
+	/* rules by chain, the lists are not indexed behind the caller's back */
+	struct nftnl_diff_index	*cur_index, *want_index;
+
+	/* current sets that are replaced */
+	struct nftnl_set	**replaced;
+	uint32_t		num_replaced;
+
+	/* rules to be added to the chains that are kept, step 6 */
+	struct nftnl_diff_add	*adds;
+	uint32_t		num_adds, size_adds;
+
+	char			*fp_buf;
+};
+
+enum {
+	NFTNL_DIFF_KEEP = 0,
+	NFTNL_DIFF_UPDATE,
+	NFTNL_DIFF_REPLACE,
+	NFTNL_DIFF_REMOVE,
+};
+
+static struct nlmsghdr *nftnl_diff_msg(struct nftnl_diff *d, uint16_t cmd,
+				       uint16_t family, uint16_t flags)
+{
+	return nftnl_nlmsg_build_hdr(nftnl_batch_buffer(d->batch), cmd,
+				     family, flags, (*d->seq)++);
+}
+
+static int nftnl_diff_msg_end(struct nftnl_diff *d)
+{
+	if (nftnl_batch_update(d->batch) < 0)
+		return -1;
+
+	d->msgs++;
+	return 0;
+}
+
+/*
+ * Tables
+ */
+
+static struct nftnl_table *nftnl_diff_table_peer(struct nftnl_table_list *l,
+						 struct nftnl_table *t)
+{
+	return nftnl_table_list_lookup_byname(l,
+			nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+			nftnl_table_get_str(t, NFTNL_TABLE_NAME));
+}
+
+static int nftnl_diff_table_add_cb(struct nftnl_table *t, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_table *cur;
+	struct nlmsghdr *nlh;
+	uint16_t flags = NLM_F_ACK;
+
+	cur = nftnl_diff_table_peer(d->cur_tables, t);
+	if (cur == NULL)
+		flags |= NLM_F_CREATE;
+	else if (nftnl_table_get_u32(cur, NFTNL_TABLE_FLAGS) ==
+		 nftnl_table_get_u32(t, NFTNL_TABLE_FLAGS))
+		return 0;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_NEWTABLE,
+			     nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY), flags);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_table_del_cb(struct nftnl_table *t, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nlmsghdr *nlh;
+
+	if (nftnl_diff_table_peer(d->want_tables, t) != NULL)
+		return 0;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_DELTABLE,
+			     nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+			     NLM_F_ACK);
+	mnl_attr_put_strz(nlh, NFTA_TABLE_NAME,
+			  nftnl_table_get_str(t, NFTNL_TABLE_NAME));
+
+	return nftnl_diff_msg_end(d);
+}
+
+/*
+ * Chains
+ */
+
+static struct nftnl_chain *nftnl_diff_chain_peer(struct nftnl_chain_list *l,
+						 struct nftnl_chain *c)
+{
+	return nftnl_chain_list_lookup_byname(l,
+			nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+			nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+			nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+}
+
+static bool nftnl_diff_chain_attr_equal(struct nftnl_chain *a,
+					struct nftnl_chain *b, uint16_t attr)
+{
+	if (nftnl_chain_is_set(a, attr) != nftnl_chain_is_set(b, attr))
+		return false;
+	if (!nftnl_chain_is_set(a, attr))
+		return true;
+
+	switch (attr) {
+	case NFTNL_CHAIN_TYPE:
+	case NFTNL_CHAIN_DEV:
+		return strcmp(nftnl_chain_get_str(a, attr),
+			      nftnl_chain_get_str(b, attr)) == 0;
+	default:
+		return nftnl_chain_get_u32(a, attr) ==
+		       nftnl_chain_get_u32(b, attr);
+	}
+}
+
+static int nftnl_diff_chain_state(struct nftnl_chain *cur,
+				  struct nftnl_chain *want)
+{
+	if (want == NULL)
+		return NFTNL_DIFF_REMOVE;
+
+	if (!nftnl_diff_chain_attr_equal(cur, want, NFTNL_CHAIN_HOOKNUM) ||
+	    !nftnl_diff_chain_attr_equal(cur, want, NFTNL_CHAIN_PRIO) ||
+	    !nftnl_diff_chain_attr_equal(cur, want, NFTNL_CHAIN_TYPE) ||
+	    !nftnl_diff_chain_attr_equal(cur, want, NFTNL_CHAIN_DEV))
+		return NFTNL_DIFF_REPLACE;
+
+	if (nftnl_chain_is_set(want, NFTNL_CHAIN_POLICY) &&
+	    !nftnl_diff_chain_attr_equal(cur, want, NFTNL_CHAIN_POLICY))
+		return NFTNL_DIFF_UPDATE;
+
+	return NFTNL_DIFF_KEEP;
+}
+
+/* Like nftnl_chain_nlmsg_build_payload(), without handle and counters. */
+static int nftnl_diff_chain_new(struct nftnl_diff *d, struct nftnl_chain *c,
+				bool update)
+{
+	struct nlmsghdr *nlh;
+	struct nlattr *nest;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_NEWCHAIN,
+			     nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+			     update ? NLM_F_ACK : NLM_F_CREATE | NLM_F_ACK);
+	mnl_attr_put_strz(nlh, NFTA_CHAIN_TABLE,
+			  nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE));
+	mnl_attr_put_strz(nlh, NFTA_CHAIN_NAME,
+			  nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+
+	if (!update && nftnl_chain_is_set(c, NFTNL_CHAIN_HOOKNUM) &&
+	    nftnl_chain_is_set(c, NFTNL_CHAIN_PRIO)) {
+		nest = mnl_attr_nest_start(nlh, NFTA_CHAIN_HOOK);
+		mnl_attr_put_u32(nlh, NFTA_HOOK_HOOKNUM,
+			htonl(nftnl_chain_get_u32(c, NFTNL_CHAIN_HOOKNUM)));
+		mnl_attr_put_u32(nlh, NFTA_HOOK_PRIORITY,
+			htonl(nftnl_chain_get_s32(c, NFTNL_CHAIN_PRIO)));
+		if (nftnl_chain_is_set(c, NFTNL_CHAIN_DEV))
+			mnl_attr_put_strz(nlh, NFTA_HOOK_DEV,
+				nftnl_chain_get_str(c, NFTNL_CHAIN_DEV));
+		mnl_attr_nest_end(nlh, nest);
+	}
+	if (nftnl_chain_is_set(c, NFTNL_CHAIN_POLICY))
+		mnl_attr_put_u32(nlh, NFTA_CHAIN_POLICY,
+			htonl(nftnl_chain_get_u32(c, NFTNL_CHAIN_POLICY)));
+	if (!update && nftnl_chain_is_set(c, NFTNL_CHAIN_TYPE))
+		mnl_attr_put_strz(nlh, NFTA_CHAIN_TYPE,
+				  nftnl_chain_get_str(c, NFTNL_CHAIN_TYPE));
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_chain_del(struct nftnl_diff *d, struct nftnl_chain *c,
+				uint16_t cmd)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_diff_msg(d, cmd, nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+			     NLM_F_ACK);
+	/* NFTA_RULE_TABLE and NFTA_CHAIN_TABLE have the same value */
+	mnl_attr_put_strz(nlh, NFTA_CHAIN_TABLE,
+			  nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE));
+	mnl_attr_put_strz(nlh, cmd == NFT_MSG_DELRULE ? NFTA_RULE_CHAIN :
+							NFTA_CHAIN_NAME,
+			  nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_chain_add_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_chain *cur;
+
+	cur = nftnl_diff_chain_peer(d->cur_chains, c);
+	if (cur == NULL)
+		return nftnl_diff_chain_new(d, c, false);
+
+	if (nftnl_diff_chain_state(cur, c) == NFTNL_DIFF_UPDATE)
+		return nftnl_diff_chain_new(d, c, true);
+
+	return 0;
+}
+
+static int nftnl_diff_chain_replace_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_chain *want;
+
+	want = nftnl_diff_chain_peer(d->want_chains, c);
+	if (nftnl_diff_chain_state(c, want) != NFTNL_DIFF_REPLACE)
+		return 0;
+
+	if (nftnl_diff_chain_del(d, c, NFT_MSG_DELCHAIN) < 0)
+		return -1;
+
+	return nftnl_diff_chain_new(d, want, false);
+}
+
+static int nftnl_diff_chain_del_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_diff *d = data;
+
+	if (nftnl_diff_chain_peer(d->want_chains, c) != NULL)
+		return 0;
+
+	return nftnl_diff_chain_del(d, c, NFT_MSG_DELCHAIN);
+}
+
+/*
+ * Sets
+ */
+
+static bool nftnl_diff_set_anonymous(const struct nftnl_set *s)
+{
+	return s->flags & (1 << NFTNL_SET_FLAGS) &&
+	       s->set_flags & NFT_SET_ANONYMOUS;
+}
+
+static struct nftnl_set *nftnl_diff_set_peer(struct nftnl_set_list *l,
+					     struct nftnl_set *s)
+{
+	return nftnl_set_list_lookup_byname(l, s->family, s->table, s->name);
+}
+
+static bool nftnl_diff_set_equal(const struct nftnl_set *a,
+				 const struct nftnl_set *b)
+{
+	return a->set_flags == b->set_flags &&
+	       a->key_type == b->key_type && a->key_len == b->key_len &&
+	       a->data_type == b->data_type && a->data_len == b->data_len &&
+	       a->timeout == b->timeout;
+}
+
+static bool nftnl_diff_set_empty(const struct nftnl_set *s)
+{
+	return list_empty(&s->element_list);
+}
+
+static int nftnl_diff_set_new(struct nftnl_diff *d, struct nftnl_set *s)
+{
+	struct nlmsghdr *nlh;
+	int ret;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_NEWSET, s->family,
+			     NLM_F_CREATE | NLM_F_ACK);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+	if (nftnl_diff_msg_end(d) < 0)
+		return -1;
+
+	if (nftnl_diff_set_empty(s))
+		return 0;
+
+	ret = nftnl_set_elems_batch_build(d->batch, s, NFT_MSG_NEWSETELEM,
+					  NLM_F_CREATE | NLM_F_ACK, d->seq, 1);
+	if (ret < 0)
+		return -1;
+
+	d->msgs += ret;
+	return 0;
+}
+
+static int nftnl_diff_set_del(struct nftnl_diff *d, struct nftnl_set *s)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_DELSET, s->family, NLM_F_ACK);
+	mnl_attr_put_strz(nlh, NFTA_SET_TABLE, s->table);
+	mnl_attr_put_strz(nlh, NFTA_SET_NAME, s->name);
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_set_add_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_set *cur;
+	int ret;
+
+	if (nftnl_diff_set_anonymous(s))
+		return 0;
+
+	cur = nftnl_diff_set_peer(d->cur_sets, s);
+	if (cur == NULL)
+		return nftnl_diff_set_new(d, s);
+	if (!nftnl_diff_set_equal(cur, s))
+		return 0;
+
+	ret = nftnl_set_elems_batch_diff(d->batch, cur, s, d->seq);
+	if (ret < 0)
+		return -1;
+
+	d->msgs += ret;
+	return 0;
+}
+
+static int nftnl_diff_set_replaced_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_set *want;
+
+	if (nftnl_diff_set_anonymous(s))
+		return 0;
+
+	want = nftnl_diff_set_peer(d->want_sets, s);
+	if (want != NULL && !nftnl_diff_set_equal(s, want))
+		d->replaced[d->num_replaced++] = s;
+
+	return 0;
+}
+
+static int nftnl_diff_set_del_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_diff *d = data;
+
+	if (nftnl_diff_set_anonymous(s) ||
+	    nftnl_diff_set_peer(d->want_sets, s) != NULL)
+		return 0;
+
+	return nftnl_diff_set_del(d, s);
+}
+
+/*
+ * Rules
+ */
+
+static int nftnl_diff_strcmp(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a != NULL) - (b != NULL);
+
+	return strcmp(a, b);
+}
+
+static int nftnl_diff_index_cmp(const void *a, const void *b)
+{
+	const struct nftnl_diff_index_entry *ea = a, *eb = b;
+	int ret;
+
+	if (ea->family != eb->family)
+		return ea->family < eb->family ? -1 : 1;
+	ret = nftnl_diff_strcmp(ea->table, eb->table);
+	if (ret != 0)
+		return ret;
+	ret = nftnl_diff_strcmp(ea->chain, eb->chain);
+	if (ret != 0)
+		return ret;
+	if (ea->idx != eb->idx)
+		return ea->idx < eb->idx ? -1 : 1;
+
+	return 0;
+}
+
+static int nftnl_diff_index_add_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_diff_index *index = data;
+	struct nftnl_diff_index_entry *e;
+
+	if (index->num == index->size) {
+		index->size = index->size ? index->size * 2 : 64;
+		e = realloc(index->rules,
+			    index->size * sizeof(struct nftnl_diff_index_entry));
+		if (e == NULL)
+			return -1;
+		index->rules = e;
+	}
+	e = &index->rules[index->num];
+	e->rule = r;
+	e->family = nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY);
+	e->table = nftnl_rule_get_str(r, NFTNL_RULE_TABLE);
+	e->chain = nftnl_rule_get_str(r, NFTNL_RULE_CHAIN);
+	e->idx = index->num++;
+
+	return 0;
+}
+
+static struct nftnl_diff_index *
+nftnl_diff_index_alloc(struct nftnl_rule_list *list)
+{
+	struct nftnl_diff_index *index;
+
+	index = calloc(1, sizeof(struct nftnl_diff_index));
+	if (index == NULL)
+		return NULL;
+
+	if (nftnl_rule_list_foreach(list, nftnl_diff_index_add_cb, index) < 0) {
+		xfree(index->rules);
+		xfree(index);
+		return NULL;
+	}
+	qsort(index->rules, index->num, sizeof(struct nftnl_diff_index_entry),
+	      nftnl_diff_index_cmp);
+
+	return index;
+}
+
+static void nftnl_diff_index_free(struct nftnl_diff_index *index)
+{
+	xfree(index->rules);
+	xfree(index);
+}
+
+/* Like nftnl_rule_list_chain_foreach(), on the sorted rules. */
+static int nftnl_diff_index_foreach(struct nftnl_diff_index *index,
+				    struct nftnl_chain *c,
+				    int (*cb)(struct nftnl_rule *r, void *data),
+				    void *data)
+{
+	struct nftnl_diff_index_entry key = {
+		.family	= nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+		.table	= nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+		.chain	= nftnl_chain_get_str(c, NFTNL_CHAIN_NAME),
+	};
+	uint32_t lo = 0, hi = index->num, mid;
+	int ret;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (nftnl_diff_index_cmp(&index->rules[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < index->num; lo++) {
+		key.idx = index->rules[lo].idx;
+		if (nftnl_diff_index_cmp(&index->rules[lo], &key) != 0)
+			break;
+
+		ret = cb(index->rules[lo].rule, data);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+struct nftnl_diff_rule {
+	struct nftnl_rule	*rule;
+	uint64_t		fp[2];
+	uint32_t		idx;
+	bool			forced;	/* refers to a replaced set */
+	bool			matched;
+	struct nftnl_rule	*peer;
+};
+
+struct nftnl_diff_rules {
+	struct nftnl_diff	*d;
+	/* to tell anonymous sets by what is in them */
+	struct nftnl_set_list	*sets;
+	struct nftnl_diff_rule	*rules;
+	uint32_t		num, size;
+};
+
+struct nftnl_diff_set_ref {
+	struct nftnl_diff	*d;
+	struct nftnl_rule	*rule;
+	bool			found;
+};
+
+static bool nftnl_diff_set_replaced(struct nftnl_diff *d, uint32_t family,
+				    const char *table, const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < d->num_replaced; i++) {
+		if (d->replaced[i]->family == family &&
+		    nftnl_str_equal(d->replaced[i]->table, table) &&
+		    nftnl_str_equal(d->replaced[i]->name, name))
+			return true;
+	}
+	return false;
+}
+
+static const char *nftnl_diff_expr_set(struct nftnl_expr *e)
+{
+	if (strcmp(e->ops->name, "lookup") == 0)
+		return nftnl_expr_get_str(e, NFTNL_EXPR_LOOKUP_SET);
+	if (strcmp(e->ops->name, "dynset") == 0)
+		return nftnl_expr_get_str(e, NFTNL_EXPR_DYNSET_SET_NAME);
+
+	return NULL;
+}
+
+static int nftnl_diff_set_ref_cb(struct nftnl_expr *e, void *data)
+{
+	struct nftnl_diff_set_ref *ref = data;
+	const char *name = nftnl_diff_expr_set(e);
+
+	if (name != NULL &&
+	    nftnl_diff_set_replaced(ref->d,
+			nftnl_rule_get_u32(ref->rule, NFTNL_RULE_FAMILY),
+			nftnl_rule_get_str(ref->rule, NFTNL_RULE_TABLE), name))
+		ref->found = true;
+
+	return 0;
+}
+
+static int nftnl_diff_rules_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_diff_rules *rules = data;
+	struct nftnl_diff_set_ref ref = {
+		.d	= rules->d,
+		.rule	= r,
+	};
+	struct nftnl_diff_rule *dr;
+
+	if (rules->num == rules->size) {
+		rules->size = rules->size ? rules->size * 2 : 16;
+		dr = realloc(rules->rules,
+			     rules->size * sizeof(struct nftnl_diff_rule));
+		if (dr == NULL)
+			return -1;
+		rules->rules = dr;
+	}
+	dr = &rules->rules[rules->num];
+	memset(dr, 0, sizeof(*dr));
+	dr->rule = r;
+	dr->idx = rules->num++;
+
+	if (rules->d->num_replaced > 0) {
+		nftnl_expr_foreach(r, nftnl_diff_set_ref_cb, &ref);
+		dr->forced = ref.found;
+	}
+
+	return nftnl_rule_fingerprint_buf(r, rules->d->fp_buf, dr->fp,
+					  rules->sets);
+}
+
+static int nftnl_diff_rules_get(struct nftnl_diff *d,
+				struct nftnl_diff_index *index,
+				struct nftnl_set_list *sets,
+				struct nftnl_chain *c,
+				struct nftnl_diff_rules *rules)
+{
+	memset(rules, 0, sizeof(*rules));
+	rules->d = d;
+	rules->sets = sets;
+
+	return nftnl_diff_index_foreach(index, c, nftnl_diff_rules_cb, rules);
+}
+
+static int nftnl_diff_rule_cmp(const void *a, const void *b)
+{
+	const struct nftnl_diff_rule *ra = a, *rb = b;
+
+	if (ra->fp[0] != rb->fp[0])
+		return ra->fp[0] < rb->fp[0] ? -1 : 1;
+	if (ra->fp[1] != rb->fp[1])
+		return ra->fp[1] < rb->fp[1] ? -1 : 1;
+	if (ra->idx != rb->idx)
+		return ra->idx < rb->idx ? -1 : 1;
+
+	return 0;
+}
+
+/* First entry of the sorted array with this fingerprint, if any. */
+static int nftnl_diff_rule_find(const struct nftnl_diff_rule *sorted,
+				uint32_t num, const uint64_t fp[2])
+{
+	struct nftnl_diff_rule key = { .fp = { fp[0], fp[1] } };
+	uint32_t lo = 0, hi = num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (nftnl_diff_rule_cmp(&sorted[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == num || sorted[lo].fp[0] != fp[0] || sorted[lo].fp[1] != fp[1])
+		return -1;
+
+	return lo;
+}
+
+static void nftnl_diff_rule_pair(struct nftnl_diff_rule *cur,
+				 struct nftnl_diff_rule *want)
+{
+	cur->matched = true;
+	want->matched = true;
+	want->peer = cur->rule;
+}
+
+static bool nftnl_diff_rule_same(const struct nftnl_diff_rule *a,
+				 const struct nftnl_diff_rule *b)
+{
+	return !a->forced && !b->forced &&
+	       a->fp[0] == b->fp[0] && a->fp[1] == b->fp[1];
+}
+
+/* One match of the longest common subsequence, and the one before it. */
+struct nftnl_diff_lcs_node {
+	uint32_t	cur, want;
+	int32_t		prev;
+};
+
+/*
+ * Match the rules of both versions of a chain keeping their relative order,
+ * as many as possible so that the fewest rules are deleted and added again.
+ * The longest common subsequence of the fingerprints is found with the
+ * Hunt-Szymanski algorithm: for each desired rule, the current rules with
+ * the same fingerprint are walked backwards and extend the shortest
+ * subsequence that ends at a later rule. That is one node per pair of
+ * equal rules, so the common head and tail are matched up front.
+ */
+static int nftnl_diff_rules_match(struct nftnl_diff_rules *cur,
+				  struct nftnl_diff_rules *want)
+{
+	uint32_t head = 0, cur_end = cur->num, want_end = want->num;
+	uint32_t i, j, k, num, len = 0, lo, hi, mid, num_nodes = 0;
+	struct nftnl_diff_lcs_node *nodes = NULL, *node;
+	uint32_t size_nodes = 0, *thresh = NULL;
+	struct nftnl_diff_rule *sorted;
+	int32_t *link = NULL, n;
+	int g, ret = -1;
+
+	while (head < cur_end && head < want_end &&
+	       nftnl_diff_rule_same(&cur->rules[head], &want->rules[head])) {
+		nftnl_diff_rule_pair(&cur->rules[head], &want->rules[head]);
+		head++;
+	}
+	while (cur_end > head && want_end > head &&
+	       nftnl_diff_rule_same(&cur->rules[cur_end - 1],
+				    &want->rules[want_end - 1])) {
+		nftnl_diff_rule_pair(&cur->rules[cur_end - 1],
+				     &want->rules[want_end - 1]);
+		cur_end--;
+		want_end--;
+	}
+	if (head == cur_end || head == want_end)
+		return 0;
+
+	sorted = calloc(cur_end - head, sizeof(struct nftnl_diff_rule));
+	thresh = calloc(cur_end - head, sizeof(uint32_t));
+	link = calloc(cur_end - head, sizeof(int32_t));
+	if (sorted == NULL || thresh == NULL || link == NULL)
+		goto out;
+
+	num = 0;
+	for (i = head; i < cur_end; i++) {
+		if (!cur->rules[i].forced)
+			sorted[num++] = cur->rules[i];
+	}
+	qsort(sorted, num, sizeof(struct nftnl_diff_rule), nftnl_diff_rule_cmp);
+
+	for (i = head; i < want_end; i++) {
+		if (want->rules[i].forced)
+			continue;
+
+		g = nftnl_diff_rule_find(sorted, num, want->rules[i].fp);
+		if (g < 0)
+			continue;
+
+		for (k = g; k < num && sorted[k].fp[0] == want->rules[i].fp[0] &&
+			    sorted[k].fp[1] == want->rules[i].fp[1]; k++)
+			;
+
+		while (k-- > (uint32_t)g) {
+			j = sorted[k].idx;
+
+			/* first subsequence that ends at or after this rule */
+			lo = 0;
+			hi = len;
+			while (lo < hi) {
+				mid = lo + (hi - lo) / 2;
+				if (thresh[mid] < j)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo < len && thresh[lo] == j)
+				continue;
+
+			if (num_nodes == size_nodes) {
+				size_nodes = size_nodes ? size_nodes * 2 : 64;
+				node = realloc(nodes, size_nodes *
+					       sizeof(struct nftnl_diff_lcs_node));
+				if (node == NULL)
+					goto out;
+				nodes = node;
+			}
+			node = &nodes[num_nodes];
+			node->cur = j;
+			node->want = i;
+			node->prev = lo > 0 ? link[lo - 1] : -1;
+
+			thresh[lo] = j;
+			link[lo] = num_nodes++;
+			if (lo == len)
+				len++;
+		}
+	}
+
+	for (n = len > 0 ? link[len - 1] : -1; n >= 0; n = nodes[n].prev)
+		nftnl_diff_rule_pair(&cur->rules[nodes[n].cur],
+				     &want->rules[nodes[n].want]);
+	ret = 0;
+out:
+	xfree(sorted);
+	xfree(thresh);
+	xfree(link);
+	xfree(nodes);
+	return ret;
+}
+
+static int nftnl_diff_rule_del(struct nftnl_diff *d, struct nftnl_rule *r)
+{
+	struct nlmsghdr *nlh;
+
+	if (!nftnl_rule_is_set(r, NFTNL_RULE_HANDLE)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_DELRULE,
+			     nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+			     NLM_F_ACK);
+	mnl_attr_put_strz(nlh, NFTA_RULE_TABLE,
+			  nftnl_rule_get_str(r, NFTNL_RULE_TABLE));
+	mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN,
+			  nftnl_rule_get_str(r, NFTNL_RULE_CHAIN));
+	mnl_attr_put_u64(nlh, NFTA_RULE_HANDLE,
+			 htobe64(nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE)));
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_add_push(struct nftnl_diff *d, struct nftnl_rule *r,
+			       uint64_t pos)
+{
+	struct nftnl_diff_add *adds;
+
+	if (d->num_adds == d->size_adds) {
+		d->size_adds = d->size_adds ? d->size_adds * 2 : 64;
+		adds = realloc(d->adds,
+			       d->size_adds * sizeof(struct nftnl_diff_add));
+		if (adds == NULL)
+			return -1;
+		d->adds = adds;
+	}
+	d->adds[d->num_adds].rule = r;
+	d->adds[d->num_adds].pos = pos;
+	d->num_adds++;
+
+	return 0;
+}
+
+/* Step 4 for a chain that is kept, and queue its new rules for step 6. */
+static int nftnl_diff_chain_rules(struct nftnl_diff *d, struct nftnl_chain *c,
+				  struct nftnl_chain *want)
+{
+	struct nftnl_diff_rules cur_rules = {}, want_rules = {};
+	uint64_t pos = 0;
+	uint32_t i, j;
+	int ret = -1;
+
+	if (nftnl_diff_rules_get(d, d->cur_index, d->cur_sets, c,
+				 &cur_rules) < 0 ||
+	    nftnl_diff_rules_get(d, d->want_index, d->want_sets, want,
+				 &want_rules) < 0 ||
+	    nftnl_diff_rules_match(&cur_rules, &want_rules) < 0)
+		goto out;
+
+	for (i = 0; i < cur_rules.num; i++) {
+		if (!cur_rules.rules[i].matched &&
+		    nftnl_diff_rule_del(d, cur_rules.rules[i].rule) < 0)
+			goto out;
+	}
+
+	for (i = 0; i < want_rules.num; i++) {
+		if (want_rules.rules[i].matched)
+			continue;
+
+		/*
+		 * New rules go before the next rule that stays, if any. That
+		 * is the same for all of a run of new rules, look it up once.
+		 */
+		if (i == 0 || want_rules.rules[i - 1].matched) {
+			pos = 0;
+			for (j = i + 1; j < want_rules.num; j++) {
+				if (want_rules.rules[j].matched) {
+					pos = nftnl_rule_get_u64(
+						want_rules.rules[j].peer,
+						NFTNL_RULE_HANDLE);
+					break;
+				}
+			}
+		}
+		if (nftnl_diff_add_push(d, want_rules.rules[i].rule, pos) < 0)
+			goto out;
+	}
+	ret = 0;
+out:
+	xfree(cur_rules.rules);
+	xfree(want_rules.rules);
+	return ret;
+}
+
+static int nftnl_diff_rule_del_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_chain *want;
+
+	want = nftnl_diff_chain_peer(d->want_chains, c);
+	switch (nftnl_diff_chain_state(c, want)) {
+	case NFTNL_DIFF_REMOVE:
+	case NFTNL_DIFF_REPLACE:
+		return nftnl_diff_chain_del(d, c, NFT_MSG_DELRULE);
+	default:
+		return nftnl_diff_chain_rules(d, c, want);
+	}
+}
+
+static int nftnl_diff_anon_set_cb(struct nftnl_expr *e, void *data)
+{
+	struct nftnl_diff_set_ref *ref = data;
+	const char *name = nftnl_diff_expr_set(e);
+	struct nftnl_set *s;
+
+	if (name == NULL)
+		return 0;
+
+	s = nftnl_set_list_lookup_byname(ref->d->want_sets,
+			nftnl_rule_get_u32(ref->rule, NFTNL_RULE_FAMILY),
+			nftnl_rule_get_str(ref->rule, NFTNL_RULE_TABLE), name);
+	if (s == NULL || !nftnl_diff_set_anonymous(s))
+		return 0;
+
+	return nftnl_diff_set_new(ref->d, s);
+}
+
+/* Like nftnl_rule_nlmsg_build_payload(), but with our own position. */
+static int nftnl_diff_rule_expr_cb(struct nftnl_expr *e, void *data)
+{
+	struct nlmsghdr *nlh = data;
+	struct nlattr *nest;
+
+	nest = mnl_attr_nest_start(nlh, NFTA_LIST_ELEM);
+	nftnl_expr_build_payload(nlh, e);
+	mnl_attr_nest_end(nlh, nest);
+
+	return 0;
+}
+
+static int nftnl_diff_rule_new(struct nftnl_diff *d, struct nftnl_rule *r,
+			       uint64_t pos)
+{
+	struct nftnl_diff_set_ref ref = {
+		.d	= d,
+		.rule	= r,
+	};
+	struct nlmsghdr *nlh;
+	struct nlattr *nest;
+	const void *udata;
+	uint32_t len;
+
+	if (nftnl_expr_foreach(r, nftnl_diff_anon_set_cb, &ref) < 0)
+		return -1;
+
+	nlh = nftnl_diff_msg(d, NFT_MSG_NEWRULE,
+			     nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+			     pos ? NLM_F_CREATE | NLM_F_ACK :
+				   NLM_F_CREATE | NLM_F_APPEND | NLM_F_ACK);
+	mnl_attr_put_strz(nlh, NFTA_RULE_TABLE,
+			  nftnl_rule_get_str(r, NFTNL_RULE_TABLE));
+	mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN,
+			  nftnl_rule_get_str(r, NFTNL_RULE_CHAIN));
+	if (pos)
+		mnl_attr_put_u64(nlh, NFTA_RULE_POSITION, htobe64(pos));
+	if (nftnl_rule_is_set(r, NFTNL_RULE_USERDATA)) {
+		udata = nftnl_rule_get_data(r, NFTNL_RULE_USERDATA, &len);
+		mnl_attr_put(nlh, NFTA_RULE_USERDATA, len, udata);
+	}
+
+	nest = mnl_attr_nest_start(nlh, NFTA_RULE_EXPRESSIONS);
+	nftnl_expr_foreach(r, nftnl_diff_rule_expr_cb, nlh);
+	mnl_attr_nest_end(nlh, nest);
+
+	if (nftnl_rule_is_set(r, NFTNL_RULE_COMPAT_PROTO) &&
+	    nftnl_rule_is_set(r, NFTNL_RULE_COMPAT_FLAGS)) {
+		nest = mnl_attr_nest_start(nlh, NFTA_RULE_COMPAT);
+		mnl_attr_put_u32(nlh, NFTA_RULE_COMPAT_PROTO,
+			htonl(nftnl_rule_get_u32(r, NFTNL_RULE_COMPAT_PROTO)));
+		mnl_attr_put_u32(nlh, NFTA_RULE_COMPAT_FLAGS,
+			htonl(nftnl_rule_get_u32(r, NFTNL_RULE_COMPAT_FLAGS)));
+		mnl_attr_nest_end(nlh, nest);
+	}
+
+	return nftnl_diff_msg_end(d);
+}
+
+static int nftnl_diff_rule_append_cb(struct nftnl_rule *r, void *data)
+{
+	return nftnl_diff_rule_new(data, r, 0);
+}
+
+/* Step 6 for the chains that are new or replaced. */
+static int nftnl_diff_rule_add_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_diff *d = data;
+	struct nftnl_chain *cur;
+
+	cur = nftnl_diff_chain_peer(d->cur_chains, c);
+	if (cur != NULL && nftnl_diff_chain_state(cur, c) != NFTNL_DIFF_REPLACE)
+		return 0;
+
+	return nftnl_diff_index_foreach(d->want_index, c,
+					nftnl_diff_rule_append_cb, d);
+}
+
+static int nftnl_diff_set_replace(struct nftnl_diff *d)
+{
+	struct nftnl_set *want;
+	uint32_t i;
+
+	for (i = 0; i < d->num_replaced; i++) {
+		want = nftnl_diff_set_peer(d->want_sets, d->replaced[i]);
+		if (nftnl_diff_set_del(d, d->replaced[i]) < 0 ||
+		    nftnl_diff_set_new(d, want) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int nftnl_diff_run(struct nftnl_diff *d)
+{
+	uint32_t i;
+
+	/* 1) and 2) */
+	if (nftnl_table_list_foreach(d->want_tables,
+				     nftnl_diff_table_add_cb, d) < 0 ||
+	    nftnl_chain_list_foreach(d->want_chains,
+				     nftnl_diff_chain_add_cb, d) < 0)
+		return -1;
+
+	/* 3) */
+	if (nftnl_set_list_foreach(d->cur_sets,
+				   nftnl_diff_set_replaced_cb, d) < 0 ||
+	    nftnl_set_list_foreach(d->want_sets, nftnl_diff_set_add_cb, d) < 0)
+		return -1;
+
+	/* 4) */
+	if (nftnl_chain_list_foreach(d->cur_chains,
+				     nftnl_diff_rule_del_cb, d) < 0)
+		return -1;
+
+	/* 5) */
+	if (nftnl_diff_set_replace(d) < 0 ||
+	    nftnl_chain_list_foreach(d->cur_chains,
+				     nftnl_diff_chain_replace_cb, d) < 0)
+		return -1;
+
+	/* 6) */
+	if (nftnl_chain_list_foreach(d->want_chains,
+				     nftnl_diff_rule_add_cb, d) < 0)
+		return -1;
+	for (i = 0; i < d->num_adds; i++) {
+		if (nftnl_diff_rule_new(d, d->adds[i].rule, d->adds[i].pos) < 0)
+			return -1;
+	}
+
+	/* 7), 8) and 9) */
+	if (nftnl_set_list_foreach(d->cur_sets, nftnl_diff_set_del_cb, d) < 0 ||
+	    nftnl_chain_list_foreach(d->cur_chains,
+				     nftnl_diff_chain_del_cb, d) < 0 ||
+	    nftnl_table_list_foreach(d->cur_tables,
+				     nftnl_diff_table_del_cb, d) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void *nftnl_diff_list(struct nftnl_ruleset *rs, uint16_t attr,
+			     void *empty)
+{
+	void *list = nftnl_ruleset_get(rs, attr);
+
+	return list != NULL ? list : empty;
+}
+
+static int nftnl_set_count_cb(struct nftnl_set *s, void *data)
+{
+	(*(uint32_t *)data)++;
+	return 0;
+}
+
+int nftnl_ruleset_diff(struct nftnl_batch *batch, struct nftnl_ruleset *cur,
+		       struct nftnl_ruleset *want, uint32_t *seq)
+{
+	struct nftnl_table_list *tables;
+	struct nftnl_chain_list *chains;
+	struct nftnl_set_list *sets;
+	struct nftnl_rule_list *rules;
+	struct nftnl_diff d = {
+		.batch	= batch,
+		.seq	= seq,
+	};
+	uint32_t num_sets = 0;
+	int ret = -1;
+
+	/* Lists that are missing in either ruleset are taken as empty. */
+	tables = nftnl_table_list_alloc();
+	chains = nftnl_chain_list_alloc();
+	sets = nftnl_set_list_alloc();
+	rules = nftnl_rule_list_alloc();
+	if (tables == NULL || chains == NULL || sets == NULL ||
+	    rules == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	d.cur_tables = nftnl_diff_list(cur, NFTNL_RULESET_TABLELIST, tables);
+	d.want_tables = nftnl_diff_list(want, NFTNL_RULESET_TABLELIST, tables);
+	d.cur_chains = nftnl_diff_list(cur, NFTNL_RULESET_CHAINLIST, chains);
+	d.want_chains = nftnl_diff_list(want, NFTNL_RULESET_CHAINLIST, chains);
+	d.cur_sets = nftnl_diff_list(cur, NFTNL_RULESET_SETLIST, sets);
+	d.want_sets = nftnl_diff_list(want, NFTNL_RULESET_SETLIST, sets);
+	d.cur_rules = nftnl_diff_list(cur, NFTNL_RULESET_RULELIST, rules);
+	d.want_rules = nftnl_diff_list(want, NFTNL_RULESET_RULELIST, rules);
+
+	nftnl_set_list_foreach(d.cur_sets, nftnl_set_count_cb, &num_sets);
+	d.replaced = calloc(num_sets + 1, sizeof(struct nftnl_set *));
+	d.fp_buf = calloc(1, NFTNL_RULE_FP_BUFSIZ);
+	d.cur_index = nftnl_diff_index_alloc(d.cur_rules);
+	d.want_index = nftnl_diff_index_alloc(d.want_rules);
+	if (d.replaced == NULL || d.fp_buf == NULL ||
+	    d.cur_index == NULL || d.want_index == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	if (nftnl_diff_run(&d) == 0)
+		ret = d.msgs;
+out:
+	xfree(d.replaced);
+	xfree(d.adds);
+	xfree(d.fp_buf);
+	if (d.cur_index != NULL)
+		nftnl_diff_index_free(d.cur_index);
+	if (d.want_index != NULL)
+		nftnl_diff_index_free(d.want_index);
+	if (tables != NULL)
+		nftnl_table_list_free(tables);
+	if (chains != NULL)
+		nftnl_chain_list_free(chains);
+	if (sets != NULL)
+		nftnl_set_list_free(sets);
+	if (rules != NULL)
+		nftnl_rule_list_free(rules);
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_diff);
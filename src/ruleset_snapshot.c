@@ -0,0 +1,840 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+
+/*
+ * File layout, all fields in network byte order:
+ *
+ *	header
+ *	netlink messages, those of one object are contiguous
+ *	string table, NUL terminated strings, the empty string at offset 0
+ *	index, one entry per object
+ *	trailer
+ *
+ * The index and the string table come last so that the file can be written
+ * in one go to a pipe.
+ */
+#define NFTNL_SNAPSHOT_MAGIC	0x4e465253	/* "NFRS" */
+#define NFTNL_SNAPSHOT_VERSION	1
+
+struct nftnl_snapshot_hdr {
+	uint32_t	magic;
+	uint32_t	version;
+};
+
+struct nftnl_snapshot_obj {
+	uint32_t	offset;		/* of the first message */
+	uint32_t	len;		/* of all messages of the object */
+	uint16_t	type;		/* enum nftnl_ruleset_type */
+	uint16_t	family;
+	uint32_t	table;		/* string table offsets */
+	uint32_t	name;		/* chain of rules */
+};
+
+struct nftnl_snapshot_trailer {
+	uint32_t	nobjs;
+	uint32_t	index_off;
+	uint32_t	strtab_off;
+	uint32_t	strtab_len;
+	uint32_t	magic;
+};
+
+/* Large enough for a full element message, see nftnl_attr_nest_overflow() */
+#define NFTNL_SNAPSHOT_MSGBUF	(2 * (UINT16_MAX + 1))
+
+/*
+ * Largest message in a snapshot: a nest of up to UINT16_MAX bytes, as
+ * element messages are split at, behind the headers and the names. The set
+ * ID that is added on restore has to fit in too.
+ */
+#define NFTNL_SNAPSHOT_MSG_MAX	(MNL_NLMSG_HDRLEN +			\
+				 MNL_ALIGN(sizeof(struct nfgenmsg)) +	\
+				 UINT16_MAX + 1024)
+#define NFTNL_SNAPSHOT_SET_ID_LEN	(MNL_ATTR_HDRLEN + sizeof(uint32_t))
+
+struct nftnl_snapshot_writer {
+	FILE				*fp;
+	uint32_t			off;
+	char				*msg;
+	/* string table, deduplicated through an open addressed hash */
+	char				*strtab;
+	uint32_t			strtab_len;
+	uint32_t			strtab_size;
+	uint32_t			*strhash;	/* offset + 1, 0 is free */
+	uint32_t			strhash_size;
+	uint32_t			nstrs;
+	struct nftnl_snapshot_obj	*objs;
+	uint32_t			nobjs;
+	uint32_t			objs_size;
+};
+
+static int nftnl_snapshot_strhash_grow(struct nftnl_snapshot_writer *w)
+{
+	uint32_t size = w->strhash_size ? w->strhash_size * 2 : 256;
+	uint32_t *hash, i, h;
+
+	hash = calloc(size, sizeof(uint32_t));
+	if (hash == NULL)
+		return -1;
+
+	for (i = 0; i < w->strhash_size; i++) {
+		if (w->strhash[i] == 0)
+			continue;
+
+		h = nftnl_hash_str(5381, w->strtab + w->strhash[i] - 1);
+		while (hash[h & (size - 1)] != 0)
+			h++;
+		hash[h & (size - 1)] = w->strhash[i];
+	}
+	xfree(w->strhash);
+	w->strhash = hash;
+	w->strhash_size = size;
+
+	return 0;
+}
+
+static int nftnl_snapshot_str(struct nftnl_snapshot_writer *w,
+			      const char *str, uint32_t *off)
+{
+	uint32_t h, len;
+	char *strtab;
+
+	if (str == NULL || str[0] == '\0') {
+		*off = 0;
+		return 0;
+	}
+
+	if (w->nstrs * 2 >= w->strhash_size &&
+	    nftnl_snapshot_strhash_grow(w) < 0)
+		return -1;
+
+	for (h = nftnl_hash_str(5381, str); ; h++) {
+		*off = w->strhash[h & (w->strhash_size - 1)];
+		if (*off == 0)
+			break;
+		if (strcmp(w->strtab + *off - 1, str) == 0) {
+			(*off)--;
+			return 0;
+		}
+	}
+
+	len = strlen(str) + 1;
+	if (w->strtab_len + len > w->strtab_size) {
+		w->strtab_size = (w->strtab_len + len) * 2;
+		strtab = realloc(w->strtab, w->strtab_size);
+		if (strtab == NULL)
+			return -1;
+		w->strtab = strtab;
+	}
+	*off = w->strtab_len;
+	memcpy(w->strtab + w->strtab_len, str, len);
+	w->strtab_len += len;
+	w->strhash[h & (w->strhash_size - 1)] = *off + 1;
+	w->nstrs++;
+
+	return 0;
+}
+
+static int nftnl_snapshot_obj_add(struct nftnl_snapshot_writer *w,
+				  uint16_t type, uint16_t family,
+				  const char *table, const char *name)
+{
+	struct nftnl_snapshot_obj *obj;
+
+	if (w->nobjs == w->objs_size) {
+		w->objs_size = w->objs_size ? w->objs_size * 2 : 64;
+		obj = realloc(w->objs,
+			      w->objs_size * sizeof(struct nftnl_snapshot_obj));
+		if (obj == NULL)
+			return -1;
+		w->objs = obj;
+	}
+	obj = &w->objs[w->nobjs++];
+	obj->offset = w->off;
+	obj->len = 0;
+	obj->type = type;
+	obj->family = family;
+
+	return nftnl_snapshot_str(w, table, &obj->table) < 0 ||
+	       nftnl_snapshot_str(w, name, &obj->name) < 0 ? -1 : 0;
+}
+
+static int nftnl_snapshot_put(struct nftnl_snapshot_writer *w,
+			      const void *data, uint32_t len)
+{
+	if (len > 0 && fwrite(data, len, 1, w->fp) != 1)
+		return -1;
+
+	w->off += len;
+	if (w->nobjs > 0)
+		w->objs[w->nobjs - 1].len = w->off - w->objs[w->nobjs - 1].offset;
+
+	return 0;
+}
+
+static int nftnl_snapshot_put_msg(struct nftnl_snapshot_writer *w,
+				  const struct nlmsghdr *nlh)
+{
+	if (nlh->nlmsg_len + NFTNL_SNAPSHOT_SET_ID_LEN >
+	    NFTNL_SNAPSHOT_MSG_MAX) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	return nftnl_snapshot_put(w, nlh, NLMSG_ALIGN(nlh->nlmsg_len));
+}
+
+static int nftnl_snapshot_save_tables(struct nftnl_snapshot_writer *w,
+				      struct nftnl_table_list *list)
+{
+	struct nftnl_table_list_iter *iter;
+	struct nlmsghdr *nlh;
+	struct nftnl_table *t;
+	int ret = 0;
+
+	iter = nftnl_table_list_iter_create(list);
+	if (iter == NULL)
+		return -1;
+
+	while ((t = nftnl_table_list_iter_next(iter)) != NULL) {
+		nlh = nftnl_table_nlmsg_build_hdr(w->msg, NFT_MSG_NEWTABLE,
+				nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				NLM_F_CREATE | NLM_F_ACK, 0);
+		nftnl_table_nlmsg_build_payload(nlh, t);
+
+		if (nftnl_snapshot_obj_add(w, NFTNL_RULESET_TABLE,
+				nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				nftnl_table_get_str(t, NFTNL_TABLE_NAME),
+				NULL) < 0 ||
+		    nftnl_snapshot_put_msg(w, nlh) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	nftnl_table_list_iter_destroy(iter);
+
+	return ret;
+}
+
+static int nftnl_snapshot_save_chains(struct nftnl_snapshot_writer *w,
+				      struct nftnl_chain_list *list)
+{
+	struct nftnl_chain_list_iter *iter;
+	struct nlmsghdr *nlh;
+	struct nftnl_chain *c;
+	int ret = 0;
+
+	iter = nftnl_chain_list_iter_create(list);
+	if (iter == NULL)
+		return -1;
+
+	while ((c = nftnl_chain_list_iter_next(iter)) != NULL) {
+		nlh = nftnl_chain_nlmsg_build_hdr(w->msg, NFT_MSG_NEWCHAIN,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				NLM_F_CREATE | NLM_F_ACK, 0);
+		nftnl_chain_nlmsg_build_payload(nlh, c);
+
+		if (nftnl_snapshot_obj_add(w, NFTNL_RULESET_CHAIN,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME)) < 0 ||
+		    nftnl_snapshot_put_msg(w, nlh) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	nftnl_chain_list_iter_destroy(iter);
+
+	return ret;
+}
+
+static int nftnl_snapshot_save_set(struct nftnl_snapshot_writer *w,
+				   struct nftnl_set *s)
+{
+	struct nftnl_set_elems_iter *iter;
+	struct nlmsghdr *nlh;
+	int more = 0;
+
+	nlh = nftnl_set_nlmsg_build_hdr(w->msg, NFT_MSG_NEWSET, s->family,
+					NLM_F_CREATE | NLM_F_ACK, 0);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+
+	if (nftnl_snapshot_obj_add(w, NFTNL_RULESET_SET, s->family, s->table,
+				   s->name) < 0 ||
+	    nftnl_snapshot_put_msg(w, nlh) < 0)
+		return -1;
+
+	if (list_empty(&s->element_list))
+		return 0;
+
+	iter = nftnl_set_elems_iter_create(s);
+	if (iter == NULL)
+		return -1;
+
+	do {
+		nlh = nftnl_set_nlmsg_build_hdr(w->msg, NFT_MSG_NEWSETELEM,
+						s->family,
+						NLM_F_CREATE | NLM_F_ACK, 0);
+		more = nftnl_set_elems_nlmsg_build_payload_iter(nlh, iter);
+		if (nftnl_snapshot_put_msg(w, nlh) < 0) {
+			more = -1;
+			break;
+		}
+	} while (more > 0);
+	nftnl_set_elems_iter_destroy(iter);
+
+	return more;
+}
+
+static int nftnl_snapshot_save_sets(struct nftnl_snapshot_writer *w,
+				    struct nftnl_set_list *list)
+{
+	struct nftnl_set_list_iter *iter;
+	struct nftnl_set *s;
+	int ret = 0;
+
+	iter = nftnl_set_list_iter_create(list);
+	if (iter == NULL)
+		return -1;
+
+	while ((s = nftnl_set_list_iter_next(iter)) != NULL) {
+		if (nftnl_snapshot_save_set(w, s) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	nftnl_set_list_iter_destroy(iter);
+
+	return ret;
+}
+
+static int nftnl_snapshot_save_rules(struct nftnl_snapshot_writer *w,
+				     struct nftnl_rule_list *list)
+{
+	struct nftnl_rule_list_iter *iter;
+	struct nlmsghdr *nlh;
+	struct nftnl_rule *r;
+	int ret = 0;
+
+	iter = nftnl_rule_list_iter_create(list);
+	if (iter == NULL)
+		return -1;
+
+	while ((r = nftnl_rule_list_iter_next(iter)) != NULL) {
+		nlh = nftnl_rule_nlmsg_build_hdr(w->msg, NFT_MSG_NEWRULE,
+				nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+				NLM_F_CREATE | NLM_F_APPEND | NLM_F_ACK, 0);
+		nftnl_rule_nlmsg_build_payload(nlh, r);
+
+		if (nftnl_snapshot_obj_add(w, NFTNL_RULESET_RULE,
+				nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+				nftnl_rule_get_str(r, NFTNL_RULE_TABLE),
+				nftnl_rule_get_str(r, NFTNL_RULE_CHAIN)) < 0 ||
+		    nftnl_snapshot_put_msg(w, nlh) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	nftnl_rule_list_iter_destroy(iter);
+
+	return ret;
+}
+
+static int nftnl_snapshot_save_index(struct nftnl_snapshot_writer *w)
+{
+	struct nftnl_snapshot_trailer trailer;
+	struct nftnl_snapshot_obj *obj;
+	static const char pad[4];
+	uint32_t i, nobjs = w->nobjs;
+
+	/* the last object is done, what follows is not part of it */
+	w->nobjs = 0;
+
+	trailer.strtab_off = htonl(w->off);
+	trailer.strtab_len = htonl(w->strtab_len);
+	if (nftnl_snapshot_put(w, w->strtab, w->strtab_len) < 0 ||
+	    nftnl_snapshot_put(w, pad, -w->off & 3) < 0)
+		return -1;
+
+	trailer.index_off = htonl(w->off);
+	for (i = 0; i < nobjs; i++) {
+		obj = &w->objs[i];
+		obj->offset = htonl(obj->offset);
+		obj->len = htonl(obj->len);
+		obj->type = htons(obj->type);
+		obj->family = htons(obj->family);
+		obj->table = htonl(obj->table);
+		obj->name = htonl(obj->name);
+	}
+	if (nftnl_snapshot_put(w, w->objs,
+			       nobjs * sizeof(struct nftnl_snapshot_obj)) < 0)
+		return -1;
+
+	trailer.nobjs = htonl(nobjs);
+	trailer.magic = htonl(NFTNL_SNAPSHOT_MAGIC);
+
+	return nftnl_snapshot_put(w, &trailer, sizeof(trailer));
+}
+
+int nftnl_ruleset_snapshot_save(const struct nftnl_ruleset *rs, FILE *fp)
+{
+	struct nftnl_snapshot_writer w = {
+		.fp	= fp,
+	};
+	struct nftnl_snapshot_hdr hdr = {
+		.magic		= htonl(NFTNL_SNAPSHOT_MAGIC),
+		.version	= htonl(NFTNL_SNAPSHOT_VERSION),
+	};
+	int ret = -1;
+
+	w.msg = calloc(1, NFTNL_SNAPSHOT_MSGBUF);
+	if (w.msg == NULL)
+		return -1;
+
+	/* the empty string, for objects without a name */
+	w.strtab = calloc(1, 64);
+	if (w.strtab == NULL)
+		goto out;
+	w.strtab_size = 64;
+	w.strtab_len = 1;
+
+	if (nftnl_snapshot_put(&w, &hdr, sizeof(hdr)) < 0)
+		goto out;
+
+	if (nftnl_ruleset_is_set(rs, NFTNL_RULESET_TABLELIST) &&
+	    nftnl_snapshot_save_tables(&w,
+				nftnl_ruleset_get(rs, NFTNL_RULESET_TABLELIST)) < 0)
+		goto out;
+	if (nftnl_ruleset_is_set(rs, NFTNL_RULESET_CHAINLIST) &&
+	    nftnl_snapshot_save_chains(&w,
+				nftnl_ruleset_get(rs, NFTNL_RULESET_CHAINLIST)) < 0)
+		goto out;
+	if (nftnl_ruleset_is_set(rs, NFTNL_RULESET_SETLIST) &&
+	    nftnl_snapshot_save_sets(&w,
+				nftnl_ruleset_get(rs, NFTNL_RULESET_SETLIST)) < 0)
+		goto out;
+	if (nftnl_ruleset_is_set(rs, NFTNL_RULESET_RULELIST) &&
+	    nftnl_snapshot_save_rules(&w,
+				nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST)) < 0)
+		goto out;
+
+	ret = nftnl_snapshot_save_index(&w);
+out:
+	xfree(w.objs);
+	xfree(w.strhash);
+	xfree(w.strtab);
+	xfree(w.msg);
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_save);
+
+struct nftnl_ruleset_snapshot {
+	const char				*map;
+	size_t					map_len;
+	const struct nftnl_snapshot_obj		*objs;
+	uint32_t				nobjs;
+	const char				*strtab;
+	uint32_t				strtab_len;
+};
+
+struct nftnl_ruleset_snapshot *nftnl_ruleset_snapshot_open(const char *filename)
+{
+	const struct nftnl_snapshot_trailer *trailer;
+	const struct nftnl_snapshot_hdr *hdr;
+	const struct nftnl_snapshot_obj *obj;
+	struct nftnl_ruleset_snapshot *snap;
+	uint32_t strtab_off, index_off, i;
+	struct stat st;
+	int fd;
+
+	snap = calloc(1, sizeof(struct nftnl_ruleset_snapshot));
+	if (snap == NULL)
+		return NULL;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		goto err1;
+
+	if (fstat(fd, &st) < 0)
+		goto err2;
+
+	if (st.st_size < sizeof(*hdr) + sizeof(*trailer) ||
+	    st.st_size > UINT32_MAX) {
+		errno = EINVAL;
+		goto err2;
+	}
+
+	snap->map_len = st.st_size;
+	snap->map = mmap(NULL, snap->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (snap->map == MAP_FAILED)
+		goto err2;
+
+	close(fd);
+
+	hdr = (const struct nftnl_snapshot_hdr *)snap->map;
+	trailer = (const struct nftnl_snapshot_trailer *)
+		  (snap->map + snap->map_len - sizeof(*trailer));
+
+	snap->nobjs = ntohl(trailer->nobjs);
+	snap->strtab_len = ntohl(trailer->strtab_len);
+	strtab_off = ntohl(trailer->strtab_off);
+	index_off = ntohl(trailer->index_off);
+	snap->strtab = snap->map + strtab_off;
+	snap->objs = (const struct nftnl_snapshot_obj *)(snap->map + index_off);
+
+	if (ntohl(hdr->magic) != NFTNL_SNAPSHOT_MAGIC ||
+	    ntohl(hdr->version) != NFTNL_SNAPSHOT_VERSION ||
+	    ntohl(trailer->magic) != NFTNL_SNAPSHOT_MAGIC ||
+	    strtab_off < sizeof(*hdr) || snap->strtab_len == 0 ||
+	    index_off < strtab_off + snap->strtab_len ||
+	    index_off % sizeof(uint32_t) != 0 ||
+	    (uint64_t)index_off + (uint64_t)snap->nobjs * sizeof(*obj) !=
+	    snap->map_len - sizeof(*trailer) ||
+	    snap->strtab[snap->strtab_len - 1] != '\0')
+		goto err3;
+
+	/* messages are checked once the object is decoded */
+	for (i = 0; i < snap->nobjs; i++) {
+		obj = &snap->objs[i];
+		if (ntohl(obj->offset) < sizeof(*hdr) ||
+		    (uint64_t)ntohl(obj->offset) + ntohl(obj->len) > strtab_off ||
+		    ntohl(obj->table) >= snap->strtab_len ||
+		    ntohl(obj->name) >= snap->strtab_len)
+			goto err3;
+	}
+
+	return snap;
+err3:
+	errno = EINVAL;
+	munmap((void *)snap->map, snap->map_len);
+	goto err1;
+err2:
+	close(fd);
+err1:
+	xfree(snap);
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_open);
+
+void nftnl_ruleset_snapshot_close(struct nftnl_ruleset_snapshot *snap)
+{
+	munmap((void *)snap->map, snap->map_len);
+	xfree(snap);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_close);
+
+uint32_t nftnl_ruleset_snapshot_count(const struct nftnl_ruleset_snapshot *snap)
+{
+	return snap->nobjs;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_count);
+
+enum nftnl_ruleset_type
+nftnl_ruleset_snapshot_type(const struct nftnl_ruleset_snapshot *snap,
+			    uint32_t idx)
+{
+	if (idx >= snap->nobjs)
+		return NFTNL_RULESET_UNSPEC;
+
+	return ntohs(snap->objs[idx].type);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_type);
+
+int nftnl_ruleset_snapshot_find(const struct nftnl_ruleset_snapshot *snap,
+				enum nftnl_ruleset_type type, uint32_t family,
+				const char *table, const char *name)
+{
+	const struct nftnl_snapshot_obj *obj;
+	uint32_t i;
+
+	for (i = 0; i < snap->nobjs; i++) {
+		obj = &snap->objs[i];
+		if (ntohs(obj->type) != type || ntohs(obj->family) != family)
+			continue;
+		if (table != NULL &&
+		    strcmp(snap->strtab + ntohl(obj->table), table) != 0)
+			continue;
+		if (name != NULL &&
+		    strcmp(snap->strtab + ntohl(obj->name), name) != 0)
+			continue;
+
+		return i;
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_find);
+
+/* Messages of an object, NULL once there are no more or on garbage. */
+static const struct nlmsghdr *
+nftnl_snapshot_msg_next(const struct nftnl_ruleset_snapshot *snap,
+			uint32_t idx, const struct nlmsghdr *nlh, int *len)
+{
+	const struct nftnl_snapshot_obj *obj = &snap->objs[idx];
+
+	if (nlh == NULL) {
+		*len = ntohl(obj->len);
+		nlh = (const struct nlmsghdr *)(snap->map + ntohl(obj->offset));
+	} else {
+		nlh = mnl_nlmsg_next(nlh, len);
+	}
+
+	if (*len == 0)
+		return NULL;
+
+	if (!mnl_nlmsg_ok(nlh, *len) ||
+	    nlh->nlmsg_len < MNL_NLMSG_HDRLEN + sizeof(struct nfgenmsg) ||
+	    nlh->nlmsg_len + NFTNL_SNAPSHOT_SET_ID_LEN >
+	    NFTNL_SNAPSHOT_MSG_MAX) {
+		*len = -1;
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return nlh;
+}
+
+static struct nftnl_set *
+nftnl_snapshot_get_set(const struct nftnl_ruleset_snapshot *snap, uint32_t idx)
+{
+	const struct nlmsghdr *nlh;
+	struct nftnl_set *s;
+	int len;
+
+	s = nftnl_set_alloc();
+	if (s == NULL)
+		return NULL;
+
+	nlh = nftnl_snapshot_msg_next(snap, idx, NULL, &len);
+	if (nlh == NULL || nftnl_set_nlmsg_parse(nlh, s) < 0)
+		goto err;
+
+	while ((nlh = nftnl_snapshot_msg_next(snap, idx, nlh, &len)) != NULL) {
+		if (nftnl_set_elems_nlmsg_parse(nlh, s) < 0)
+			goto err;
+	}
+	if (len < 0)
+		goto err;
+
+	return s;
+err:
+	nftnl_set_free(s);
+	return NULL;
+}
+
+void *nftnl_ruleset_snapshot_get(const struct nftnl_ruleset_snapshot *snap,
+				 uint32_t idx)
+{
+	const struct nlmsghdr *nlh;
+	void *obj = NULL;
+	int len, ret = -1;
+
+	if (idx >= snap->nobjs) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (ntohs(snap->objs[idx].type) == NFTNL_RULESET_SET)
+		return nftnl_snapshot_get_set(snap, idx);
+
+	nlh = nftnl_snapshot_msg_next(snap, idx, NULL, &len);
+	if (nlh == NULL)
+		return NULL;
+
+	switch (ntohs(snap->objs[idx].type)) {
+	case NFTNL_RULESET_TABLE:
+		obj = nftnl_table_alloc();
+		if (obj != NULL)
+			ret = nftnl_table_nlmsg_parse(nlh, obj);
+		if (ret < 0 && obj != NULL)
+			nftnl_table_free(obj);
+		break;
+	case NFTNL_RULESET_CHAIN:
+		obj = nftnl_chain_alloc();
+		if (obj != NULL)
+			ret = nftnl_chain_nlmsg_parse(nlh, obj);
+		if (ret < 0 && obj != NULL)
+			nftnl_chain_free(obj);
+		break;
+	case NFTNL_RULESET_RULE:
+		obj = nftnl_rule_alloc();
+		if (obj != NULL)
+			ret = nftnl_rule_nlmsg_parse(nlh, obj);
+		if (ret < 0 && obj != NULL)
+			nftnl_rule_free(obj);
+		break;
+	default:
+		errno = EINVAL;
+		break;
+	}
+
+	return ret < 0 ? NULL : obj;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_get);
+
+struct nftnl_ruleset *
+nftnl_ruleset_snapshot_load(const struct nftnl_ruleset_snapshot *snap)
+{
+	struct nftnl_table_list *tables;
+	struct nftnl_chain_list *chains;
+	struct nftnl_set_list *sets;
+	struct nftnl_rule_list *rules;
+	struct nftnl_ruleset *rs;
+	uint32_t i;
+	void *obj;
+
+	rs = nftnl_ruleset_alloc();
+	if (rs == NULL)
+		return NULL;
+
+	tables = nftnl_table_list_alloc();
+	if (tables == NULL)
+		goto err;
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tables);
+	chains = nftnl_chain_list_alloc();
+	if (chains == NULL)
+		goto err;
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, chains);
+	sets = nftnl_set_list_alloc();
+	if (sets == NULL)
+		goto err;
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sets);
+	rules = nftnl_rule_list_alloc();
+	if (rules == NULL)
+		goto err;
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rules);
+
+	for (i = 0; i < snap->nobjs; i++) {
+		obj = nftnl_ruleset_snapshot_get(snap, i);
+		if (obj == NULL)
+			goto err;
+
+		switch (ntohs(snap->objs[i].type)) {
+		case NFTNL_RULESET_TABLE:
+			nftnl_table_list_add_tail(obj, tables);
+			break;
+		case NFTNL_RULESET_CHAIN:
+			nftnl_chain_list_add_tail(obj, chains);
+			break;
+		case NFTNL_RULESET_SET:
+			nftnl_set_list_add_tail(obj, sets);
+			break;
+		case NFTNL_RULESET_RULE:
+			nftnl_rule_list_add_tail(obj, rules);
+			break;
+		}
+	}
+
+	return rs;
+err:
+	nftnl_ruleset_free(rs);
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_load);
+
+/*
+ * Attributes that refer to objects by their handle in the kernel the
+ * snapshot was taken from, they have to go when restoring.
+ */
+static bool nftnl_snapshot_attr_skip(uint16_t msg, uint16_t attr)
+{
+	switch (msg) {
+	case NFT_MSG_NEWCHAIN:
+		return attr == NFTA_CHAIN_HANDLE || attr == NFTA_CHAIN_USE;
+	case NFT_MSG_NEWRULE:
+		return attr == NFTA_RULE_HANDLE || attr == NFTA_RULE_POSITION;
+	case NFT_MSG_NEWSET:
+		return attr == NFTA_SET_ID;
+	case NFT_MSG_NEWSETELEM:
+		return attr == NFTA_SET_ELEM_LIST_SET_ID;
+	}
+	return false;
+}
+
+static void nftnl_snapshot_msg_copy(struct nlmsghdr *dst,
+				    const struct nlmsghdr *src,
+				    uint32_t seq, uint32_t set_id)
+{
+	const struct nlattr *attr;
+	uint16_t msg = NFNL_MSG_TYPE(src->nlmsg_type);
+
+	memcpy(dst, src, MNL_NLMSG_HDRLEN + sizeof(struct nfgenmsg));
+	dst->nlmsg_len = MNL_NLMSG_HDRLEN + MNL_ALIGN(sizeof(struct nfgenmsg));
+	dst->nlmsg_seq = seq;
+
+	mnl_attr_for_each(attr, src, sizeof(struct nfgenmsg)) {
+		if (nftnl_snapshot_attr_skip(msg, mnl_attr_get_type(attr)))
+			continue;
+
+		memcpy(mnl_nlmsg_get_payload_tail(dst), attr,
+		       MNL_ALIGN(attr->nla_len));
+		dst->nlmsg_len += MNL_ALIGN(attr->nla_len);
+	}
+
+	/* sets created in the same batch are found by their ID */
+	if (msg == NFT_MSG_NEWSET)
+		mnl_attr_put_u32(dst, NFTA_SET_ID, htonl(set_id));
+	else if (msg == NFT_MSG_NEWSETELEM)
+		mnl_attr_put_u32(dst, NFTA_SET_ELEM_LIST_SET_ID,
+				 htonl(set_id));
+}
+
+int nftnl_ruleset_snapshot_batch(const struct nftnl_ruleset_snapshot *snap,
+				 struct nftnl_batch *batch, uint32_t *seq)
+{
+	const struct nlmsghdr *nlh;
+	uint32_t i, set_id = 0;
+	int len, msgs = 0;
+
+	for (i = 0; i < snap->nobjs; i++) {
+		if (ntohs(snap->objs[i].type) == NFTNL_RULESET_SET)
+			set_id++;
+
+		nlh = NULL;
+		while ((nlh = nftnl_snapshot_msg_next(snap, i, nlh,
+						      &len)) != NULL) {
+			if (nftnl_batch_room(batch) <
+			    MNL_ALIGN(nlh->nlmsg_len) +
+			    NFTNL_SNAPSHOT_SET_ID_LEN) {
+				errno = EMSGSIZE;
+				return -1;
+			}
+			nftnl_snapshot_msg_copy(nftnl_batch_buffer(batch), nlh,
+						(*seq)++, set_id);
+			if (nftnl_batch_update(batch) < 0)
+				return -1;
+			msgs++;
+		}
+		if (len < 0)
+			return -1;
+	}
+
+	return msgs;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_ruleset_snapshot_batch);
@@ -45,9 +45,9 @@ void nftnl_set_free(struct nftnl_set *s)
 	struct nftnl_set_elem *elem, *tmp;
 
 	if (s->table != NULL)
-		xfree(s->table);
+		nftnl_str_release(s->table);
 	if (s->name != NULL)
-		xfree(s->name);
+		nftnl_str_release(s->name);
 
 	list_for_each_entry_safe(elem, tmp, &s->element_list, head) {
 		list_del(&elem->head);
@@ -69,14 +69,14 @@ void nftnl_set_unset(struct nftnl_set *s, uint16_t attr)
 	case NFTNL_SET_TABLE:
 		if (s->flags & (1 << NFTNL_SET_TABLE))
 			if (s->table) {
-				xfree(s->table);
+				nftnl_str_release(s->table);
 				s->table = NULL;
 			}
 		break;
 	case NFTNL_SET_NAME:
 		if (s->flags & (1 << NFTNL_SET_NAME))
 			if (s->name) {
-				xfree(s->name);
+				nftnl_str_release(s->name);
 				s->name = NULL;
 			}
 		break;
@@ -124,15 +124,15 @@ void nftnl_set_set_data(struct nftnl_set *s, uint16_t attr, const void *data,
 	switch(attr) {
 	case NFTNL_SET_TABLE:
 		if (s->table)
-			xfree(s->table);
+			nftnl_str_release(s->table);
 
-		s->table = strdup(data);
+		s->table = nftnl_str_intern(data);
 		break;
 	case NFTNL_SET_NAME:
 		if (s->name)
-			xfree(s->name);
+			nftnl_str_release(s->name);
 
-		s->name = strdup(data);
+		s->name = nftnl_str_intern(data);
 		break;
 	case NFTNL_SET_FLAGS:
 		s->set_flags = *((uint32_t *)data);
@@ -290,11 +290,12 @@ struct nftnl_set *nftnl_set_clone(const struct nftnl_set *set)
 		return NULL;
 
 	memcpy(newset, set, sizeof(*set));
+	INIT_HLIST_NODE(&newset->hnode);
 
 	if (set->flags & (1 << NFTNL_SET_TABLE))
-		newset->table = strdup(set->table);
+		newset->table = nftnl_str_intern(set->table);
 	if (set->flags & (1 << NFTNL_SET_NAME))
-		newset->name = strdup(set->name);
+		newset->name = nftnl_str_intern(set->name);
 
 	INIT_LIST_HEAD(&newset->element_list);
 	list_for_each_entry(elem, &set->element_list, head) {
@@ -351,13 +352,31 @@ void nftnl_set_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set *s)
 }
 EXPORT_SYMBOL(nftnl_set_nlmsg_build_payload, nft_set_nlmsg_build_payload);
 
+/* Mask bits that select each NFTA_SET_* attribute. */
+static const uint32_t nftnl_set_attr_mask[NFTA_SET_MAX + 1] = {
+	[NFTA_SET_TABLE]	= (1 << NFTNL_SET_TABLE),
+	[NFTA_SET_NAME]		= (1 << NFTNL_SET_NAME),
+	[NFTA_SET_FLAGS]	= (1 << NFTNL_SET_FLAGS),
+	[NFTA_SET_KEY_TYPE]	= (1 << NFTNL_SET_KEY_TYPE),
+	[NFTA_SET_KEY_LEN]	= (1 << NFTNL_SET_KEY_LEN),
+	[NFTA_SET_DATA_TYPE]	= (1 << NFTNL_SET_DATA_TYPE),
+	[NFTA_SET_DATA_LEN]	= (1 << NFTNL_SET_DATA_LEN),
+	[NFTA_SET_POLICY]	= (1 << NFTNL_SET_POLICY),
+	[NFTA_SET_DESC]		= (1 << NFTNL_SET_DESC_SIZE),
+	[NFTA_SET_ID]		= (1 << NFTNL_SET_ID),
+	[NFTA_SET_TIMEOUT]	= (1 << NFTNL_SET_TIMEOUT),
+	[NFTA_SET_GC_INTERVAL]	= (1 << NFTNL_SET_GC_INTERVAL),
+};
+
 static int nftnl_set_parse_attr_cb(const struct nlattr *attr, void *data)
 {
-	const struct nlattr **tb = data;
+	struct nftnl_nlmsg_parse_ctx *ctx = data;
 	int type = mnl_attr_get_type(attr);
 
 	if (mnl_attr_type_valid(attr, NFTA_SET_MAX) < 0)
 		return MNL_CB_OK;
+	if (!(ctx->mask & nftnl_set_attr_mask[type]))
+		return MNL_CB_OK;
 
 	switch(type) {
 	case NFTA_SET_TABLE:
@@ -386,7 +405,7 @@ static int nftnl_set_parse_attr_cb(const struct nlattr *attr, void *data)
 		break;
 	}
 
-	tb[type] = attr;
+	ctx->tb[type] = attr;
 	return MNL_CB_OK;
 }
 
@@ -425,23 +444,31 @@ static int nftnl_set_desc_parse(struct nftnl_set *s,
 	return 0;
 }
 
-int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
+int nftnl_set_nlmsg_parse_mask(const struct nlmsghdr *nlh, struct nftnl_set *s,
+			       uint32_t mask)
 {
 	struct nlattr *tb[NFTA_SET_MAX+1] = {};
 	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	struct nftnl_nlmsg_parse_ctx ctx = {
+		.tb	= (const struct nlattr **)tb,
+		.mask	= mask,
+	};
 	int ret = 0;
 
-	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_set_parse_attr_cb, tb) < 0)
+	if (mnl_attr_parse(nlh, sizeof(*nfg), nftnl_set_parse_attr_cb,
+			   &ctx) < 0)
 		return -1;
 
 	if (tb[NFTA_SET_TABLE]) {
-		xfree(s->table);
-		s->table = strdup(mnl_attr_get_str(tb[NFTA_SET_TABLE]));
+		nftnl_str_release(s->table);
+		s->table =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_TABLE]));
 		s->flags |= (1 << NFTNL_SET_TABLE);
 	}
 	if (tb[NFTA_SET_NAME]) {
-		xfree(s->name);
-		s->name = strdup(mnl_attr_get_str(tb[NFTA_SET_NAME]));
+		nftnl_str_release(s->name);
+		s->name =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_NAME]));
 		s->flags |= (1 << NFTNL_SET_NAME);
 	}
 	if (tb[NFTA_SET_FLAGS]) {
@@ -488,6 +515,12 @@ int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 
 	return ret;
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_set_nlmsg_parse_mask);
+
+int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
+{
+	return nftnl_set_nlmsg_parse_mask(nlh, s, ~0U);
+}
 EXPORT_SYMBOL(nftnl_set_nlmsg_parse, nft_set_nlmsg_parse);
 
 #ifdef JSON_PARSING
@@ -608,14 +641,15 @@ int nftnl_jansson_parse_elem(struct nftnl_set *s, json_t *tree,
 
 static int nftnl_set_json_parse(struct nftnl_set *s, const void *json,
 			      struct nftnl_parse_err *err,
-			      enum nftnl_parse_input input)
+			      enum nftnl_parse_input input,
+			      enum nftnl_parse_type type)
 {
 #ifdef JSON_PARSING
 	json_t *tree;
 	json_error_t error;
 	int ret;
 
-	tree = nftnl_jansson_create_root(json, &error, err, input);
+	tree = nftnl_jansson_create_root(json, &error, err, input, type);
 	if (tree == NULL)
 		return -1;
 
@@ -744,7 +778,8 @@ static int nftnl_set_do_parse(struct nftnl_set *s, enum nftnl_parse_type type,
 		ret = nftnl_set_xml_parse(s, data, &perr, input);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_set_json_parse(s, data, &perr, input);
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_set_json_parse(s, data, &perr, input, type);
 		break;
 	default:
 		ret = -1;
@@ -772,12 +807,11 @@ int nftnl_set_parse_file(struct nftnl_set *s, enum nftnl_parse_type type,
 EXPORT_SYMBOL(nftnl_set_parse_file, nft_set_parse_file);
 
 static int nftnl_set_snprintf_json(char *buf, size_t size, struct nftnl_set *s,
-				  uint32_t type, uint32_t flags)
+				   const char *tag)
 {
 	int len = size, offset = 0, ret;
-	struct nftnl_set_elem *elem;
 
-	ret = snprintf(buf, len, "{\"set\":{");
+	ret = snprintf(buf, len, "{\"%s\":{", tag);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	if (s->flags & (1 << NFTNL_SET_NAME)) {
@@ -832,42 +866,18 @@ static int nftnl_set_snprintf_json(char *buf, size_t size, struct nftnl_set *s,
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
-	/* Empty set? Skip printinf of elements */
-	if (list_empty(&s->element_list)){
-		ret = snprintf(buf + offset, len, "}}");
-		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-		return offset;
-	}
-
-	ret = snprintf(buf + offset, len, ",\"set_elem\":[");
-	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-	list_for_each_entry(elem, &s->element_list, head) {
-		ret = snprintf(buf + offset, len, "{");
-		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-		ret = nftnl_set_elem_snprintf(buf + offset, len, elem, type,
-					    flags);
-		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-		ret = snprintf(buf + offset, len, "},");
+	if (!list_empty(&s->element_list)) {
+		ret = snprintf(buf + offset, len, ",\"set_elem\":[");
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
-	/* Overwrite trailing ", " from last set element */
-	offset --;
-
-	ret = snprintf(buf + offset, len, "]}}");
-	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	return offset;
 }
 
-static int nftnl_set_snprintf_default(char *buf, size_t size, struct nftnl_set *s,
-				    uint32_t type, uint32_t flags)
+static int nftnl_set_snprintf_default(char *buf, size_t size, struct nftnl_set *s)
 {
 	int ret;
 	int len = size, offset = 0;
-	struct nftnl_set_elem *elem;
 
 	ret = snprintf(buf, len, "%s %s %x",
 			s->name, s->table, s->set_flags);
@@ -895,30 +905,18 @@ static int nftnl_set_snprintf_default(char *buf, size_t size, struct nftnl_set *
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
-	/* Empty set? Skip printinf of elements */
-	if (list_empty(&s->element_list))
-		return offset;
-
-	ret = snprintf(buf+offset, len, "\n");
-	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-	list_for_each_entry(elem, &s->element_list, head) {
-		ret = snprintf(buf+offset, len, "\t");
-		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-
-		ret = nftnl_set_elem_snprintf(buf+offset, len, elem, type, flags);
+	if (!list_empty(&s->element_list)) {
+		ret = snprintf(buf+offset, len, "\n");
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
 	return offset;
 }
 
-static int nftnl_set_snprintf_xml(char *buf, size_t size, struct nftnl_set *s,
-				uint32_t flags)
+static int nftnl_set_snprintf_xml(char *buf, size_t size, struct nftnl_set *s)
 {
 	int ret;
 	int len = size, offset = 0;
-	struct nftnl_set_elem *elem;
 
 	ret = snprintf(buf, len, "<set>");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
@@ -980,48 +978,175 @@ static int nftnl_set_snprintf_xml(char *buf, size_t size, struct nftnl_set *s,
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
-	if (!list_empty(&s->element_list)) {
-		list_for_each_entry(elem, &s->element_list, head) {
-			ret = nftnl_set_elem_snprintf(buf + offset, len, elem,
-						    NFTNL_OUTPUT_XML, flags);
-			SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
-		}
-	}
+	return offset;
+}
+
+static int nftnl_set_snprintf_cbor(char *buf, size_t size, struct nftnl_set *s,
+				   const char *tag)
+{
+	int len = size, offset = 0, ret;
 
-	ret = snprintf(buf + offset, len, "</set>");
+	ret = nftnl_cbor_byte(buf, len, NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
+	ret = nftnl_cbor_str(buf + offset, len, tag);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf + offset, len,
+			      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	if (s->flags & (1 << NFTNL_SET_NAME)) {
+		ret = nftnl_cbor_pair_str(buf + offset, len, "name", s->name);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_TABLE)) {
+		ret = nftnl_cbor_pair_str(buf + offset, len, "table", s->table);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_FLAGS)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "flags",
+					   s->set_flags);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_FAMILY)) {
+		ret = nftnl_cbor_pair_str(buf + offset, len, "family",
+					  nftnl_family2str(s->family));
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_KEY_TYPE)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "key_type",
+					   s->key_type);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_KEY_LEN)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "key_len",
+					   s->key_len);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_DATA_TYPE)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "data_type",
+					   s->data_type);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_DATA_LEN)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "data_len",
+					   s->data_len);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_POLICY)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "policy",
+					   s->policy);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+	if (s->flags & (1 << NFTNL_SET_DESC_SIZE)) {
+		ret = nftnl_cbor_pair_uint(buf + offset, len, "desc_size",
+					   s->desc.size);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	if (!list_empty(&s->element_list)) {
+		ret = nftnl_cbor_str(buf + offset, len, "set_elem");
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_byte(buf + offset, len,
+				      NFTNL_CBOR_ARRAY | NFTNL_CBOR_INDEF);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
 	return offset;
 }
 
-static int nftnl_set_cmd_snprintf(char *buf, size_t size, struct nftnl_set *s,
-				uint32_t cmd, uint32_t type, uint32_t flags)
+/*
+ * Sets are printed in pieces: the set attributes, each element and the
+ * closing part, so that nftnl_set_output() does not need to render the
+ * whole set at once.
+ */
+static int nftnl_set_snprintf_head(char *buf, size_t size, struct nftnl_set *s,
+				   uint32_t cmd, uint32_t type, uint32_t flags,
+				   const char *tag)
 {
 	int ret, len = size, offset = 0;
-	uint32_t inner_flags = flags;
-
-	/* prevent set_elems to print as events */
-	inner_flags &= ~NFTNL_OF_EVENT_ANY;
 
 	ret = nftnl_cmd_header_snprintf(buf + offset, len, cmd, type, flags);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	switch(type) {
 	case NFTNL_OUTPUT_DEFAULT:
-		ret = nftnl_set_snprintf_default(buf+offset, len, s, type,
-					       inner_flags);
+		ret = nftnl_set_snprintf_default(buf+offset, len, s);
 		break;
 	case NFTNL_OUTPUT_XML:
-		ret = nftnl_set_snprintf_xml(buf+offset, len, s, inner_flags);
+		ret = nftnl_set_snprintf_xml(buf+offset, len, s);
 		break;
 	case NFTNL_OUTPUT_JSON:
-		ret = nftnl_set_snprintf_json(buf+offset, len, s, type,
-					    inner_flags);
+		ret = nftnl_set_snprintf_json(buf+offset, len, s, tag);
+		break;
+	case NFTNL_OUTPUT_CBOR:
+		ret = nftnl_set_snprintf_cbor(buf+offset, len, s, tag);
 		break;
 	default:
 		return -1;
 	}
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
 
+static int nftnl_set_snprintf_elem(char *buf, size_t size,
+				   struct nftnl_set_elem *elem, bool first,
+				   uint32_t type, uint32_t flags)
+{
+	int ret, len = size, offset = 0;
+
+	switch (type) {
+	case NFTNL_OUTPUT_DEFAULT:
+		ret = snprintf(buf, len, "\t");
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+		break;
+	case NFTNL_OUTPUT_JSON:
+		ret = snprintf(buf, len, first ? "{" : ",{");
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+		break;
+	case NFTNL_OUTPUT_CBOR:
+		ret = nftnl_cbor_byte(buf, len,
+				      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+		break;
+	}
+
+	ret = nftnl_set_elem_snprintf(buf + offset, len, elem, type, flags);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	if (type == NFTNL_OUTPUT_JSON) {
+		ret = snprintf(buf + offset, len, "}");
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	} else if (type == NFTNL_OUTPUT_CBOR) {
+		ret = nftnl_cbor_byte(buf + offset, len, NFTNL_CBOR_BREAK);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	return offset;
+}
+
+static int nftnl_set_snprintf_tail(char *buf, size_t size, struct nftnl_set *s,
+				   uint32_t cmd, uint32_t type, uint32_t flags)
+{
+	int ret = 0, len = size, offset = 0;
+
+	switch (type) {
+	case NFTNL_OUTPUT_XML:
+		ret = snprintf(buf, len, "</set>");
+		break;
+	case NFTNL_OUTPUT_JSON:
+		ret = snprintf(buf, len, list_empty(&s->element_list) ?
+					 "}}" : "]}}");
+		break;
+	case NFTNL_OUTPUT_CBOR:
+		/* the element array if any, the set and the outer map */
+		ret = list_empty(&s->element_list) ? 2 : 3;
+		ret = nftnl_fmt_copy(buf, len, "\xff\xff\xff", ret);
+		break;
+	}
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
 	ret = nftnl_cmd_footer_snprintf(buf + offset, len, cmd, type, flags);
@@ -1030,6 +1155,35 @@ static int nftnl_set_cmd_snprintf(char *buf, size_t size, struct nftnl_set *s,
 	return offset;
 }
 
+static int nftnl_set_cmd_snprintf(char *buf, size_t size, struct nftnl_set *s,
+				uint32_t cmd, uint32_t type, uint32_t flags)
+{
+	int ret, len = size, offset = 0;
+	uint32_t inner_flags = flags;
+	struct nftnl_set_elem *elem;
+	bool first = true;
+
+	/* prevent set_elems to print as events */
+	inner_flags &= ~NFTNL_OF_EVENT_ANY;
+
+	ret = nftnl_set_snprintf_head(buf, len, s, cmd, type, flags, "set");
+	if (ret < 0)
+		return -1;
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	list_for_each_entry(elem, &s->element_list, head) {
+		ret = nftnl_set_snprintf_elem(buf + offset, len, elem, first,
+					      type, inner_flags);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+		first = false;
+	}
+
+	ret = nftnl_set_snprintf_tail(buf + offset, len, s, cmd, type, flags);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	return offset;
+}
+
 int nftnl_set_snprintf(char *buf, size_t size, struct nftnl_set *s,
 		     uint32_t type, uint32_t flags)
 {
@@ -1038,18 +1192,142 @@ int nftnl_set_snprintf(char *buf, size_t size, struct nftnl_set *s,
 }
 EXPORT_SYMBOL(nftnl_set_snprintf, nft_set_snprintf);
 
-static inline int nftnl_set_do_snprintf(char *buf, size_t size, void *s,
-				      uint32_t cmd, uint32_t type,
-				      uint32_t flags)
+struct nftnl_set_output_ctx {
+	uint32_t	type;
+	uint32_t	flags;
+};
+
+static int nftnl_set_output_elem(struct nftnl_sink *sink, void *elem,
+				 uint32_t idx, void *data)
+{
+	struct nftnl_set_output_ctx *ctx = data;
+	size_t size;
+	char *buf;
+	int ret;
+
+	do {
+		buf = nftnl_sink_reserve(sink, &size);
+		if (buf == NULL)
+			return -1;
+		ret = nftnl_set_snprintf_elem(buf, size, elem, idx == 0,
+					      ctx->type, ctx->flags);
+	} while ((ret = nftnl_sink_commit(sink, ret)) > 0);
+
+	return ret;
+}
+
+static int nftnl_set_output_elems_parallel(struct nftnl_sink *sink,
+					   struct nftnl_set *s,
+					   struct nftnl_set_output_ctx *ctx,
+					   unsigned int nthreads)
+{
+	struct nftnl_set_elem *elem, **elems;
+	uint32_t num = 0;
+	int ret;
+
+	list_for_each_entry(elem, &s->element_list, head)
+		num++;
+
+	elems = calloc(num, sizeof(struct nftnl_set_elem *));
+	if (elems == NULL)
+		return -1;
+
+	num = 0;
+	list_for_each_entry(elem, &s->element_list, head)
+		elems[num++] = elem;
+
+	ret = nftnl_sink_parallel(sink, (void **)elems, num,
+				  nftnl_set_output_elem, ctx, nthreads);
+	xfree(elems);
+
+	return ret;
+}
+
+static int nftnl_set_cmd_output(struct nftnl_sink *sink, struct nftnl_set *s,
+				uint32_t cmd, uint32_t type, uint32_t flags,
+				unsigned int nthreads, const char *tag)
+{
+	struct nftnl_set_output_ctx ctx = {
+		.type	= type,
+		.flags	= flags & ~NFTNL_OF_EVENT_ANY,
+	};
+	uint64_t total = sink->total;
+	struct nftnl_set_elem *elem;
+	uint32_t idx = 0;
+	size_t size;
+	char *buf;
+	int ret;
+
+	do {
+		buf = nftnl_sink_reserve(sink, &size);
+		if (buf == NULL)
+			return -1;
+		ret = nftnl_set_snprintf_head(buf, size, s, cmd, type, flags,
+					      tag);
+	} while ((ret = nftnl_sink_commit(sink, ret)) > 0);
+	if (ret < 0)
+		return -1;
+
+	if (nthreads > 1 && !list_empty(&s->element_list)) {
+		if (nftnl_set_output_elems_parallel(sink, s, &ctx,
+						    nthreads) < 0)
+			return -1;
+	} else {
+		list_for_each_entry(elem, &s->element_list, head) {
+			if (nftnl_set_output_elem(sink, elem, idx++, &ctx) < 0)
+				return -1;
+		}
+	}
+
+	do {
+		buf = nftnl_sink_reserve(sink, &size);
+		if (buf == NULL)
+			return -1;
+		ret = nftnl_set_snprintf_tail(buf, size, s, cmd, type, flags);
+	} while ((ret = nftnl_sink_commit(sink, ret)) > 0);
+	if (ret < 0)
+		return -1;
+
+	return sink->total - total;
+}
+
+int nftnl_set_output(struct nftnl_sink *sink, struct nftnl_set *s,
+		     uint32_t type, uint32_t flags)
 {
-	return nftnl_set_snprintf(buf, size, s, type, flags);
+	return nftnl_set_cmd_output(sink, s, nftnl_flag2cmd(flags), type,
+				    flags, 1, "set");
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_set_output);
+
+int nftnl_set_elems_output(struct nftnl_sink *sink, struct nftnl_set *s,
+			   uint32_t type, uint32_t flags)
+{
+	return nftnl_set_cmd_output(sink, s, nftnl_flag2cmd(flags), type,
+				    flags, 1, "element");
+}
+
+int nftnl_set_output_parallel(struct nftnl_sink *sink, struct nftnl_set *s,
+			      uint32_t type, uint32_t flags,
+			      unsigned int nthreads)
+{
+	return nftnl_set_cmd_output(sink, s, nftnl_flag2cmd(flags), type,
+				    flags, nthreads, "set");
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_output_parallel);
 
 int nftnl_set_fprintf(FILE *fp, struct nftnl_set *s, uint32_t type,
 		    uint32_t flags)
 {
-	return nftnl_fprintf(fp, s, NFTNL_CMD_UNSPEC, type, flags,
-			   nftnl_set_do_snprintf);
+	char buf[NFTNL_SNPRINTF_BUFSIZ];
+	struct nftnl_sink sink;
+	int ret;
+
+	nftnl_sink_init_file(&sink, fp, buf, sizeof(buf));
+	ret = nftnl_set_output(&sink, s, type, flags);
+	if (nftnl_sink_release(&sink) < 0)
+		return -1;
+
+	return ret;
 }
 EXPORT_SYMBOL(nftnl_set_fprintf, nft_set_fprintf);
 
@@ -1059,10 +1337,67 @@ void nftnl_set_elem_add(struct nftnl_set *s, struct nftnl_set_elem *elem)
 }
 EXPORT_SYMBOL(nftnl_set_elem_add, nft_set_elem_add);
 
+/* initial number of buckets, doubled as the list grows */
+#define NFTNL_SET_LIST_HSIZE	16
+
 struct nftnl_set_list {
-	struct list_head list;
+	struct list_head	list;
+	struct hlist_head	*name_hash;
+	uint32_t		hsize;
+	/* sets added since the last count, removals do not reach the list */
+	uint32_t		nsets;
 };
 
+static uint32_t nftnl_set_list_hash(uint32_t family, const char *table,
+				    const char *name)
+{
+	uint32_t hash = 5381 + family;
+
+	hash = nftnl_hash_str(hash, table);
+	hash = nftnl_hash_str(hash, name);
+
+	return hash;
+}
+
+static void nftnl_set_list_hash_add(struct nftnl_set *s,
+				    struct nftnl_set_list *list)
+{
+	uint32_t hash = nftnl_set_list_hash(s->family, s->table, s->name);
+
+	hlist_add_head(&s->hnode, &list->name_hash[hash % list->hsize]);
+}
+
+/* Same as for chain lists: at most two sets per bucket. */
+static void nftnl_set_list_grow(struct nftnl_set_list *list)
+{
+	struct hlist_head *name_hash;
+	struct nftnl_set *s;
+	uint32_t hsize, n = 0;
+
+	if (++list->nsets <= 2 * list->hsize)
+		return;
+
+	list_for_each_entry(s, &list->list, head)
+		n++;
+	list->nsets = n;
+
+	for (hsize = list->hsize; hsize < n; hsize *= 2)
+		;
+	if (hsize == list->hsize)
+		return;
+
+	name_hash = calloc(hsize, sizeof(struct hlist_head));
+	if (name_hash == NULL)
+		return;
+
+	xfree(list->name_hash);
+	list->name_hash = name_hash;
+	list->hsize = hsize;
+
+	list_for_each_entry(s, &list->list, head)
+		nftnl_set_list_hash_add(s, list);
+}
+
 struct nftnl_set_list *nftnl_set_list_alloc(void)
 {
 	struct nftnl_set_list *list;
@@ -1071,6 +1406,13 @@ struct nftnl_set_list *nftnl_set_list_alloc(void)
 	if (list == NULL)
 		return NULL;
 
+	list->hsize = NFTNL_SET_LIST_HSIZE;
+	list->name_hash = calloc(list->hsize, sizeof(struct hlist_head));
+	if (list->name_hash == NULL) {
+		xfree(list);
+		return NULL;
+	}
+
 	INIT_LIST_HEAD(&list->list);
 
 	return list;
@@ -1083,8 +1425,10 @@ void nftnl_set_list_free(struct nftnl_set_list *list)
 
 	list_for_each_entry_safe(s, tmp, &list->list, head) {
 		list_del(&s->head);
+		hlist_del_init(&s->hnode);
 		nftnl_set_free(s);
 	}
+	xfree(list->name_hash);
 	xfree(list);
 }
 EXPORT_SYMBOL(nftnl_set_list_free, nft_set_list_free);
@@ -1098,18 +1442,23 @@ EXPORT_SYMBOL(nftnl_set_list_is_empty, nft_set_list_is_empty);
 void nftnl_set_list_add(struct nftnl_set *s, struct nftnl_set_list *list)
 {
 	list_add(&s->head, &list->list);
+	nftnl_set_list_hash_add(s, list);
+	nftnl_set_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_set_list_add, nft_set_list_add);
 
 void nftnl_set_list_add_tail(struct nftnl_set *s, struct nftnl_set_list *list)
 {
 	list_add_tail(&s->head, &list->list);
+	nftnl_set_list_hash_add(s, list);
+	nftnl_set_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_set_list_add_tail, nft_set_list_add_tail);
 
 void nftnl_set_list_del(struct nftnl_set *s)
 {
 	list_del(&s->head);
+	hlist_del_init(&s->hnode);
 }
 EXPORT_SYMBOL(nftnl_set_list_del, nft_set_list_del);
 
@@ -1179,41 +1528,39 @@ void nftnl_set_list_iter_destroy(struct nftnl_set_list_iter *iter)
 }
 EXPORT_SYMBOL(nftnl_set_list_iter_destroy, nft_set_list_iter_destroy);
 
-static struct nftnl_set *nftnl_set_lookup(const char *this_set_name,
-				      struct nftnl_set_list *set_list)
+struct nftnl_set *nftnl_set_list_lookup_byname(struct nftnl_set_list *set_list,
+					       uint32_t family,
+					       const char *table,
+					       const char *name)
 {
-	struct nftnl_set_list_iter *iter;
+	struct hlist_node *n;
 	struct nftnl_set *s;
-	const char *set_name;
+	uint32_t hash;
 
-	iter = nftnl_set_list_iter_create(set_list);
-	if (iter == NULL)
+	if (table == NULL || name == NULL)
 		return NULL;
 
-	s = nftnl_set_list_iter_cur(iter);
-	while (s != NULL) {
-		set_name  = nftnl_set_get_str(s, NFTNL_SET_NAME);
-		if (strcmp(this_set_name, set_name) == 0)
-			break;
-
-		s = nftnl_set_list_iter_next(iter);
+	hash = nftnl_set_list_hash(family, table, name) % set_list->hsize;
+	hlist_for_each_entry(s, n, &set_list->name_hash[hash], hnode) {
+		if (s->family == family &&
+		    nftnl_str_equal(s->table, table) &&
+		    nftnl_str_equal(s->name, name))
+			return s;
 	}
-	nftnl_set_list_iter_destroy(iter);
-
-	return s;
+	return NULL;
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_set_list_lookup_byname);
 
-int nftnl_set_lookup_id(struct nftnl_expr *e,
-		      struct nftnl_set_list *set_list, uint32_t *set_id)
+int nftnl_set_lookup_id(const char *set_name,
+		      struct nftnl_set_list *set_list, uint32_t family,
+		      const char *table, uint32_t *set_id)
 {
-	const char *set_name;
 	struct nftnl_set *s;
 
-	set_name = nftnl_expr_get_str(e, NFTNL_EXPR_LOOKUP_SET);
 	if (set_name == NULL)
 		return 0;
 
-	s = nftnl_set_lookup(set_name, set_list);
+	s = nftnl_set_list_lookup_byname(set_list, family, table, set_name);
 	if (s == NULL)
 		return 0;
 
@@ -0,0 +1,299 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+
+/*
+ * Elements are matched by key (and interval end flag). An element that is
+ * present in both sets but whose data/verdict differs is deleted and added
+ * again, since the kernel does not allow to update the element mapping.
+ */
+
+enum {
+	NFTNL_SET_ELEM_DIFF_DEL	= 0,
+	NFTNL_SET_ELEM_DIFF_KEEP,
+	NFTNL_SET_ELEM_DIFF_REPLACE,
+};
+
+struct nftnl_set_elem_slot {
+	uint32_t			idx;	/* position + 1, zero is free */
+	uint32_t			hash;
+};
+
+struct nftnl_set_elem_delta {
+	struct nftnl_set_elem		**add;
+	uint32_t			num_add;
+	struct nftnl_set_elem		**del;
+	uint32_t			num_del;
+};
+
+static bool nftnl_set_elem_interval_end(const struct nftnl_set_elem *e)
+{
+	return (e->flags & (1 << NFTNL_SET_ELEM_FLAGS)) &&
+	       (e->set_elem_flags & NFT_SET_ELEM_INTERVAL_END);
+}
+
+uint32_t nftnl_set_elem_hash(const struct nftnl_set_elem *e)
+{
+	const uint8_t *key = nftnl_set_elem_key(e);
+	uint32_t i, hash = 2166136261U;
+
+	for (i = 0; i < e->key_len; i++) {
+		hash ^= key[i];
+		hash *= 16777619U;
+	}
+	return hash ^ nftnl_set_elem_interval_end(e);
+}
+
+bool nftnl_set_elem_key_equal(const struct nftnl_set_elem *a,
+			      const struct nftnl_set_elem *b)
+{
+	return a->key_len == b->key_len &&
+	       memcmp(nftnl_set_elem_key(a), nftnl_set_elem_key(b),
+		      a->key_len) == 0 &&
+	       nftnl_set_elem_interval_end(a) == nftnl_set_elem_interval_end(b);
+}
+
+static bool nftnl_set_elem_data_equal(const struct nftnl_set_elem *a,
+				      const struct nftnl_set_elem *b)
+{
+	uint32_t mask = (1 << NFTNL_SET_ELEM_DATA) |
+			(1 << NFTNL_SET_ELEM_VERDICT) |
+			(1 << NFTNL_SET_ELEM_CHAIN);
+
+	if ((a->flags & mask) != (b->flags & mask))
+		return false;
+
+	if (a->flags & (1 << NFTNL_SET_ELEM_DATA) &&
+	    (a->data_len != b->data_len ||
+	     memcmp(nftnl_set_elem_data(a), nftnl_set_elem_data(b),
+		    a->data_len) != 0))
+		return false;
+	if (a->flags & (1 << NFTNL_SET_ELEM_VERDICT) &&
+	    a->verdict != b->verdict)
+		return false;
+	if (a->flags & (1 << NFTNL_SET_ELEM_CHAIN) &&
+	    strcmp(a->chain, b->chain) != 0)
+		return false;
+
+	return true;
+}
+
+static uint32_t nftnl_set_elem_count(const struct nftnl_set *s)
+{
+	struct nftnl_set_elem *elem;
+	uint32_t num = 0;
+
+	list_for_each_entry(elem, &s->element_list, head)
+		num++;
+
+	return num;
+}
+
+static void nftnl_set_elem_delta_free(struct nftnl_set_elem_delta *d)
+{
+	xfree(d->add);
+	xfree(d->del);
+}
+
+static int nftnl_set_elem_delta_build(struct nftnl_set_elem_delta *d,
+				      const struct nftnl_set *cur,
+				      const struct nftnl_set *want)
+{
+	struct nftnl_set_elem **cur_elems, *elem;
+	struct nftnl_set_elem_slot *slots, *slot;
+	uint32_t num_cur, num_want, size = 16, mask, hash, i;
+	uint8_t *state;
+
+	num_cur = nftnl_set_elem_count(cur);
+	num_want = nftnl_set_elem_count(want);
+
+	while (size < num_cur * 2)
+		size <<= 1;
+	mask = size - 1;
+
+	memset(d, 0, sizeof(*d));
+	cur_elems = calloc(num_cur + 1, sizeof(struct nftnl_set_elem *));
+	state = calloc(num_cur + 1, sizeof(uint8_t));
+	slots = calloc(size, sizeof(struct nftnl_set_elem_slot));
+	d->add = calloc(num_want + 1, sizeof(struct nftnl_set_elem *));
+	d->del = calloc(num_cur + 1, sizeof(struct nftnl_set_elem *));
+	if (cur_elems == NULL || state == NULL || slots == NULL ||
+	    d->add == NULL || d->del == NULL)
+		goto err;
+
+	i = 0;
+	list_for_each_entry(elem, &cur->element_list, head) {
+		hash = nftnl_set_elem_hash(elem);
+		slot = &slots[hash & mask];
+		while (slot->idx != 0)
+			slot = &slots[(slot - slots + 1) & mask];
+
+		cur_elems[i] = elem;
+		slot->idx = ++i;
+		slot->hash = hash;
+	}
+
+	list_for_each_entry(elem, &want->element_list, head) {
+		hash = nftnl_set_elem_hash(elem);
+		slot = &slots[hash & mask];
+		while (slot->idx != 0) {
+			if (slot->hash == hash &&
+			    nftnl_set_elem_key_equal(cur_elems[slot->idx - 1],
+						     elem))
+				break;
+			slot = &slots[(slot - slots + 1) & mask];
+		}
+
+		if (slot->idx == 0) {
+			d->add[d->num_add++] = elem;
+			continue;
+		}
+		/* Duplicated key in the desired set, first one wins. */
+		if (state[slot->idx - 1] != NFTNL_SET_ELEM_DIFF_DEL)
+			continue;
+
+		if (nftnl_set_elem_data_equal(cur_elems[slot->idx - 1], elem)) {
+			state[slot->idx - 1] = NFTNL_SET_ELEM_DIFF_KEEP;
+		} else {
+			state[slot->idx - 1] = NFTNL_SET_ELEM_DIFF_REPLACE;
+			d->add[d->num_add++] = elem;
+		}
+	}
+
+	for (i = 0; i < num_cur; i++) {
+		if (state[i] != NFTNL_SET_ELEM_DIFF_KEEP)
+			d->del[d->num_del++] = cur_elems[i];
+	}
+
+	xfree(slots);
+	xfree(state);
+	xfree(cur_elems);
+	return 0;
+err:
+	xfree(slots);
+	xfree(state);
+	xfree(cur_elems);
+	nftnl_set_elem_delta_free(d);
+	errno = ENOMEM;
+	return -1;
+}
+
+static int nftnl_set_elems_diff_clone(struct nftnl_set *s,
+				      struct nftnl_set_elem **elems,
+				      uint32_t num)
+{
+	struct nftnl_set_elem *elem;
+	uint32_t i;
+
+	for (i = 0; i < num; i++) {
+		elem = nftnl_set_elem_clone(elems[i]);
+		if (elem == NULL)
+			return -1;
+
+		nftnl_set_elem_add(s, elem);
+	}
+	return 0;
+}
+
+int nftnl_set_elems_diff(struct nftnl_set *cur, struct nftnl_set *want,
+			 struct nftnl_set *add, struct nftnl_set *del)
+{
+	struct nftnl_set_elem_delta d;
+	int ret = -1;
+
+	if (nftnl_set_elem_delta_build(&d, cur, want) < 0)
+		return -1;
+
+	if (nftnl_set_elems_diff_clone(add, d.add, d.num_add) < 0 ||
+	    nftnl_set_elems_diff_clone(del, d.del, d.num_del) < 0) {
+		errno = ENOMEM;
+		goto out;
+	}
+	ret = 0;
+out:
+	nftnl_set_elem_delta_free(&d);
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_diff);
+
+static int nftnl_set_elems_batch_put(struct nftnl_batch *batch, uint16_t cmd,
+				     uint16_t type, struct nftnl_set *s,
+				     struct nftnl_set_elem **elems,
+				     uint32_t num, uint32_t *seq)
+{
+	struct nlmsghdr *nlh;
+	uint32_t pos = 0, last;
+	int more, msgs = 0;
+
+	if (num == 0)
+		return 0;
+
+	do {
+		last = pos;
+		nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch), cmd,
+					    s->family, type, (*seq)++);
+		more = nftnl_set_elems_nlmsg_build_payload_array(nlh, s, elems,
+								 num, &pos);
+		if (pos == last) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+		if (nftnl_batch_update(batch) < 0)
+			return -1;
+
+		msgs++;
+	} while (more);
+
+	return msgs;
+}
+
+int nftnl_set_elems_batch_diff(struct nftnl_batch *batch,
+			       struct nftnl_set *cur, struct nftnl_set *want,
+			       uint32_t *seq)
+{
+	struct nftnl_set_elem_delta d;
+	int ret, msgs;
+
+	if (!(want->flags & (1 << NFTNL_SET_TABLE)) ||
+	    !(want->flags & (1 << NFTNL_SET_NAME))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (nftnl_set_elem_delta_build(&d, cur, want) < 0)
+		return -1;
+
+	/* Deletions go first, so replaced elements can be added back. */
+	ret = nftnl_set_elems_batch_put(batch, NFT_MSG_DELSETELEM, NLM_F_ACK,
+					want, d.del, d.num_del, seq);
+	if (ret < 0)
+		goto out;
+	msgs = ret;
+
+	ret = nftnl_set_elems_batch_put(batch, NFT_MSG_NEWSETELEM,
+					NLM_F_CREATE | NLM_F_ACK,
+					want, d.add, d.num_add, seq);
+	if (ret < 0)
+		goto out;
+	ret += msgs;
+out:
+	nftnl_set_elem_delta_free(&d);
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_batch_diff);
@@ -27,24 +27,62 @@
 #include <libnftnl/rule.h>
 #include <libnftnl/expr.h>
 
-struct nftnl_set_elem *nftnl_set_elem_alloc(void)
+static size_t nftnl_set_elem_size(uint32_t key_size, uint32_t data_size)
+{
+	return sizeof(struct nftnl_set_elem) + key_size + data_size;
+}
+
+static struct nftnl_set_elem *__nftnl_set_elem_alloc(uint32_t key_len,
+						     uint32_t data_len)
 {
 	struct nftnl_set_elem *s;
+	uint32_t key_size, data_size;
 
-	s = calloc(1, sizeof(struct nftnl_set_elem));
+	if (key_len > NFT_DATA_VALUE_MAXLEN)
+		key_len = NFT_DATA_VALUE_MAXLEN;
+	if (data_len > NFT_DATA_VALUE_MAXLEN)
+		data_len = NFT_DATA_VALUE_MAXLEN;
+
+	/* Keep data aligned, it is read as an array of 32 bits words. */
+	key_size = div_round_up(key_len, sizeof(uint32_t)) * sizeof(uint32_t);
+	data_size = div_round_up(data_len, sizeof(uint32_t)) * sizeof(uint32_t);
+
+	s = calloc(1, nftnl_set_elem_size(key_size, data_size));
 	if (s == NULL)
 		return NULL;
 
+	s->key_size = key_size;
+	s->data_size = data_size;
+
 	return s;
 }
+
+struct nftnl_set_elem *nftnl_set_elem_alloc(void)
+{
+	return __nftnl_set_elem_alloc(NFT_DATA_VALUE_MAXLEN,
+				      NFT_DATA_VALUE_MAXLEN);
+}
 EXPORT_SYMBOL(nftnl_set_elem_alloc, nft_set_elem_alloc);
 
+struct nftnl_set_elem *nftnl_set_elem_alloc_compact(const struct nftnl_set *s)
+{
+	uint32_t key_len = NFT_DATA_VALUE_MAXLEN, data_len = 0;
+
+	if (s->flags & (1 << NFTNL_SET_KEY_LEN))
+		key_len = s->key_len;
+	if (s->flags & (1 << NFTNL_SET_DATA_LEN))
+		data_len = s->data_len;
+
+	return __nftnl_set_elem_alloc(key_len, data_len);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elem_alloc_compact);
+
 void nftnl_set_elem_free(struct nftnl_set_elem *s)
 {
 	if (s->flags & (1 << NFTNL_SET_ELEM_CHAIN)) {
-		if (s->data.chain) {
-			xfree(s->data.chain);
-			s->data.chain = NULL;
+		if (s->chain) {
+			xfree(s->chain);
+			s->chain = NULL;
 		}
 	}
 
@@ -66,9 +104,9 @@ void nftnl_set_elem_unset(struct nftnl_set_elem *s, uint16_t attr)
 	switch (attr) {
 	case NFTNL_SET_ELEM_CHAIN:
 		if (s->flags & (1 << NFTNL_SET_ELEM_CHAIN)) {
-			if (s->data.chain) {
-				xfree(s->data.chain);
-				s->data.chain = NULL;
+			if (s->chain) {
+				xfree(s->chain);
+				s->chain = NULL;
 			}
 		}
 		break;
@@ -102,21 +140,28 @@ void nftnl_set_elem_set(struct nftnl_set_elem *s, uint16_t attr,
 		s->set_elem_flags = *((uint32_t *)data);
 		break;
 	case NFTNL_SET_ELEM_KEY:	/* NFTA_SET_ELEM_KEY */
-		memcpy(&s->key.val, data, data_len);
-		s->key.len = data_len;
+		/* No room for it, see nftnl_set_elem_alloc_compact() */
+		if (data_len > s->key_size)
+			return;
+
+		memcpy(nftnl_set_elem_key(s), data, data_len);
+		s->key_len = data_len;
 		break;
 	case NFTNL_SET_ELEM_VERDICT:	/* NFTA_SET_ELEM_DATA */
-		s->data.verdict = *((uint32_t *)data);
+		s->verdict = *((uint32_t *)data);
 		break;
 	case NFTNL_SET_ELEM_CHAIN:	/* NFTA_SET_ELEM_DATA */
-		if (s->data.chain)
-			xfree(s->data.chain);
+		if (s->chain)
+			xfree(s->chain);
 
-		s->data.chain = strdup(data);
+		s->chain = strdup(data);
 		break;
 	case NFTNL_SET_ELEM_DATA:	/* NFTA_SET_ELEM_DATA */
-		memcpy(s->data.val, data, data_len);
-		s->data.len = data_len;
+		if (data_len > s->data_size)
+			return;
+
+		memcpy(nftnl_set_elem_data(s), data, data_len);
+		s->data_len = data_len;
 		break;
 	case NFTNL_SET_ELEM_TIMEOUT:	/* NFTA_SET_ELEM_TIMEOUT */
 		s->timeout = *((uint64_t *)data);
@@ -159,15 +204,15 @@ const void *nftnl_set_elem_get(struct nftnl_set_elem *s, uint16_t attr, uint32_t
 	case NFTNL_SET_ELEM_FLAGS:
 		return &s->set_elem_flags;
 	case NFTNL_SET_ELEM_KEY:	/* NFTA_SET_ELEM_KEY */
-		*data_len = s->key.len;
-		return &s->key.val;
+		*data_len = s->key_len;
+		return nftnl_set_elem_key(s);
 	case NFTNL_SET_ELEM_VERDICT:	/* NFTA_SET_ELEM_DATA */
-		return &s->data.verdict;
+		return &s->verdict;
 	case NFTNL_SET_ELEM_CHAIN:	/* NFTA_SET_ELEM_DATA */
-		return s->data.chain;
+		return s->chain;
 	case NFTNL_SET_ELEM_DATA:	/* NFTA_SET_ELEM_DATA */
-		*data_len = s->data.len;
-		return &s->data.val;
+		*data_len = s->data_len;
+		return nftnl_set_elem_data(s);
 	case NFTNL_SET_ELEM_TIMEOUT:	/* NFTA_SET_ELEM_TIMEOUT */
 		return &s->timeout;
 	case NFTNL_SET_ELEM_EXPIRATION:	/* NFTA_SET_ELEM_EXPIRATION */
@@ -210,14 +255,15 @@ struct nftnl_set_elem *nftnl_set_elem_clone(struct nftnl_set_elem *elem)
 {
 	struct nftnl_set_elem *newelem;
 
-	newelem = nftnl_set_elem_alloc();
+	newelem = __nftnl_set_elem_alloc(elem->key_size, elem->data_size);
 	if (newelem == NULL)
 		return NULL;
 
-	memcpy(newelem, elem, sizeof(*elem));
+	memcpy(newelem, elem, nftnl_set_elem_size(elem->key_size,
+						  elem->data_size));
 
 	if (elem->flags & (1 << NFTNL_SET_ELEM_CHAIN))
-		newelem->data.chain = strdup(elem->data.chain);
+		newelem->chain = strdup(elem->chain);
 
 	return newelem;
 }
@@ -233,7 +279,8 @@ void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 		struct nlattr *nest1;
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_KEY);
-		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->key.len, e->key.val);
+		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->key_len,
+			     nftnl_set_elem_key(e));
 		mnl_attr_nest_end(nlh, nest1);
 	}
 	if (e->flags & (1 << NFTNL_SET_ELEM_VERDICT)) {
@@ -241,9 +288,9 @@ void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_DATA);
 		nest2 = mnl_attr_nest_start(nlh, NFTA_DATA_VERDICT);
-		mnl_attr_put_u32(nlh, NFTA_VERDICT_CODE, htonl(e->data.verdict));
+		mnl_attr_put_u32(nlh, NFTA_VERDICT_CODE, htonl(e->verdict));
 		if (e->flags & (1 << NFTNL_SET_ELEM_CHAIN))
-			mnl_attr_put_strz(nlh, NFTA_VERDICT_CHAIN, e->data.chain);
+			mnl_attr_put_strz(nlh, NFTA_VERDICT_CHAIN, e->chain);
 
 		mnl_attr_nest_end(nlh, nest1);
 		mnl_attr_nest_end(nlh, nest2);
@@ -252,15 +299,16 @@ void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 		struct nlattr *nest1;
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_DATA);
-		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->data.len, e->data.val);
+		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->data_len,
+			     nftnl_set_elem_data(e));
 		mnl_attr_nest_end(nlh, nest1);
 	}
 	if (e->flags & (1 << NFTNL_SET_ELEM_USERDATA))
 		mnl_attr_put(nlh, NFTA_SET_ELEM_USERDATA, e->user.len, e->user.data);
 }
 
-static void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
-					 struct nftnl_set *s)
+void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
+				    struct nftnl_set *s)
 {
 	if (s->flags & (1 << NFTNL_SET_NAME))
 		mnl_attr_put_strz(nlh, NFTA_SET_ELEM_LIST_SET, s->name);
@@ -270,8 +318,8 @@ static void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
 		mnl_attr_put_strz(nlh, NFTA_SET_ELEM_LIST_TABLE, s->table);
 }
 
-static struct nlattr *nftnl_set_elem_build(struct nlmsghdr *nlh,
-					      struct nftnl_set_elem *elem, int i)
+struct nlattr *nftnl_set_elem_build(struct nlmsghdr *nlh,
+				    struct nftnl_set_elem *elem, int i)
 {
 	struct nlattr *nest2;
 
@@ -298,12 +346,27 @@ void nftnl_set_elems_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set
 }
 EXPORT_SYMBOL(nftnl_set_elems_nlmsg_build_payload, nft_set_elems_nlmsg_build_payload);
 
+/* Element attributes decoded from each NFTA_SET_ELEM_* attribute. */
+static const uint32_t nftnl_set_elem_attr_mask[NFTA_SET_ELEM_MAX + 1] = {
+	[NFTA_SET_ELEM_KEY]		= (1 << NFTNL_SET_ELEM_KEY),
+	[NFTA_SET_ELEM_DATA]		= (1 << NFTNL_SET_ELEM_VERDICT) |
+					  (1 << NFTNL_SET_ELEM_CHAIN) |
+					  (1 << NFTNL_SET_ELEM_DATA),
+	[NFTA_SET_ELEM_FLAGS]		= (1 << NFTNL_SET_ELEM_FLAGS),
+	[NFTA_SET_ELEM_TIMEOUT]		= (1 << NFTNL_SET_ELEM_TIMEOUT),
+	[NFTA_SET_ELEM_EXPIRATION]	= (1 << NFTNL_SET_ELEM_EXPIRATION),
+	[NFTA_SET_ELEM_USERDATA]	= (1 << NFTNL_SET_ELEM_USERDATA),
+	[NFTA_SET_ELEM_EXPR]		= (1 << NFTNL_SET_ELEM_EXPR),
+};
+
 static int nftnl_set_elem_parse_attr_cb(const struct nlattr *attr, void *data)
 {
-	const struct nlattr **tb = data;
+	struct nftnl_nlmsg_parse_ctx *ctx = data;
 	int type = mnl_attr_get_type(attr);
 
-	if (mnl_attr_type_valid(attr, NFTA_SET_MAX) < 0)
+	if (mnl_attr_type_valid(attr, NFTA_SET_ELEM_MAX) < 0)
+		return MNL_CB_OK;
+	if (!(ctx->mask & nftnl_set_elem_attr_mask[type]))
 		return MNL_CB_OK;
 
 	switch(type) {
@@ -328,22 +391,37 @@ static int nftnl_set_elem_parse_attr_cb(const struct nlattr *attr, void *data)
 		break;
 	}
 
-	tb[type] = attr;
+	ctx->tb[type] = attr;
 	return MNL_CB_OK;
 }
 
-static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest)
+static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest,
+				  uint32_t mask)
 {
 	struct nlattr *tb[NFTA_SET_ELEM_MAX+1] = {};
+	struct nftnl_nlmsg_parse_ctx ctx = {
+		.tb	= (const struct nlattr **)tb,
+		.mask	= mask,
+	};
+	union nftnl_data_reg key = {}, data = {};
+	int type = DATA_NONE;
 	struct nftnl_set_elem *e;
-	int ret = 0, type;
 
-	e = nftnl_set_elem_alloc();
-	if (e == NULL)
+	if (mnl_attr_parse_nested(nest, nftnl_set_elem_parse_attr_cb, &ctx) < 0)
+		return -1;
+
+	/* Element is allocated as large as the key and data it carries. */
+	if (tb[NFTA_SET_ELEM_KEY] &&
+	    nftnl_parse_data(&key, tb[NFTA_SET_ELEM_KEY], NULL) < 0)
+		return -1;
+	if (tb[NFTA_SET_ELEM_DATA] &&
+	    nftnl_parse_data(&data, tb[NFTA_SET_ELEM_DATA], &type) < 0)
 		return -1;
 
-	if (mnl_attr_parse_nested(nest, nftnl_set_elem_parse_attr_cb, tb) < 0) {
-		nftnl_set_elem_free(e);
+	e = __nftnl_set_elem_alloc(key.len, type == DATA_VALUE ? data.len : 0);
+	if (e == NULL) {
+		if (type == DATA_CHAIN)
+			xfree(data.chain);
 		return -1;
 	}
 
@@ -360,25 +438,30 @@ static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest
 		e->expiration = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_EXPIRATION]));
 		e->flags |= (1 << NFTNL_SET_ELEM_EXPIRATION);
 	}
-        if (tb[NFTA_SET_ELEM_KEY]) {
-		ret = nftnl_parse_data(&e->key, tb[NFTA_SET_ELEM_KEY], &type);
+	if (tb[NFTA_SET_ELEM_KEY]) {
+		memcpy(nftnl_set_elem_key(e), key.val, key.len);
+		e->key_len = key.len;
 		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
-        }
-        if (tb[NFTA_SET_ELEM_DATA]) {
-		ret = nftnl_parse_data(&e->data, tb[NFTA_SET_ELEM_DATA], &type);
+	}
+	if (tb[NFTA_SET_ELEM_DATA]) {
 		switch(type) {
 		case DATA_VERDICT:
+			e->verdict = data.verdict;
 			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
 			break;
 		case DATA_CHAIN:
+			e->verdict = data.verdict;
+			e->chain = data.chain;
 			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT) |
 				    (1 << NFTNL_SET_ELEM_CHAIN);
 			break;
 		case DATA_VALUE:
+			memcpy(nftnl_set_elem_data(e), data.val, data.len);
+			e->data_len = data.len;
 			e->flags |= (1 << NFTNL_SET_ELEM_DATA);
 			break;
 		}
-        }
+	}
 	if (tb[NFTA_SET_ELEM_EXPR]) {
 		e->expr = nftnl_expr_parse(tb[NFTA_SET_ELEM_EXPR]);
 		if (e->expr == NULL)
@@ -400,16 +483,13 @@ static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest
 		e->flags |= (1 << NFTNL_RULE_USERDATA);
 	}
 
-	if (ret < 0) {
-err:
-		nftnl_set_elem_free(e);
-		return -1;
-	}
-
 	/* Add this new element to this set */
 	list_add_tail(&e->head, &s->element_list);
 
-	return ret;
+	return 0;
+err:
+	nftnl_set_elem_free(e);
+	return -1;
 }
 
 static int
@@ -437,21 +517,26 @@ nftnl_set_elem_list_parse_attr_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int nftnl_set_elems_parse(struct nftnl_set *s, const struct nlattr *nest)
+static int nftnl_set_elems_parse(struct nftnl_set *s, const struct nlattr *nest,
+				 uint32_t mask)
 {
 	struct nlattr *attr;
 	int ret = 0;
 
+	/*
+	 * The kernel does not look at the type of the element nests, and
+	 * nftnl_set_elem_build() numbers them, so neither do we.
+	 */
 	mnl_attr_for_each_nested(attr, nest) {
-		if (mnl_attr_get_type(attr) != NFTA_LIST_ELEM)
-			return -1;
-
-		ret = nftnl_set_elems_parse2(s, attr);
+		ret = nftnl_set_elems_parse2(s, attr, mask);
+		if (ret < 0)
+			break;
 	}
 	return ret;
 }
 
-int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
+int nftnl_set_elems_nlmsg_parse_mask(const struct nlmsghdr *nlh,
+				     struct nftnl_set *s, uint32_t mask)
 {
 	struct nlattr *tb[NFTA_SET_ELEM_LIST_MAX+1] = {};
 	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
@@ -462,15 +547,15 @@ int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 		return -1;
 
 	if (tb[NFTA_SET_ELEM_LIST_TABLE]) {
-		xfree(s->table);
-		s->table =
-			strdup(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_TABLE]));
+		nftnl_str_release(s->table);
+		s->table = nftnl_str_intern(
+				mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_TABLE]));
 		s->flags |= (1 << NFTNL_SET_TABLE);
 	}
 	if (tb[NFTA_SET_ELEM_LIST_SET]) {
-		xfree(s->name);
-		s->name =
-			strdup(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_SET]));
+		nftnl_str_release(s->name);
+		s->name = nftnl_str_intern(
+				mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_SET]));
 		s->flags |= (1 << NFTNL_SET_NAME);
 	}
 	if (tb[NFTA_SET_ELEM_LIST_SET_ID]) {
@@ -478,19 +563,27 @@ int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 		s->flags |= (1 << NFTNL_SET_ID);
 	}
         if (tb[NFTA_SET_ELEM_LIST_ELEMENTS])
-	 	ret = nftnl_set_elems_parse(s, tb[NFTA_SET_ELEM_LIST_ELEMENTS]);
+	 	ret = nftnl_set_elems_parse(s, tb[NFTA_SET_ELEM_LIST_ELEMENTS],
+					    mask);
 
 	s->family = nfg->nfgen_family;
 	s->flags |= (1 << NFTNL_SET_FAMILY);
 
 	return ret;
 }
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_nlmsg_parse_mask);
+
+int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
+{
+	return nftnl_set_elems_nlmsg_parse_mask(nlh, s, ~0U);
+}
 EXPORT_SYMBOL(nftnl_set_elems_nlmsg_parse, nft_set_elems_nlmsg_parse);
 
 #ifdef XML_PARSING
 int nftnl_mxml_set_elem_parse(mxml_node_t *tree, struct nftnl_set_elem *e,
 			    struct nftnl_parse_err *err)
 {
+	union nftnl_data_reg key = {}, data = {};
 	int set_elem_data;
 	uint32_t set_elem_flags;
 
@@ -499,22 +592,24 @@ int nftnl_mxml_set_elem_parse(mxml_node_t *tree, struct nftnl_set_elem *e,
 			       err) == 0)
 		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS, set_elem_flags);
 
-	if (nftnl_mxml_data_reg_parse(tree, "key", &e->key,
+	if (nftnl_mxml_data_reg_parse(tree, "key", &key,
 				    NFTNL_XML_MAND, err) == DATA_VALUE)
-		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key.val, key.len);
 
 	/* <set_elem_data> is not mandatory */
 	set_elem_data = nftnl_mxml_data_reg_parse(tree, "data",
-						&e->data, NFTNL_XML_OPT, err);
+						&data, NFTNL_XML_OPT, err);
 	switch (set_elem_data) {
 	case DATA_VALUE:
-		e->flags |= (1 << NFTNL_SET_ELEM_DATA);
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, data.val, data.len);
 		break;
 	case DATA_VERDICT:
-		e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
-		if (e->data.chain != NULL)
-			e->flags |= (1 << NFTNL_SET_ELEM_CHAIN);
-
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT, data.verdict);
+		if (data.chain != NULL) {
+			nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN,
+					       data.chain);
+			xfree(data.chain);
+		}
 		break;
 	}
 
@@ -545,13 +640,14 @@ static int nftnl_set_elem_xml_parse(struct nftnl_set_elem *e, const void *xml,
 
 static int nftnl_set_elem_json_parse(struct nftnl_set_elem *e, const void *json,
 				   struct nftnl_parse_err *err,
-				   enum nftnl_parse_input input)
+				   enum nftnl_parse_input input,
+				   enum nftnl_parse_type type)
 {
 #ifdef JSON_PARSING
 	json_t *tree;
 	json_error_t error;
 
-	tree = nftnl_jansson_create_root(json, &error, err, input);
+	tree = nftnl_jansson_create_root(json, &error, err, input, type);
 	if (tree == NULL)
 		return -1;
 
@@ -574,7 +670,8 @@ nftnl_set_elem_do_parse(struct nftnl_set_elem *e, enum nftnl_parse_type type,
 		ret = nftnl_set_elem_xml_parse(e, data, err, input);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_set_elem_json_parse(e, data, err, input);
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_set_elem_json_parse(e, data, err, input, type);
 		break;
 	default:
 		errno = EOPNOTSUPP;
@@ -598,9 +695,29 @@ int nftnl_set_elem_parse_file(struct nftnl_set_elem *e, enum nftnl_parse_type ty
 }
 EXPORT_SYMBOL(nftnl_set_elem_parse_file, nft_set_elem_parse_file);
 
+static void nftnl_set_elem_key_reg(const struct nftnl_set_elem *e,
+				   union nftnl_data_reg *reg)
+{
+	memcpy(reg->val, nftnl_set_elem_key(e), e->key_len);
+	reg->len = e->key_len;
+}
+
+static void nftnl_set_elem_data_reg(const struct nftnl_set_elem *e,
+				    union nftnl_data_reg *reg)
+{
+	if (e->flags & (1 << NFTNL_SET_ELEM_DATA)) {
+		memcpy(reg->val, nftnl_set_elem_data(e), e->data_len);
+		reg->len = e->data_len;
+	} else {
+		reg->verdict = e->verdict;
+		reg->chain = e->chain;
+	}
+}
+
 static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 				      struct nftnl_set_elem *e, uint32_t flags)
 {
+	union nftnl_data_reg key = {}, data = {};
 	int ret, len = size, offset = 0, type = -1;
 
 	if (e->flags & (1 << NFTNL_SET_ELEM_FLAGS)) {
@@ -611,7 +728,8 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 	ret = snprintf(buf + offset, len, "\"key\":{");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-	ret = nftnl_data_reg_snprintf(buf + offset, len, &e->key,
+	nftnl_set_elem_key_reg(e, &key);
+	ret = nftnl_data_reg_snprintf(buf + offset, len, &key,
 				    NFTNL_OUTPUT_JSON, flags, DATA_VALUE);
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
@@ -629,7 +747,8 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 		ret = snprintf(buf + offset, len, ",\"data\":{");
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-		ret = nftnl_data_reg_snprintf(buf + offset, len, &e->data,
+		nftnl_set_elem_data_reg(e, &data);
+		ret = nftnl_data_reg_snprintf(buf + offset, len, &data,
 					    NFTNL_OUTPUT_JSON, flags, type);
 			SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
@@ -640,24 +759,83 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 	return offset;
 }
 
+static int nftnl_set_elem_snprintf_cbor(char *buf, size_t size,
+					struct nftnl_set_elem *e, uint32_t flags)
+{
+	union nftnl_data_reg key = {}, data = {};
+	int ret, len = size, offset = 0, type = -1;
+
+	if (e->flags & (1 << NFTNL_SET_ELEM_FLAGS)) {
+		ret = nftnl_cbor_pair_uint(buf, len, "flags", e->set_elem_flags);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	ret = nftnl_cbor_str(buf + offset, len, "key");
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf + offset, len,
+			      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	nftnl_set_elem_key_reg(e, &key);
+	ret = nftnl_data_reg_snprintf(buf + offset, len, &key,
+				      NFTNL_OUTPUT_CBOR, flags, DATA_VALUE);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	ret = nftnl_cbor_byte(buf + offset, len, NFTNL_CBOR_BREAK);
+	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+	if (e->flags & (1 << NFTNL_SET_ELEM_DATA))
+		type = DATA_VALUE;
+	else if (e->flags & (1 << NFTNL_SET_ELEM_CHAIN))
+		type = DATA_CHAIN;
+	else if (e->flags & (1 << NFTNL_SET_ELEM_VERDICT))
+		type = DATA_VERDICT;
+
+	if (type != -1) {
+		ret = nftnl_cbor_str(buf + offset, len, "data");
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_byte(buf + offset, len,
+				      NFTNL_CBOR_MAP | NFTNL_CBOR_INDEF);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		nftnl_set_elem_data_reg(e, &data);
+		ret = nftnl_data_reg_snprintf(buf + offset, len, &data,
+					      NFTNL_OUTPUT_CBOR, flags, type);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+
+		ret = nftnl_cbor_byte(buf + offset, len, NFTNL_CBOR_BREAK);
+		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
+	}
+
+	return offset;
+}
+
 static int nftnl_set_elem_snprintf_default(char *buf, size_t size,
 					 struct nftnl_set_elem *e)
 {
+	uint32_t *key = nftnl_set_elem_key(e), *data = nftnl_set_elem_data(e);
 	int ret, len = size, offset = 0, i;
+	char word[9];
+
+	word[8] = ' ';
 
 	ret = snprintf(buf, len, "element ");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-	for (i = 0; i < div_round_up(e->key.len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf+offset, len, "%.8x ", e->key.val[i]);
+	for (i = 0; i < div_round_up(e->key_len, sizeof(uint32_t)); i++) {
+		nftnl_fmt_hex32(word, key[i]);
+		ret = nftnl_fmt_copy(buf+offset, len, word, sizeof(word));
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
 	ret = snprintf(buf+offset, len, " : ");
 	SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-	for (i = 0; i < div_round_up(e->data.len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf+offset, len, "%.8x ", e->data.val[i]);
+	for (i = 0; i < div_round_up(e->data_len, sizeof(uint32_t)); i++) {
+		nftnl_fmt_hex32(word, data[i]);
+		ret = nftnl_fmt_copy(buf+offset, len, word, sizeof(word));
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 	}
 
@@ -686,6 +864,7 @@ static int nftnl_set_elem_snprintf_default(char *buf, size_t size,
 static int nftnl_set_elem_snprintf_xml(char *buf, size_t size,
 				     struct nftnl_set_elem *e, uint32_t flags)
 {
+	union nftnl_data_reg key = {}, data = {};
 	int ret, len = size, offset = 0, type = DATA_NONE;
 
 	ret = snprintf(buf, size, "<set_elem>");
@@ -701,7 +880,8 @@ static int nftnl_set_elem_snprintf_xml(char *buf, size_t size,
 		ret = snprintf(buf + offset, len, "<key>");
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-		ret = nftnl_data_reg_snprintf(buf + offset, len, &e->key,
+		nftnl_set_elem_key_reg(e, &key);
+		ret = nftnl_data_reg_snprintf(buf + offset, len, &key,
 					    NFTNL_OUTPUT_XML, flags, DATA_VALUE);
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
@@ -720,7 +900,8 @@ static int nftnl_set_elem_snprintf_xml(char *buf, size_t size,
 		ret = snprintf(buf + offset, len, "<data>");
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
-		ret = nftnl_data_reg_snprintf(buf + offset, len, &e->data,
+		nftnl_set_elem_data_reg(e, &data);
+		ret = nftnl_data_reg_snprintf(buf + offset, len, &data,
 					    NFTNL_OUTPUT_XML, flags, type);
 		SNPRINTF_BUFFER_SIZE(ret, size, len, offset);
 
@@ -753,6 +934,9 @@ static int nftnl_set_elem_cmd_snprintf(char *buf, size_t size,
 	case NFTNL_OUTPUT_JSON:
 		ret = nftnl_set_elem_snprintf_json(buf+offset, len, e, flags);
 		break;
+	case NFTNL_OUTPUT_CBOR:
+		ret = nftnl_set_elem_snprintf_cbor(buf+offset, len, e, flags);
+		break;
 	default:
 		return -1;
 	}
@@ -901,3 +1085,25 @@ int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 	return ret;
 }
 EXPORT_SYMBOL(nftnl_set_elems_nlmsg_build_payload_iter, nft_set_elems_nlmsg_build_payload_iter);
+
+int nftnl_set_elems_nlmsg_build_payload_array(struct nlmsghdr *nlh,
+					      struct nftnl_set *s,
+					      struct nftnl_set_elem **elems,
+					      uint32_t num, uint32_t *pos)
+{
+	struct nlattr *nest1, *nest2;
+	int i = 0;
+
+	nftnl_set_elem_nlmsg_build_def(nlh, s);
+
+	nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
+	while (*pos < num) {
+		nest2 = nftnl_set_elem_build(nlh, elems[*pos], ++i);
+		if (nftnl_attr_nest_overflow(nlh, nest1, nest2))
+			break;
+		(*pos)++;
+	}
+	mnl_attr_nest_end(nlh, nest1);
+
+	return *pos < num;
+}
@@ -0,0 +1,231 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+
+/* Not worth to spawn a thread for less elements than this. */
+#define NFTNL_SET_ELEM_BATCH_MIN	4096
+
+static int nftnl_set_elems_batch_build_serial(struct nftnl_batch *batch,
+					      struct nftnl_set *s,
+					      uint16_t cmd, uint16_t type,
+					      uint32_t *seq)
+{
+	struct nftnl_set_elems_iter *iter;
+	struct nlmsghdr *nlh;
+	int more, msgs = 0;
+
+	iter = nftnl_set_elems_iter_create(s);
+	if (iter == NULL)
+		return -1;
+
+	do {
+		nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch), cmd,
+					    s->family, type, (*seq)++);
+		more = nftnl_set_elems_nlmsg_build_payload_iter(nlh, iter);
+		if (nftnl_batch_update(batch) < 0) {
+			msgs = -1;
+			break;
+		}
+		msgs++;
+	} while (more);
+
+	nftnl_set_elems_iter_destroy(iter);
+	return msgs;
+}
+
+/*
+ * Each worker serializes a contiguous range of elements as a sequence of
+ * element nests into a private buffer, the nests are numbered later on
+ * when they are copied to the batch.
+ */
+struct nftnl_set_elem_worker {
+	struct nftnl_worker		range;
+	struct nftnl_set_elem		**elems;
+	char				*buf;
+	size_t				size;
+	int				err;
+};
+
+/* Upper bound of the room that an element takes in the message. */
+static size_t nftnl_set_elem_maxlen(const struct nftnl_set_elem *e)
+{
+	size_t len = 256;
+
+	if (e->flags & (1 << NFTNL_SET_ELEM_CHAIN))
+		len += strlen(e->chain);
+	if (e->flags & (1 << NFTNL_SET_ELEM_USERDATA))
+		len += e->user.len;
+
+	return len;
+}
+
+static void *nftnl_set_elem_worker(void *data)
+{
+	struct nftnl_set_elem_worker *w = data;
+	struct nlmsghdr *nlh;
+	size_t len;
+	uint32_t i;
+	char *buf;
+
+	/* Zeroed, libmnl does not always clear the attribute padding. */
+	w->size = MNL_NLMSG_HDRLEN + w->range.num * 32;
+	w->buf = calloc(1, w->size);
+	if (w->buf == NULL)
+		goto err;
+
+	nlh = mnl_nlmsg_put_header(w->buf);
+	for (i = w->range.first; i < w->range.first + w->range.num; i++) {
+		len = nlh->nlmsg_len + nftnl_set_elem_maxlen(w->elems[i]);
+		if (len > w->size) {
+			if (len < w->size * 2)
+				len = w->size * 2;
+
+			buf = realloc(w->buf, len);
+			if (buf == NULL)
+				goto err;
+
+			memset(buf + w->size, 0, len - w->size);
+			w->buf = buf;
+			w->size = len;
+			nlh = (struct nlmsghdr *)w->buf;
+		}
+		nftnl_set_elem_build(nlh, w->elems[i], 0);
+	}
+	return NULL;
+err:
+	w->err = ENOMEM;
+	return NULL;
+}
+
+/*
+ * Assemble the element nests in order, splitting the messages at the same
+ * spots as nftnl_set_elems_nlmsg_build_payload_iter() does.
+ */
+static int nftnl_set_elem_workers_put(struct nftnl_batch *batch,
+				      struct nftnl_set *s,
+				      struct nftnl_set_elem_worker *w,
+				      unsigned int nthreads,
+				      uint16_t cmd, uint16_t type,
+				      uint32_t *seq)
+{
+	struct nlattr *nest, *attr;
+	struct nlmsghdr *nlh;
+	unsigned int i = 0;
+	char *cur = NULL, *end = NULL;
+	int idx, msgs = 0;
+
+	do {
+		nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch), cmd,
+					    s->family, type, (*seq)++);
+		nftnl_set_elem_nlmsg_build_def(nlh, s);
+		nest = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
+		idx = 0;
+
+		for (;;) {
+			if (cur == end) {
+				if (i == nthreads)
+					break;
+
+				cur = w[i].buf + MNL_NLMSG_HDRLEN;
+				end = w[i].buf +
+				      ((struct nlmsghdr *)w[i].buf)->nlmsg_len;
+				i++;
+				continue;
+			}
+			attr = (struct nlattr *)cur;
+			if ((char *)mnl_nlmsg_get_payload_tail(nlh) -
+			    (char *)nest + attr->nla_len > UINT16_MAX)
+				break;
+
+			memcpy(mnl_nlmsg_get_payload_tail(nlh), attr,
+			       attr->nla_len);
+			attr = mnl_nlmsg_get_payload_tail(nlh);
+			attr->nla_type = (attr->nla_type & ~NLA_TYPE_MASK) |
+					 ++idx;
+			nlh->nlmsg_len += attr->nla_len;
+			cur += attr->nla_len;
+		}
+		mnl_attr_nest_end(nlh, nest);
+
+		if (nftnl_batch_update(batch) < 0)
+			return -1;
+
+		msgs++;
+	} while (cur != end || i != nthreads);
+
+	return msgs;
+}
+
+int nftnl_set_elems_batch_build(struct nftnl_batch *batch,
+				struct nftnl_set *s, uint16_t cmd,
+				uint16_t type, uint32_t *seq,
+				unsigned int nthreads)
+{
+	struct nftnl_set_elem_worker *w;
+	struct nftnl_set_elem **elems;
+	struct nftnl_set_elem *elem;
+	uint32_t num = 0, i;
+	int ret = -1;
+
+	list_for_each_entry(elem, &s->element_list, head)
+		num++;
+
+	if (nthreads > num / NFTNL_SET_ELEM_BATCH_MIN)
+		nthreads = num / NFTNL_SET_ELEM_BATCH_MIN;
+	if (nthreads <= 1)
+		return nftnl_set_elems_batch_build_serial(batch, s, cmd, type,
+							  seq);
+
+	elems = calloc(num, sizeof(struct nftnl_set_elem *));
+	w = calloc(nthreads, sizeof(struct nftnl_set_elem_worker));
+	if (elems == NULL || w == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	i = 0;
+	list_for_each_entry(elem, &s->element_list, head)
+		elems[i++] = elem;
+
+	for (i = 0; i < nthreads; i++)
+		w[i].elems = elems;
+
+	nftnl_workers_run(w, sizeof(struct nftnl_set_elem_worker), nthreads,
+			  0, num, nftnl_set_elem_worker);
+
+	for (i = 0; i < nthreads; i++) {
+		if (w[i].err) {
+			errno = w[i].err;
+			goto out;
+		}
+	}
+
+	ret = nftnl_set_elem_workers_put(batch, s, w, nthreads, cmd, type,
+					 seq);
+out:
+	if (w != NULL) {
+		for (i = 0; i < nthreads; i++)
+			xfree(w[i].buf);
+	}
+	xfree(w);
+	xfree(elems);
+	return ret;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_batch_build);
@@ -0,0 +1,166 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/set.h>
+
+struct nftnl_set_elems_file {
+	const char			*map;
+	size_t				map_len;
+	uint32_t			key_len;
+	uint32_t			data_len;
+	uint32_t			flags;
+	uint32_t			rec_len;
+	/* records left to be put into messages */
+	const char			*cur;
+	const char			*end;
+};
+
+struct nftnl_set_elems_file *nftnl_set_elems_file_open(const char *filename)
+{
+	const struct nftnl_set_elems_file_hdr *hdr;
+	struct nftnl_set_elems_file *f;
+	struct stat st;
+	int fd;
+
+	f = calloc(1, sizeof(struct nftnl_set_elems_file));
+	if (f == NULL)
+		return NULL;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		goto err1;
+
+	if (fstat(fd, &st) < 0)
+		goto err2;
+
+	if (st.st_size < sizeof(struct nftnl_set_elems_file_hdr)) {
+		errno = EINVAL;
+		goto err2;
+	}
+
+	f->map_len = st.st_size;
+	f->map = mmap(NULL, f->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (f->map == MAP_FAILED)
+		goto err2;
+
+	close(fd);
+	madvise((void *)f->map, f->map_len, MADV_SEQUENTIAL);
+
+	hdr = (const struct nftnl_set_elems_file_hdr *)f->map;
+	f->key_len = ntohl(hdr->key_len);
+	f->data_len = ntohl(hdr->data_len);
+	f->flags = ntohl(hdr->flags);
+	f->rec_len = f->key_len + f->data_len;
+	f->cur = f->map + sizeof(struct nftnl_set_elems_file_hdr);
+	f->end = f->map + f->map_len;
+
+	if (ntohl(hdr->magic) != NFTNL_SET_ELEMS_FILE_MAGIC ||
+	    ntohl(hdr->version) != NFTNL_SET_ELEMS_FILE_VERSION ||
+	    f->key_len == 0 || f->key_len > NFT_DATA_VALUE_MAXLEN ||
+	    f->data_len > NFT_DATA_VALUE_MAXLEN ||
+	    (f->end - f->cur) % f->rec_len != 0) {
+		errno = EINVAL;
+		goto err3;
+	}
+
+	return f;
+err3:
+	munmap((void *)f->map, f->map_len);
+	goto err1;
+err2:
+	close(fd);
+err1:
+	xfree(f);
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_file_open);
+
+void nftnl_set_elems_file_close(struct nftnl_set_elems_file *f)
+{
+	munmap((void *)f->map, f->map_len);
+	xfree(f);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_file_close);
+
+/* Room that one record takes in the message, see nftnl_set_elem_build() */
+static uint32_t nftnl_set_elems_file_elem_len(const struct nftnl_set_elems_file *f)
+{
+	uint32_t len;
+
+	len = MNL_ATTR_HDRLEN;
+	if (f->flags)
+		len += MNL_ATTR_HDRLEN + sizeof(uint32_t);
+	len += MNL_ATTR_HDRLEN * 2 + MNL_ALIGN(f->key_len);
+	if (f->data_len)
+		len += MNL_ATTR_HDRLEN * 2 + MNL_ALIGN(f->data_len);
+
+	return len;
+}
+
+int nftnl_set_elems_file_nlmsg_build_payload(struct nlmsghdr *nlh,
+					     struct nftnl_set *s,
+					     struct nftnl_set_elems_file *f)
+{
+	struct nlattr *nest1, *nest2, *nest3;
+	uint32_t room;
+	int i = 0;
+
+	if ((s->flags & (1 << NFTNL_SET_KEY_LEN) && s->key_len != f->key_len) ||
+	    (s->flags & (1 << NFTNL_SET_DATA_LEN) &&
+	     s->data_len != f->data_len)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	nftnl_set_elem_nlmsg_build_def(nlh, s);
+
+	nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
+
+	/* Same limit as in nftnl_set_elems_nlmsg_build_payload_iter() */
+	room = (UINT16_MAX - MNL_ATTR_HDRLEN) /
+	       nftnl_set_elems_file_elem_len(f);
+
+	while (f->cur < f->end && room-- > 0) {
+		nest2 = mnl_attr_nest_start(nlh, ++i);
+		if (f->flags)
+			mnl_attr_put_u32(nlh, NFTA_SET_ELEM_FLAGS,
+					 htonl(f->flags));
+
+		nest3 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_KEY);
+		mnl_attr_put(nlh, NFTA_DATA_VALUE, f->key_len, f->cur);
+		mnl_attr_nest_end(nlh, nest3);
+
+		if (f->data_len) {
+			nest3 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_DATA);
+			mnl_attr_put(nlh, NFTA_DATA_VALUE, f->data_len,
+				     f->cur + f->key_len);
+			mnl_attr_nest_end(nlh, nest3);
+		}
+		mnl_attr_nest_end(nlh, nest2);
+
+		f->cur += f->rec_len;
+	}
+	mnl_attr_nest_end(nlh, nest1);
+
+	return f->cur < f->end;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_set_elems_file_nlmsg_build_payload);
@@ -0,0 +1,444 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <libnftnl/sink.h>
+
+/* Staging area of the sinks that write out, flushed once it is full. */
+#define NFTNL_SINK_BUFSIZ	(4 * NFTNL_SNPRINTF_BUFSIZ)
+
+/*
+ * Objects per thread for parallel rendering: not worth to spawn a thread
+ * for less, and this many are rendered per thread before the output is
+ * handed over, which bounds the memory that is used.
+ */
+#define NFTNL_SINK_PARALLEL_MIN		1024
+#define NFTNL_SINK_PARALLEL_CHUNK	8192
+
+static struct nftnl_sink *nftnl_sink_new(enum nftnl_sink_type type)
+{
+	struct nftnl_sink *s;
+
+	s = calloc(1, sizeof(struct nftnl_sink));
+	if (s == NULL)
+		return NULL;
+
+	s->type = type;
+	if (type == NFTNL_SINK_BUFFER)
+		return s;
+
+	s->buf = malloc(NFTNL_SINK_BUFSIZ);
+	if (s->buf == NULL) {
+		xfree(s);
+		return NULL;
+	}
+	s->size = NFTNL_SINK_BUFSIZ;
+	s->owned = true;
+
+	return s;
+}
+
+struct nftnl_sink *nftnl_sink_alloc(void)
+{
+	return nftnl_sink_new(NFTNL_SINK_BUFFER);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_alloc);
+
+struct nftnl_sink *nftnl_sink_alloc_file(FILE *fp)
+{
+	struct nftnl_sink *s;
+
+	s = nftnl_sink_new(NFTNL_SINK_FILE);
+	if (s != NULL)
+		s->fp = fp;
+
+	return s;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_alloc_file);
+
+struct nftnl_sink *nftnl_sink_alloc_fd(int fd)
+{
+	struct nftnl_sink *s;
+
+	s = nftnl_sink_new(NFTNL_SINK_FD);
+	if (s != NULL)
+		s->fd = fd;
+
+	return s;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_alloc_fd);
+
+struct nftnl_sink *nftnl_sink_alloc_cb(int (*cb)(const char *buf, size_t len,
+						 void *data),
+				       void *data)
+{
+	struct nftnl_sink *s;
+
+	s = nftnl_sink_new(NFTNL_SINK_CB);
+	if (s != NULL) {
+		s->cb = cb;
+		s->data = data;
+	}
+
+	return s;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_alloc_cb);
+
+void nftnl_sink_init_file(struct nftnl_sink *s, FILE *fp, char *buf,
+			  size_t size)
+{
+	memset(s, 0, sizeof(*s));
+	s->type = NFTNL_SINK_FILE;
+	s->fp = fp;
+	s->buf = buf;
+	s->size = size;
+}
+
+static int nftnl_sink_out(struct nftnl_sink *s, const char *buf, size_t len)
+{
+	size_t off = 0;
+	ssize_t ret;
+
+	switch (s->type) {
+	case NFTNL_SINK_FILE:
+		if (fwrite(buf, 1, len, s->fp) != len)
+			return -1;
+		break;
+	case NFTNL_SINK_FD:
+		while (off < len) {
+			ret = write(s->fd, buf + off, len - off);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			off += ret;
+		}
+		break;
+	case NFTNL_SINK_CB:
+		if (s->cb(buf, len, s->data) < 0)
+			return -1;
+		break;
+	case NFTNL_SINK_BUFFER:
+		break;
+	}
+
+	return 0;
+}
+
+static int nftnl_sink_drain(struct nftnl_sink *s)
+{
+	int ret;
+
+	if (s->type == NFTNL_SINK_BUFFER || s->len == 0)
+		return 0;
+
+	ret = nftnl_sink_out(s, s->buf, s->len);
+	/* do not write the same data twice */
+	s->len = 0;
+	if (ret < 0)
+		s->error = true;
+
+	return ret;
+}
+
+static int nftnl_sink_grow(struct nftnl_sink *s, size_t need)
+{
+	size_t size = s->size ? s->size : NFTNL_SNPRINTF_BUFSIZ;
+	char *buf;
+
+	while (size < s->len + need)
+		size *= 2;
+
+	if (s->owned) {
+		buf = realloc(s->buf, size);
+		if (buf == NULL)
+			return -1;
+	} else {
+		buf = malloc(size);
+		if (buf == NULL)
+			return -1;
+		if (s->len > 0)
+			memcpy(buf, s->buf, s->len);
+	}
+	s->buf = buf;
+	s->size = size;
+	s->owned = true;
+
+	return 0;
+}
+
+/* Make room for @need bytes, plus the trailing NUL. */
+static int nftnl_sink_room(struct nftnl_sink *s, size_t need)
+{
+	if (s->size - s->len > need)
+		return 0;
+
+	if (nftnl_sink_drain(s) < 0)
+		return -1;
+	if (s->size - s->len > need)
+		return 0;
+
+	return nftnl_sink_grow(s, need + 1);
+}
+
+char *nftnl_sink_reserve(struct nftnl_sink *s, size_t *size)
+{
+	if (s->error)
+		return NULL;
+
+	if (nftnl_sink_room(s, NFTNL_SNPRINTF_BUFSIZ - 1) < 0) {
+		s->error = true;
+		return NULL;
+	}
+	*size = s->size - s->len;
+
+	return s->buf + s->len;
+}
+
+int nftnl_sink_commit(struct nftnl_sink *s, int ret)
+{
+	if (ret < 0) {
+		s->error = true;
+		return -1;
+	}
+
+	if ((size_t)ret < s->size - s->len) {
+		s->len += ret;
+		s->total += ret;
+		return 0;
+	}
+
+	if (nftnl_sink_room(s, ret) < 0) {
+		s->error = true;
+		return -1;
+	}
+
+	return 1;
+}
+
+int nftnl_sink_printf(struct nftnl_sink *s, const char *fmt, ...)
+{
+	va_list ap;
+	size_t size;
+	char *buf;
+	int ret;
+
+	do {
+		buf = nftnl_sink_reserve(s, &size);
+		if (buf == NULL)
+			return -1;
+
+		va_start(ap, fmt);
+		ret = vsnprintf(buf, size, fmt, ap);
+		va_end(ap);
+	} while ((ret = nftnl_sink_commit(s, ret)) > 0);
+
+	return ret;
+}
+
+int nftnl_sink_obj(struct nftnl_sink *s, void *obj, uint32_t cmd,
+		   uint32_t type, uint32_t flags,
+		   int (*snprintf_cb)(char *buf, size_t bufsiz, void *obj,
+				      uint32_t cmd, uint32_t type,
+				      uint32_t flags))
+{
+	uint64_t total = s->total;
+	size_t size;
+	char *buf;
+	int ret;
+
+	do {
+		buf = nftnl_sink_reserve(s, &size);
+		if (buf == NULL)
+			return -1;
+
+		ret = snprintf_cb(buf, size, obj, cmd, type, flags);
+	} while ((ret = nftnl_sink_commit(s, ret)) > 0);
+
+	if (ret < 0)
+		return -1;
+
+	return s->total - total;
+}
+
+int nftnl_sink_write(struct nftnl_sink *s, const char *buf, size_t len)
+{
+	if (s->error)
+		return -1;
+
+	/* large blocks go straight out instead of through the staging area */
+	if (s->type != NFTNL_SINK_BUFFER && len >= s->size) {
+		if (nftnl_sink_drain(s) < 0 || nftnl_sink_out(s, buf, len) < 0) {
+			s->error = true;
+			return -1;
+		}
+		s->total += len;
+		return 0;
+	}
+
+	if (nftnl_sink_room(s, len) < 0) {
+		s->error = true;
+		return -1;
+	}
+	memcpy(s->buf + s->len, buf, len);
+	s->len += len;
+	s->buf[s->len] = '\0';
+	s->total += len;
+
+	return 0;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_write);
+
+int nftnl_sink_flush(struct nftnl_sink *s)
+{
+	if (s->error || nftnl_sink_drain(s) < 0)
+		return -1;
+
+	if (s->type == NFTNL_SINK_FILE && fflush(s->fp) != 0)
+		return -1;
+
+	return 0;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_flush);
+
+int nftnl_sink_release(struct nftnl_sink *s)
+{
+	int ret = 0;
+
+	if (s->error || nftnl_sink_drain(s) < 0)
+		ret = -1;
+
+	if (s->owned)
+		xfree(s->buf);
+
+	return ret;
+}
+
+void nftnl_sink_free(struct nftnl_sink *s)
+{
+	nftnl_sink_release(s);
+	xfree(s);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_free);
+
+const char *nftnl_sink_buf(const struct nftnl_sink *s, size_t *len)
+{
+	if (s->type != NFTNL_SINK_BUFFER)
+		return NULL;
+
+	if (len != NULL)
+		*len = s->len;
+
+	return s->buf != NULL ? s->buf : "";
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_buf);
+
+void nftnl_sink_reset(struct nftnl_sink *s)
+{
+	if (s->type != NFTNL_SINK_BUFFER)
+		return;
+
+	s->len = 0;
+	s->total = 0;
+	s->error = false;
+	if (s->buf != NULL)
+		s->buf[0] = '\0';
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_sink_reset);
+
+struct nftnl_sink_worker {
+	struct nftnl_worker	range;
+	struct nftnl_sink	sink;
+	void			**objs;
+	int			(*render)(struct nftnl_sink *s, void *obj,
+					  uint32_t idx, void *data);
+	void			*data;
+	int			err;
+};
+
+static void *nftnl_sink_worker(void *arg)
+{
+	struct nftnl_sink_worker *w = arg;
+	uint32_t i;
+
+	for (i = w->range.first; i < w->range.first + w->range.num; i++) {
+		if (w->render(&w->sink, w->objs[i], i, w->data) < 0) {
+			w->err = -1;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+int nftnl_sink_parallel(struct nftnl_sink *s, void **objs, uint32_t num,
+			int (*render)(struct nftnl_sink *s, void *obj,
+				      uint32_t idx, void *data),
+			void *data, unsigned int nthreads)
+{
+	struct nftnl_sink_worker *w;
+	uint32_t done, round, i;
+	int ret = -1;
+
+	if (nthreads > num / NFTNL_SINK_PARALLEL_MIN)
+		nthreads = num / NFTNL_SINK_PARALLEL_MIN;
+
+	if (nthreads <= 1) {
+		for (i = 0; i < num; i++) {
+			if (render(s, objs[i], i, data) < 0)
+				return -1;
+		}
+		return 0;
+	}
+
+	w = calloc(nthreads, sizeof(struct nftnl_sink_worker));
+	if (w == NULL)
+		return -1;
+
+	for (i = 0; i < nthreads; i++) {
+		w[i].sink.type = NFTNL_SINK_BUFFER;
+		w[i].objs = objs;
+		w[i].render = render;
+		w[i].data = data;
+	}
+
+	for (done = 0; done < num; done += round) {
+		round = num - done;
+		if (round > nthreads * NFTNL_SINK_PARALLEL_CHUNK)
+			round = nthreads * NFTNL_SINK_PARALLEL_CHUNK;
+
+		for (i = 0; i < nthreads; i++)
+			nftnl_sink_reset(&w[i].sink);
+
+		nftnl_workers_run(w, sizeof(struct nftnl_sink_worker),
+				  nthreads, done, round, nftnl_sink_worker);
+
+		/* concatenate in order */
+		for (i = 0; i < nthreads; i++) {
+			if (w[i].err < 0 || w[i].sink.error)
+				goto out;
+			if (w[i].sink.len > 0 &&
+			    nftnl_sink_write(s, w[i].sink.buf,
+					     w[i].sink.len) < 0)
+				goto out;
+		}
+	}
+	ret = 0;
+out:
+	for (i = 0; i < nthreads; i++)
+		nftnl_sink_release(&w[i].sink);
+	xfree(w);
+	return ret;
+}
@@ -0,0 +1,154 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Table, chain and set names are repeated in every object that is dumped
+ * from the kernel, keep a single refcounted copy of each of them.
+ */
+
+/*
+ * The pool is split in stripes with a lock each, so threads that build
+ * objects at the same time rarely wait for each other. Each stripe has
+ * its own hash, which doubles once there are more than two strings per
+ * bucket.
+ */
+#define NFTNL_STR_POOL_STRIPES	64
+/* initial number of buckets of a stripe */
+#define NFTNL_STR_POOL_HSIZE	16
+
+struct nftnl_str {
+	struct hlist_node	hnode;
+	uint32_t		hash;
+	uint32_t		refcnt;
+	char			str[];
+};
+
+struct nftnl_str_stripe {
+	pthread_mutex_t		lock;
+	struct hlist_head	*hash;
+	uint32_t		hsize;
+	uint32_t		num;
+};
+
+static struct nftnl_str_stripe nftnl_str_pool[NFTNL_STR_POOL_STRIPES] = {
+	[0 ... NFTNL_STR_POOL_STRIPES - 1] = {
+		.lock	= PTHREAD_MUTEX_INITIALIZER,
+	},
+};
+
+static struct nftnl_str_stripe *nftnl_str_stripe(uint32_t hash)
+{
+	return &nftnl_str_pool[hash % NFTNL_STR_POOL_STRIPES];
+}
+
+static struct hlist_head *nftnl_str_bucket(struct hlist_head *buckets,
+					   uint32_t hsize, uint32_t hash)
+{
+	return &buckets[(hash / NFTNL_STR_POOL_STRIPES) % hsize];
+}
+
+/* Without memory for a bigger table, the old one stays in use. */
+static void nftnl_str_stripe_grow(struct nftnl_str_stripe *st)
+{
+	struct hlist_node *pos, *n;
+	struct hlist_head *hash;
+	struct nftnl_str *s;
+	uint32_t i, hsize;
+
+	if (st->num <= 2 * st->hsize)
+		return;
+
+	hsize = st->hsize * 2;
+	hash = calloc(hsize, sizeof(struct hlist_head));
+	if (hash == NULL)
+		return;
+
+	for (i = 0; i < st->hsize; i++) {
+		hlist_for_each_entry_safe(s, pos, n, &st->hash[i], hnode) {
+			hlist_del(&s->hnode);
+			hlist_add_head(&s->hnode,
+				       nftnl_str_bucket(hash, hsize, s->hash));
+		}
+	}
+	xfree(st->hash);
+	st->hash = hash;
+	st->hsize = hsize;
+}
+
+const char *nftnl_str_intern(const char *str)
+{
+	struct nftnl_str_stripe *st;
+	struct hlist_node *n;
+	struct nftnl_str *s;
+	uint32_t hash;
+	size_t len;
+
+	hash = nftnl_hash_str(5381, str);
+	st = nftnl_str_stripe(hash);
+
+	pthread_mutex_lock(&st->lock);
+	if (st->hash == NULL) {
+		st->hash = calloc(NFTNL_STR_POOL_HSIZE,
+				  sizeof(struct hlist_head));
+		if (st->hash == NULL) {
+			pthread_mutex_unlock(&st->lock);
+			return NULL;
+		}
+		st->hsize = NFTNL_STR_POOL_HSIZE;
+	}
+
+	hlist_for_each_entry(s, n, nftnl_str_bucket(st->hash, st->hsize, hash),
+			     hnode) {
+		if (s->hash == hash && strcmp(s->str, str) == 0) {
+			s->refcnt++;
+			goto out;
+		}
+	}
+
+	len = strlen(str) + 1;
+	s = malloc(sizeof(struct nftnl_str) + len);
+	if (s == NULL) {
+		pthread_mutex_unlock(&st->lock);
+		return NULL;
+	}
+	s->hash = hash;
+	s->refcnt = 1;
+	memcpy(s->str, str, len);
+	hlist_add_head(&s->hnode, nftnl_str_bucket(st->hash, st->hsize, hash));
+	st->num++;
+	nftnl_str_stripe_grow(st);
+out:
+	pthread_mutex_unlock(&st->lock);
+	return s->str;
+}
+
+void nftnl_str_release(const char *str)
+{
+	struct nftnl_str_stripe *st;
+	struct nftnl_str *s;
+
+	if (str == NULL)
+		return;
+
+	s = (struct nftnl_str *)(str - offsetof(struct nftnl_str, str));
+	st = nftnl_str_stripe(s->hash);
+
+	pthread_mutex_lock(&st->lock);
+	if (--s->refcnt == 0) {
+		hlist_del(&s->hnode);
+		st->num--;
+		xfree(s);
+	}
+	pthread_mutex_unlock(&st->lock);
+}
@@ -28,6 +28,7 @@
 
 struct nftnl_table {
 	struct list_head head;
+	struct hlist_node hnode;
 
 	const char	*name;
 	uint32_t	family;
@@ -45,7 +46,7 @@ EXPORT_SYMBOL(nftnl_table_alloc, nft_table_alloc);
 void nftnl_table_free(struct nftnl_table *t)
 {
 	if (t->flags & (1 << NFTNL_TABLE_NAME))
-		xfree(t->name);
+		nftnl_str_release(t->name);
 
 	xfree(t);
 }
@@ -65,7 +66,7 @@ void nftnl_table_unset(struct nftnl_table *t, uint16_t attr)
 	switch (attr) {
 	case NFTNL_TABLE_NAME:
 		if (t->name) {
-			xfree(t->name);
+			nftnl_str_release(t->name);
 			t->name = NULL;
 		}
 		break;
@@ -95,9 +96,9 @@ void nftnl_table_set_data(struct nftnl_table *t, uint16_t attr,
 	switch (attr) {
 	case NFTNL_TABLE_NAME:
 		if (t->name)
-			xfree(t->name);
+			nftnl_str_release(t->name);
 
-		t->name = strdup(data);
+		t->name = nftnl_str_intern(data);
 		break;
 	case NFTNL_TABLE_FLAGS:
 		t->table_flags = *((uint32_t *)data);
@@ -229,8 +230,9 @@ int nftnl_table_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_table *t)
 		return -1;
 
 	if (tb[NFTA_TABLE_NAME]) {
-		xfree(t->name);
-		t->name = strdup(mnl_attr_get_str(tb[NFTA_TABLE_NAME]));
+		nftnl_str_release(t->name);
+		t->name =
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_TABLE_NAME]));
 		t->flags |= (1 << NFTNL_TABLE_NAME);
 	}
 	if (tb[NFTA_TABLE_FLAGS]) {
@@ -331,14 +333,15 @@ int nftnl_jansson_parse_table(struct nftnl_table *t, json_t *tree,
 
 static int nftnl_table_json_parse(struct nftnl_table *t, const void *json,
 				struct nftnl_parse_err *err,
-				enum nftnl_parse_input input)
+				enum nftnl_parse_input input,
+				enum nftnl_parse_type type)
 {
 #ifdef JSON_PARSING
 	json_t *tree;
 	json_error_t error;
 	int ret;
 
-	tree = nftnl_jansson_create_root(json, &error, err, input);
+	tree = nftnl_jansson_create_root(json, &error, err, input, type);
 	if (tree == NULL)
 		return -1;
 
@@ -365,7 +368,8 @@ static int nftnl_table_do_parse(struct nftnl_table *t, enum nftnl_parse_type typ
 		ret = nftnl_table_xml_parse(t, data, &perr, input);
 		break;
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_table_json_parse(t, data, &perr, input);
+	case NFTNL_PARSE_CBOR:
+		ret = nftnl_table_json_parse(t, data, &perr, input, type);
 		break;
 	default:
 		ret = -1;
@@ -434,6 +438,7 @@ static int nftnl_table_cmd_snprintf(char *buf, size_t size, struct nftnl_table *
 		break;
 	case NFTNL_OUTPUT_XML:
 	case NFTNL_OUTPUT_JSON:
+	case NFTNL_OUTPUT_CBOR:
 		ret = nftnl_table_export(buf+offset, len, t, type);
 		break;
 	default:
@@ -470,10 +475,69 @@ int nftnl_table_fprintf(FILE *fp, struct nftnl_table *t, uint32_t type,
 }
 EXPORT_SYMBOL(nftnl_table_fprintf, nft_table_fprintf);
 
+int nftnl_table_output(struct nftnl_sink *sink, struct nftnl_table *t,
+		       uint32_t type, uint32_t flags)
+{
+	return nftnl_sink_obj(sink, t, NFTNL_CMD_UNSPEC, type, flags,
+			      nftnl_table_do_snprintf);
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_table_output);
+
+/* initial number of buckets, doubled as the list grows */
+#define NFTNL_TABLE_LIST_HSIZE	16
+
 struct nftnl_table_list {
-	struct list_head list;
+	struct list_head	list;
+	struct hlist_head	*name_hash;
+	uint32_t		hsize;
+	/* tables added since the last count, removals do not reach the list */
+	uint32_t		ntables;
 };
 
+static uint32_t nftnl_table_list_hash(uint32_t family, const char *name)
+{
+	return nftnl_hash_str(5381 + family, name);
+}
+
+static void nftnl_table_list_hash_add(struct nftnl_table *t,
+				      struct nftnl_table_list *list)
+{
+	uint32_t hash = nftnl_table_list_hash(t->family, t->name);
+
+	hlist_add_head(&t->hnode, &list->name_hash[hash % list->hsize]);
+}
+
+/* Same as for chain lists: at most two tables per bucket. */
+static void nftnl_table_list_grow(struct nftnl_table_list *list)
+{
+	struct hlist_head *name_hash;
+	struct nftnl_table *t;
+	uint32_t hsize, n = 0;
+
+	if (++list->ntables <= 2 * list->hsize)
+		return;
+
+	list_for_each_entry(t, &list->list, head)
+		n++;
+	list->ntables = n;
+
+	for (hsize = list->hsize; hsize < n; hsize *= 2)
+		;
+	if (hsize == list->hsize)
+		return;
+
+	name_hash = calloc(hsize, sizeof(struct hlist_head));
+	if (name_hash == NULL)
+		return;
+
+	xfree(list->name_hash);
+	list->name_hash = name_hash;
+	list->hsize = hsize;
+
+	list_for_each_entry(t, &list->list, head)
+		nftnl_table_list_hash_add(t, list);
+}
+
 struct nftnl_table_list *nftnl_table_list_alloc(void)
 {
 	struct nftnl_table_list *list;
@@ -482,6 +546,13 @@ struct nftnl_table_list *nftnl_table_list_alloc(void)
 	if (list == NULL)
 		return NULL;
 
+	list->hsize = NFTNL_TABLE_LIST_HSIZE;
+	list->name_hash = calloc(list->hsize, sizeof(struct hlist_head));
+	if (list->name_hash == NULL) {
+		xfree(list);
+		return NULL;
+	}
+
 	INIT_LIST_HEAD(&list->list);
 
 	return list;
@@ -494,8 +565,10 @@ void nftnl_table_list_free(struct nftnl_table_list *list)
 
 	list_for_each_entry_safe(r, tmp, &list->list, head) {
 		list_del(&r->head);
+		hlist_del_init(&r->hnode);
 		nftnl_table_free(r);
 	}
+	xfree(list->name_hash);
 	xfree(list);
 }
 EXPORT_SYMBOL(nftnl_table_list_free, nft_table_list_free);
@@ -509,18 +582,23 @@ EXPORT_SYMBOL(nftnl_table_list_is_empty, nft_table_list_is_empty);
 void nftnl_table_list_add(struct nftnl_table *r, struct nftnl_table_list *list)
 {
 	list_add(&r->head, &list->list);
+	nftnl_table_list_hash_add(r, list);
+	nftnl_table_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_table_list_add, nft_table_list_add);
 
 void nftnl_table_list_add_tail(struct nftnl_table *r, struct nftnl_table_list *list)
 {
 	list_add_tail(&r->head, &list->list);
+	nftnl_table_list_hash_add(r, list);
+	nftnl_table_list_grow(list);
 }
 EXPORT_SYMBOL(nftnl_table_list_add_tail, nft_table_list_add_tail);
 
 void nftnl_table_list_del(struct nftnl_table *t)
 {
 	list_del(&t->head);
+	hlist_del_init(&t->hnode);
 }
 EXPORT_SYMBOL(nftnl_table_list_del, nft_table_list_del);
 
@@ -540,6 +618,26 @@ int nftnl_table_list_foreach(struct nftnl_table_list *table_list,
 }
 EXPORT_SYMBOL(nftnl_table_list_foreach, nft_table_list_foreach);
 
+struct nftnl_table *nftnl_table_list_lookup_byname(struct nftnl_table_list *list,
+						   uint32_t family,
+						   const char *name)
+{
+	struct hlist_node *n;
+	struct nftnl_table *t;
+	uint32_t hash;
+
+	if (name == NULL)
+		return NULL;
+
+	hash = nftnl_table_list_hash(family, name) % list->hsize;
+	hlist_for_each_entry(t, n, &list->name_hash[hash], hnode) {
+		if (t->family == family && nftnl_str_equal(t->name, name))
+			return t;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_NOALIAS(nftnl_table_list_lookup_byname);
+
 struct nftnl_table_list_iter {
 	struct nftnl_table_list	*list;
 	struct nftnl_table	*cur;
@@ -220,36 +220,105 @@ uint32_t nftnl_str2cmd(const char *cmd)
 	return NFTNL_CMD_UNSPEC;
 }
 
-int nftnl_fprintf(FILE *fp, void *obj, uint32_t cmd, uint32_t type, uint32_t flags,
-		int (*snprintf_cb)(char *buf, size_t bufsiz, void *obj,
-				   uint32_t cmd, uint32_t type, uint32_t flags))
+/* djb2, the terminating nul is hashed too so that strings can be chained */
+uint32_t nftnl_hash_str(uint32_t hash, const char *str)
 {
-	char _buf[NFTNL_SNPRINTF_BUFSIZ];
-	char *buf = _buf;
-	size_t bufsiz = sizeof(_buf);
-	int ret;
+	if (str != NULL) {
+		while (*str)
+			hash = (hash << 5) + hash + *str++;
+	}
+	return (hash << 5) + hash;
+}
 
-	ret = snprintf_cb(buf, bufsiz, obj, cmd, type, flags);
-	if (ret <= 0)
-		goto out;
+static const char nftnl_digits[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
 
-	if (ret >= NFTNL_SNPRINTF_BUFSIZ) {
-		bufsiz = ret + 1;
+char *nftnl_fmt_u64(char *p, uint64_t value)
+{
+	char tmp[20], *q = tmp + sizeof(tmp);
+	size_t len;
 
-		buf = malloc(bufsiz);
-		if (buf == NULL)
-			return -1;
+	while (value >= 100) {
+		q -= 2;
+		memcpy(q, &nftnl_digits[(value % 100) * 2], 2);
+		value /= 100;
+	}
+	if (value >= 10) {
+		q -= 2;
+		memcpy(q, &nftnl_digits[value * 2], 2);
+	} else {
+		*--q = '0' + value;
+	}
+
+	len = tmp + sizeof(tmp) - q;
+	memcpy(p, q, len);
+
+	return p + len;
+}
+
+char *nftnl_fmt_u32(char *p, uint32_t value)
+{
+	/* single digits are the common case: lengths, registers, flags */
+	if (value < 10) {
+		*p = '0' + value;
+		return p + 1;
+	}
+
+	return nftnl_fmt_u64(p, value);
+}
+
+char *nftnl_fmt_s32(char *p, int32_t value)
+{
+	if (value < 0) {
+		*p++ = '-';
+		return nftnl_fmt_u64(p, -(int64_t)value);
+	}
+
+	return nftnl_fmt_u32(p, value);
+}
+
+char *nftnl_fmt_hex32(char *p, uint32_t value)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
 
-		ret = snprintf_cb(buf, bufsiz, obj, cmd, type, flags);
-		if (ret <= 0)
-			goto out;
+	for (i = 7; i >= 0; i--) {
+		p[i] = hex[value & 0xf];
+		value >>= 4;
 	}
 
-	ret = fprintf(fp, "%s", buf);
+	return p + 8;
+}
+
+int nftnl_fmt_copy(char *buf, size_t size, const char *src, size_t len)
+{
+	size_t n = len;
+
+	if (size == 0)
+		return len;
 
-out:
-	if (buf != _buf)
-		xfree(buf);
+	if (n >= size)
+		n = size - 1;
+	memcpy(buf, src, n);
+	buf[n] = '\0';
+
+	return len;
+}
+
+int nftnl_fprintf(FILE *fp, void *obj, uint32_t cmd, uint32_t type, uint32_t flags,
+		int (*snprintf_cb)(char *buf, size_t bufsiz, void *obj,
+				   uint32_t cmd, uint32_t type, uint32_t flags))
+{
+	char buf[NFTNL_SNPRINTF_BUFSIZ];
+	struct nftnl_sink sink;
+	int ret;
+
+	nftnl_sink_init_file(&sink, fp, buf, sizeof(buf));
+	ret = nftnl_sink_obj(&sink, obj, cmd, type, flags, snprintf_cb);
+	if (nftnl_sink_release(&sink) < 0)
+		return -1;
 
 	return ret;
 }
@@ -0,0 +1,63 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+struct nftnl_worker_thread {
+	pthread_t	thread;
+	bool		running;
+};
+
+static struct nftnl_worker *nftnl_worker_get(void *w, size_t size,
+					     unsigned int i)
+{
+	return (struct nftnl_worker *)((char *)w + i * size);
+}
+
+void nftnl_workers_run(void *w, size_t size, unsigned int nthreads,
+		       uint32_t first, uint32_t num, void *(*fn)(void *arg))
+{
+	struct nftnl_worker_thread *t;
+	struct nftnl_worker *cur;
+	uint32_t chunk;
+	unsigned int i;
+
+	chunk = div_round_up(num, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		cur = nftnl_worker_get(w, size, i);
+		cur->first = first + i * chunk;
+		if (i * chunk >= num)
+			cur->num = 0;
+		else if ((i + 1) * chunk > num)
+			cur->num = num - i * chunk;
+		else
+			cur->num = chunk;
+	}
+
+	/* Without memory for the thread handles, all runs in this thread. */
+	t = calloc(nthreads, sizeof(struct nftnl_worker_thread));
+	for (i = 1; t != NULL && i < nthreads; i++) {
+		cur = nftnl_worker_get(w, size, i);
+		if (cur->num > 0 &&
+		    pthread_create(&t[i].thread, NULL, fn, cur) == 0)
+			t[i].running = true;
+	}
+	fn(nftnl_worker_get(w, size, 0));
+
+	for (i = 1; i < nthreads; i++) {
+		/* Do it ourselves if the thread could not be started. */
+		if (t != NULL && t[i].running)
+			pthread_join(t[i].thread, NULL);
+		else
+			fn(nftnl_worker_get(w, size, i));
+	}
+	xfree(t);
+}
@@ -0,0 +1,326 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/sink.h>
+#include <libnftnl/table.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+#include <libnftnl/ruleset.h>
+
+static int test_ok = 1;
+static char cbor[1 << 16], a[1 << 16], b[1 << 16];
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+/* CBOR is only parsed from files, see NFTNL_PARSE_CBOR */
+static FILE *cbor_file(const void *data, size_t len)
+{
+	FILE *fp = fmemopen((void *)data, len, "r");
+
+	if (fp == NULL) {
+		print_err("cannot open memory file");
+		exit(EXIT_FAILURE);
+	}
+	return fp;
+}
+
+static void test_table(void)
+{
+	static const char expected[] =
+		"\xbf\x65table\xbf\x64name\x66" "filter\x66" "family\x62ip"
+		"\x65" "flags\x00\x63use\x19\x01\x2c\xff\xff";
+	struct nftnl_table *t = nftnl_table_alloc();
+	int ret;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_set_u32(t, NFTNL_TABLE_FLAGS, 0);
+	/* 300 is encoded as 0x19 0x01 0x2c, the ',' is not a json comma */
+	nftnl_table_set_u32(t, NFTNL_TABLE_USE, 300);
+
+	ret = nftnl_table_snprintf(cbor, sizeof(cbor), t, NFTNL_OUTPUT_CBOR, 0);
+	if (ret != sizeof(expected) - 1 || memcmp(cbor, expected, ret) != 0)
+		print_err("unexpected cbor table output");
+
+	/* snprintf semantics hold for binary output as well */
+	if (nftnl_table_snprintf(cbor, 10, t, NFTNL_OUTPUT_CBOR, 0) != ret)
+		print_err("truncated output returned the wrong length");
+
+	nftnl_table_free(t);
+}
+
+static struct nftnl_rule *build_rule(void)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nftnl_expr *e;
+
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, 0x123456789ULL);
+
+	e = nftnl_expr_alloc("payload");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_DREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_BASE,
+			   NFT_PAYLOAD_NETWORK_HEADER);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_OFFSET, 12);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_LEN, 4);
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("cmp");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_DATA, 0x0100000a);
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("counter");
+	nftnl_expr_set_u64(e, NFTNL_EXPR_CTR_PACKETS, 44);
+	nftnl_expr_set_u64(e, NFTNL_EXPR_CTR_BYTES, 1ULL << 40);
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("immediate");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_IMM_DREG, NFT_REG_VERDICT);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_IMM_VERDICT, NF_ACCEPT);
+	nftnl_rule_add_expr(r, e);
+
+	return r;
+}
+
+static void test_rule(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_rule *r = build_rule(), *parsed = nftnl_rule_alloc();
+	int len, jlen;
+	FILE *fp;
+
+	len = nftnl_rule_snprintf(cbor, sizeof(cbor), r, NFTNL_OUTPUT_CBOR, 0);
+	jlen = nftnl_rule_snprintf(a, sizeof(a), r, NFTNL_OUTPUT_JSON, 0);
+	if (len <= 0 || len >= jlen)
+		print_err("cbor rule is not smaller than json");
+
+	fp = cbor_file(cbor, len);
+	if (nftnl_rule_parse_file(parsed, NFTNL_PARSE_CBOR, fp, err) < 0) {
+		print_err("cannot parse cbor rule");
+		goto out;
+	}
+
+	nftnl_rule_snprintf(b, sizeof(b), parsed, NFTNL_OUTPUT_JSON, 0);
+	if (strcmp(a, b) != 0)
+		print_err("rule differs after a cbor round trip");
+out:
+	fclose(fp);
+	nftnl_rule_free(parsed);
+	nftnl_rule_free(r);
+	nftnl_parse_err_free(err);
+}
+
+static struct nftnl_set *build_set(void)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e;
+	uint32_t i;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_FLAGS, NFT_SET_MAP);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	nftnl_set_set_u32(s, NFTNL_SET_DATA_TYPE, NFT_DATA_VERDICT);
+	for (i = 0; i < 100; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, i * 300);
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+				       i % 2 ? NF_ACCEPT : NF_DROP);
+		nftnl_set_elem_add(s, e);
+	}
+
+	return s;
+}
+
+static void test_set(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_set *s = build_set(), *parsed = nftnl_set_alloc();
+	FILE *fp;
+	int len;
+
+	len = nftnl_set_snprintf(cbor, sizeof(cbor), s, NFTNL_OUTPUT_CBOR, 0);
+	nftnl_set_snprintf(a, sizeof(a), s, NFTNL_OUTPUT_JSON, 0);
+
+	fp = cbor_file(cbor, len);
+	if (nftnl_set_parse_file(parsed, NFTNL_PARSE_CBOR, fp, err) < 0) {
+		print_err("cannot parse cbor set");
+		goto out;
+	}
+
+	nftnl_set_snprintf(b, sizeof(b), parsed, NFTNL_OUTPUT_JSON, 0);
+	if (strcmp(a, b) != 0)
+		print_err("set differs after a cbor round trip");
+out:
+	fclose(fp);
+	nftnl_set_free(parsed);
+	nftnl_set_free(s);
+	nftnl_parse_err_free(err);
+}
+
+static void test_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc(), *parsed;
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	int ret, half;
+	FILE *fp;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_list_add_tail(t, tl);
+	nftnl_set_list_add_tail(build_set(), sl);
+	nftnl_rule_list_add_tail(build_rule(), rl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		exit(EXIT_FAILURE);
+	}
+	ret = nftnl_ruleset_fprintf(fp, rs, NFTNL_OUTPUT_CBOR,
+				    NFTNL_OF_EVENT_NEW);
+	if (ret <= 0 || nftnl_ruleset_snprintf(cbor, sizeof(cbor), rs,
+					       NFTNL_OUTPUT_CBOR,
+					       NFTNL_OF_EVENT_NEW) != ret)
+		print_err("ruleset fprintf returned the wrong length");
+	rewind(fp);
+
+	parsed = nftnl_ruleset_alloc();
+	if (nftnl_ruleset_parse_file(parsed, NFTNL_PARSE_CBOR, fp, err) < 0) {
+		print_err("cannot parse cbor ruleset");
+	} else {
+		nftnl_ruleset_snprintf(a, sizeof(a), rs, NFTNL_OUTPUT_JSON, 0);
+		nftnl_ruleset_snprintf(b, sizeof(b), parsed, NFTNL_OUTPUT_JSON,
+				       0);
+		if (strcmp(a, b) != 0)
+			print_err("ruleset differs after a cbor round trip");
+	}
+	nftnl_ruleset_free(parsed);
+	fclose(fp);
+
+	/* a file that ends in the middle of the document */
+	fp = tmpfile();
+	half = ret / 2;
+	if (fwrite(cbor, 1, half, fp) != (size_t)half)
+		print_err("cannot write temporary file");
+	rewind(fp);
+	parsed = nftnl_ruleset_alloc();
+	if (nftnl_ruleset_parse_file(parsed, NFTNL_PARSE_CBOR, fp, err) == 0)
+		print_err("truncated ruleset accepted");
+	nftnl_ruleset_free(parsed);
+	fclose(fp);
+
+	nftnl_ruleset_free(rs);
+	nftnl_parse_err_free(err);
+}
+
+static int parse_table(const void *data, size_t len,
+		       struct nftnl_parse_err *err)
+{
+	struct nftnl_table *t = nftnl_table_alloc();
+	FILE *fp = cbor_file(data, len);
+	int ret;
+
+	ret = nftnl_table_parse_file(t, NFTNL_PARSE_CBOR, fp, err);
+	fclose(fp);
+	nftnl_table_free(t);
+
+	return ret;
+}
+
+static void test_bad_input(void)
+{
+	static const char table[] = "\xbf\x65table\xbf\x64name\x66" "filter";
+	static const char broken[] = "\xbf\x65table\xbf\x64name\xff";
+	static const char huge[] = "\xbf\x7b\x7f\xff\xff\xff\xff\xff\xff\xff";
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	FILE *fp;
+
+	/* no "nftables" member */
+	fp = cbor_file("\xbf\xff", 2);
+	if (nftnl_ruleset_parse_file(rs, NFTNL_PARSE_CBOR, fp, err) == 0)
+		print_err("empty document accepted");
+	fclose(fp);
+
+	/* a break where the name should be */
+	if (parse_table(broken, sizeof(broken) - 1, err) == 0)
+		print_err("broken table accepted");
+
+	/* input that ends within a key, within a map */
+	if (parse_table("\xbf\x65t", 3, err) == 0 ||
+	    parse_table(table, sizeof(table) - 1, err) == 0)
+		print_err("truncated table accepted");
+
+	/* a string that claims to be longer than anything sensible */
+	if (parse_table(huge, sizeof(huge) - 1, err) == 0)
+		print_err("huge string accepted");
+
+	/* nesting is limited rather than running out of stack */
+	memset(cbor, 0x9f, 1000);
+	if (parse_table(cbor, 1000, err) == 0)
+		print_err("deeply nested document accepted");
+
+	/* there is no telling where a buffer ends */
+	if (nftnl_table_parse(t, NFTNL_PARSE_CBOR, table, err) == 0 ||
+	    errno != EOPNOTSUPP)
+		print_err("cbor buffer accepted");
+
+	nftnl_table_free(t);
+	nftnl_ruleset_free(rs);
+	nftnl_parse_err_free(err);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	int ret;
+
+	test_table();
+
+	/* parsing shares the json code and is only there with json support */
+	ret = parse_table("\xa0", 1, err);
+	nftnl_parse_err_free(err);
+	if (!(ret < 0 && errno == EOPNOTSUPP)) {
+		test_rule();
+		test_set();
+		test_ruleset();
+		test_bad_input();
+	}
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
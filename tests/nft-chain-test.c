@@ -64,6 +64,56 @@ static void cmp_nftnl_chain(struct nftnl_chain *a, struct nftnl_chain *b)
 		print_err("Chain device mismatches");
 }
 
+static void test_list_lookup(void)
+{
+	struct nftnl_chain_list *list;
+	struct nftnl_chain *c;
+	char name[32];
+	int i;
+
+	list = nftnl_chain_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	for (i = 0; i < 5000; i++) {
+		c = nftnl_chain_alloc();
+		if (c == NULL) {
+			print_err("OOM");
+			goto out;
+		}
+		snprintf(name, sizeof(name), "chain%d", i);
+		nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, name);
+		nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, AF_INET);
+		nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE,
+				    i % 2 ? "filter" : "nat");
+		nftnl_chain_set_u64(c, NFTNL_CHAIN_HANDLE, i / 2);
+		nftnl_chain_list_add_tail(c, list);
+	}
+
+	c = nftnl_chain_list_lookup_byname(list, AF_INET, "filter", "chain77");
+	if (c == NULL || nftnl_chain_get_u64(c, NFTNL_CHAIN_HANDLE) != 38)
+		print_err("Chain lookup by name failed");
+	if (nftnl_chain_list_lookup_byname(list, AF_INET, "nat", "chain77"))
+		print_err("Chain lookup by name ignores the table");
+
+	c = nftnl_chain_list_lookup_byhandle(list, AF_INET, "nat", 38);
+	if (c == NULL ||
+	    strcmp(nftnl_chain_get_str(c, NFTNL_CHAIN_NAME), "chain76") != 0)
+		print_err("Chain lookup by handle failed");
+	if (nftnl_chain_list_lookup_byhandle(list, AF_INET6, "nat", 38))
+		print_err("Chain lookup by handle ignores the family");
+
+	nftnl_chain_list_del(c);
+	nftnl_chain_free(c);
+	if (nftnl_chain_list_lookup_byhandle(list, AF_INET, "nat", 38) ||
+	    nftnl_chain_list_lookup_byname(list, AF_INET, "nat", "chain76"))
+		print_err("Deleted chain is still indexed");
+out:
+	nftnl_chain_list_free(list);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_chain *a, *b;
@@ -101,6 +151,8 @@ int main(int argc, char *argv[])
 	nftnl_chain_free(a);
 	nftnl_chain_free(b);
 
+	test_list_lookup();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
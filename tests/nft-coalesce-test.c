@@ -0,0 +1,277 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/coalesce.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+
+static int test_ok = 1;
+static char buf[8192];
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static size_t put_table(char *b, uint16_t cmd)
+{
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nlh = nftnl_table_nlmsg_build_hdr(b, cmd, NFPROTO_IPV4, 0, 1);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+	nftnl_table_free(t);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_chain(char *b, uint16_t cmd)
+{
+	struct nftnl_chain *c = nftnl_chain_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, "input");
+	nlh = nftnl_chain_nlmsg_build_hdr(b, cmd, NFPROTO_IPV4, 0, 1);
+	nftnl_chain_nlmsg_build_payload(nlh, c);
+	nftnl_chain_free(c);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_rule(char *b, uint16_t cmd, uint64_t handle)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+	nlh = nftnl_rule_nlmsg_build_hdr(b, cmd, NFPROTO_IPV4, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+	nftnl_rule_free(r);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_elem(char *b, uint16_t cmd, uint32_t key)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e = nftnl_set_elem_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, key);
+	nftnl_set_elem_add(s, e);
+	nlh = nftnl_set_nlmsg_build_hdr(b, cmd, NFPROTO_IPV4, 0, 1);
+	nftnl_set_elems_nlmsg_build_payload(nlh, s);
+	nftnl_set_free(s);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_gen(char *b, uint32_t id)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_gen_nlmsg_build_hdr(b, NFT_MSG_NEWGEN, AF_UNSPEC, 0, 1);
+	mnl_attr_put_u32(nlh, NFTA_GEN_ID, htonl(id));
+	return nlh->nlmsg_len;
+}
+
+static int keep_cb(uint16_t type, void *obj, void *data)
+{
+	if (nftnl_coalesce_add(data, type, obj) < 0)
+		return -1;
+
+	return NFTNL_MONITOR_CB_KEEP;
+}
+
+static int print_cb(uint16_t type, void *obj, void *data)
+{
+	struct nftnl_set_elems_iter *iter;
+	struct nftnl_set_elem *e;
+	char *str = data;
+
+	switch (type) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		sprintf(str + strlen(str), "%stable ",
+			type == NFT_MSG_NEWTABLE ? "new" : "del");
+		break;
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		sprintf(str + strlen(str), "%schain ",
+			type == NFT_MSG_NEWCHAIN ? "new" : "del");
+		break;
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		sprintf(str + strlen(str), "%srule:%llu ",
+			type == NFT_MSG_NEWRULE ? "new" : "del",
+			(unsigned long long)
+			nftnl_rule_get_u64(obj, NFTNL_RULE_HANDLE));
+		break;
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		sprintf(str + strlen(str), "%selem:%s",
+			type == NFT_MSG_NEWSETELEM ? "new" : "del",
+			nftnl_set_get_str(obj, NFTNL_SET_NAME));
+		iter = nftnl_set_elems_iter_create(obj);
+		while ((e = nftnl_set_elems_iter_next(iter)) != NULL)
+			sprintf(str + strlen(str), ":%u",
+				nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_KEY));
+		nftnl_set_elems_iter_destroy(iter);
+		strcat(str, " ");
+		break;
+	case NFT_MSG_NEWGEN:
+		sprintf(str + strlen(str), "gen:%u ",
+			nftnl_gen_get_u32(obj, NFTNL_GEN_ID));
+		break;
+	}
+	return 0;
+}
+
+static void test_monitor(struct nftnl_coalesce *c)
+{
+	struct nftnl_monitor *m;
+	char str[256] = "";
+	size_t len = 0;
+
+	len += put_rule(buf + len, NFT_MSG_NEWRULE, 1);
+	len += put_elem(buf + len, NFT_MSG_NEWSETELEM, 10);
+	len += put_rule(buf + len, NFT_MSG_DELRULE, 2);
+	len += put_elem(buf + len, NFT_MSG_DELSETELEM, 10);
+	len += put_elem(buf + len, NFT_MSG_DELSETELEM, 20);
+	len += put_elem(buf + len, NFT_MSG_NEWSETELEM, 20);
+	len += put_elem(buf + len, NFT_MSG_NEWSETELEM, 30);
+	len += put_elem(buf + len, NFT_MSG_NEWSETELEM, 40);
+	len += put_rule(buf + len, NFT_MSG_NEWRULE, 1);
+	len += put_gen(buf + len, 5);
+	len += put_gen(buf + len, 6);
+
+	m = nftnl_monitor_alloc();
+	if (m == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_monitor_set_cb(m, keep_cb, c);
+	if (nftnl_monitor_process(m, buf, len) != 11)
+		print_err("monitor did not hand over all events");
+	nftnl_monitor_free(m);
+
+	if (nftnl_coalesce_pending(c) != 5)
+		print_err("unexpected number of pending objects");
+
+	if (nftnl_coalesce_flush(c, print_cb, str) != 5)
+		print_err("unexpected number of coalesced events");
+	if (strcmp(str, "delrule:2 delelem:hosts:20 "
+			"newrule:1 newelem:hosts:20:30:40 gen:6 ") != 0)
+		print_err("unexpected coalesced events");
+
+	if (nftnl_coalesce_pending(c) != 0 ||
+	    nftnl_coalesce_flush(c, print_cb, str) != 0)
+		print_err("window not reset");
+}
+
+static void test_nlmsg(struct nftnl_coalesce *c)
+{
+	char str[256] = "";
+
+	/* deletions first, in order, then additions in order */
+	put_chain(buf, NFT_MSG_DELCHAIN);
+	if (nftnl_coalesce_nlmsg(c, (void *)buf) < 0)
+		print_err("cannot add event");
+	put_table(buf, NFT_MSG_DELTABLE);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_table(buf, NFT_MSG_NEWTABLE);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_chain(buf, NFT_MSG_NEWCHAIN);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_rule(buf, NFT_MSG_NEWRULE, 7);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_rule(buf, NFT_MSG_DELRULE, 7);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+
+	if (nftnl_coalesce_flush(c, print_cb, str) != 4)
+		print_err("unexpected number of coalesced events");
+	if (strcmp(str, "delchain deltable newtable newchain ") != 0)
+		print_err("unexpected event order");
+}
+
+static void test_update(struct nftnl_coalesce *c)
+{
+	char str[256] = "";
+
+	/* the chain needs the table, an update must not move it behind */
+	put_table(buf, NFT_MSG_NEWTABLE);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_chain(buf, NFT_MSG_NEWCHAIN);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+	put_table(buf, NFT_MSG_NEWTABLE);
+	nftnl_coalesce_nlmsg(c, (void *)buf);
+
+	if (nftnl_coalesce_flush(c, print_cb, str) != 2)
+		print_err("unexpected number of coalesced events");
+	if (strcmp(str, "newtable newchain ") != 0)
+		print_err("update moved the table behind the chain");
+}
+
+static void test_many(struct nftnl_coalesce *c)
+{
+	uint64_t i;
+
+	/* enough objects for the table to grow, each one found again */
+	for (i = 1; i <= 5000; i++) {
+		put_rule(buf, NFT_MSG_NEWRULE, i);
+		nftnl_coalesce_nlmsg(c, (void *)buf);
+	}
+	if (nftnl_coalesce_pending(c) != 5000)
+		print_err("unexpected number of pending objects");
+
+	for (i = 1; i <= 5000; i++) {
+		put_rule(buf, NFT_MSG_DELRULE, i);
+		nftnl_coalesce_nlmsg(c, (void *)buf);
+	}
+	if (nftnl_coalesce_pending(c) != 0)
+		print_err("added and deleted objects are still pending");
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_coalesce *c;
+
+	c = nftnl_coalesce_alloc();
+	if (c == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	test_monitor(c);
+	test_nlmsg(c);
+	test_update(c);
+	test_many(c);
+
+	nftnl_coalesce_free(c);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/gen.h>
+
+static int test_ok = 1;
+static char buf[8192];
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nlmsghdr *gen_msg(uint32_t id, uint32_t portid)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_gen_nlmsg_build_hdr(buf, NFT_MSG_NEWGEN, AF_UNSPEC, 0, 1);
+	nlh->nlmsg_pid = portid;
+	mnl_attr_put_u32(nlh, NFTA_GEN_ID, htonl(id));
+	return nlh;
+}
+
+static void test_commit(void)
+{
+	struct nftnl_gen_commit *gc;
+	struct nlmsghdr *nlh;
+
+	gc = nftnl_gen_commit_alloc(10, 1234);
+	if (gc == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	/* other messages and older generations do not matter */
+	nlh = nftnl_nlmsg_build_hdr(buf, NFT_MSG_NEWTABLE, AF_INET, 0, 1);
+	if (nftnl_gen_commit_event(gc, nlh) != NFTNL_GEN_COMMIT_PENDING)
+		print_err("table event changed the commit state");
+	if (nftnl_gen_commit_event(gc, gen_msg(10, 99)) !=
+	    NFTNL_GEN_COMMIT_PENDING)
+		print_err("old generation changed the commit state");
+
+	if (nftnl_gen_commit_event(gc, gen_msg(11, 1234)) !=
+	    NFTNL_GEN_COMMIT_OK)
+		print_err("commit not reported as done");
+	if (nftnl_gen_commit_genid(gc) != 11)
+		print_err("generation not updated");
+	nftnl_gen_commit_free(gc);
+
+	/* someone else comes first */
+	gc = nftnl_gen_commit_alloc(10, 1234);
+	if (nftnl_gen_commit_event(gc, gen_msg(11, 99)) !=
+	    NFTNL_GEN_COMMIT_CONFLICT)
+		print_err("conflict not reported");
+	if (nftnl_gen_commit_event(gc, gen_msg(12, 1234)) !=
+	    NFTNL_GEN_COMMIT_CONFLICT)
+		print_err("conflict not kept");
+	nftnl_gen_commit_free(gc);
+
+	/* our batch, but some generation was skipped */
+	gc = nftnl_gen_commit_alloc(10, 1234);
+	if (nftnl_gen_commit_event(gc, gen_msg(12, 1234)) !=
+	    NFTNL_GEN_COMMIT_CONFLICT)
+		print_err("missed generation not reported");
+	nftnl_gen_commit_free(gc);
+}
+
+static int batch_attr_cb(const struct nlattr *attr, void *data)
+{
+	const struct nlattr **tb = data;
+
+	if (mnl_attr_get_type(attr) == NFNL_BATCH_GENID)
+		*tb = attr;
+
+	return MNL_CB_OK;
+}
+
+static void test_batch_begin(void)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nlattr *attr = NULL;
+
+	nftnl_batch_begin_genid(buf, 1, 42);
+	if (nlh->nlmsg_type != NFNL_MSG_BATCH_BEGIN)
+		print_err("not a batch begin message");
+
+	mnl_attr_parse(nlh, sizeof(struct nfgenmsg), batch_attr_cb, &attr);
+	if (attr == NULL || ntohl(mnl_attr_get_u32(attr)) != 42)
+		print_err("batch generation ID is missing");
+}
+
+int main(int argc, char *argv[])
+{
+	test_commit();
+	test_batch_begin();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/monitor.h>
+#include <libnftnl/table.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+#include <libnftnl/sink.h>
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static size_t put_rule(char *buf, const char *table, uint64_t handle)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, table);
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, NFPROTO_IPV4,
+					 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+	nftnl_rule_free(r);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_elem(char *buf, const char *set, uint32_t key)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e = nftnl_set_elem_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, set);
+	nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, key);
+	nftnl_set_elem_add(s, e);
+	nlh = nftnl_set_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, NFPROTO_IPV4,
+					0, 1);
+	nftnl_set_elems_nlmsg_build_payload(nlh, s);
+	nftnl_set_free(s);
+	return nlh->nlmsg_len;
+}
+
+static size_t put_gen(char *buf, uint32_t id)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_gen_nlmsg_build_hdr(buf, NFT_MSG_NEWGEN, AF_UNSPEC, 0, 1);
+	mnl_attr_put_u32(nlh, NFTA_GEN_ID, htonl(id));
+	return nlh->nlmsg_len;
+}
+
+static int monitor_cb(uint16_t type, void *obj, void *data)
+{
+	char *str = data;
+
+	switch (type) {
+	case NFT_MSG_NEWRULE:
+		sprintf(str + strlen(str), "rule:%llu ", (unsigned long long)
+			nftnl_rule_get_u64(obj, NFTNL_RULE_HANDLE));
+		break;
+	case NFT_MSG_NEWSETELEM:
+		sprintf(str + strlen(str), "elem:%s ",
+			nftnl_set_get_str(obj, NFTNL_SET_NAME));
+		break;
+	case NFT_MSG_NEWGEN:
+		sprintf(str + strlen(str), "gen:%u ",
+			nftnl_gen_get_u32(obj, NFTNL_GEN_ID));
+		break;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_monitor_stats stats;
+	struct nftnl_monitor *m;
+	struct nftnl_sink *sink;
+	char buf[8192], str[256] = "";
+	size_t len = 0;
+	int ret;
+
+	len += put_rule(buf + len, "filter", 1);
+	len += put_rule(buf + len, "nat", 2);
+	len += put_elem(buf + len, "hosts", 10);
+	len += put_elem(buf + len, "ports", 20);
+	len += put_rule(buf + len, "filter", 3);
+	len += put_gen(buf + len, 7);
+
+	m = nftnl_monitor_alloc();
+	if (m == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_monitor_set_cb(m, monitor_cb, str);
+	nftnl_monitor_set_str(m, NFTNL_MONITOR_TABLE, "filter");
+	nftnl_monitor_set_str(m, NFTNL_MONITOR_SET, "hosts");
+
+	ret = nftnl_monitor_process(m, buf, len);
+	if (ret != 4)
+		print_err("unexpected number of events");
+	if (strcmp(str, "rule:1 elem:hosts rule:3 gen:7 ") != 0)
+		print_err("unexpected events");
+
+	nftnl_monitor_get_stats(m, &stats);
+	if (stats.received != 6 || stats.filtered != 2 ||
+	    stats.decoded != 4 || stats.errors != 0 || stats.lost != 0)
+		print_err("unexpected statistics");
+
+	/* only rules from now on */
+	str[0] = '\0';
+	nftnl_monitor_set_u32(m, NFTNL_MONITOR_TYPES, 1 << NFT_MSG_NEWRULE);
+	nftnl_monitor_set_str(m, NFTNL_MONITOR_TABLE, NULL);
+	ret = nftnl_monitor_process(m, buf, len);
+	if (ret != 3 || strcmp(str, "rule:1 rule:2 rule:3 ") != 0)
+		print_err("type filter failed");
+
+	/* NDJSON, one line per event */
+	sink = nftnl_sink_alloc();
+	nftnl_monitor_set_sink(m, sink);
+	nftnl_monitor_set_cb(m, NULL, NULL);
+	nftnl_monitor_set_u32(m, NFTNL_MONITOR_TYPES, ~0U);
+	nftnl_monitor_set_str(m, NFTNL_MONITOR_TABLE, "filter");
+	ret = nftnl_monitor_process(m, buf, len);
+	if (ret != 4 || strcmp(nftnl_sink_buf(sink, NULL),
+		"{\"add\":{\"rule\":{\"family\":\"ip\",\"table\":\"filter\","
+		"\"chain\":\"input\",\"handle\":1,\"expr\":[]}}}\n"
+		"{\"add\":{\"element\":{\"name\":\"hosts\",\"table\":\"filter\","
+		"\"family\":\"ip\",\"set_elem\":[{\"key\":{\"reg\":{"
+		"\"type\":\"value\",\"len\":4,\"data0\":\"0x0000000a\"}}}]}}}\n"
+		"{\"add\":{\"rule\":{\"family\":\"ip\",\"table\":\"filter\","
+		"\"chain\":\"input\",\"handle\":3,\"expr\":[]}}}\n"
+		"{\"add\":{\"gen\":{\"id\":7}}}\n") != 0)
+		print_err("unexpected NDJSON output");
+
+	nftnl_monitor_free(m);
+	nftnl_sink_free(sink);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
@@ -11,10 +11,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include <netinet/in.h>
 #include <linux/netfilter/nf_tables.h>
 #include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
 
 static int test_ok = 1;
 
@@ -49,6 +52,354 @@ static void cmp_nftnl_rule(struct nftnl_rule *a, struct nftnl_rule *b)
 		print_err("Rule compat_position mismatches");
 }
 
+static struct nftnl_rule *rule_build(const char *chain, uint64_t handle)
+{
+	struct nftnl_rule *r;
+
+	r = nftnl_rule_alloc();
+	if (r == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, AF_INET);
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, chain);
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+
+	return r;
+}
+
+static int chain_order_cb(struct nftnl_rule *r, void *data)
+{
+	uint64_t **handle = data;
+
+	if (nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) != **handle)
+		print_err("Rule out of order in chain");
+	(*handle)++;
+	return 0;
+}
+
+static void test_list(bool index)
+{
+	static uint64_t order[] = { 2, 1000, 4, 8, 10 };
+	uint64_t *pos = order;
+	struct nftnl_rule_list *list;
+	struct nftnl_rule *r;
+	uint64_t i;
+
+	list = nftnl_rule_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 1; i <= 10; i++)
+		nftnl_rule_list_add_tail(rule_build(i % 2 ? "a" : "b", i),
+					 list);
+
+	if (index && nftnl_rule_list_index(list) < 0)
+		print_err("Cannot index rule list");
+
+	r = nftnl_rule_list_lookup_byhandle(list, AF_INET, "table", 6);
+	if (r == NULL ||
+	    strcmp(nftnl_rule_get_str(r, NFTNL_RULE_CHAIN), "b") != 0)
+		print_err("Rule lookup by handle failed");
+	if (nftnl_rule_list_lookup_byhandle(list, AF_INET, "other", 6))
+		print_err("Rule lookup by handle ignores the table");
+
+	nftnl_rule_list_del(r);
+	nftnl_rule_free(r);
+	if (nftnl_rule_list_lookup_byhandle(list, AF_INET, "table", 6))
+		print_err("Deleted rule is still found");
+
+	r = rule_build("b", 1000);
+	if (nftnl_rule_list_insert_after(r, list, 2) < 0)
+		print_err("Cannot insert rule after handle");
+	r = rule_build("b", 1001);
+	if (nftnl_rule_list_insert_after(r, list, 3) == 0)
+		print_err("Rule inserted after a rule in another chain");
+	nftnl_rule_free(r);
+
+	nftnl_rule_list_chain_foreach(list, AF_INET, "table", "b",
+				      chain_order_cb, &pos);
+	if (pos != order + sizeof(order) / sizeof(order[0]))
+		print_err("Wrong number of rules in chain");
+
+	nftnl_rule_list_free(list);
+}
+
+static int count_cb(struct nftnl_rule *r, void *data)
+{
+	(*(uint32_t *)data)++;
+	return 0;
+}
+
+/* the index grows past its initial size while rules come and go */
+static void test_index_grow(void)
+{
+	struct nftnl_rule_list *list;
+	struct nftnl_rule *r;
+	uint32_t i, n = 0;
+	char chain[32];
+
+	list = nftnl_rule_list_alloc();
+	if (list == NULL || nftnl_rule_list_index(list) < 0) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 1; i <= 20000; i++) {
+		snprintf(chain, sizeof(chain), "chain%u", i % 2000);
+		nftnl_rule_list_add_tail(rule_build(chain, i), list);
+		if (i % 3 == 0) {
+			r = nftnl_rule_list_lookup_byhandle(list, AF_INET,
+							    "table", i / 2);
+			if (r == NULL) {
+				print_err("Rule lost while the index grows");
+				break;
+			}
+			nftnl_rule_list_del(r);
+			nftnl_rule_free(r);
+		}
+	}
+
+	r = nftnl_rule_list_lookup_byhandle(list, AF_INET, "table", 19999);
+	if (r == NULL ||
+	    strcmp(nftnl_rule_get_str(r, NFTNL_RULE_CHAIN), "chain1999") != 0)
+		print_err("Rule lookup by handle failed after growing");
+
+	nftnl_rule_list_chain_foreach(list, AF_INET, "table", "chain1999",
+				      count_cb, &n);
+	if (n == 0 || n > 10)
+		print_err("Wrong number of rules in chain after growing");
+
+	nftnl_rule_list_free(list);
+}
+
+static struct nftnl_rule *rule_build_expr(uint64_t handle, uint32_t port,
+					  uint64_t packets)
+{
+	struct nftnl_rule *r = rule_build("chain", handle);
+	struct nftnl_expr *e;
+
+	nftnl_rule_set_u64(r, NFTNL_RULE_POSITION, handle * 2);
+
+	e = nftnl_expr_alloc("cmp");
+	if (e == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+	nftnl_expr_set(e, NFTNL_EXPR_CMP_DATA, &port, sizeof(port));
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("counter");
+	if (e == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_expr_set_u64(e, NFTNL_EXPR_CTR_PACKETS, packets);
+	nftnl_rule_add_expr(r, e);
+
+	return r;
+}
+
+static void test_fingerprint(void)
+{
+	uint64_t fp_a[2], fp_b[2], fp_c[2];
+	struct nftnl_rule_list *list;
+	struct nftnl_rule_dedup *d;
+	struct nftnl_rule *a, *b, *c;
+	uint32_t i;
+
+	a = rule_build_expr(1, 22, 10);
+	b = rule_build_expr(2, 22, 20);
+	c = rule_build_expr(1, 80, 10);
+
+	if (nftnl_rule_fingerprint(a, NULL, fp_a) < 0 ||
+	    nftnl_rule_fingerprint(b, NULL, fp_b) < 0 ||
+	    nftnl_rule_fingerprint(c, NULL, fp_c) < 0)
+		print_err("Cannot fingerprint rule");
+	if (fp_a[0] != fp_b[0] || fp_a[1] != fp_b[1])
+		print_err("Equal rules have different fingerprints");
+	if (fp_a[0] == fp_c[0] && fp_a[1] == fp_c[1])
+		print_err("Different rules have the same fingerprint");
+
+	d = nftnl_rule_dedup_alloc();
+	if (d == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	if (nftnl_rule_dedup_add(d, a) != 1 || nftnl_rule_dedup_add(d, b) != 0)
+		print_err("Rule dedup add failed");
+	if (nftnl_rule_dedup_lookup(d, b) != a ||
+	    nftnl_rule_dedup_lookup(d, c) != NULL)
+		print_err("Rule dedup lookup failed");
+	nftnl_rule_dedup_free(d);
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+	nftnl_rule_free(c);
+
+	list = nftnl_rule_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	/* 5000 distinct rules, each one twice */
+	for (i = 0; i < 10000; i++)
+		nftnl_rule_list_add_tail(rule_build_expr(i, i % 5000, i), list);
+
+	if (nftnl_rule_list_dedup(list) != 5000)
+		print_err("Wrong number of duplicated rules removed");
+
+	a = nftnl_rule_list_lookup_byhandle(list, AF_INET, "table", 4999);
+	b = nftnl_rule_list_lookup_byhandle(list, AF_INET, "table", 5000);
+	if (a == NULL || b != NULL)
+		print_err("Rule dedup did not keep the first rule");
+
+	nftnl_rule_list_free(list);
+}
+
+static struct nftnl_set *anon_set_build(const char *name, uint32_t id,
+					uint32_t key)
+{
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s;
+
+	s = nftnl_set_alloc();
+	e = nftnl_set_elem_alloc();
+	if (s == NULL || e == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, AF_INET);
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "table");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, name);
+	nftnl_set_set_u32(s, NFTNL_SET_ID, id);
+	nftnl_set_set_u32(s, NFTNL_SET_FLAGS,
+			  NFT_SET_ANONYMOUS | NFT_SET_CONSTANT);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(key));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_add(s, e);
+
+	return s;
+}
+
+static struct nftnl_rule *rule_build_lookup(uint64_t handle, const char *set,
+					    uint32_t set_id)
+{
+	struct nftnl_rule *r = rule_build("chain", handle);
+	struct nftnl_expr *e;
+
+	e = nftnl_expr_alloc("lookup");
+	if (e == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_expr_set_u32(e, NFTNL_EXPR_LOOKUP_SREG, NFT_REG_1);
+	nftnl_expr_set_str(e, NFTNL_EXPR_LOOKUP_SET, set);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_LOOKUP_SET_ID, set_id);
+	nftnl_rule_add_expr(r, e);
+
+	return r;
+}
+
+static int lookup_check_cb(struct nftnl_expr *e, void *data)
+{
+	if (!nftnl_expr_is_set(e, NFTNL_EXPR_LOOKUP_SET) ||
+	    !nftnl_expr_is_set(e, NFTNL_EXPR_LOOKUP_SET_ID))
+		print_err("Fingerprint changed the lookup expression");
+	return 0;
+}
+
+static void test_fingerprint_anon(void)
+{
+	uint64_t fp_a[2], fp_b[2], fp_c[2];
+	struct nftnl_set_list *sets;
+	struct nftnl_rule *a, *b, *c;
+
+	sets = nftnl_set_list_alloc();
+	if (sets == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_set_list_add_tail(anon_set_build("__set0", 1, 22), sets);
+	nftnl_set_list_add_tail(anon_set_build("__set1", 2, 22), sets);
+	nftnl_set_list_add_tail(anon_set_build("__set2", 3, 80), sets);
+
+	a = rule_build_lookup(1, "__set0", 1);
+	b = rule_build_lookup(2, "__set1", 2);
+	c = rule_build_lookup(3, "__set2", 3);
+
+	if (nftnl_rule_fingerprint(a, sets, fp_a) < 0 ||
+	    nftnl_rule_fingerprint(b, sets, fp_b) < 0 ||
+	    nftnl_rule_fingerprint(c, sets, fp_c) < 0)
+		print_err("Cannot fingerprint rule");
+	if (fp_a[0] != fp_b[0] || fp_a[1] != fp_b[1])
+		print_err("Renamed anonymous set changes the fingerprint");
+	if (fp_a[0] == fp_c[0] && fp_a[1] == fp_c[1])
+		print_err("Anonymous set content not in the fingerprint");
+
+	if (nftnl_rule_fingerprint(a, NULL, fp_a) < 0 ||
+	    nftnl_rule_fingerprint(b, NULL, fp_b) < 0)
+		print_err("Cannot fingerprint rule");
+	if (fp_a[0] == fp_b[0] && fp_a[1] == fp_b[1])
+		print_err("Unknown anonymous set names not in the fingerprint");
+
+	nftnl_expr_foreach(a, lookup_check_cb, NULL);
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+	nftnl_rule_free(c);
+	nftnl_set_list_free(sets);
+}
+
+static int expr_count_cb(struct nftnl_expr *e, void *data)
+{
+	uint32_t *num = data;
+
+	if (strcmp(nftnl_expr_get_str(e, NFTNL_EXPR_NAME), "counter") != 0 ||
+	    nftnl_expr_get_u64(e, NFTNL_EXPR_CTR_PACKETS) != 99)
+		print_err("Unexpected expression decoded");
+	(*num)++;
+	return 0;
+}
+
+static void test_parse_mask(void)
+{
+	struct nftnl_rule *a, *b;
+	struct nlmsghdr *nlh;
+	char buf[4096];
+	uint32_t num = 0;
+
+	a = rule_build_expr(7, 22, 99);
+	b = nftnl_rule_alloc();
+	if (b == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh, a);
+
+	if (nftnl_rule_nlmsg_parse_mask(nlh, b, (1 << NFTNL_RULE_HANDLE) |
+					NFTNL_RULE_PARSE_EXPRS, "counter") < 0)
+		print_err("parsing problems");
+
+	if (nftnl_rule_get_u64(b, NFTNL_RULE_HANDLE) != 7)
+		print_err("Rule handle not decoded");
+	if (nftnl_rule_is_set(b, NFTNL_RULE_TABLE) ||
+	    nftnl_rule_is_set(b, NFTNL_RULE_POSITION))
+		print_err("Unwanted rule attribute decoded");
+
+	nftnl_expr_foreach(b, expr_count_cb, &num);
+	if (num != 1)
+		print_err("Wrong number of expressions decoded");
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_rule *a, *b;
@@ -76,8 +427,20 @@ int main(int argc, char *argv[])
 
 	cmp_nftnl_rule(a,b);
 
+	if (nftnl_rule_get_str(a, NFTNL_RULE_TABLE) !=
+	    nftnl_rule_get_str(b, NFTNL_RULE_TABLE))
+		print_err("Rule table name is not shared");
+
 	nftnl_rule_free(a);
 	nftnl_rule_free(b);
+
+	test_list(false);
+	test_list(true);
+	test_index_grow();
+	test_fingerprint();
+	test_fingerprint_anon();
+	test_parse_mask();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -0,0 +1,319 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/sink.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+#include <libnftnl/ruleset.h>
+
+#define NRULES	100
+#define NELEMS	5000
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_ruleset *build_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_chain_list *cl = nftnl_chain_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nftnl_chain *c = nftnl_chain_alloc();
+	struct nftnl_set_elem *e;
+	struct nftnl_expr *ex;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	uint32_t i;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_list_add_tail(t, tl);
+
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, "input");
+	nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, NFPROTO_IPV4);
+	nftnl_chain_set_u64(c, NFTNL_CHAIN_HANDLE, 1);
+	nftnl_chain_list_add_tail(c, cl);
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < NELEMS; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, i);
+		nftnl_set_elem_add(s, e);
+	}
+	nftnl_set_list_add_tail(s, sl);
+
+	for (i = 0; i < NRULES; i++) {
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+		nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, i + 10);
+		ex = nftnl_expr_alloc("lookup");
+		nftnl_expr_set_str(ex, NFTNL_EXPR_LOOKUP_SET, "hosts");
+		nftnl_expr_set_u32(ex, NFTNL_EXPR_LOOKUP_SREG, NFT_REG_1);
+		nftnl_rule_add_expr(r, ex);
+		ex = nftnl_expr_alloc("dynset");
+		nftnl_expr_set_str(ex, NFTNL_EXPR_DYNSET_SET_NAME, "hosts");
+		nftnl_expr_set_u32(ex, NFTNL_EXPR_DYNSET_SREG_KEY, NFT_REG_1);
+		nftnl_expr_set_u32(ex, NFTNL_EXPR_DYNSET_OP,
+				   NFT_DYNSET_OP_UPDATE);
+		nftnl_expr_set_u64(ex, NFTNL_EXPR_DYNSET_TIMEOUT, 1000);
+		nftnl_rule_add_expr(r, ex);
+		nftnl_rule_list_add_tail(r, rl);
+	}
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, cl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	return rs;
+}
+
+struct count {
+	uint32_t	msgs;
+	uint32_t	types[NFT_MSG_MAX];
+	uint32_t	set_id;
+	bool		set_id_ok;
+	bool		rule_ok;
+};
+
+static void check_rule(struct count *c, const struct nlmsghdr *nlh)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nftnl_expr_iter *it;
+	struct nftnl_expr *e;
+	int ids = 0;
+
+	if (nftnl_rule_nlmsg_parse(nlh, r) < 0 ||
+	    nftnl_rule_is_set(r, NFTNL_RULE_HANDLE) ||
+	    !(nlh->nlmsg_flags & NLM_F_APPEND))
+		c->rule_ok = false;
+
+	it = nftnl_expr_iter_create(r);
+	while ((e = nftnl_expr_iter_next(it)) != NULL) {
+		if (nftnl_expr_is_set(e, NFTNL_EXPR_LOOKUP_SET_ID) &&
+		    nftnl_expr_get_u32(e, NFTNL_EXPR_LOOKUP_SET_ID) == c->set_id)
+			ids++;
+		else if (nftnl_expr_is_set(e, NFTNL_EXPR_DYNSET_SET_ID) &&
+			 nftnl_expr_get_u32(e, NFTNL_EXPR_DYNSET_SET_ID) == c->set_id)
+			ids++;
+	}
+	nftnl_expr_iter_destroy(it);
+
+	/* both the lookup and the dynset refer to the set by its ID */
+	if (ids != 2)
+		c->set_id_ok = false;
+
+	nftnl_rule_free(r);
+}
+
+static void count_msgs(struct count *c, struct nftnl_batch *batch)
+{
+	struct nftnl_set *s;
+	struct nlmsghdr *nlh;
+	struct iovec *v;
+	int i, len;
+	uint16_t type;
+
+	v = calloc(nftnl_batch_iovec_len(batch), sizeof(struct iovec));
+	nftnl_batch_iovec(batch, v, nftnl_batch_iovec_len(batch));
+	for (i = 0; i < nftnl_batch_iovec_len(batch); i++) {
+		len = v[i].iov_len;
+		for (nlh = v[i].iov_base; mnl_nlmsg_ok(nlh, len);
+		     nlh = mnl_nlmsg_next(nlh, &len)) {
+			type = nlh->nlmsg_type & 0xff;
+			c->msgs++;
+			if (type < NFT_MSG_MAX)
+				c->types[type]++;
+
+			switch (type) {
+			case NFT_MSG_NEWSET:
+				s = nftnl_set_alloc();
+				nftnl_set_nlmsg_parse(nlh, s);
+				c->set_id = nftnl_set_get_u32(s, NFTNL_SET_ID);
+				nftnl_set_free(s);
+				break;
+			case NFT_MSG_NEWSETELEM:
+			case NFT_MSG_DELSETELEM:
+				s = nftnl_set_alloc();
+				nftnl_set_elems_nlmsg_parse(nlh, s);
+				/* "gone" is not in the ruleset, it has no ID */
+				if (strcmp(nftnl_set_get_str(s, NFTNL_SET_NAME),
+					   "gone") == 0 ?
+				    nftnl_set_is_set(s, NFTNL_SET_ID) :
+				    nftnl_set_get_u32(s, NFTNL_SET_ID) != c->set_id)
+					c->set_id_ok = false;
+				nftnl_set_free(s);
+				break;
+			case NFT_MSG_NEWRULE:
+				check_rule(c, nlh);
+				break;
+			}
+		}
+	}
+	free(v);
+}
+
+static void test_ruleset(void)
+{
+	struct nftnl_ruleset *rs = build_ruleset();
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct count c = { .set_id_ok = true, .rule_ok = true };
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	struct nftnl_batch *batch;
+	uint32_t seq = 1;
+	int msgs;
+
+	nftnl_ruleset_output(sink, rs, NFTNL_OUTPUT_JSON, NFTNL_OF_EVENT_NEW);
+	nftnl_ruleset_free(rs);
+
+	batch = nftnl_batch_alloc(4 * 65536, 2 * 65536);
+	msgs = nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+						nftnl_sink_buf(sink, NULL),
+						err, batch, &seq);
+	if (msgs < 0) {
+		print_err("cannot import ruleset");
+		goto out;
+	}
+
+	count_msgs(&c, batch);
+	if (c.msgs != (uint32_t)msgs || seq != (uint32_t)msgs + 1)
+		print_err("batch does not hold the messages");
+	if (c.types[NFT_MSG_NEWTABLE] != 1 || c.types[NFT_MSG_NEWCHAIN] != 1 ||
+	    c.types[NFT_MSG_NEWSET] != 1 || c.types[NFT_MSG_NEWRULE] != NRULES)
+		print_err("wrong number of objects");
+	if (c.types[NFT_MSG_NEWSETELEM] < 2)
+		print_err("elements not split over several messages");
+	if (!c.set_id_ok)
+		print_err("set not referred to by its ID");
+	if (!c.rule_ok)
+		print_err("rule not appended");
+out:
+	nftnl_batch_free(batch);
+	nftnl_sink_free(sink);
+	nftnl_parse_err_free(err);
+}
+
+#define ELEMS(cmd, name)						\
+	"{\"" cmd "\":[{\"element\":{\"name\":\"" name "\","		\
+	"\"table\":\"filter\",\"family\":\"ip\",\"key_len\":4,"	\
+	"\"set_elem\":[{\"key\":{\"reg\":{\"type\":\"value\","		\
+	"\"len\":4,\"data0\":\"0x00000007\"}}}]}}]}"
+
+static void test_commands(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct count c = { .set_id_ok = true, .rule_ok = true };
+	struct nftnl_batch *batch;
+	uint32_t seq = 1;
+	int msgs;
+
+	batch = nftnl_batch_alloc(4 * 65536, 2 * 65536);
+	msgs = nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+			"{\"nftables\":[{\"flush\":[]},"
+			"{\"add\":[{\"set\":{\"name\":\"hosts\","
+			"\"table\":\"filter\",\"family\":\"ip\","
+			"\"key_len\":4}}]},"
+			ELEMS("add", "hosts") ","
+			ELEMS("delete", "gone") "]}",
+			err, batch, &seq);
+	if (msgs != 4) {
+		print_err("cannot import commands");
+		goto out;
+	}
+
+	count_msgs(&c, batch);
+	if (c.types[NFT_MSG_DELTABLE] != 1 || c.types[NFT_MSG_NEWSET] != 1 ||
+	    c.types[NFT_MSG_NEWSETELEM] != 1 ||
+	    c.types[NFT_MSG_DELSETELEM] != 1)
+		print_err("wrong messages for the commands");
+	if (!c.set_id_ok)
+		print_err("elements refer to the wrong set");
+
+	/* nothing to replace a table with */
+	if (nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+			"{\"nftables\":[{\"replace\":[{\"table\":"
+			"{\"name\":\"filter\",\"family\":\"ip\"}}]}]}",
+			err, batch, &seq) >= 0)
+		print_err("replace table accepted");
+out:
+	nftnl_batch_free(batch);
+	nftnl_parse_err_free(err);
+}
+
+/* element messages would not fit behind the end of a page */
+static void test_small_overrun(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_batch *batch;
+	uint32_t seq = 1;
+
+	batch = nftnl_batch_alloc(4 * 65536, 4096);
+	errno = 0;
+	if (nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+			"{\"nftables\":[{\"flush\":[]}]}",
+			err, batch, &seq) >= 0 || errno != EINVAL ||
+	    seq != 1)
+		print_err("batch with a small overrun accepted");
+
+	nftnl_batch_free(batch);
+	nftnl_parse_err_free(err);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	int ret;
+
+	/* nothing to test without JSON support */
+	ret = nftnl_ruleset_parse(rs, NFTNL_PARSE_JSON, "{}", err);
+	nftnl_ruleset_free(rs);
+	nftnl_parse_err_free(err);
+	if (ret < 0 && errno == EOPNOTSUPP) {
+		printf("%s: \033[32mOK\e[0m\n", argv[0]);
+		return EXIT_SUCCESS;
+	}
+
+	test_ruleset();
+	test_commands();
+	test_small_overrun();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
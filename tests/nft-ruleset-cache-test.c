@@ -0,0 +1,270 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/gen.h>
+
+static int test_ok = 1;
+static char buf[8192];
+static uint32_t seq;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nlmsghdr *gen_msg(uint32_t id)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_gen_nlmsg_build_hdr(buf, NFT_MSG_NEWGEN, AF_UNSPEC, 0,
+					seq++);
+	mnl_attr_put_u32(nlh, NFTA_GEN_ID, htonl(id));
+	return nlh;
+}
+
+static struct nlmsghdr *table_msg(uint16_t cmd)
+{
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nlh = nftnl_table_nlmsg_build_hdr(buf, cmd, NFPROTO_IPV4, 0, seq++);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+	nftnl_table_free(t);
+	return nlh;
+}
+
+static struct nlmsghdr *chain_msg(uint16_t cmd, const char *name)
+{
+	struct nftnl_chain *c = nftnl_chain_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, name);
+	nlh = nftnl_chain_nlmsg_build_hdr(buf, cmd, NFPROTO_IPV4, 0, seq++);
+	nftnl_chain_nlmsg_build_payload(nlh, c);
+	nftnl_chain_free(c);
+	return nlh;
+}
+
+static struct nlmsghdr *rule_msg(uint16_t cmd, uint64_t handle, uint64_t pos)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+	if (pos)
+		nftnl_rule_set_u64(r, NFTNL_RULE_POSITION, pos);
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, cmd, NFPROTO_IPV4, 0, seq++);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+	nftnl_rule_free(r);
+	return nlh;
+}
+
+static struct nlmsghdr *set_msg(uint16_t cmd)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	nlh = nftnl_set_nlmsg_build_hdr(buf, cmd, NFPROTO_IPV4, 0, seq++);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+	nftnl_set_free(s);
+	return nlh;
+}
+
+static struct nlmsghdr *elem_msg(uint16_t cmd, uint32_t key)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e = nftnl_set_elem_alloc();
+	struct nlmsghdr *nlh;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, key);
+	nftnl_set_elem_add(s, e);
+	nlh = nftnl_set_nlmsg_build_hdr(buf, cmd, NFPROTO_IPV4, 0, seq++);
+	nftnl_set_elems_nlmsg_build_payload(nlh, s);
+	nftnl_set_free(s);
+	return nlh;
+}
+
+static int rule_handle_cb(struct nftnl_rule *r, void *data)
+{
+	char *str = data;
+
+	sprintf(str + strlen(str), "%llu ", (unsigned long long)
+		nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE));
+	return 0;
+}
+
+static void check_rules(struct nftnl_ruleset_cache *c, const char *expected)
+{
+	const struct nftnl_ruleset *rs = nftnl_ruleset_cache_ruleset(c);
+	char str[64] = "";
+
+	nftnl_rule_list_chain_foreach(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_RULELIST),
+				      NFPROTO_IPV4, "filter", "input",
+				      rule_handle_cb, str);
+	if (strcmp(str, expected) != 0)
+		print_err("unexpected rules");
+}
+
+static void check_elems(struct nftnl_ruleset_cache *c, const char *expected)
+{
+	const struct nftnl_ruleset *rs = nftnl_ruleset_cache_ruleset(c);
+	struct nftnl_set_elems_iter *iter;
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s;
+	char str[64] = "";
+
+	s = nftnl_set_list_lookup_byname(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST),
+					 NFPROTO_IPV4, "filter", "hosts");
+	if (s == NULL) {
+		if (expected != NULL)
+			print_err("set is missing");
+		return;
+	}
+	if (expected == NULL) {
+		print_err("set is still there");
+		return;
+	}
+
+	iter = nftnl_set_elems_iter_create(s);
+	while ((e = nftnl_set_elems_iter_next(iter)) != NULL)
+		sprintf(str + strlen(str), "%u ",
+			nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_KEY));
+	nftnl_set_elems_iter_destroy(iter);
+
+	if (strcmp(str, expected) != 0)
+		print_err("unexpected elements");
+}
+
+static bool has_chain(struct nftnl_ruleset_cache *c, const char *name)
+{
+	const struct nftnl_ruleset *rs = nftnl_ruleset_cache_ruleset(c);
+
+	return nftnl_chain_list_lookup_byname(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_CHAINLIST),
+					      NFPROTO_IPV4, "filter",
+					      name) != NULL;
+}
+
+static void event(struct nftnl_ruleset_cache *c, struct nlmsghdr *nlh,
+		  int expected)
+{
+	if (nftnl_ruleset_cache_event(c, nlh) != expected)
+		print_err("unexpected event result");
+}
+
+static void load(struct nftnl_ruleset_cache *c)
+{
+	if (nftnl_ruleset_cache_reset(c) < 0 ||
+	    nftnl_ruleset_cache_dump(c, gen_msg(5)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, table_msg(NFT_MSG_NEWTABLE)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, chain_msg(NFT_MSG_NEWCHAIN,
+						  "input")) < 0 ||
+	    nftnl_ruleset_cache_dump(c, set_msg(NFT_MSG_NEWSET)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, elem_msg(NFT_MSG_NEWSETELEM, 10)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, elem_msg(NFT_MSG_NEWSETELEM, 20)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, rule_msg(NFT_MSG_NEWRULE, 1, 0)) < 0 ||
+	    nftnl_ruleset_cache_dump(c, rule_msg(NFT_MSG_NEWRULE, 2, 1)) < 0)
+		print_err("dump failed");
+
+	if (!nftnl_ruleset_cache_synced(c) ||
+	    nftnl_ruleset_cache_genid(c) != 5)
+		print_err("cache not in sync after dump");
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_ruleset_cache *c;
+
+	c = nftnl_ruleset_cache_alloc();
+	if (c == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	if (nftnl_ruleset_cache_synced(c))
+		print_err("new cache is in sync");
+	event(c, rule_msg(NFT_MSG_NEWRULE, 1, 0), NFTNL_RULESET_CACHE_RESYNC);
+
+	load(c);
+	check_rules(c, "1 2 ");
+	check_elems(c, "10 20 ");
+
+	/* nothing changes until the generation is complete */
+	event(c, rule_msg(NFT_MSG_NEWRULE, 3, 1), 0);
+	event(c, rule_msg(NFT_MSG_DELRULE, 2, 0), 0);
+	event(c, rule_msg(NFT_MSG_NEWRULE, 4, 0), 0);
+	event(c, elem_msg(NFT_MSG_NEWSETELEM, 30), 0);
+	event(c, elem_msg(NFT_MSG_NEWSETELEM, 20), 0);
+	event(c, elem_msg(NFT_MSG_DELSETELEM, 10), 0);
+	check_rules(c, "1 2 ");
+	event(c, gen_msg(6), 0);
+	check_rules(c, "4 1 3 ");
+	check_elems(c, "30 20 ");
+	if (nftnl_ruleset_cache_genid(c) != 6)
+		print_err("generation ID not updated");
+
+	/* already seen, dropped */
+	event(c, chain_msg(NFT_MSG_NEWCHAIN, "output"), 0);
+	event(c, gen_msg(6), 0);
+	if (has_chain(c, "output"))
+		print_err("stale event applied");
+
+	event(c, table_msg(NFT_MSG_DELTABLE), 0);
+	event(c, gen_msg(7), 0);
+	check_rules(c, "");
+	check_elems(c, NULL);
+	if (has_chain(c, "input"))
+		print_err("chain survived its table");
+
+	/* generation 8 is missing */
+	event(c, table_msg(NFT_MSG_NEWTABLE), 0);
+	event(c, gen_msg(9), NFTNL_RULESET_CACHE_RESYNC);
+	if (nftnl_ruleset_cache_synced(c))
+		print_err("gap not detected");
+	event(c, gen_msg(10), NFTNL_RULESET_CACHE_RESYNC);
+
+	load(c);
+	check_rules(c, "1 2 ");
+	event(c, chain_msg(NFT_MSG_DELCHAIN, "input"), 0);
+	event(c, gen_msg(6), 0);
+	check_rules(c, "");
+
+	nftnl_ruleset_cache_free(c);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
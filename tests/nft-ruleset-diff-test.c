@@ -0,0 +1,341 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+struct ruleset_desc {
+	const char	*chains[2];
+	uint32_t	rules[2][6];	/* cmp data of each rule, zero ends */
+	uint32_t	elems[5];	/* zero ends */
+	const char	*anon;		/* anonymous set of the last rule */
+	uint32_t	anon_elems[3];	/* zero ends */
+};
+
+static struct nftnl_ruleset *ruleset_build(const struct ruleset_desc *desc,
+					   bool handles)
+{
+	struct nftnl_table_list *tables = nftnl_table_list_alloc();
+	struct nftnl_chain_list *chains = nftnl_chain_list_alloc();
+	struct nftnl_set_list *sets = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rules = nftnl_rule_list_alloc();
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_set_elem *e;
+	struct nftnl_table *t;
+	struct nftnl_chain *c;
+	struct nftnl_expr *ex;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	uint64_t handle = 1;
+	int i, j;
+
+	if (!tables || !chains || !sets || !rules || !rs) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	if (desc->chains[0] != NULL) {
+		t = nftnl_table_alloc();
+		nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+		nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+		nftnl_table_list_add_tail(t, tables);
+
+		s = nftnl_set_alloc();
+		nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+		nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+		nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+		nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+		for (i = 0; desc->elems[i] != 0; i++) {
+			e = nftnl_set_elem_alloc();
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY,
+					       desc->elems[i]);
+			nftnl_set_elem_add(s, e);
+		}
+		nftnl_set_list_add_tail(s, sets);
+	}
+
+	if (desc->anon != NULL) {
+		s = nftnl_set_alloc();
+		nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+		nftnl_set_set_str(s, NFTNL_SET_NAME, desc->anon);
+		nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+		nftnl_set_set_u32(s, NFTNL_SET_FLAGS,
+				  NFT_SET_ANONYMOUS | NFT_SET_CONSTANT);
+		nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+		for (i = 0; desc->anon_elems[i] != 0; i++) {
+			e = nftnl_set_elem_alloc();
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY,
+					       desc->anon_elems[i]);
+			nftnl_set_elem_add(s, e);
+		}
+		nftnl_set_list_add_tail(s, sets);
+	}
+
+	for (i = 0; i < 2 && desc->chains[i] != NULL; i++) {
+		c = nftnl_chain_alloc();
+		nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+		nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, desc->chains[i]);
+		nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, NFPROTO_IPV4);
+		nftnl_chain_list_add_tail(c, chains);
+
+		for (j = 0; desc->rules[i][j] != 0; j++) {
+			r = nftnl_rule_alloc();
+			nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+			nftnl_rule_set_str(r, NFTNL_RULE_CHAIN,
+					   desc->chains[i]);
+			nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+			if (handles)
+				nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE,
+						   handle++);
+
+			ex = nftnl_expr_alloc("cmp");
+			nftnl_expr_set_u32(ex, NFTNL_EXPR_CMP_SREG,
+					   NFT_REG_1);
+			nftnl_expr_set_u32(ex, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+			nftnl_expr_set_u32(ex, NFTNL_EXPR_CMP_DATA,
+					   desc->rules[i][j]);
+			nftnl_rule_add_expr(r, ex);
+			nftnl_rule_list_add_tail(r, rules);
+		}
+
+		if (i > 0 || desc->anon == NULL)
+			continue;
+
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, desc->chains[i]);
+		nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+		if (handles)
+			nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle++);
+
+		ex = nftnl_expr_alloc("lookup");
+		nftnl_expr_set_u32(ex, NFTNL_EXPR_LOOKUP_SREG, NFT_REG_1);
+		nftnl_expr_set_str(ex, NFTNL_EXPR_LOOKUP_SET, desc->anon);
+		nftnl_rule_add_expr(r, ex);
+		nftnl_rule_list_add_tail(r, rules);
+	}
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tables);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, chains);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sets);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rules);
+
+	return rs;
+}
+
+static int rule_attr_cb(const struct nlattr *attr, void *data)
+{
+	const struct nlattr **tb = data;
+
+	if (mnl_attr_get_type(attr) <= NFTA_RULE_MAX)
+		tb[mnl_attr_get_type(attr)] = attr;
+
+	return MNL_CB_OK;
+}
+
+/* Put the message types in @types, positions of the new rules in @pos. */
+static int batch_types(struct nftnl_batch *batch, char *types,
+		       uint64_t *pos, int max)
+{
+	struct nlattr *tb[NFTA_RULE_MAX + 1];
+	struct nlmsghdr *nlh;
+	struct iovec *iov;
+	int i, iovlen, len, num = 0;
+
+	iovlen = nftnl_batch_iovec_len(batch);
+	iov = calloc(iovlen, sizeof(struct iovec));
+	if (iov == NULL)
+		return -1;
+
+	nftnl_batch_iovec(batch, iov, iovlen);
+
+	for (i = 0; i < iovlen; i++) {
+		nlh = iov[i].iov_base;
+		len = iov[i].iov_len;
+		while (mnl_nlmsg_ok(nlh, len) && num < max) {
+			types[num] = nlh->nlmsg_type & 0xff;
+			pos[num] = 0;
+
+			memset(tb, 0, sizeof(tb));
+			mnl_attr_parse(nlh, sizeof(struct nfgenmsg),
+				       rule_attr_cb, tb);
+			if (types[num] == NFT_MSG_NEWRULE &&
+			    tb[NFTA_RULE_POSITION])
+				pos[num] = be64toh(mnl_attr_get_u64(
+						tb[NFTA_RULE_POSITION]));
+			num++;
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+	}
+	free(iov);
+	return num;
+}
+
+static void test_diff(const char *name, const struct ruleset_desc *from,
+		      const struct ruleset_desc *to, const char *expected,
+		      int expected_num, const uint64_t *expected_pos)
+{
+	struct nftnl_ruleset *cur, *want;
+	struct nftnl_batch *batch;
+	uint64_t pos[32];
+	char types[32];
+	uint32_t seq = 1;
+	int ret, num, i;
+
+	cur = ruleset_build(from, true);
+	want = ruleset_build(to, false);
+	batch = nftnl_batch_alloc(getpagesize() * 32,
+				  UINT16_MAX + getpagesize());
+	if (batch == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	ret = nftnl_ruleset_diff(batch, cur, want, &seq);
+	num = batch_types(batch, types, pos, 32);
+	if (ret < 0 || num < 0) {
+		printf("%s: ", name);
+		print_err("diff failed");
+	} else if (ret != num || seq != (uint32_t)num + 1) {
+		printf("%s: ", name);
+		print_err("number of messages mismatches");
+	} else if (num != expected_num ||
+		   (num > 0 && memcmp(types, expected, num) != 0)) {
+		printf("%s: ", name);
+		print_err("unexpected messages");
+	} else {
+		for (i = 0; i < num; i++) {
+			if (expected_pos != NULL && pos[i] != expected_pos[i]) {
+				printf("%s: ", name);
+				print_err("unexpected rule position");
+				break;
+			}
+		}
+	}
+
+	nftnl_batch_free(batch);
+	nftnl_ruleset_free(cur);
+	nftnl_ruleset_free(want);
+}
+
+static const struct ruleset_desc empty;
+
+static const struct ruleset_desc base = {
+	.chains	= { "input" },
+	.rules	= { { 1, 2, 3 } },
+	.elems	= { 10, 20 },
+};
+
+static const struct ruleset_desc changed = {
+	.chains	= { "input", "output" },
+	.rules	= { { 1, 4, 3, 5 }, { 6 } },
+	.elems	= { 10, 30 },
+};
+
+/* one rule moved to the front, the others stay */
+static const struct ruleset_desc moved_from = {
+	.chains	= { "input" },
+	.rules	= { { 1, 2, 3, 4, 9 } },
+};
+
+static const struct ruleset_desc moved_to = {
+	.chains	= { "input" },
+	.rules	= { { 9, 1, 2, 3, 4 } },
+};
+
+/* the kernel names anonymous sets, the same set may come back renamed */
+static const struct ruleset_desc anon = {
+	.chains		= { "input" },
+	.rules		= { { 1 } },
+	.anon		= "__set0",
+	.anon_elems	= { 40, 50 },
+};
+
+static const struct ruleset_desc anon_renamed = {
+	.chains		= { "input" },
+	.rules		= { { 1 } },
+	.anon		= "__set3",
+	.anon_elems	= { 50, 40 },
+};
+
+static const struct ruleset_desc anon_changed = {
+	.chains		= { "input" },
+	.rules		= { { 1 } },
+	.anon		= "__set3",
+	.anon_elems	= { 40, 60 },
+};
+
+int main(int argc, char *argv[])
+{
+	const char create[] = {
+		NFT_MSG_NEWTABLE, NFT_MSG_NEWCHAIN, NFT_MSG_NEWSET,
+		NFT_MSG_NEWSETELEM, NFT_MSG_NEWRULE, NFT_MSG_NEWRULE,
+		NFT_MSG_NEWRULE
+	};
+	const char destroy[] = {
+		NFT_MSG_DELRULE, NFT_MSG_DELSET, NFT_MSG_DELCHAIN,
+		NFT_MSG_DELTABLE
+	};
+	const char update[] = {
+		NFT_MSG_NEWCHAIN, NFT_MSG_DELSETELEM, NFT_MSG_NEWSETELEM,
+		NFT_MSG_DELRULE, NFT_MSG_NEWRULE, NFT_MSG_NEWRULE,
+		NFT_MSG_NEWRULE
+	};
+	const char anon_update[] = {
+		NFT_MSG_DELRULE, NFT_MSG_NEWSET, NFT_MSG_NEWSETELEM,
+		NFT_MSG_NEWRULE
+	};
+	const char moved[] = {
+		NFT_MSG_DELRULE, NFT_MSG_NEWRULE
+	};
+	const uint64_t moved_pos[] = { 0, 1 };
+	/* rule 4 goes before the rule with handle 3, the others append */
+	const uint64_t update_pos[] = { 0, 0, 0, 0, 0, 3, 0 };
+
+	test_diff("same", &base, &base, NULL, 0, NULL);
+	test_diff("create", &empty, &base, create, sizeof(create), NULL);
+	test_diff("destroy", &base, &empty, destroy, sizeof(destroy), NULL);
+	test_diff("update", &base, &changed, update, sizeof(update),
+		  update_pos);
+	test_diff("moved", &moved_from, &moved_to, moved, sizeof(moved),
+		  moved_pos);
+	test_diff("anon renamed", &anon, &anon_renamed, NULL, 0, NULL);
+	test_diff("anon changed", &anon, &anon_changed, anon_update,
+		  sizeof(anon_update), NULL);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/sink.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+#include <libnftnl/ruleset.h>
+
+#define NRULES	20000
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+struct count {
+	uint32_t	tables;
+	uint32_t	sets;
+	uint32_t	rules;
+	uint64_t	last_handle;
+	bool		in_order;
+	uint32_t	set_id;
+	bool		ids_ok;
+};
+
+static void check_lookups(struct count *c, struct nftnl_rule *r)
+{
+	struct nftnl_expr_iter *it = nftnl_expr_iter_create(r);
+	struct nftnl_expr *e;
+
+	while ((e = nftnl_expr_iter_next(it)) != NULL) {
+		if (strcmp(nftnl_expr_get_str(e, NFTNL_EXPR_NAME), "lookup"))
+			continue;
+		if (!nftnl_expr_is_set(e, NFTNL_EXPR_LOOKUP_SET_ID) ||
+		    nftnl_expr_get_u32(e, NFTNL_EXPR_LOOKUP_SET_ID) != c->set_id)
+			c->ids_ok = false;
+	}
+	nftnl_expr_iter_destroy(it);
+}
+
+static int count_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct count *c = nftnl_ruleset_ctx_get(ctx, NFTNL_RULESET_CTX_DATA);
+	struct nftnl_rule *r;
+
+	switch (nftnl_ruleset_ctx_get_u32(ctx, NFTNL_RULESET_CTX_TYPE)) {
+	case NFTNL_RULESET_TABLE:
+		c->tables++;
+		break;
+	case NFTNL_RULESET_SET:
+		c->set_id = nftnl_set_get_u32(nftnl_ruleset_ctx_get(ctx,
+						NFTNL_RULESET_CTX_SET),
+					      NFTNL_SET_ID);
+		c->sets++;
+		break;
+	case NFTNL_RULESET_RULE:
+		r = nftnl_ruleset_ctx_get(ctx, NFTNL_RULESET_CTX_RULE);
+		check_lookups(c, r);
+		if (nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) != c->last_handle + 1)
+			c->in_order = false;
+		c->last_handle = nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE);
+		c->rules++;
+		break;
+	}
+	nftnl_ruleset_ctx_free(ctx);
+
+	return 0;
+}
+
+static struct nftnl_ruleset *build_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nftnl_set_elem *e;
+	struct nftnl_expr *ex;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	uint32_t i;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_list_add_tail(t, tl);
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < 100; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, i);
+		nftnl_set_elem_add(s, e);
+	}
+	nftnl_set_list_add_tail(s, sl);
+
+	for (i = 0; i < NRULES; i++) {
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+		nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, i + 1);
+		ex = nftnl_expr_alloc("lookup");
+		nftnl_expr_set_str(ex, NFTNL_EXPR_LOOKUP_SET, "hosts");
+		nftnl_expr_set_u32(ex, NFTNL_EXPR_LOOKUP_SREG, NFT_REG_1);
+		nftnl_rule_add_expr(r, ex);
+		ex = nftnl_expr_alloc("counter");
+		nftnl_expr_set_u64(ex, NFTNL_EXPR_CTR_PACKETS, i);
+		nftnl_rule_add_expr(r, ex);
+		nftnl_rule_list_add_tail(r, rl);
+	}
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	return rs;
+}
+
+static void test_file(unsigned int nthreads)
+{
+	struct nftnl_ruleset *rs = build_ruleset();
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct count c = { .in_order = true, .ids_ok = true };
+	struct nftnl_sink *sink;
+	FILE *fp;
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		exit(EXIT_FAILURE);
+	}
+	sink = nftnl_sink_alloc_file(fp);
+	nftnl_ruleset_output(sink, rs, NFTNL_OUTPUT_JSON, NFTNL_OF_EVENT_NEW);
+	nftnl_sink_free(sink);
+	rewind(fp);
+
+	if (nftnl_ruleset_parse_file_cb_parallel(NFTNL_PARSE_JSON, fp, err, &c,
+						 count_cb, nthreads) < 0)
+		print_err("cannot parse ruleset");
+	else if (c.tables != 1 || c.sets != 1 || c.rules != NRULES ||
+		 !c.in_order)
+		print_err("callback did not get all objects in order");
+	else if (!c.ids_ok)
+		print_err("lookups do not refer to the set id");
+
+	fclose(fp);
+	nftnl_parse_err_free(err);
+	nftnl_ruleset_free(rs);
+}
+
+static void test_buffer(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct count c = { .in_order = true };
+
+	/* whitespace and members that are not ours are fine */
+	if (nftnl_ruleset_parse_buffer_cb(NFTNL_PARSE_JSON,
+			"{ \"version\": [1, {\"x\": \"]}\"}],\n"
+			"  \"nftables\": [ { \"add\": [\n"
+			"    {\"table\": {\"name\": \"filter\", \"family\": \"ip\","
+			" \"flags\": 0, \"use\": 0}} ],\n"
+			"    \"comment\": null } ] }\n",
+			err, &c, count_cb) < 0 || c.tables != 1)
+		print_err("cannot parse formatted ruleset");
+
+	if (nftnl_ruleset_parse(rs, NFTNL_PARSE_JSON,
+			"{\"nftables\":[{\"add\":[\n"
+			"  {\"table\":{\"name\":\"filter\",,}}]}]}", err) == 0)
+		print_err("bad input accepted");
+
+	if (nftnl_ruleset_parse(rs, NFTNL_PARSE_JSON,
+			"{\"nftables\":[{\"add\":[]}]} trailing", err) == 0)
+		print_err("trailing garbage accepted");
+
+	nftnl_ruleset_free(rs);
+	nftnl_parse_err_free(err);
+}
+
+static void put(struct nftnl_sink *sink, const char *str)
+{
+	nftnl_sink_write(sink, str, strlen(str));
+}
+
+/* objects after a broken one must not reach the callback */
+static void test_parallel_error(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct count c = { .in_order = true };
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	uint32_t i;
+
+	put(sink, "{\"nftables\":[{\"add\":[");
+	for (i = 0; i < 5000; i++) {
+		if (i == 3000)
+			put(sink, "{\"bogus\":{}},");
+		put(sink, "{\"table\":{\"name\":\"filter\","
+			  "\"family\":\"ip\",\"flags\":0}},");
+	}
+	put(sink, "{\"table\":{\"name\":\"filter\","
+		  "\"family\":\"ip\",\"flags\":0}}]}]}");
+
+	if (nftnl_ruleset_parse_buffer_cb_parallel(NFTNL_PARSE_JSON,
+			nftnl_sink_buf(sink, NULL), err, &c, count_cb, 4) == 0)
+		print_err("broken object accepted");
+	else if (c.tables != 3000)
+		print_err("callback got objects after the broken one");
+
+	nftnl_sink_free(sink);
+	nftnl_parse_err_free(err);
+}
+
+/* a truncated document stops both paths behind the same objects */
+static void test_parallel_syntax_error(void)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct count serial = { .in_order = true };
+	struct count parallel = { .in_order = true };
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	uint32_t i;
+
+	put(sink, "{\"nftables\":[{\"add\":[");
+	for (i = 0; i < 3000; i++)
+		put(sink, "{\"table\":{\"name\":\"filter\","
+			  "\"family\":\"ip\",\"flags\":0}},");
+	put(sink, "{\"table\":{\"name\":\"fil");
+
+	if (nftnl_ruleset_parse_buffer_cb(NFTNL_PARSE_JSON,
+			nftnl_sink_buf(sink, NULL), err, &serial,
+			count_cb) == 0 ||
+	    nftnl_ruleset_parse_buffer_cb_parallel(NFTNL_PARSE_JSON,
+			nftnl_sink_buf(sink, NULL), err, &parallel, count_cb,
+			4) == 0)
+		print_err("syntax error accepted");
+	else if (serial.tables != 3000 || parallel.tables != serial.tables)
+		print_err("parallel path did not deliver the objects in front");
+
+	nftnl_sink_free(sink);
+	nftnl_parse_err_free(err);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	int ret;
+
+	/* nothing to test without JSON support */
+	ret = nftnl_ruleset_parse(rs, NFTNL_PARSE_JSON, "{}", err);
+	nftnl_ruleset_free(rs);
+	nftnl_parse_err_free(err);
+	if (ret < 0 && errno == EOPNOTSUPP) {
+		printf("%s: \033[32mOK\e[0m\n", argv[0]);
+		return EXIT_SUCCESS;
+	}
+
+	test_file(1);
+	test_file(4);
+	test_buffer();
+	test_parallel_error();
+	test_parallel_syntax_error();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
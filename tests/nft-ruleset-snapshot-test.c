@@ -0,0 +1,249 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/sink.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+#include <libnftnl/ruleset.h>
+
+#define NRULES	100
+#define NELEMS	5000
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_ruleset *build_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_chain_list *cl = nftnl_chain_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nftnl_chain *c;
+	struct nftnl_set_elem *e;
+	struct nftnl_expr *ex;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	uint32_t i;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_list_add_tail(t, tl);
+
+	for (i = 0; i < 2; i++) {
+		c = nftnl_chain_alloc();
+		nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+		nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, i ? "output" : "input");
+		nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, NFPROTO_IPV4);
+		nftnl_chain_set_u64(c, NFTNL_CHAIN_HANDLE, i + 1);
+		nftnl_chain_list_add_tail(c, cl);
+	}
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < NELEMS; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, i);
+		nftnl_set_elem_add(s, e);
+	}
+	nftnl_set_list_add_tail(s, sl);
+
+	for (i = 0; i < NRULES; i++) {
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, i % 2 ? "output" : "input");
+		nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, i + 10);
+		ex = nftnl_expr_alloc("counter");
+		nftnl_expr_set_u64(ex, NFTNL_EXPR_CTR_PACKETS, i);
+		nftnl_rule_add_expr(r, ex);
+		nftnl_rule_list_add_tail(r, rl);
+	}
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, cl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	return rs;
+}
+
+static void test_lookup(struct nftnl_ruleset_snapshot *snap)
+{
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	int idx;
+
+	if (nftnl_ruleset_snapshot_count(snap) != 1 + 2 + 1 + NRULES)
+		print_err("wrong number of objects");
+
+	idx = nftnl_ruleset_snapshot_find(snap, NFTNL_RULESET_SET,
+					  NFPROTO_IPV4, "filter", "hosts");
+	if (idx != 3 ||
+	    nftnl_ruleset_snapshot_type(snap, idx) != NFTNL_RULESET_SET) {
+		print_err("set not found");
+		return;
+	}
+	s = nftnl_ruleset_snapshot_get(snap, idx);
+	if (s == NULL ||
+	    strcmp(nftnl_set_get_str(s, NFTNL_SET_NAME), "hosts") != 0)
+		print_err("set not decoded");
+	if (s != NULL)
+		nftnl_set_free(s);
+
+	idx = nftnl_ruleset_snapshot_find(snap, NFTNL_RULESET_RULE,
+					  NFPROTO_IPV4, "filter", "output");
+	r = idx < 0 ? NULL : nftnl_ruleset_snapshot_get(snap, idx);
+	if (r == NULL || nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) != 11)
+		print_err("first rule of the output chain not found");
+	if (r != NULL)
+		nftnl_rule_free(r);
+
+	if (nftnl_ruleset_snapshot_find(snap, NFTNL_RULESET_CHAIN,
+					NFPROTO_IPV6, "filter", NULL) >= 0)
+		print_err("found a chain of the wrong family");
+}
+
+static void test_load(struct nftnl_ruleset_snapshot *snap,
+		      struct nftnl_ruleset *rs)
+{
+	struct nftnl_sink *a = nftnl_sink_alloc(), *b = nftnl_sink_alloc();
+	struct nftnl_ruleset *loaded;
+	const char *abuf, *bbuf;
+	size_t alen, blen;
+
+	loaded = nftnl_ruleset_snapshot_load(snap);
+	if (loaded == NULL) {
+		print_err("cannot load snapshot");
+		goto out;
+	}
+
+	nftnl_ruleset_output(a, rs, NFTNL_OUTPUT_JSON, 0);
+	nftnl_ruleset_output(b, loaded, NFTNL_OUTPUT_JSON, 0);
+	abuf = nftnl_sink_buf(a, &alen);
+	bbuf = nftnl_sink_buf(b, &blen);
+	if (alen != blen || memcmp(abuf, bbuf, alen) != 0)
+		print_err("loaded ruleset differs");
+
+	nftnl_ruleset_free(loaded);
+out:
+	nftnl_sink_free(a);
+	nftnl_sink_free(b);
+}
+
+static void test_batch(struct nftnl_ruleset_snapshot *snap)
+{
+	struct nftnl_batch *batch;
+	struct nlmsghdr *nlh;
+	uint32_t seq = 1;
+	int msgs, n = 0, elems = 0, i, len;
+	struct iovec *v;
+
+	batch = nftnl_batch_alloc(4 * 65536, 2 * 65536);
+	msgs = nftnl_ruleset_snapshot_batch(snap, batch, &seq);
+	if (msgs < (int)nftnl_ruleset_snapshot_count(snap) + 1 ||
+	    seq != (uint32_t)msgs + 1)
+		print_err("wrong number of batch messages");
+
+	v = calloc(nftnl_batch_iovec_len(batch), sizeof(struct iovec));
+	nftnl_batch_iovec(batch, v, nftnl_batch_iovec_len(batch));
+	for (i = 0; i < nftnl_batch_iovec_len(batch); i++) {
+		len = v[i].iov_len;
+		for (nlh = v[i].iov_base; mnl_nlmsg_ok(nlh, len);
+		     nlh = mnl_nlmsg_next(nlh, &len)) {
+			struct nftnl_set *s;
+
+			n++;
+			if ((nlh->nlmsg_type & 0xff) != NFT_MSG_NEWSETELEM)
+				continue;
+
+			s = nftnl_set_alloc();
+			if (nftnl_set_elems_nlmsg_parse(nlh, s) < 0 ||
+			    !nftnl_set_is_set(s, NFTNL_SET_ID))
+				print_err("element message without set id");
+			nftnl_set_free(s);
+			elems++;
+		}
+	}
+	if (n != msgs || elems == 0)
+		print_err("batch does not hold the messages");
+
+	free(v);
+	nftnl_batch_free(batch);
+
+	/* without overrun, messages do not fit at the end of a page */
+	batch = nftnl_batch_alloc(64, 0);
+	errno = 0;
+	if (nftnl_ruleset_snapshot_batch(snap, batch, &seq) >= 0 ||
+	    errno != EMSGSIZE)
+		print_err("batch without overrun accepted");
+	nftnl_batch_free(batch);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_ruleset_snapshot *snap;
+	struct nftnl_ruleset *rs = build_ruleset();
+	char filename[] = "/tmp/nft-snapshot-XXXXXX";
+	FILE *fp;
+	int fd;
+
+	fd = mkstemp(filename);
+	if (fd < 0) {
+		print_err("cannot create temporary file");
+		exit(EXIT_FAILURE);
+	}
+	fp = fdopen(fd, "w");
+	if (nftnl_ruleset_snapshot_save(rs, fp) < 0)
+		print_err("cannot save snapshot");
+	fclose(fp);
+
+	snap = nftnl_ruleset_snapshot_open(filename);
+	unlink(filename);
+	if (snap == NULL) {
+		print_err("cannot open snapshot");
+		exit(EXIT_FAILURE);
+	}
+
+	test_lookup(snap);
+	test_load(snap, rs);
+	test_batch(snap);
+
+	nftnl_ruleset_snapshot_close(snap);
+	nftnl_ruleset_free(rs);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
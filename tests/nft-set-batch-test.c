@@ -0,0 +1,283 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+
+#define NUM_ELEMS	60000
+
+static int test_ok = 1;
+
+/* the elements only point to their user data */
+static char udata[NUM_ELEMS / 5][16];
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_set *set_build(void)
+{
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s;
+	uint32_t i, key[4];
+
+	s = nftnl_set_alloc();
+	if (s == NULL)
+		return NULL;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV6);
+
+	for (i = 0; i < NUM_ELEMS; i++) {
+		e = nftnl_set_elem_alloc();
+		if (e == NULL)
+			return NULL;
+
+		memset(key, 0, sizeof(key));
+		key[i % 4] = i;
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key, sizeof(key));
+
+		switch (i % 5) {
+		case 0:
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_DATA, i);
+			break;
+		case 1:
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+					       NFT_JUMP);
+			nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN,
+					       i % 2 ? "chain" : "other-chain");
+			break;
+		case 2:
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS,
+					       NFT_SET_ELEM_INTERVAL_END);
+			nftnl_set_elem_set_u64(e, NFTNL_SET_ELEM_TIMEOUT, i);
+			break;
+		case 3:
+			snprintf(udata[i / 5], sizeof(udata[0]), "element %u", i);
+			nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA,
+					   udata[i / 5], strlen(udata[i / 5]));
+			break;
+		}
+		nftnl_set_elem_add(s, e);
+	}
+	return s;
+}
+
+static char *batch_flatten(struct nftnl_batch *batch, size_t *len)
+{
+	struct iovec *iov;
+	int i, iovlen;
+	char *buf;
+
+	iovlen = nftnl_batch_iovec_len(batch);
+	iov = calloc(iovlen, sizeof(struct iovec));
+	if (iov == NULL)
+		return NULL;
+
+	nftnl_batch_iovec(batch, iov, iovlen);
+
+	*len = 0;
+	for (i = 0; i < iovlen; i++)
+		*len += iov[i].iov_len;
+
+	buf = malloc(*len);
+	if (buf != NULL) {
+		*len = 0;
+		for (i = 0; i < iovlen; i++) {
+			memcpy(buf + *len, iov[i].iov_base, iov[i].iov_len);
+			*len += iov[i].iov_len;
+		}
+	}
+	free(iov);
+	return buf;
+}
+
+static struct nftnl_set *set_build_file(const char *filename)
+{
+	struct nftnl_set_elems_file_hdr hdr = {
+		.magic		= htonl(NFTNL_SET_ELEMS_FILE_MAGIC),
+		.version	= htonl(NFTNL_SET_ELEMS_FILE_VERSION),
+		.key_len	= htonl(sizeof(uint32_t)),
+		.data_len	= htonl(sizeof(uint32_t)),
+	};
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s;
+	uint32_t i, rec[2];
+	FILE *fp;
+
+	s = nftnl_set_alloc();
+	fp = fopen(filename, "w");
+	if (s == NULL || fp == NULL)
+		return NULL;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	nftnl_set_set_u32(s, NFTNL_SET_DATA_LEN, sizeof(uint32_t));
+
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	for (i = 0; i < NUM_ELEMS; i++) {
+		rec[0] = htonl(0x0a000000 + i);
+		rec[1] = i;
+		fwrite(rec, sizeof(rec), 1, fp);
+
+		e = nftnl_set_elem_alloc_compact(s);
+		if (e == NULL)
+			return NULL;
+
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &rec[0],
+				   sizeof(rec[0]));
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &rec[1],
+				   sizeof(rec[1]));
+		nftnl_set_elem_add(s, e);
+	}
+	fclose(fp);
+
+	return s;
+}
+
+static int batch_build_file(struct nftnl_batch *batch, struct nftnl_set *s,
+			    const char *filename, uint32_t *seq)
+{
+	struct nftnl_set_elems_file *f;
+	struct nlmsghdr *nlh;
+	int more, msgs = 0;
+
+	f = nftnl_set_elems_file_open(filename);
+	if (f == NULL)
+		return -1;
+
+	do {
+		nlh = nftnl_set_elem_nlmsg_build_hdr(nftnl_batch_buffer(batch),
+						     NFT_MSG_NEWSETELEM,
+						     NFPROTO_IPV4,
+						     NLM_F_CREATE, (*seq)++);
+		more = nftnl_set_elems_file_nlmsg_build_payload(nlh, s, f);
+		if (more < 0 || nftnl_batch_update(batch) < 0) {
+			msgs = -1;
+			break;
+		}
+		msgs++;
+	} while (more);
+
+	nftnl_set_elems_file_close(f);
+	return msgs;
+}
+
+static void test_file(void)
+{
+	char filename[] = "/tmp/nft-set-batch-test.XXXXXX";
+	uint32_t seq_a = 1, seq_b = 1;
+	struct nftnl_batch *a, *b;
+	struct nftnl_set *s;
+	char *buf_a, *buf_b;
+	size_t len_a, len_b;
+	int fd, ret_a, ret_b;
+
+	fd = mkstemp(filename);
+	if (fd < 0) {
+		print_err("cannot create temporary file");
+		return;
+	}
+	close(fd);
+
+	s = set_build_file(filename);
+	a = nftnl_batch_alloc(getpagesize() * 32, UINT16_MAX + getpagesize());
+	b = nftnl_batch_alloc(getpagesize() * 32, UINT16_MAX + getpagesize());
+	if (s == NULL || a == NULL || b == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	ret_a = nftnl_set_elems_batch_build(a, s, NFT_MSG_NEWSETELEM,
+					    NLM_F_CREATE, &seq_a, 1);
+	ret_b = batch_build_file(b, s, filename, &seq_b);
+	if (ret_a < 0 || ret_b < 0)
+		print_err("file batch build failed");
+	if (ret_a != ret_b || seq_a != seq_b)
+		print_err("number of file messages mismatches");
+
+	buf_a = batch_flatten(a, &len_a);
+	buf_b = batch_flatten(b, &len_b);
+	if (buf_a == NULL || buf_b == NULL)
+		print_err("OOM");
+	else if (len_a != len_b || memcmp(buf_a, buf_b, len_a) != 0)
+		print_err("file build differs from element build");
+
+	unlink(filename);
+	free(buf_a);
+	free(buf_b);
+	nftnl_batch_free(a);
+	nftnl_batch_free(b);
+	nftnl_set_free(s);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t seq_a = 1, seq_b = 1;
+	struct nftnl_batch *a, *b;
+	struct nftnl_set *s;
+	char *buf_a, *buf_b;
+	size_t len_a, len_b;
+	int ret_a, ret_b;
+
+	s = set_build();
+	a = nftnl_batch_alloc(getpagesize() * 32, UINT16_MAX + getpagesize());
+	b = nftnl_batch_alloc(getpagesize() * 32, UINT16_MAX + getpagesize());
+	if (s == NULL || a == NULL || b == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	ret_a = nftnl_set_elems_batch_build(a, s, NFT_MSG_NEWSETELEM,
+					    NLM_F_CREATE, &seq_a, 1);
+	ret_b = nftnl_set_elems_batch_build(b, s, NFT_MSG_NEWSETELEM,
+					    NLM_F_CREATE, &seq_b, 4);
+	if (ret_a < 0 || ret_b < 0)
+		print_err("batch build failed");
+	if (ret_a != ret_b || seq_a != seq_b)
+		print_err("number of messages mismatches");
+	if (ret_a < 2)
+		print_err("element list was not split");
+
+	buf_a = batch_flatten(a, &len_a);
+	buf_b = batch_flatten(b, &len_b);
+	if (buf_a == NULL || buf_b == NULL)
+		print_err("OOM");
+	else if (len_a != len_b || memcmp(buf_a, buf_b, len_a) != 0)
+		print_err("parallel build differs from serial build");
+
+	free(buf_a);
+	free(buf_b);
+	nftnl_batch_free(a);
+	nftnl_batch_free(b);
+	nftnl_set_free(s);
+
+	test_file();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
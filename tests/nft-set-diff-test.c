@@ -0,0 +1,181 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libmnl/libmnl.h>
+#include <libnftnl/set.h>
+#include <libnftnl/batch.h>
+
+#define NUM_ELEMS	20000
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_set *set_alloc(void)
+{
+	struct nftnl_set *s;
+
+	s = nftnl_set_alloc();
+	if (s == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+
+	return s;
+}
+
+static void set_add(struct nftnl_set *s, uint32_t key, uint32_t data)
+{
+	struct nftnl_set_elem *e;
+
+	e = nftnl_set_elem_alloc();
+	if (e == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &data, sizeof(data));
+	nftnl_set_elem_add(s, e);
+}
+
+static int count_cb(struct nftnl_set_elem *e, void *data)
+{
+	(*(uint32_t *)data)++;
+	return 0;
+}
+
+static uint32_t set_count(struct nftnl_set *s)
+{
+	uint32_t num = 0;
+
+	nftnl_set_elem_foreach(s, count_cb, &num);
+	return num;
+}
+
+/* The builder numbers the element nests, count them by hand. */
+static uint32_t nlmsg_count(const struct nlmsghdr *nlh)
+{
+	struct nlattr *attr, *nest;
+	uint32_t num = 0;
+
+	mnl_attr_for_each(attr, nlh, sizeof(struct nfgenmsg)) {
+		if (mnl_attr_get_type(attr) != NFTA_SET_ELEM_LIST_ELEMENTS)
+			continue;
+
+		mnl_attr_for_each_nested(nest, attr)
+			num++;
+	}
+	return num;
+}
+
+static void count_batch(struct nftnl_batch *batch, uint32_t *num_del,
+			uint32_t *num_add)
+{
+	struct iovec iov[64];
+	struct nlmsghdr *nlh;
+	int i, len, iovlen;
+
+	iovlen = nftnl_batch_iovec_len(batch);
+	if (iovlen > 64) {
+		print_err("too many batch pages");
+		return;
+	}
+	nftnl_batch_iovec(batch, iov, iovlen);
+
+	for (i = 0; i < iovlen; i++) {
+		nlh = iov[i].iov_base;
+		len = iov[i].iov_len;
+		while (mnl_nlmsg_ok(nlh, len)) {
+			if ((nlh->nlmsg_type & 0xff) == NFT_MSG_DELSETELEM)
+				*num_del += nlmsg_count(nlh);
+			else if ((nlh->nlmsg_type & 0xff) == NFT_MSG_NEWSETELEM)
+				*num_add += nlmsg_count(nlh);
+			else
+				print_err("unexpected message type");
+
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_set *cur, *want, *add, *del;
+	uint32_t i, seq = 0, num_del = 0, num_add = 0;
+	struct nftnl_batch *batch;
+	int ret;
+
+	cur = set_alloc();
+	want = set_alloc();
+	add = set_alloc();
+	del = set_alloc();
+
+	/* 0-9 are removed, 10-19 change their mapping, the rest stays */
+	for (i = 0; i < 100; i++)
+		set_add(cur, i, i);
+	for (i = 10; i < 100; i++)
+		set_add(want, i, i < 20 ? i + 1 : i);
+	/* and a large batch of new elements */
+	for (i = 100; i < 100 + NUM_ELEMS; i++)
+		set_add(want, i, i);
+
+	if (nftnl_set_elems_diff(cur, want, add, del) < 0)
+		print_err("diff failed");
+	if (set_count(del) != 20)
+		print_err("wrong number of elements to delete");
+	if (set_count(add) != 10 + NUM_ELEMS)
+		print_err("wrong number of elements to add");
+
+	batch = nftnl_batch_alloc(getpagesize() * 32,
+				  UINT16_MAX + getpagesize());
+	if (batch == NULL)
+		print_err("OOM");
+
+	ret = nftnl_set_elems_batch_diff(batch, cur, want, &seq);
+	if (ret < 0)
+		print_err("batch diff failed");
+	if (ret != (int)seq)
+		print_err("message count and sequence number mismatch");
+	if (ret < 2 + NUM_ELEMS / 4096)
+		print_err("large element list was not split");
+
+	count_batch(batch, &num_del, &num_add);
+	if (num_del != 20)
+		print_err("wrong number of elements deleted in batch");
+	if (num_add != 10 + NUM_ELEMS)
+		print_err("wrong number of elements added in batch");
+
+	nftnl_batch_free(batch);
+	nftnl_set_free(cur);
+	nftnl_set_free(want);
+	nftnl_set_free(add);
+	nftnl_set_free(del);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
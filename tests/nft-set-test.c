@@ -49,6 +49,131 @@ static void cmp_nftnl_set(struct nftnl_set *a, struct nftnl_set *b)
 		print_err("Set data-len mismatches");
 }
 
+static int get_elem_cb(struct nftnl_set_elem *e, void *data)
+{
+	*(struct nftnl_set_elem **)data = e;
+	return 0;
+}
+
+static void test_elem_compact(void)
+{
+	uint32_t key = 0x01020304, data = 0x0a0b0c0d, len, longkey[4] = {};
+	struct nftnl_set_elem *e;
+	struct nftnl_set *a, *b;
+	const uint32_t *val;
+	char buf[4096];
+	struct nlmsghdr *nlh;
+
+	a = nftnl_set_alloc();
+	b = nftnl_set_alloc();
+	if (a == NULL || b == NULL)
+		print_err("OOM");
+
+	nftnl_set_set_str(a, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(a, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(a, NFTNL_SET_KEY_LEN, sizeof(key));
+	nftnl_set_set_u32(a, NFTNL_SET_DATA_LEN, sizeof(data));
+
+	e = nftnl_set_elem_alloc_compact(a);
+	if (e == NULL)
+		print_err("OOM");
+
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, longkey, sizeof(longkey));
+	if (nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_KEY))
+		print_err("Set elem key larger than set key-len accepted");
+
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &data, sizeof(data));
+	nftnl_set_elem_add(a, e);
+
+	nlh = nftnl_set_elem_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, AF_INET,
+					     0, 1234);
+	nftnl_set_elems_nlmsg_build_payload(nlh, a);
+
+	if (nftnl_set_elems_nlmsg_parse(nlh, b) < 0)
+		print_err("parsing problems");
+
+	e = NULL;
+	nftnl_set_elem_foreach(b, get_elem_cb, &e);
+	if (e == NULL) {
+		print_err("Set elem missing");
+	} else {
+		val = nftnl_set_elem_get(e, NFTNL_SET_ELEM_KEY, &len);
+		if (len != sizeof(key) || *val != key)
+			print_err("Set elem key mismatches");
+		val = nftnl_set_elem_get(e, NFTNL_SET_ELEM_DATA, &len);
+		if (len != sizeof(data) || *val != data)
+			print_err("Set elem data mismatches");
+	}
+	nftnl_set_free(b);
+
+	/* keys only */
+	b = nftnl_set_alloc();
+	if (b == NULL)
+		print_err("OOM");
+	if (nftnl_set_elems_nlmsg_parse_mask(nlh, b,
+					     1 << NFTNL_SET_ELEM_KEY) < 0)
+		print_err("parsing problems");
+
+	e = NULL;
+	nftnl_set_elem_foreach(b, get_elem_cb, &e);
+	if (e == NULL || !nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_KEY) ||
+	    nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_DATA))
+		print_err("Set elem mask not applied");
+
+	nftnl_set_free(a); nftnl_set_free(b);
+}
+
+static void test_list_lookup(void)
+{
+	static const char *tables[] = { "filter", "nat" };
+	struct nftnl_set_list *list;
+	struct nftnl_set *s;
+	char name[32];
+	int i, j;
+
+	list = nftnl_set_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 1000; j++) {
+			s = nftnl_set_alloc();
+			if (s == NULL) {
+				print_err("OOM");
+				goto out;
+			}
+			snprintf(name, sizeof(name), "set%d", j);
+			nftnl_set_set_str(s, NFTNL_SET_TABLE, tables[i]);
+			nftnl_set_set_str(s, NFTNL_SET_NAME, name);
+			nftnl_set_set_u32(s, NFTNL_SET_FAMILY, AF_INET);
+			nftnl_set_set_u32(s, NFTNL_SET_ID, i * 1000 + j);
+			nftnl_set_list_add_tail(s, list);
+		}
+	}
+
+	s = nftnl_set_list_lookup_byname(list, AF_INET, "nat", "set123");
+	if (s == NULL || nftnl_set_get_u32(s, NFTNL_SET_ID) != 1123)
+		print_err("Set lookup by name failed");
+	if (nftnl_set_list_lookup_byname(list, AF_INET6, "nat", "set123"))
+		print_err("Set lookup by name ignores the family");
+	if (nftnl_set_list_lookup_byname(list, AF_INET, "raw", "set123"))
+		print_err("Set lookup by name ignores the table");
+
+	nftnl_set_list_del(s);
+	nftnl_set_free(s);
+	if (nftnl_set_list_lookup_byname(list, AF_INET, "nat", "set123"))
+		print_err("Deleted set is still indexed");
+
+	s = nftnl_set_list_lookup_byname(list, AF_INET, "filter", "set123");
+	if (s == NULL || nftnl_set_get_u32(s, NFTNL_SET_ID) != 123)
+		print_err("Set lookup by name failed after delete");
+out:
+	nftnl_set_list_free(list);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_set *a, *b = NULL;
@@ -80,6 +205,9 @@ int main(int argc, char *argv[])
 
 	nftnl_set_free(a); nftnl_set_free(b);
 
+	test_elem_compact();
+	test_list_lookup();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -0,0 +1,327 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <libnftnl/sink.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/set.h>
+#include <libnftnl/ruleset.h>
+
+#define NELEMS	2000
+
+static int test_ok = 1;
+static char buf[1 << 20];
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_set *build_set(uint32_t nelems)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e;
+	uint32_t i;
+
+	if (s == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < nelems; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_KEY, i);
+		nftnl_set_elem_add(s, e);
+	}
+
+	return s;
+}
+
+static int count_cb(const char *data, size_t len, void *priv)
+{
+	size_t *total = priv;
+
+	if (memcmp(buf + *total, data, len) != 0)
+		return -1;
+
+	*total += len;
+	return 0;
+}
+
+static void test_set(uint32_t type)
+{
+	struct nftnl_set *s = build_set(NELEMS);
+	struct nftnl_sink *sink;
+	const char *out;
+	size_t len, total = 0;
+	int ret;
+
+	ret = nftnl_set_snprintf(buf, sizeof(buf), s, type, 0);
+	if (ret <= 4096 || ret >= (int)sizeof(buf))
+		print_err("unexpected set output length");
+
+	sink = nftnl_sink_alloc();
+	if (nftnl_set_output(sink, s, type, 0) != ret)
+		print_err("set output returned the wrong length");
+	out = nftnl_sink_buf(sink, &len);
+	if (len != (size_t)ret || strcmp(out, buf) != 0)
+		print_err("set output differs from snprintf");
+	nftnl_sink_free(sink);
+
+	sink = nftnl_sink_alloc_cb(count_cb, &total);
+	if (nftnl_set_output(sink, s, type, 0) != ret ||
+	    nftnl_sink_flush(sink) < 0 || total != (size_t)ret)
+		print_err("callback sink did not get the whole set");
+	nftnl_sink_free(sink);
+
+	nftnl_set_free(s);
+}
+
+static void test_set_empty(void)
+{
+	struct nftnl_set *s = build_set(0);
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	const char *out;
+	size_t len;
+	int ret;
+
+	ret = nftnl_set_snprintf(buf, sizeof(buf), s, NFTNL_OUTPUT_DEFAULT, 0);
+	if (nftnl_set_output_parallel(sink, s, NFTNL_OUTPUT_DEFAULT, 0,
+				      4) != ret)
+		print_err("empty set output returned the wrong length");
+	out = nftnl_sink_buf(sink, &len);
+	if (len != (size_t)ret || strcmp(out, buf) != 0)
+		print_err("empty set output differs from snprintf");
+
+	nftnl_sink_free(sink);
+	nftnl_set_free(s);
+}
+
+static void test_set_json(void)
+{
+	struct nftnl_set *s = build_set(2);
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+
+	nftnl_set_output(sink, s, NFTNL_OUTPUT_JSON, 0);
+	if (strcmp(nftnl_sink_buf(sink, NULL),
+		   "{\"set\":{\"name\":\"hosts\",\"table\":\"filter\","
+		   "\"family\":\"ip\",\"key_len\":4,\"set_elem\":["
+		   "{\"key\":{\"reg\":{\"type\":\"value\",\"len\":4,"
+		   "\"data0\":\"0x00000000\"}}},"
+		   "{\"key\":{\"reg\":{\"type\":\"value\",\"len\":4,"
+		   "\"data0\":\"0x00000001\"}}}]}}") != 0)
+		print_err("unexpected json set output");
+
+	nftnl_sink_reset(sink);
+	nftnl_set_free(s);
+	s = build_set(0);
+	nftnl_set_output(sink, s, NFTNL_OUTPUT_JSON, 0);
+	if (strcmp(nftnl_sink_buf(sink, NULL),
+		   "{\"set\":{\"name\":\"hosts\",\"table\":\"filter\","
+		   "\"family\":\"ip\",\"key_len\":4}}") != 0)
+		print_err("unexpected json output of an empty set");
+
+	nftnl_sink_free(sink);
+	nftnl_set_free(s);
+}
+
+static void test_set_words(void)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e = nftnl_set_elem_alloc();
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	uint32_t key[2] = { 0xdeadbeef, 7 };
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "hosts");
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key, sizeof(key));
+	nftnl_set_elem_add(s, e);
+
+	nftnl_set_output(sink, s, NFTNL_OUTPUT_DEFAULT, 0);
+	if (strcmp(nftnl_sink_buf(sink, NULL), "hosts filter 0\n"
+		   "\telement deadbeef 00000007  : 0 [end]") != 0)
+		print_err("unexpected default set output");
+
+	nftnl_sink_reset(sink);
+	nftnl_set_output(sink, s, NFTNL_OUTPUT_XML, 0);
+	if (strcmp(nftnl_sink_buf(sink, NULL),
+		   "<set><table>filter</table><name>hosts</name><set_elem>"
+		   "<key><reg type=\"value\"><len>8</len>"
+		   "<data0>0xdeadbeef</data0><data1>0x00000007</data1>"
+		   "</reg></key></set_elem></set>") != 0)
+		print_err("unexpected xml set output");
+
+	nftnl_sink_free(sink);
+	nftnl_set_free(s);
+}
+
+static void test_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_table *t = nftnl_table_alloc();
+	struct nftnl_sink *sink;
+	char *file;
+	size_t len;
+	FILE *fp;
+	int ret;
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_list_add_tail(t, tl);
+	nftnl_set_list_add_tail(build_set(NELEMS), sl);
+	nftnl_set_list_add_tail(build_set(3), sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+
+	ret = nftnl_ruleset_snprintf(buf, sizeof(buf), rs, NFTNL_OUTPUT_JSON,
+				     0);
+
+	/* fprintf streams through a sink as well */
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		exit(EXIT_FAILURE);
+	}
+	if (nftnl_ruleset_fprintf(fp, rs, NFTNL_OUTPUT_JSON, 0) != ret)
+		print_err("ruleset fprintf returned the wrong length");
+
+	file = calloc(1, ret + 1);
+	rewind(fp);
+	len = fread(file, 1, ret + 1, fp);
+	if (len != (size_t)ret || strcmp(file, buf) != 0)
+		print_err("ruleset fprintf differs from snprintf");
+	fclose(fp);
+
+	/* so does an fd sink */
+	fp = tmpfile();
+	sink = nftnl_sink_alloc_fd(fileno(fp));
+	if (nftnl_ruleset_output(sink, rs, NFTNL_OUTPUT_JSON, 0) != ret ||
+	    nftnl_sink_flush(sink) < 0)
+		print_err("fd sink failed");
+	nftnl_sink_free(sink);
+
+	memset(file, 0, ret + 1);
+	if (pread(fileno(fp), file, ret + 1, 0) != ret ||
+	    strcmp(file, buf) != 0)
+		print_err("fd sink output differs from snprintf");
+	fclose(fp);
+
+	free(file);
+	nftnl_ruleset_free(rs);
+}
+
+static void test_parallel(uint32_t type)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_sink *serial, *parallel;
+	struct nftnl_expr *e;
+	struct nftnl_rule *r;
+	const char *a, *b;
+	size_t alen, blen;
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < 20000; i++) {
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, i);
+		e = nftnl_expr_alloc("counter");
+		nftnl_expr_set_u64(e, NFTNL_EXPR_CTR_PACKETS, i * 3);
+		nftnl_rule_add_expr(r, e);
+		nftnl_rule_list_add_tail(r, rl);
+	}
+	nftnl_set_list_add_tail(build_set(3), sl);
+	nftnl_set_list_add_tail(build_set(50000), sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	serial = nftnl_sink_alloc();
+	parallel = nftnl_sink_alloc();
+	ret = nftnl_ruleset_output(serial, rs, type, 0);
+	if (nftnl_ruleset_output_parallel(parallel, rs, type, 0, 4) != ret)
+		print_err("parallel output returned the wrong length");
+
+	a = nftnl_sink_buf(serial, &alen);
+	b = nftnl_sink_buf(parallel, &blen);
+	if (alen != blen || memcmp(a, b, alen) != 0)
+		print_err("parallel output differs");
+
+	nftnl_sink_free(serial);
+	nftnl_sink_free(parallel);
+	nftnl_ruleset_free(rs);
+}
+
+/* the buffer sink starts without a buffer and grows on demand */
+static void test_grow(void)
+{
+	struct nftnl_sink *sink = nftnl_sink_alloc();
+	const char *out;
+	size_t len;
+
+	if (sink == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	out = nftnl_sink_buf(sink, &len);
+	if (out == NULL || len != 0 || out[0] != '\0')
+		print_err("unexpected output of an empty sink");
+
+	memset(buf, 'x', 3 * 8192);
+	if (nftnl_sink_write(sink, "a", 1) < 0 ||
+	    nftnl_sink_write(sink, buf, 3 * 8192) < 0)
+		print_err("cannot write to the sink");
+
+	out = nftnl_sink_buf(sink, &len);
+	if (len != 1 + 3 * 8192 || out[0] != 'a' ||
+	    memcmp(out + 1, buf, 3 * 8192) != 0 || out[len] != '\0')
+		print_err("unexpected output after growing");
+
+	nftnl_sink_free(sink);
+}
+
+int main(int argc, char *argv[])
+{
+	test_set(NFTNL_OUTPUT_DEFAULT);
+	test_set(NFTNL_OUTPUT_JSON);
+	test_set_empty();
+	test_set(NFTNL_OUTPUT_XML);
+	test_set_json();
+	test_set_words();
+	test_grow();
+	test_ruleset();
+	test_parallel(NFTNL_OUTPUT_DEFAULT);
+	test_parallel(NFTNL_OUTPUT_JSON);
+	test_parallel(NFTNL_OUTPUT_XML);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
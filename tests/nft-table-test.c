@@ -37,6 +37,49 @@ static void cmp_nftnl_table(struct nftnl_table *a, struct nftnl_table *b)
 		print_err("tabke family mismatches");
 }
 
+static void test_list_lookup(void)
+{
+	struct nftnl_table_list *list;
+	struct nftnl_table *t;
+	char name[32];
+	int i;
+
+	list = nftnl_table_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	for (i = 0; i < 1000; i++) {
+		t = nftnl_table_alloc();
+		if (t == NULL) {
+			print_err("OOM");
+			goto out;
+		}
+		snprintf(name, sizeof(name), "table%d", i / 2);
+		nftnl_table_set_str(t, NFTNL_TABLE_NAME, name);
+		nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY,
+				    i % 2 ? AF_INET : AF_INET6);
+		nftnl_table_set_u32(t, NFTNL_TABLE_FLAGS, i);
+		nftnl_table_list_add(t, list);
+	}
+
+	t = nftnl_table_list_lookup_byname(list, AF_INET6, "table12");
+	if (t == NULL || nftnl_table_get_u32(t, NFTNL_TABLE_FLAGS) != 24)
+		print_err("Table lookup by name failed");
+
+	nftnl_table_list_del(t);
+	nftnl_table_free(t);
+	if (nftnl_table_list_lookup_byname(list, AF_INET6, "table12"))
+		print_err("Deleted table is still indexed");
+
+	t = nftnl_table_list_lookup_byname(list, AF_INET, "table12");
+	if (t == NULL || nftnl_table_get_u32(t, NFTNL_TABLE_FLAGS) != 25)
+		print_err("Table lookup by name ignores the family");
+out:
+	nftnl_table_list_free(list);
+}
+
 int main(int argc, char *argv[])
 {
 	char buf[4096];
@@ -66,6 +109,9 @@ int main(int argc, char *argv[])
 
 	nftnl_table_free(a);
 	nftnl_table_free(b);
+
+	test_list_lookup();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -19,6 +19,18 @@
 ./nft-expr_target-test
 ./nft-rule-test
 ./nft-set-test
+./nft-set-diff-test
+./nft-set-batch-test
+./nft-ruleset-diff-test
+./nft-ruleset-cache-test
+./nft-gen-test
+./nft-monitor-test
+./nft-coalesce-test
+./nft-ruleset-json-test
+./nft-cbor-test
+./nft-ruleset-snapshot-test
+./nft-ruleset-batch-test
+./nft-sink-test
 ./nft-table-test
 ./nft-parsing-test -d xmlfiles
 ./nft-parsing-test -d jsonfiles